@@ -0,0 +1,617 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * fax_channel_density.c - Measure how many concurrent FAX calls, and T.38
+ *                         gateway calls, a single core can sustain.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page fax_channel_density_page FAX channel density
+\section fax_channel_density_page_sec_1 What does it do?
+This is a load harness, rather than a test. It runs N complete FAX calls side
+by side, in simulated real time, and measures how much CPU they cost. Two
+arrangements are supported:
+
+    - "fax": FAX machine <-> FAX machine, as in fax_tests.
+    - "t38": FAX machine <-> T.38 gateway <-> T.38 gateway <-> FAX machine, as
+      in t38_gateway_tests, with the two gateways wired together through a
+      lossless local loopback.
+
+Each channel sends pages from ../test-data/itu/fax/itutests.tif. When a call
+finishes a new one is started on the same channel straight away, so the load
+stays constant for the whole run. All the channels start together, so their
+modem training and page phases line up, which is the worst case for the
+per-block load.
+
+The channels are processed in 20ms blocks (160 samples), with no sleeping
+between blocks. For each channel count the harness reports the CPU time used
+per channel, as a percentage of one core, the mean and worst case time taken
+to process one 20ms block across all the channels, the number of blocks which
+took longer than 20ms to process, the mean CPU cycles (as measured by
+rdtscll()) one channel takes to process one 20ms block, the peak memory used by
+the FAX and T.38 contexts of each channel, and the peak resident set size of
+the process. The channel count is doubled from 1 up to the maximum requested,
+and the lowest count at which a block overran its 20ms budget is reported at
+the end. The text report starts with the size of each of the main FAX related
+contexts.
+
+\section fax_channel_density_page_sec_2 How is it used?
+The options are:
+
+    - -c <channels> sets the maximum number of channels (default 64).
+    - -d <seconds> sets the simulated duration of each run (default 30).
+    - -e enables ECM.
+    - -f text|csv selects the output format.
+    - -m fax|t38 only runs one of the two arrangements.
+    - -p <pages> sets the number of pages sent in each call (default 2).
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define SAMPLES_PER_CHUNK       160
+
+/* The time available to process one block of SAMPLES_PER_CHUNK samples on every channel */
+#define BLOCK_BUDGET_US         (1000000*SAMPLES_PER_CHUNK/SAMPLE_RATE)
+
+#define INPUT_FILE_NAME         "../test-data/itu/fax/itutests.tif"
+#define OUTPUT_FILE_NAME        "fax_channel_density_%d.tif"
+
+#define MAX_QUEUED_PACKETS      32
+#define MAX_PACKET_LEN          512
+
+enum
+{
+    OUTPUT_TEXT = 0,
+    OUTPUT_CSV
+};
+
+enum
+{
+    MODE_FAX = 0x01,
+    MODE_T38 = 0x02
+};
+
+/* The packets sent by one gateway during a block, awaiting delivery to the other */
+typedef struct
+{
+    uint8_t buf[MAX_QUEUED_PACKETS][MAX_PACKET_LEN];
+    int len[MAX_QUEUED_PACKETS];
+    uint16_t seq_no[MAX_QUEUED_PACKETS];
+    int packets;
+    int dropped;
+} packet_queue_t;
+
+typedef struct
+{
+    int chan;
+    fax_state_t *fax[2];
+    t38_gateway_state_t *t38[2];
+    /*! Path 0 carries packets from gateway A to gateway B. Path 1 the reverse. */
+    packet_queue_t path[2];
+    int done[2];
+    int succeeded[2];
+    int calls_completed;
+    int calls_failed;
+} channel_t;
+
+typedef struct
+{
+    int channels;
+    double simulated_seconds;
+    double cpu_seconds;
+    double mean_block_us;
+    double max_block_us;
+    double mean_block_cycles;
+    int blocks;
+    int overruns;
+    int calls_completed;
+    int calls_failed;
+    int packets_dropped;
+    size_t peak_footprint;
+    long int peak_rss_kb;
+} density_result_t;
+
+static int pages_per_call = 2;
+static int use_ecm = FALSE;
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec*1000000 + tv.tv_usec;
+}
+/*- End of function --------------------------------------------------------*/
+
+static double cpu_seconds(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1000000.0
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static long int peak_rss_kb(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+/*- End of function --------------------------------------------------------*/
+
+static size_t channel_footprint(channel_t *ch)
+{
+    size_t len;
+    int i;
+
+    len = 0;
+    for (i = 0;  i < 2;  i++)
+    {
+        if (ch->fax[i])
+            len += fax_get_memory_footprint(ch->fax[i]);
+        if (ch->t38[i])
+            len += t38_gateway_get_memory_footprint(ch->t38[i]);
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void phase_e_handler(t30_state_t *s, void *user_data, int result)
+{
+    channel_t *ch;
+    t30_stats_t t;
+    int side;
+
+    ch = (channel_t *) user_data;
+    side = (s == fax_get_t30_state(ch->fax[0]))  ?  0  :  1;
+    t30_get_transfer_statistics(s, &t);
+    ch->succeeded[side] = (result == T30_ERR_OK)  &&  (t.pages_tx == pages_per_call  ||  t.pages_rx == pages_per_call);
+    ch->done[side] = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    packet_queue_t *queue;
+    int i;
+
+    /* Queue the packet, and its repeats, for delivery at the end of the block. Delivering
+       them immediately would recurse into the far gateway in the middle of its own
+       processing. */
+    queue = (packet_queue_t *) user_data;
+    for (i = 0;  i < count;  i++)
+    {
+        if (queue->packets >= MAX_QUEUED_PACKETS  ||  len > MAX_PACKET_LEN)
+        {
+            queue->dropped++;
+            continue;
+        }
+        memcpy(queue->buf[queue->packets], buf, len);
+        queue->len[queue->packets] = len;
+        queue->seq_no[queue->packets] = s->tx_seq_no;
+        queue->packets++;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int start_call(channel_t *ch, int mode)
+{
+    t30_state_t *t30;
+    char rx_file[64];
+    int i;
+
+    snprintf(rx_file, sizeof(rx_file), OUTPUT_FILE_NAME, ch->chan);
+    for (i = 0;  i < 2;  i++)
+    {
+        if ((ch->fax[i] = fax_init(NULL, (i == 0))) == NULL)
+            return -1;
+        t30 = fax_get_t30_state(ch->fax[i]);
+        fax_set_transmit_on_idle(ch->fax[i], TRUE);
+        t30_set_tx_ident(t30, (i == 0)  ?  "11111111"  :  "22222222");
+        t30_set_phase_e_handler(t30, phase_e_handler, (void *) ch);
+        t30_set_ecm_capability(t30, use_ecm);
+        if (use_ecm)
+            t30_set_supported_compressions(t30, T30_SUPPORT_T4_1D_COMPRESSION | T30_SUPPORT_T4_2D_COMPRESSION | T30_SUPPORT_T6_COMPRESSION);
+        if (i == 0)
+            t30_set_tx_file(t30, INPUT_FILE_NAME, 0, pages_per_call - 1);
+        else
+            t30_set_rx_file(t30, rx_file, -1);
+        ch->done[i] = FALSE;
+        ch->succeeded[i] = FALSE;
+        ch->path[i].packets = 0;
+        ch->t38[i] = NULL;
+    }
+    if (mode == MODE_T38)
+    {
+        for (i = 0;  i < 2;  i++)
+        {
+            if ((ch->t38[i] = t38_gateway_init(NULL, tx_packet_handler, (void *) &ch->path[i])) == NULL)
+                return -1;
+            t38_gateway_set_transmit_on_idle(ch->t38[i], TRUE);
+            t38_gateway_set_ecm_capability(ch->t38[i], use_ecm);
+        }
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void release_call(channel_t *ch)
+{
+    int i;
+
+    for (i = 0;  i < 2;  i++)
+    {
+        if (ch->fax[i])
+        {
+            fax_free(ch->fax[i]);
+            ch->fax[i] = NULL;
+        }
+        if (ch->t38[i])
+        {
+            t38_gateway_free(ch->t38[i]);
+            ch->t38[i] = NULL;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_call(channel_t *ch)
+{
+    if (ch->succeeded[0]  &&  ch->succeeded[1])
+        ch->calls_completed++;
+    else
+        ch->calls_failed++;
+    release_call(ch);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void run_fax_block(channel_t *ch)
+{
+    int16_t amp[2][SAMPLES_PER_CHUNK];
+    int i;
+    int len;
+
+    for (i = 0;  i < 2;  i++)
+    {
+        len = fax_tx(ch->fax[i], amp[i], SAMPLES_PER_CHUNK);
+        if (len < SAMPLES_PER_CHUNK)
+            memset(amp[i] + len, 0, sizeof(int16_t)*(SAMPLES_PER_CHUNK - len));
+    }
+    fax_rx(ch->fax[0], amp[1], SAMPLES_PER_CHUNK);
+    fax_rx(ch->fax[1], amp[0], SAMPLES_PER_CHUNK);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void run_t38_block(channel_t *ch)
+{
+    int16_t fax_amp[SAMPLES_PER_CHUNK];
+    int16_t t38_amp[SAMPLES_PER_CHUNK];
+    t38_core_state_t *t38_core;
+    packet_queue_t *queue;
+    int i;
+    int j;
+    int len;
+
+    for (i = 0;  i < 2;  i++)
+    {
+        len = fax_tx(ch->fax[i], fax_amp, SAMPLES_PER_CHUNK);
+        if (len < SAMPLES_PER_CHUNK)
+            memset(fax_amp + len, 0, sizeof(int16_t)*(SAMPLES_PER_CHUNK - len));
+        t38_gateway_rx(ch->t38[i], fax_amp, SAMPLES_PER_CHUNK);
+        len = t38_gateway_tx(ch->t38[i], t38_amp, SAMPLES_PER_CHUNK);
+        if (len < SAMPLES_PER_CHUNK)
+            memset(t38_amp + len, 0, sizeof(int16_t)*(SAMPLES_PER_CHUNK - len));
+        fax_rx(ch->fax[i], t38_amp, SAMPLES_PER_CHUNK);
+    }
+    /* Deliver this block's packets to the far gateway */
+    for (i = 0;  i < 2;  i++)
+    {
+        queue = &ch->path[i];
+        t38_core = t38_gateway_get_t38_core_state(ch->t38[i ^ 1]);
+        for (j = 0;  j < queue->packets;  j++)
+            t38_core_rx_ifp_packet(t38_core, queue->buf[j], queue->len[j], queue->seq_no[j]);
+        queue->packets = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_density(int mode, int channels, double duration, density_result_t *result)
+{
+    channel_t *chans;
+    uint64_t start;
+    uint64_t block_us;
+    uint64_t total_us;
+    uint64_t start_cycles;
+    uint64_t total_cycles;
+    size_t footprint;
+    double start_cpu;
+    int blocks;
+    int i;
+    int j;
+
+    if ((chans = (channel_t *) calloc(channels, sizeof(*chans))) == NULL)
+        return -1;
+    for (i = 0;  i < channels;  i++)
+    {
+        chans[i].chan = i;
+        if (start_call(&chans[i], mode))
+        {
+            fprintf(stderr, "    Cannot start a call on channel %d\n", i);
+            exit(2);
+        }
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->channels = channels;
+    blocks = duration*SAMPLE_RATE/SAMPLES_PER_CHUNK;
+    total_us = 0;
+    total_cycles = 0;
+    start_cpu = cpu_seconds();
+    for (j = 0;  j < blocks;  j++)
+    {
+        start = now_us();
+        footprint = 0;
+        for (i = 0;  i < channels;  i++)
+        {
+            start_cycles = rdtscll();
+            if (mode == MODE_T38)
+                run_t38_block(&chans[i]);
+            else
+                run_fax_block(&chans[i]);
+            total_cycles += rdtscll() - start_cycles;
+            if (chans[i].done[0]  &&  chans[i].done[1])
+            {
+                /* Keep the channel busy with back to back calls */
+                end_call(&chans[i]);
+                if (start_call(&chans[i], mode))
+                {
+                    fprintf(stderr, "    Cannot restart a call on channel %d\n", i);
+                    exit(2);
+                }
+            }
+            footprint += channel_footprint(&chans[i]);
+        }
+        block_us = now_us() - start;
+        if (footprint > result->peak_footprint)
+            result->peak_footprint = footprint;
+        total_us += block_us;
+        if (block_us > result->max_block_us)
+            result->max_block_us = block_us;
+        if (block_us > BLOCK_BUDGET_US)
+            result->overruns++;
+    }
+    result->cpu_seconds = cpu_seconds() - start_cpu;
+    result->peak_rss_kb = peak_rss_kb();
+    result->blocks = blocks;
+    result->simulated_seconds = (double) blocks*SAMPLES_PER_CHUNK/SAMPLE_RATE;
+    result->mean_block_us = (blocks > 0)  ?  (double) total_us/blocks  :  0.0;
+    result->mean_block_cycles = (blocks > 0)  ?  (double) total_cycles/((double) blocks*channels)  :  0.0;
+
+    for (i = 0;  i < channels;  i++)
+    {
+        /* Calls still in progress at the end of the run are not counted */
+        release_call(&chans[i]);
+        result->calls_completed += chans[i].calls_completed;
+        result->calls_failed += chans[i].calls_failed;
+        result->packets_dropped += chans[i].path[0].dropped + chans[i].path[1].dropped;
+    }
+    free(chans);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_context_sizes(void)
+{
+    printf("Context sizes, in bytes\n");
+    printf("    %-24s %8d\n", "fax_state_t", (int) sizeof(fax_state_t));
+    printf("    %-24s %8d\n", "t30_state_t", (int) sizeof(t30_state_t));
+    printf("    %-24s %8d\n", "fax_modems_state_t", (int) sizeof(fax_modems_state_t));
+    printf("    %-24s %8d\n", "t31_state_t", (int) sizeof(t31_state_t));
+    printf("    %-24s %8d\n", "t38_gateway_state_t", (int) sizeof(t38_gateway_state_t));
+    printf("    %-24s %8d\n", "t38_terminal_state_t", (int) sizeof(t38_terminal_state_t));
+    printf("    %-24s %8d\n", "v17_rx_state_t", (int) sizeof(v17_rx_state_t));
+    printf("    %-24s %8d\n", "v29_rx_state_t", (int) sizeof(v29_rx_state_t));
+    printf("    %-24s %8d\n", "v27ter_rx_state_t", (int) sizeof(v27ter_rx_state_t));
+    printf("    %-24s %8d\n", "fsk_rx_state_t", (int) sizeof(fsk_rx_state_t));
+    printf("    %-24s %8d\n", "hdlc_rx_state_t", (int) sizeof(hdlc_rx_state_t));
+    printf("\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_header(int format)
+{
+    if (format == OUTPUT_CSV)
+    {
+        printf("mode,channels,simulated_seconds,cpu_seconds,cpu_per_channel_percent,mean_block_ms,max_block_ms,mean_channel_block_cycles,"
+               "overruns,calls_completed,calls_failed,packets_dropped,peak_kb_per_channel,peak_rss_kb\n");
+        return;
+    }
+    printf("%-4s %8s %10s %10s %10s %12s %10s %9s %8s %7s %10s %12s\n",
+           "Mode", "Channels", "CPU/chan %", "Mean ms", "Max ms", "Cycles/chan", "Overruns", "Calls OK", "Failed", "Dropped", "kB/chan", "Peak RSS kB");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_result(int format, const char *tag, const density_result_t *r)
+{
+    double per_channel;
+    double kb_per_channel;
+
+    kb_per_channel = (r->channels > 0)  ?  r->peak_footprint/(1024.0*r->channels)  :  0.0;
+    per_channel = (r->simulated_seconds > 0.0)  ?  100.0*r->cpu_seconds/(r->simulated_seconds*r->channels)  :  0.0;
+    if (format == OUTPUT_CSV)
+    {
+        printf("%s,%d,%.2f,%.3f,%.3f,%.3f,%.3f,%.0f,%d,%d,%d,%d,%.1f,%ld\n",
+               tag,
+               r->channels,
+               r->simulated_seconds,
+               r->cpu_seconds,
+               per_channel,
+               r->mean_block_us/1000.0,
+               r->max_block_us/1000.0,
+               r->mean_block_cycles,
+               r->overruns,
+               r->calls_completed,
+               r->calls_failed,
+               r->packets_dropped,
+               kb_per_channel,
+               r->peak_rss_kb);
+        return;
+    }
+    printf("%-4s %8d %10.3f %10.3f %10.3f %12.0f %10d %9d %8d %7d %10.1f %12ld\n",
+           tag,
+           r->channels,
+           per_channel,
+           r->mean_block_us/1000.0,
+           r->max_block_us/1000.0,
+           r->mean_block_cycles,
+           r->overruns,
+           r->calls_completed,
+           r->calls_failed,
+           r->packets_dropped,
+           kb_per_channel,
+           r->peak_rss_kb);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void run_sweep(int format, int mode, int max_channels, double duration)
+{
+    density_result_t result;
+    const char *tag;
+    int first_overrun;
+    int channels;
+    double per_channel_us;
+
+    tag = (mode == MODE_T38)  ?  "t38"  :  "fax";
+    first_overrun = -1;
+    per_channel_us = 0.0;
+    for (channels = 1;  ;  channels *= 2)
+    {
+        if (channels > max_channels)
+            channels = max_channels;
+        if (run_density(mode, channels, duration, &result))
+        {
+            fprintf(stderr, "    Out of memory at %d channels\n", channels);
+            exit(2);
+        }
+        report_result(format, tag, &result);
+        if (result.overruns  &&  first_overrun < 0)
+            first_overrun = channels;
+        per_channel_us = result.mean_block_us/channels;
+        if (channels >= max_channels)
+            break;
+    }
+    if (format != OUTPUT_TEXT)
+        return;
+    if (first_overrun > 0)
+        printf("%s: a 20ms block first overran its budget with %d channels\n", tag, first_overrun);
+    else
+        printf("%s: no 20ms block overran its budget with up to %d channels\n", tag, max_channels);
+    if (per_channel_us > 0.0)
+        printf("%s: the mean block time suggests about %.0f channels per core\n", tag, BLOCK_BUDGET_US/per_channel_us);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    double duration;
+    int max_channels;
+    int modes;
+    int format;
+    int opt;
+
+    max_channels = 64;
+    duration = 30.0;
+    modes = MODE_FAX | MODE_T38;
+    format = OUTPUT_TEXT;
+    while ((opt = getopt(argc, argv, "c:d:ef:m:p:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            max_channels = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'e':
+            use_ecm = TRUE;
+            break;
+        case 'f':
+            format = (strcmp(optarg, "csv") == 0)  ?  OUTPUT_CSV  :  OUTPUT_TEXT;
+            break;
+        case 'm':
+            if (strcmp(optarg, "fax") == 0)
+                modes = MODE_FAX;
+            else if (strcmp(optarg, "t38") == 0)
+                modes = MODE_T38;
+            break;
+        case 'p':
+            pages_per_call = atoi(optarg);
+            break;
+        default:
+            //usage();
+            exit(2);
+            break;
+        }
+    }
+    if (max_channels < 1  ||  pages_per_call < 1  ||  duration <= 0.0)
+    {
+        fprintf(stderr, "    Bad parameters\n");
+        exit(2);
+    }
+    if (access(INPUT_FILE_NAME, R_OK))
+    {
+        fprintf(stderr, "    Cannot open '%s'\n", INPUT_FILE_NAME);
+        exit(2);
+    }
+
+    if (format == OUTPUT_TEXT)
+        report_context_sizes();
+    report_header(format);
+    if ((modes & MODE_FAX))
+        run_sweep(format, MODE_FAX, max_channels, duration);
+    if ((modes & MODE_T38))
+        run_sweep(format, MODE_T38, max_channels, duration);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,1136 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * module_benchmarks.c - Cycle counting benchmarks for the hot paths of
+ *                       the main spandsp modules.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page module_benchmarks_page Module benchmarks
+\section module_benchmarks_page_sec_1 What does it do?
+These benchmarks drive the main per-sample and per-octet entry points of the
+library (DTMF detection, echo cancellation, the speech codecs, the FAX modem
+receivers, T.4 compression and decompression, HDLC reception, the CRC
+routines and V.42bis compression) over canned data. For each one they report
+the CPU cycles consumed per unit of work, as measured by rdtscll(), the
+number of units processed per second of wall clock time, and the number of
+real time channels a single core could sustain.
+
+\section module_benchmarks_page_sec_2 How is it used?
+Running module_benchmarks with no parameters runs every benchmark, and
+prints a human readable table. The options are:
+
+    - -f text|csv|json selects the output format. The CSV and JSON forms are
+      intended to be captured, and compared between releases.
+    - -m <name> only runs the benchmarks whose name starts with <name>.
+    - -t <seconds> sets the minimum time each benchmark runs for (default 1).
+    - -l lists the available benchmarks.
+
+The speech based benchmarks use ../test-data/local/short_nb_voice.wav and
+../test-data/local/short_wb_voice.wav. The T.4 benchmarks use
+../test-data/itu/fax/itutests.tif, and are skipped if that file is not present.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sndfile.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+#include "spandsp-sim.h"
+
+#define NB_IN_FILE_NAME     "../test-data/local/short_nb_voice.wav"
+#define WB_IN_FILE_NAME     "../test-data/local/short_wb_voice.wav"
+#define T4_IN_FILE_NAME     "../test-data/itu/fax/itutests.tif"
+
+#define G722_SAMPLE_RATE    16000
+
+/* The modem benchmarks run over this much synthesised line signal */
+#define MODEM_SIGNAL_SAMPLES    (SAMPLE_RATE*10)
+
+/* Audio is fed to the modules in the block size typical of a 20ms media stream */
+#define BLOCK_LEN           160
+
+#define CRC_BUF_LEN         65536
+#define CRC_FRAME_LEN       256
+#define HDLC_BUF_LEN        65536
+#define V42BIS_BUF_LEN      65536
+#define T4_MAX_CHUNKS       4096
+#define T4_CHUNK_LEN        256
+
+enum
+{
+    OUTPUT_TEXT = 0,
+    OUTPUT_CSV,
+    OUTPUT_JSON
+};
+
+typedef struct
+{
+    /*! The name used to identify the benchmark */
+    const char *name;
+    /*! The unit in which work is counted (e.g. sample, byte) */
+    const char *unit;
+    /*! The number of units per second which make one real time channel */
+    int units_per_channel_second;
+    /*! Prepare the canned data. Returns -1 if the benchmark cannot be run. */
+    int (*setup)(void);
+    /*! Make one pass over the canned data, returning the number of units processed. */
+    int (*run)(void);
+} benchmark_t;
+
+static int16_t *nb_audio = NULL;
+static int nb_audio_len = 0;
+static int16_t *wb_audio = NULL;
+static int wb_audio_len = 0;
+
+static int16_t *work_audio = NULL;
+static uint8_t *work_codes = NULL;
+static int work_codes_len = 0;
+static int16_t *wb_work_audio = NULL;
+static uint8_t *wb_work_codes = NULL;
+static int wb_work_codes_len = 0;
+
+static uint8_t *ulaw_codes = NULL;
+static uint8_t *alaw_codes = NULL;
+
+static int16_t *dtmf_signal = NULL;
+static int16_t *echo_rx_signal = NULL;
+static int16_t *v17_signal = NULL;
+static int16_t *v29_signal = NULL;
+static int16_t *v27ter_signal = NULL;
+
+static uint8_t *crc_buf = NULL;
+static uint8_t *hdlc_buf = NULL;
+static int hdlc_buf_len = 0;
+static uint8_t *v42bis_buf = NULL;
+
+static uint8_t *t4_data = NULL;
+static int t4_chunk_lens[T4_MAX_CHUNKS];
+static int t4_chunks = 0;
+static int t4_image_width;
+static int t4_x_resolution;
+static int t4_y_resolution;
+
+static volatile int sink;
+
+/* Use a local random generator, so the results are consistent across platforms. */
+static int my_rand(void)
+{
+    static int rndnum = 1234567;
+
+    return (rndnum = 1664525U*rndnum + 1013904223U) >> 8;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec*1000000 + tv.tv_usec;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int load_audio(const char *name, int rate, int16_t **buf)
+{
+    SNDFILE *inhandle;
+    SF_INFO info;
+    int len;
+
+    memset(&info, 0, sizeof(info));
+    if ((inhandle = sf_open(name, SFM_READ, &info)) == NULL)
+    {
+        fprintf(stderr, "    Cannot open audio file '%s'\n", name);
+        return -1;
+    }
+    if (info.samplerate != rate  ||  info.channels != 1)
+    {
+        fprintf(stderr, "    Unexpected format in audio file '%s'\n", name);
+        sf_close(inhandle);
+        return -1;
+    }
+    if ((*buf = (int16_t *) malloc(info.frames*sizeof(int16_t))) == NULL)
+    {
+        sf_close(inhandle);
+        return -1;
+    }
+    len = sf_readf_short(inhandle, *buf, info.frames);
+    sf_close(inhandle);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_nb_audio(void)
+{
+    if (nb_audio)
+        return 0;
+    if ((nb_audio_len = load_audio(NB_IN_FILE_NAME, SAMPLE_RATE, &nb_audio)) <= 0)
+        return -1;
+    /* Trim to a whole number of GSM 06.10 (160 sample) and LPC-10 (180 sample) frames */
+    nb_audio_len -= nb_audio_len%1440;
+    /* Working buffers, big enough for any of the codecs' output */
+    work_audio = (int16_t *) malloc(nb_audio_len*sizeof(int16_t));
+    work_codes = (uint8_t *) malloc(nb_audio_len*sizeof(int16_t));
+    if (work_audio == NULL  ||  work_codes == NULL)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_wb_audio(void)
+{
+    if (wb_audio)
+        return 0;
+    if ((wb_audio_len = load_audio(WB_IN_FILE_NAME, G722_SAMPLE_RATE, &wb_audio)) <= 0)
+        return -1;
+    /* The G.722 encoder works on pairs of samples */
+    wb_audio_len &= ~1;
+    wb_work_audio = (int16_t *) malloc(wb_audio_len*sizeof(int16_t));
+    wb_work_codes = (uint8_t *) malloc(wb_audio_len);
+    if (wb_work_audio == NULL  ||  wb_work_codes == NULL)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int get_random_bit(void *user_data)
+{
+    return my_rand() & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void put_bit_sink(void *user_data, int bit)
+{
+    sink += bit;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void digits_sink(void *user_data, const char *digits, int len)
+{
+    sink += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void hdlc_frame_sink(void *user_data, const uint8_t *msg, int len, int ok)
+{
+    sink += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void v42bis_frame_sink(void *user_data, const uint8_t *msg, int len)
+{
+    sink += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t4_row_sink(void *user_data, const uint8_t buf[], size_t len)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_dtmf_rx(void)
+{
+    dtmf_tx_state_t *gen;
+    int16_t tones[BLOCK_LEN];
+    int i;
+    int j;
+    int len;
+
+    if (setup_nb_audio())
+        return -1;
+    if ((dtmf_signal = (int16_t *) malloc(nb_audio_len*sizeof(int16_t))) == NULL)
+        return -1;
+    /* Speech, with bursts of digits mixed in */
+    gen = dtmf_tx_init(NULL);
+    for (i = 0;  i < nb_audio_len;  i += BLOCK_LEN)
+    {
+        if ((i % (SAMPLE_RATE*2)) == 0)
+            dtmf_tx_put(gen, "1234567890*#ABCD", -1);
+        len = dtmf_tx(gen, tones, BLOCK_LEN);
+        for (j = 0;  j < BLOCK_LEN  &&  i + j < nb_audio_len;  j++)
+            dtmf_signal[i + j] = saturate(nb_audio[i + j]/4 + ((j < len)  ?  tones[j]  :  0));
+    }
+    dtmf_tx_free(gen);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_dtmf_rx(void)
+{
+    dtmf_rx_state_t *s;
+    int i;
+    int len;
+
+    s = dtmf_rx_init(NULL, digits_sink, NULL);
+    for (i = 0;  i < nb_audio_len;  i += len)
+    {
+        len = (nb_audio_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (nb_audio_len - i);
+        dtmf_rx(s, &dtmf_signal[i], len);
+    }
+    dtmf_rx_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_dtmf_rx_bank(void)
+{
+    dtmf_rx_bank_t *s;
+    const int16_t *amp[DTMF_RX_BANK_MAX_CHANNELS];
+    int i;
+    int ch;
+    int len;
+
+    /* A full bank, with every channel hearing the same signal */
+    s = dtmf_rx_bank_init(NULL, DTMF_RX_BANK_MAX_CHANNELS, digits_sink, NULL);
+    for (i = 0;  i < nb_audio_len;  i += len)
+    {
+        len = (nb_audio_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (nb_audio_len - i);
+        for (ch = 0;  ch < DTMF_RX_BANK_MAX_CHANNELS;  ch++)
+            amp[ch] = &dtmf_signal[i];
+        dtmf_rx_bank(s, amp, len);
+    }
+    dtmf_rx_bank_free(s);
+    return nb_audio_len*DTMF_RX_BANK_MAX_CHANNELS;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_echo_can(void)
+{
+    int i;
+
+    if (setup_nb_audio())
+        return -1;
+    if ((echo_rx_signal = (int16_t *) malloc(nb_audio_len*sizeof(int16_t))) == NULL)
+        return -1;
+    /* A crude hybrid: the transmitted speech, delayed and attenuated, plus a little noise */
+    for (i = 0;  i < nb_audio_len;  i++)
+        echo_rx_signal[i] = ((i >= 80)  ?  nb_audio[i - 80]/8  :  0) + (my_rand() & 0x3F) - 0x20;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_echo_can_128ms(void)
+{
+    echo_can_state_t *ec;
+    int i;
+
+    ec = echo_can_init(1024, ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_NLP | ECHO_CAN_USE_CNG | ECHO_CAN_USE_TX_HPF | ECHO_CAN_USE_RX_HPF);
+    for (i = 0;  i < nb_audio_len;  i++)
+        work_audio[i] = echo_can_update(ec, nb_audio[i], echo_rx_signal[i]);
+    echo_can_free(ec);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_echo_can_fdaf_512ms(void)
+{
+    echo_can_state_t *ec;
+    int i;
+
+    ec = echo_can_init(4096, ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_NLP | ECHO_CAN_USE_CNG | ECHO_CAN_USE_TX_HPF | ECHO_CAN_USE_RX_HPF | ECHO_CAN_USE_FREQ_DOMAIN);
+    for (i = 0;  i < nb_audio_len;  i++)
+        work_audio[i] = echo_can_update(ec, nb_audio[i], echo_rx_signal[i]);
+    echo_can_free(ec);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_g711(void)
+{
+    g711_state_t *s;
+
+    if (setup_nb_audio())
+        return -1;
+    if (ulaw_codes)
+        return 0;
+    ulaw_codes = (uint8_t *) malloc(nb_audio_len);
+    alaw_codes = (uint8_t *) malloc(nb_audio_len);
+    if (ulaw_codes == NULL  ||  alaw_codes == NULL)
+        return -1;
+    s = g711_init(NULL, G711_ULAW);
+    g711_encode(s, ulaw_codes, nb_audio, nb_audio_len);
+    g711_free(s);
+    s = g711_init(NULL, G711_ALAW);
+    g711_encode(s, alaw_codes, nb_audio, nb_audio_len);
+    g711_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_encode(int mode)
+{
+    g711_state_t *s;
+    int i;
+    int len;
+
+    s = g711_init(NULL, mode);
+    for (i = 0;  i < nb_audio_len;  i += len)
+    {
+        len = (nb_audio_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (nb_audio_len - i);
+        g711_encode(s, &work_codes[i], &nb_audio[i], len);
+    }
+    g711_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_decode(int mode, const uint8_t codes[])
+{
+    g711_state_t *s;
+    int i;
+    int len;
+
+    s = g711_init(NULL, mode);
+    for (i = 0;  i < nb_audio_len;  i += len)
+    {
+        len = (nb_audio_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (nb_audio_len - i);
+        g711_decode(s, &work_audio[i], &codes[i], len);
+    }
+    g711_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_ulaw_encode(void)
+{
+    return run_g711_encode(G711_ULAW);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_ulaw_decode(void)
+{
+    return run_g711_decode(G711_ULAW, ulaw_codes);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_alaw_encode(void)
+{
+    return run_g711_encode(G711_ALAW);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g711_alaw_decode(void)
+{
+    return run_g711_decode(G711_ALAW, alaw_codes);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_g722(void)
+{
+    g722_encode_state_t *enc;
+
+    if (setup_wb_audio())
+        return -1;
+    enc = g722_encode_init(NULL, 64000, 0);
+    wb_work_codes_len = g722_encode(enc, wb_work_codes, wb_audio, wb_audio_len);
+    g722_encode_free(enc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g722_encode(void)
+{
+    g722_encode_state_t *s;
+    int i;
+    int len;
+
+    s = g722_encode_init(NULL, 64000, 0);
+    for (i = 0;  i < wb_audio_len;  i += len)
+    {
+        len = (wb_audio_len - i > 2*BLOCK_LEN)  ?  2*BLOCK_LEN  :  (wb_audio_len - i);
+        g722_encode(s, &wb_work_codes[i >> 1], &wb_audio[i], len);
+    }
+    g722_encode_free(s);
+    return wb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g722_decode(void)
+{
+    g722_decode_state_t *s;
+    int i;
+    int len;
+
+    s = g722_decode_init(NULL, 64000, 0);
+    for (i = 0;  i < wb_work_codes_len;  i += len)
+    {
+        len = (wb_work_codes_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (wb_work_codes_len - i);
+        g722_decode(s, &wb_work_audio[i << 1], &wb_work_codes[i], len);
+    }
+    g722_decode_free(s);
+    return 2*wb_work_codes_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_g726(void)
+{
+    g726_state_t *enc;
+
+    if (setup_nb_audio())
+        return -1;
+    enc = g726_init(NULL, 32000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+    work_codes_len = g726_encode(enc, work_codes, nb_audio, nb_audio_len);
+    g726_free(enc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g726_encode(void)
+{
+    g726_state_t *s;
+    int i;
+    int len;
+
+    s = g726_init(NULL, 32000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+    for (i = 0;  i < nb_audio_len;  i += len)
+    {
+        len = (nb_audio_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (nb_audio_len - i);
+        g726_encode(s, &work_codes[i], &nb_audio[i], len);
+    }
+    g726_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_g726_decode(void)
+{
+    g726_state_t *s;
+    int i;
+    int len;
+
+    s = g726_init(NULL, 32000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+    for (i = 0;  i < work_codes_len;  i += len)
+    {
+        len = (work_codes_len - i > BLOCK_LEN)  ?  BLOCK_LEN  :  (work_codes_len - i);
+        g726_decode(s, &work_audio[i], &work_codes[i], len);
+    }
+    g726_free(s);
+    return work_codes_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_gsm0610(void)
+{
+    gsm0610_state_t *enc;
+
+    if (setup_nb_audio())
+        return -1;
+    enc = gsm0610_init(NULL, GSM0610_PACKING_VOIP);
+    work_codes_len = gsm0610_encode(enc, work_codes, nb_audio, nb_audio_len);
+    gsm0610_free(enc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_gsm0610_encode(void)
+{
+    gsm0610_state_t *s;
+    int i;
+    int j;
+
+    s = gsm0610_init(NULL, GSM0610_PACKING_VOIP);
+    for (i = 0, j = 0;  i < nb_audio_len;  i += 160)
+        j += gsm0610_encode(s, &work_codes[j], &nb_audio[i], 160);
+    gsm0610_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_gsm0610_decode(void)
+{
+    gsm0610_state_t *s;
+    int i;
+    int j;
+
+    s = gsm0610_init(NULL, GSM0610_PACKING_VOIP);
+    for (i = 0, j = 0;  i < work_codes_len;  i += 33)
+        j += gsm0610_decode(s, &work_audio[j], &work_codes[i], 33);
+    gsm0610_free(s);
+    return j;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_lpc10(void)
+{
+    lpc10_encode_state_t *enc;
+
+    if (setup_nb_audio())
+        return -1;
+    enc = lpc10_encode_init(NULL, TRUE);
+    work_codes_len = lpc10_encode(enc, work_codes, nb_audio, nb_audio_len);
+    lpc10_encode_free(enc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_lpc10_encode(void)
+{
+    lpc10_encode_state_t *s;
+    int i;
+    int j;
+
+    s = lpc10_encode_init(NULL, TRUE);
+    for (i = 0, j = 0;  i < nb_audio_len;  i += 180)
+        j += lpc10_encode(s, &work_codes[j], &nb_audio[i], 180);
+    lpc10_encode_free(s);
+    return nb_audio_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_lpc10_decode(void)
+{
+    lpc10_decode_state_t *s;
+    int i;
+    int j;
+
+    s = lpc10_decode_init(NULL, TRUE);
+    for (i = 0, j = 0;  i < work_codes_len;  i += 7)
+        j += lpc10_decode(s, &work_audio[j], &work_codes[i], 7);
+    lpc10_decode_free(s);
+    return j;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_v17_rx(void)
+{
+    v17_tx_state_t *tx;
+    int i;
+
+    if ((v17_signal = (int16_t *) malloc(MODEM_SIGNAL_SAMPLES*sizeof(int16_t))) == NULL)
+        return -1;
+    tx = v17_tx_init(NULL, 14400, FALSE, get_random_bit, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v17_tx(tx, &v17_signal[i], BLOCK_LEN);
+    v17_tx_free(tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_v17_rx(void)
+{
+    v17_rx_state_t *s;
+    int i;
+
+    s = v17_rx_init(NULL, 14400, put_bit_sink, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v17_rx(s, &v17_signal[i], BLOCK_LEN);
+    v17_rx_free(s);
+    return MODEM_SIGNAL_SAMPLES;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_v29_rx(void)
+{
+    v29_tx_state_t *tx;
+    int i;
+
+    if ((v29_signal = (int16_t *) malloc(MODEM_SIGNAL_SAMPLES*sizeof(int16_t))) == NULL)
+        return -1;
+    tx = v29_tx_init(NULL, 9600, FALSE, get_random_bit, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v29_tx(tx, &v29_signal[i], BLOCK_LEN);
+    v29_tx_free(tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_v29_rx(void)
+{
+    v29_rx_state_t *s;
+    int i;
+
+    s = v29_rx_init(NULL, 9600, put_bit_sink, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v29_rx(s, &v29_signal[i], BLOCK_LEN);
+    v29_rx_free(s);
+    return MODEM_SIGNAL_SAMPLES;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_v27ter_rx(void)
+{
+    v27ter_tx_state_t *tx;
+    int i;
+
+    if ((v27ter_signal = (int16_t *) malloc(MODEM_SIGNAL_SAMPLES*sizeof(int16_t))) == NULL)
+        return -1;
+    tx = v27ter_tx_init(NULL, 4800, FALSE, get_random_bit, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v27ter_tx(tx, &v27ter_signal[i], BLOCK_LEN);
+    v27ter_tx_free(tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_v27ter_rx(void)
+{
+    v27ter_rx_state_t *s;
+    int i;
+
+    s = v27ter_rx_init(NULL, 4800, put_bit_sink, NULL);
+    for (i = 0;  i < MODEM_SIGNAL_SAMPLES;  i += BLOCK_LEN)
+        v27ter_rx(s, &v27ter_signal[i], BLOCK_LEN);
+    v27ter_rx_free(s);
+    return MODEM_SIGNAL_SAMPLES;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t4_encode_document(int store)
+{
+    t4_tx_state_t *s;
+    uint8_t block[T4_CHUNK_LEN];
+    int total;
+    int len;
+    int pos;
+
+    if ((s = t4_tx_init(NULL, T4_IN_FILE_NAME, -1, -1)) == NULL)
+        return -1;
+    t4_tx_set_tx_encoding(s, T4_COMPRESSION_ITU_T6);
+    if (store)
+    {
+        t4_image_width = t4_tx_get_image_width(s);
+        t4_x_resolution = t4_tx_get_x_resolution(s);
+        t4_y_resolution = t4_tx_get_y_resolution(s);
+        t4_chunks = 0;
+    }
+    total = 0;
+    pos = 0;
+    /* Only the first page is used, so the receive side sees exactly one page per pass */
+    if (t4_tx_start_page(s) == 0)
+    {
+        while ((len = t4_tx_get_chunk(s, block, T4_CHUNK_LEN)) > 0)
+        {
+            if (store  &&  t4_chunks < T4_MAX_CHUNKS)
+            {
+                memcpy(&t4_data[pos], block, len);
+                t4_chunk_lens[t4_chunks++] = len;
+                pos += len;
+            }
+            total += len;
+            if (len < T4_CHUNK_LEN)
+                break;
+        }
+        t4_tx_end_page(s);
+    }
+    t4_tx_free(s);
+    return total;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_t4(void)
+{
+    if (t4_data)
+        return 0;
+    if ((t4_data = (uint8_t *) malloc(T4_MAX_CHUNKS*T4_CHUNK_LEN)) == NULL)
+        return -1;
+    if (t4_encode_document(TRUE) <= 0)
+    {
+        fprintf(stderr, "    Cannot use TIFF file '%s'\n", T4_IN_FILE_NAME);
+        free(t4_data);
+        t4_data = NULL;
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_t4_tx_get_chunk(void)
+{
+    return t4_encode_document(FALSE);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_t4_rx_put_chunk(void)
+{
+    t4_rx_state_t *s;
+    int i;
+    int pos;
+
+    if ((s = t4_rx_init(NULL, "module_benchmarks.tif", T4_COMPRESSION_ITU_T6)) == NULL)
+        return -1;
+    t4_rx_set_row_write_handler(s, t4_row_sink, NULL);
+    t4_rx_set_rx_encoding(s, T4_COMPRESSION_ITU_T6);
+    t4_rx_set_image_width(s, t4_image_width);
+    t4_rx_set_x_resolution(s, t4_x_resolution);
+    t4_rx_set_y_resolution(s, t4_y_resolution);
+    t4_rx_start_page(s);
+    for (i = 0, pos = 0;  i < t4_chunks;  i++)
+    {
+        if (t4_rx_put_chunk(s, &t4_data[pos], t4_chunk_lens[i]))
+            break;
+        pos += t4_chunk_lens[i];
+    }
+    t4_rx_end_page(s);
+    t4_rx_free(s);
+    return pos;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_hdlc_rx(void)
+{
+    hdlc_tx_state_t *tx;
+    uint8_t frame[260];
+    int i;
+    int len;
+    int frame_len;
+
+    if ((hdlc_buf = (uint8_t *) malloc(HDLC_BUF_LEN)) == NULL)
+        return -1;
+    /* Build a stream of back to back random frames, just as a modem would deliver it */
+    tx = hdlc_tx_init(NULL, TRUE, 2, FALSE, NULL, NULL);
+    hdlc_tx_flags(tx, 10);
+    frame_len = 0;
+    for (hdlc_buf_len = 0;  hdlc_buf_len < HDLC_BUF_LEN;  hdlc_buf_len += len)
+    {
+        if (frame_len == 0)
+        {
+            frame_len = (my_rand() & 0x7F) + 64;
+            for (i = 0;  i < frame_len;  i++)
+                frame[i] = my_rand();
+        }
+        /* This is refused while the previous frame is still going out */
+        if (hdlc_tx_frame(tx, frame, frame_len) == 0)
+            frame_len = 0;
+        len = (HDLC_BUF_LEN - hdlc_buf_len > 32)  ?  32  :  (HDLC_BUF_LEN - hdlc_buf_len);
+        len = hdlc_tx_get(tx, &hdlc_buf[hdlc_buf_len], len);
+        if (len <= 0)
+            break;
+    }
+    hdlc_tx_free(tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_hdlc_rx_put(void)
+{
+    hdlc_rx_state_t *s;
+    int i;
+    int len;
+
+    s = hdlc_rx_init(NULL, TRUE, FALSE, 2, hdlc_frame_sink, NULL);
+    for (i = 0;  i < hdlc_buf_len;  i += len)
+    {
+        len = (hdlc_buf_len - i > 64)  ?  64  :  (hdlc_buf_len - i);
+        hdlc_rx_put(s, &hdlc_buf[i], len);
+    }
+    hdlc_rx_free(s);
+    return hdlc_buf_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_crc(void)
+{
+    int i;
+
+    if (crc_buf)
+        return 0;
+    if ((crc_buf = (uint8_t *) malloc(CRC_BUF_LEN)) == NULL)
+        return -1;
+    for (i = 0;  i < CRC_BUF_LEN;  i++)
+        crc_buf[i] = my_rand();
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_crc_itu16(void)
+{
+    uint16_t crc;
+    int i;
+
+    crc = 0;
+    for (i = 0;  i < CRC_BUF_LEN;  i += CRC_FRAME_LEN)
+        crc += crc_itu16_calc(&crc_buf[i], CRC_FRAME_LEN, 0xFFFF);
+    sink += crc;
+    return CRC_BUF_LEN;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_crc_itu32(void)
+{
+    uint32_t crc;
+    int i;
+
+    crc = 0;
+    for (i = 0;  i < CRC_BUF_LEN;  i += CRC_FRAME_LEN)
+        crc += crc_itu32_calc(&crc_buf[i], CRC_FRAME_LEN, 0xFFFFFFFF);
+    sink += crc;
+    return CRC_BUF_LEN;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int setup_v42bis(void)
+{
+    static const char *words[] =
+    {
+        "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ",
+        "FAX ", "modem ", "compression ", "dictionary ", "string ", "\r\n", "0123456789 ", "spandsp "
+    };
+    const char *w;
+    int i;
+
+    if ((v42bis_buf = (uint8_t *) malloc(V42BIS_BUF_LEN)) == NULL)
+        return -1;
+    /* Compressible text, with enough variety to keep the dictionary busy */
+    for (i = 0;  i < V42BIS_BUF_LEN;  )
+    {
+        for (w = words[my_rand() & 0xF];  *w  &&  i < V42BIS_BUF_LEN;  w++)
+            v42bis_buf[i++] = *w;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_v42bis_compress(void)
+{
+    v42bis_state_t s;
+    int i;
+    int len;
+
+    /* v42bis_free() only frees the dictionaries, so use a local context */
+    v42bis_init(&s, 3, 512, 6, v42bis_frame_sink, NULL, 512, v42bis_frame_sink, NULL, 512);
+    for (i = 0;  i < V42BIS_BUF_LEN;  i += len)
+    {
+        len = (V42BIS_BUF_LEN - i > 256)  ?  256  :  (V42BIS_BUF_LEN - i);
+        v42bis_compress(&s, &v42bis_buf[i], len);
+    }
+    v42bis_compress_flush(&s);
+    v42bis_free(&s);
+    return V42BIS_BUF_LEN;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Audio benchmarks count samples, and a channel is one real time stream. The data path
+   benchmarks count octets, and a channel is a 64kbps stream (or a 14400bps V.17 FAX stream
+   for the T.4 image data). */
+static const benchmark_t benchmarks[] =
+{
+    {"dtmf_rx",             "sample",   SAMPLE_RATE,        setup_dtmf_rx,  run_dtmf_rx},
+    {"dtmf_rx_bank",        "sample",   SAMPLE_RATE,        setup_dtmf_rx,  run_dtmf_rx_bank},
+    {"echo_can_update",     "sample",   SAMPLE_RATE,        setup_echo_can, run_echo_can_128ms},
+    {"echo_can_fdaf_512ms", "sample",   SAMPLE_RATE,        setup_echo_can, run_echo_can_fdaf_512ms},
+    {"g711_ulaw_encode",    "sample",   SAMPLE_RATE,        setup_g711,     run_g711_ulaw_encode},
+    {"g711_ulaw_decode",    "sample",   SAMPLE_RATE,        setup_g711,     run_g711_ulaw_decode},
+    {"g711_alaw_encode",    "sample",   SAMPLE_RATE,        setup_g711,     run_g711_alaw_encode},
+    {"g711_alaw_decode",    "sample",   SAMPLE_RATE,        setup_g711,     run_g711_alaw_decode},
+    {"g722_encode",         "sample",   G722_SAMPLE_RATE,   setup_g722,     run_g722_encode},
+    {"g722_decode",         "sample",   G722_SAMPLE_RATE,   setup_g722,     run_g722_decode},
+    {"g726_encode",         "sample",   SAMPLE_RATE,        setup_g726,     run_g726_encode},
+    {"g726_decode",         "sample",   SAMPLE_RATE,        setup_g726,     run_g726_decode},
+    {"gsm0610_encode",      "sample",   SAMPLE_RATE,        setup_gsm0610,  run_gsm0610_encode},
+    {"gsm0610_decode",      "sample",   SAMPLE_RATE,        setup_gsm0610,  run_gsm0610_decode},
+    {"lpc10_encode",        "sample",   SAMPLE_RATE,        setup_lpc10,    run_lpc10_encode},
+    {"lpc10_decode",        "sample",   SAMPLE_RATE,        setup_lpc10,    run_lpc10_decode},
+    {"v17_rx",              "sample",   SAMPLE_RATE,        setup_v17_rx,   run_v17_rx},
+    {"v29_rx",              "sample",   SAMPLE_RATE,        setup_v29_rx,   run_v29_rx},
+    {"v27ter_rx",           "sample",   SAMPLE_RATE,        setup_v27ter_rx, run_v27ter_rx},
+    {"t4_tx_get_chunk",     "byte",     14400/8,            setup_t4,       run_t4_tx_get_chunk},
+    {"t4_rx_put_chunk",     "byte",     14400/8,            setup_t4,       run_t4_rx_put_chunk},
+    {"hdlc_rx_put",         "byte",     64000/8,            setup_hdlc_rx,  run_hdlc_rx_put},
+    {"crc_itu16_calc",      "byte",     64000/8,            setup_crc,      run_crc_itu16},
+    {"crc_itu32_calc",      "byte",     64000/8,            setup_crc,      run_crc_itu32},
+    {"v42bis_compress",     "byte",     64000/8,            setup_v42bis,   run_v42bis_compress},
+    {NULL, NULL, 0, NULL, NULL}
+};
+
+static void report_header(int format)
+{
+    switch (format)
+    {
+    case OUTPUT_CSV:
+        printf("module,unit,units,cycles,seconds,cycles_per_unit,units_per_second,channels_per_core\n");
+        break;
+    case OUTPUT_JSON:
+        printf("[\n");
+        break;
+    default:
+        printf("%-20s %-7s %14s %12s %16s %16s\n", "Module", "Unit", "Units", "Cycles/unit", "Units/s", "Channels/core");
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_result(int format,
+                          int first,
+                          const benchmark_t *b,
+                          int64_t units,
+                          uint64_t cycles,
+                          double seconds)
+{
+    double cycles_per_unit;
+    double units_per_second;
+    double channels;
+
+    cycles_per_unit = (units > 0)  ?  (double) cycles/units  :  0.0;
+    units_per_second = (seconds > 0.0)  ?  units/seconds  :  0.0;
+    channels = units_per_second/b->units_per_channel_second;
+    switch (format)
+    {
+    case OUTPUT_CSV:
+        printf("%s,%s,%lld,%llu,%.6f,%.3f,%.0f,%.1f\n",
+               b->name,
+               b->unit,
+               (long long int) units,
+               (unsigned long long int) cycles,
+               seconds,
+               cycles_per_unit,
+               units_per_second,
+               channels);
+        break;
+    case OUTPUT_JSON:
+        printf("%s    {\"module\": \"%s\", \"unit\": \"%s\", \"units\": %lld, \"cycles\": %llu, \"seconds\": %.6f, "
+               "\"cycles_per_unit\": %.3f, \"units_per_second\": %.0f, \"channels_per_core\": %.1f}",
+               (first)  ?  ""  :  ",\n",
+               b->name,
+               b->unit,
+               (long long int) units,
+               (unsigned long long int) cycles,
+               seconds,
+               cycles_per_unit,
+               units_per_second,
+               channels);
+        break;
+    default:
+        printf("%-20s %-7s %14lld %12.2f %16.0f %16.1f\n",
+               b->name,
+               b->unit,
+               (long long int) units,
+               cycles_per_unit,
+               units_per_second,
+               channels);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_footer(int format)
+{
+    if (format == OUTPUT_JSON)
+        printf("\n]\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_benchmark(const benchmark_t *b, int format, int first, double min_seconds)
+{
+    int64_t units;
+    uint64_t cycles;
+    uint64_t start_cycles;
+    uint64_t start_us;
+    uint64_t elapsed_us;
+    int res;
+
+    if (b->setup())
+    {
+        fprintf(stderr, "    Skipping %s - no test data\n", b->name);
+        return -1;
+    }
+    /* One untimed pass to warm up the caches, and settle any lazy initialisation */
+    if (b->run() < 0)
+    {
+        fprintf(stderr, "    Skipping %s - it failed to run\n", b->name);
+        return -1;
+    }
+    units = 0;
+    elapsed_us = 0;
+    start_us = now_us();
+    start_cycles = rdtscll();
+    do
+    {
+        if ((res = b->run()) < 0)
+            break;
+        units += res;
+        elapsed_us = now_us() - start_us;
+    }
+    while (elapsed_us < min_seconds*1000000.0);
+    cycles = rdtscll() - start_cycles;
+    report_result(format, first, b, units, cycles, elapsed_us/1000000.0);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    const char *match;
+    double min_seconds;
+    int format;
+    int first;
+    int opt;
+    int i;
+
+    format = OUTPUT_TEXT;
+    match = NULL;
+    min_seconds = 1.0;
+    while ((opt = getopt(argc, argv, "f:lm:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (strcmp(optarg, "csv") == 0)
+                format = OUTPUT_CSV;
+            else if (strcmp(optarg, "json") == 0)
+                format = OUTPUT_JSON;
+            else
+                format = OUTPUT_TEXT;
+            break;
+        case 'l':
+            for (i = 0;  benchmarks[i].name;  i++)
+                printf("%s\n", benchmarks[i].name);
+            exit(0);
+        case 'm':
+            match = optarg;
+            break;
+        case 't':
+            min_seconds = atof(optarg);
+            break;
+        default:
+            //usage();
+            exit(2);
+            break;
+        }
+    }
+
+    report_header(format);
+    first = TRUE;
+    for (i = 0;  benchmarks[i].name;  i++)
+    {
+        if (match  &&  strncmp(benchmarks[i].name, match, strlen(match)) != 0)
+            continue;
+        if (run_benchmark(&benchmarks[i], format, first, min_seconds) == 0)
+            first = FALSE;
+    }
+    report_footer(format);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
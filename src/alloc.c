@@ -0,0 +1,289 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc.c - memory allocation handling.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+
+#include "spandsp/private/alloc.h"
+
+/* The selected arena must be per thread, or threads would carve their allocations from
+   each other's arenas. */
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__)  &&  __STDC_VERSION__ >= 201112L  &&  !defined(__STDC_NO_THREADS__)
+#define THREAD_LOCAL _Thread_local
+#else
+#error "No thread local storage is available, so memory arenas cannot be selected per thread"
+#endif
+
+/* The alignment of every block handed out, and of every allocation in an arena. This must
+   be a power of two. */
+#define ALLOC_ALIGNMENT 16
+
+/* Every block handed out is preceded by one of these, so span_free() and span_realloc()
+   can tell where the block came from, and how big it is. The union pads the header to
+   ALLOC_ALIGNMENT bytes, so the memory following it keeps the alignment of the memory
+   before it. */
+typedef union
+{
+    struct
+    {
+        /*! The arena the block came from, or NULL for the heap. */
+        span_arena_t *arena;
+        /*! The size of the block, excluding this header. */
+        size_t len;
+    } h;
+    long double align_ld;
+    uint64_t align_64;
+    void *align_ptr;
+    uint8_t pad[ALLOC_ALIGNMENT];
+} alloc_header_t;
+
+static span_alloc_t heap_alloc = malloc;
+static span_realloc_t heap_realloc = realloc;
+static span_free_t heap_free = free;
+
+static THREAD_LOCAL span_arena_t *current_arena = NULL;
+
+static __inline__ size_t round_up(size_t len)
+{
+    return (len + ALLOC_ALIGNMENT - 1) & ~((size_t) ALLOC_ALIGNMENT - 1);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *arena_alloc(span_arena_t *s, size_t size)
+{
+    alloc_header_t *hdr;
+    size_t len;
+
+    len = sizeof(alloc_header_t) + round_up(size);
+    if (len < size  ||  len > s->size - s->used)
+        return NULL;
+    hdr = (alloc_header_t *) &s->buf[s->used];
+    hdr->h.arena = s;
+    hdr->h.len = size;
+    s->last = s->used;
+    s->used += len;
+    return hdr + 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void *) span_alloc(size_t size)
+{
+    alloc_header_t *hdr;
+
+    if (current_arena)
+        return arena_alloc(current_arena, size);
+    if (size > SIZE_MAX - sizeof(alloc_header_t))
+        return NULL;
+    if ((hdr = (alloc_header_t *) heap_alloc(sizeof(alloc_header_t) + size)) == NULL)
+        return NULL;
+    hdr->h.arena = NULL;
+    hdr->h.len = size;
+    return hdr + 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void *) span_realloc(void *ptr, size_t size)
+{
+    alloc_header_t *hdr;
+    span_arena_t *arena;
+    void *new_ptr;
+
+    if (ptr == NULL)
+        return span_alloc(size);
+    hdr = ((alloc_header_t *) ptr) - 1;
+    if ((arena = hdr->h.arena) == NULL)
+    {
+        if (size > SIZE_MAX - sizeof(alloc_header_t))
+            return NULL;
+        if ((hdr = (alloc_header_t *) heap_realloc(hdr, sizeof(alloc_header_t) + size)) == NULL)
+            return NULL;
+        hdr->h.len = size;
+        return hdr + 1;
+    }
+    if ((uint8_t *) hdr == &arena->buf[arena->last])
+    {
+        /* This is the most recent allocation in the arena, so it can change size in place */
+        if (round_up(size) <= arena->size - arena->last - sizeof(alloc_header_t))
+        {
+            arena->used = arena->last + sizeof(alloc_header_t) + round_up(size);
+            hdr->h.len = size;
+            return ptr;
+        }
+        return NULL;
+    }
+    if (size <= hdr->h.len)
+    {
+        hdr->h.len = size;
+        return ptr;
+    }
+    if ((new_ptr = arena_alloc(arena, size)) == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, hdr->h.len);
+    return new_ptr;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_free(void *ptr)
+{
+    alloc_header_t *hdr;
+
+    if (ptr == NULL)
+        return;
+    hdr = ((alloc_header_t *) ptr) - 1;
+    /* Memory from an arena is only recovered when the whole arena is reset */
+    if (hdr->h.arena == NULL)
+        heap_free(hdr);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(char *) span_strdup(const char *s)
+{
+    char *t;
+    size_t len;
+
+    len = strlen(s) + 1;
+    if ((t = (char *) span_alloc(len)) == NULL)
+        return NULL;
+    memcpy(t, s, len);
+    return t;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_set_allocator(span_alloc_t custom_alloc,
+                                     span_realloc_t custom_realloc,
+                                     span_free_t custom_free)
+{
+    heap_alloc = (custom_alloc)  ?  custom_alloc  :  malloc;
+    heap_realloc = (custom_realloc)  ?  custom_realloc  :  realloc;
+    heap_free = (custom_free)  ?  custom_free  :  free;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(span_arena_t *) span_arena_select(span_arena_t *s)
+{
+    span_arena_t *previous;
+
+    previous = current_arena;
+    current_arena = s;
+    return previous;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_arena_reset(span_arena_t *s)
+{
+    s->used = 0;
+    s->last = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) span_arena_get_used(span_arena_t *s)
+{
+    return s->used;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) span_arena_get_size(span_arena_t *s)
+{
+    return s->size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(span_arena_t *) span_arena_init(span_arena_t *s, void *buf, size_t size)
+{
+    int own_state;
+    uint8_t *t;
+
+    /* The arena's own context, and its memory if none is supplied, always come from
+       the heap, whatever arena is currently selected. */
+    own_state = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (span_arena_t *) heap_alloc(sizeof(*s))) == NULL)
+            return NULL;
+        own_state = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    if (buf == NULL)
+    {
+        if ((buf = heap_alloc(size)) == NULL)
+        {
+            if (own_state)
+                heap_free(s);
+            return NULL;
+        }
+        s->own_buf = TRUE;
+    }
+    /* Make sure the allocations will be properly aligned */
+    t = (uint8_t *) buf;
+    while (((uintptr_t) t & (ALLOC_ALIGNMENT - 1))  &&  size > 0)
+    {
+        t++;
+        size--;
+    }
+    s->buf = t;
+    s->size = size & ~((size_t) ALLOC_ALIGNMENT - 1);
+    s->base = buf;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_arena_release(span_arena_t *s)
+{
+    if (current_arena == s)
+        current_arena = NULL;
+    if (s->own_buf  &&  s->base)
+        heap_free(s->base);
+    s->base = NULL;
+    s->buf = NULL;
+    s->size = 0;
+    s->used = 0;
+    s->own_buf = FALSE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_arena_free(span_arena_t *s)
+{
+    span_arena_release(s);
+    heap_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
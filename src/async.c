@@ -35,6 +35,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/async.h"
 
 #include "spandsp/private/async.h"
@@ -90,7 +91,7 @@ SPAN_DECLARE(async_rx_state_t *) async_rx_init(async_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (async_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (async_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     s->data_bits = data_bits;
@@ -119,7 +120,7 @@ SPAN_DECLARE(int) async_rx_release(async_rx_state_t *s)
 
 SPAN_DECLARE(int) async_rx_free(async_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -215,7 +216,7 @@ SPAN_DECLARE(async_tx_state_t *) async_tx_init(async_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (async_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (async_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     /* We have a use_v14 parameter for completeness, but right now V.14 only
@@ -245,7 +246,7 @@ SPAN_DECLARE(int) async_tx_release(async_tx_state_t *s)
 
 SPAN_DECLARE(int) async_tx_free(async_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -46,6 +46,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/power_meter.h"
@@ -317,7 +318,7 @@ SPAN_DECLARE(void) at_reset_call_info(at_state_t *s)
     for (call_id = s->call_id;  call_id;  call_id = next)
     {
         next = call_id->next;
-        free(call_id);
+        span_free(call_id);
     }
     s->call_id = NULL;
     s->rings_indicated = 0;
@@ -331,13 +332,13 @@ SPAN_DECLARE(void) at_set_call_info(at_state_t *s, char const *id, char const *v
     at_call_id_t *call_id;
 
     /* TODO: We should really not merely ignore a failure to malloc */
-    if ((new_call_id = (at_call_id_t *) malloc(sizeof(*new_call_id))) == NULL)
+    if ((new_call_id = (at_call_id_t *) span_alloc(sizeof(*new_call_id))) == NULL)
         return;
     call_id = s->call_id;
     /* If these strdups fail its pretty harmless. We just appear to not
        have the relevant field. */
-    new_call_id->id = (id)  ?  strdup(id)  :  NULL;
-    new_call_id->value = (value)  ?  strdup(value)  :  NULL;
+    new_call_id->id = (id)  ?  span_strdup(id)  :  NULL;
+    new_call_id->value = (value)  ?  span_strdup(value)  :  NULL;
     new_call_id->next = NULL;
 
     if (call_id)
@@ -690,9 +691,9 @@ static int parse_string_out(at_state_t *s, const char **t, char **target, const
         default:
             /* Set value */
             if (*target)
-                free(*target);
+                span_free(*target);
             /* If this strdup fails, it should be harmless */
-            *target = strdup(*t);
+            *target = span_strdup(*t);
             break;
         }
         break;
@@ -5508,7 +5509,7 @@ SPAN_DECLARE(at_state_t *) at_init(at_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (at_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (at_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, '\0', sizeof(*s));
@@ -5531,7 +5532,7 @@ SPAN_DECLARE(int) at_release(at_state_t *s)
 {
     at_reset_call_info(s);
     if (s->local_id)
-        free(s->local_id);
+        span_free(s->local_id);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -5541,7 +5542,7 @@ SPAN_DECLARE(int) at_free(at_state_t *s)
     int ret;
 
     ret = at_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
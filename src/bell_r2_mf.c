@@ -43,6 +43,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/queue.h"
@@ -326,7 +327,7 @@ SPAN_DECLARE(bell_mf_tx_state_t *) bell_mf_tx_init(bell_mf_tx_state_t *s)
 {
     if (s == NULL)
     {
-        if ((s = (bell_mf_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (bell_mf_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -349,7 +350,7 @@ SPAN_DECLARE(int) bell_mf_tx_release(bell_mf_tx_state_t *s)
 
 SPAN_DECLARE(int) bell_mf_tx_free(bell_mf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -398,7 +399,7 @@ SPAN_DECLARE(r2_mf_tx_state_t *) r2_mf_tx_init(r2_mf_tx_state_t *s, int fwd)
 
     if (s == NULL)
     {
-        if ((s = (r2_mf_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (r2_mf_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -452,7 +453,7 @@ SPAN_DECLARE(int) r2_mf_tx_release(r2_mf_tx_state_t *s)
 
 SPAN_DECLARE(int) r2_mf_tx_free(r2_mf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -461,13 +462,10 @@ SPAN_DECLARE(int) bell_mf_rx(bell_mf_rx_state_t *s, const int16_t amp[], int sam
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
     int32_t energy[6];
-    int16_t xamp;
 #else
     float energy[6];
-    float xamp;
 #endif
     int i;
-    int j;
     int sample;
     int best;
     int second_best;
@@ -481,16 +479,7 @@ SPAN_DECLARE(int) bell_mf_rx(bell_mf_rx_state_t *s, const int16_t amp[], int sam
             limit = sample + (BELL_MF_SAMPLES_PER_BLOCK - s->current_sample);
         else
             limit = samples;
-        for (j = sample;  j < limit;  j++)
-        {
-            xamp = goertzel_preadjust_amp(amp[j]);
-            goertzel_samplex(&s->out[0], xamp);
-            goertzel_samplex(&s->out[1], xamp);
-            goertzel_samplex(&s->out[2], xamp);
-            goertzel_samplex(&s->out[3], xamp);
-            goertzel_samplex(&s->out[4], xamp);
-            goertzel_samplex(&s->out[5], xamp);
-        }
+        goertzel_bank_update(&s->out, &amp[sample], limit - sample);
         s->current_sample += (limit - sample);
         if (s->current_sample < BELL_MF_SAMPLES_PER_BLOCK)
             continue;
@@ -502,8 +491,7 @@ SPAN_DECLARE(int) bell_mf_rx(bell_mf_rx_state_t *s, const int16_t amp[], int sam
            well. The sinc function mess, due to rectangular windowing
            ensure that! Find the two highest energies and ensure they
            are considerably stronger than any of the others. */
-        energy[0] = goertzel_result(&s->out[0]);
-        energy[1] = goertzel_result(&s->out[1]);
+        goertzel_bank_result(&s->out, energy);
         if (energy[0] > energy[1])
         {
             best = 0;
@@ -516,7 +504,6 @@ SPAN_DECLARE(int) bell_mf_rx(bell_mf_rx_state_t *s, const int16_t amp[], int sam
         }
         for (i = 2;  i < 6;  i++)
         {
-            energy[i] = goertzel_result(&s->out[i]);
             if (energy[i] >= energy[best])
             {
                 second_best = best;
@@ -634,7 +621,7 @@ SPAN_DECLARE(bell_mf_rx_state_t *) bell_mf_rx_init(bell_mf_rx_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (bell_mf_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (bell_mf_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -654,8 +641,7 @@ SPAN_DECLARE(bell_mf_rx_state_t *) bell_mf_rx_init(bell_mf_rx_state_t *s,
     s->hits[3] = 
     s->hits[4] = 0;
 
-    for (i = 0;  i < 6;  i++)
-        goertzel_init(&s->out[i], &bell_mf_detect_desc[i]);
+    goertzel_bank_init(&s->out, bell_mf_detect_desc, 6);
     s->current_sample = 0;
     s->lost_digits = 0;
     s->current_digits = 0;
@@ -672,7 +658,7 @@ SPAN_DECLARE(int) bell_mf_rx_release(bell_mf_rx_state_t *s)
 
 SPAN_DECLARE(int) bell_mf_rx_free(bell_mf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -681,13 +667,10 @@ SPAN_DECLARE(int) r2_mf_rx(r2_mf_rx_state_t *s, const int16_t amp[], int samples
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
     int32_t energy[6];
-    int16_t xamp;
 #else
     float energy[6];
-    float xamp;
 #endif
     int i;
-    int j;
     int sample;
     int best;
     int second_best;
@@ -703,24 +686,14 @@ SPAN_DECLARE(int) r2_mf_rx(r2_mf_rx_state_t *s, const int16_t amp[], int samples
             limit = sample + (R2_MF_SAMPLES_PER_BLOCK - s->current_sample);
         else
             limit = samples;
-        for (j = sample;  j < limit;  j++)
-        {
-            xamp = goertzel_preadjust_amp(amp[j]);
-            goertzel_samplex(&s->out[0], xamp);
-            goertzel_samplex(&s->out[1], xamp);
-            goertzel_samplex(&s->out[2], xamp);
-            goertzel_samplex(&s->out[3], xamp);
-            goertzel_samplex(&s->out[4], xamp);
-            goertzel_samplex(&s->out[5], xamp);
-        }
+        goertzel_bank_update(&s->out, &amp[sample], limit - sample);
         s->current_sample += (limit - sample);
         if (s->current_sample < R2_MF_SAMPLES_PER_BLOCK)
             continue;
 
         /* We are at the end of an MF detection block */
         /* Find the two highest energies */
-        energy[0] = goertzel_result(&s->out[0]);
-        energy[1] = goertzel_result(&s->out[1]);
+        goertzel_bank_result(&s->out, energy);
         if (energy[0] > energy[1])
         {
             best = 0;
@@ -734,7 +707,6 @@ SPAN_DECLARE(int) r2_mf_rx(r2_mf_rx_state_t *s, const int16_t amp[], int samples
         
         for (i = 2;  i < 6;  i++)
         {
-            energy[i] = goertzel_result(&s->out[i]);
             if (energy[i] >= energy[best])
             {
                 second_best = best;
@@ -814,7 +786,7 @@ SPAN_DECLARE(r2_mf_rx_state_t *) r2_mf_rx_init(r2_mf_rx_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (r2_mf_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (r2_mf_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -830,16 +802,7 @@ SPAN_DECLARE(r2_mf_rx_state_t *) r2_mf_rx_init(r2_mf_rx_state_t *s,
         }
         initialised = TRUE;
     }
-    if (fwd)
-    {
-        for (i = 0;  i < 6;  i++)
-            goertzel_init(&s->out[i], &mf_fwd_detect_desc[i]);
-    }
-    else
-    {
-        for (i = 0;  i < 6;  i++)
-            goertzel_init(&s->out[i], &mf_back_detect_desc[i]);
-    }
+    goertzel_bank_init(&s->out, (fwd)  ?  mf_fwd_detect_desc  :  mf_back_detect_desc, 6);
     s->callback = callback;
     s->callback_data = user_data;
     s->current_digit = 0;
@@ -856,7 +819,7 @@ SPAN_DECLARE(int) r2_mf_rx_release(r2_mf_rx_state_t *s)
 
 SPAN_DECLARE(int) r2_mf_rx_free(r2_mf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
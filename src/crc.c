@@ -33,10 +33,58 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
 #include "spandsp/crc.h"
 #include "spandsp/bit_operations.h"
 
+/* The carry-less multiply routines are built with per-function target attributes, so
+   the rest of the library can still be built for a baseline CPU. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define CRC_WITH_PCLMUL
+#include <immintrin.h>
+#endif
+#endif
+
+/* The normal (not bit reversed) forms of the generator polynomials */
+#define CRC_ITU32_POLY      0x104C11DB7ULL
+#define CRC_ITU16_POLY      0x11021ULL
+
+/* The PCLMUL routines are only worth starting up for frames at least this long */
+#define CRC_PCLMUL_MIN_LEN  64
+
+typedef uint32_t (*crc_kernel_t)(const uint8_t *buf, int len, uint32_t crc);
+
+/*! The tables and folding constants for one CRC. The slicing by 8 tables are
+    derived from the byte-wise table, the first time a CRC is calculated. */
+typedef struct
+{
+    /*! The width of the CRC, in bits. */
+    int width;
+    /*! The generator polynomial, including the x^width term. */
+    uint64_t poly;
+    /*! Slicing by 8 tables. Table 0 is the usual byte-wise table. */
+    uint32_t slice[8][256];
+    /*! Bit reversed x^(128 + 63) mod P and x^(128 - 1) mod P, for folding by one 128 bit block */
+    uint64_t fold128[2];
+    /*! Bit reversed x^(512 + 63) mod P and x^(512 - 1) mod P, for folding by four 128 bit blocks */
+    uint64_t fold512[2];
+} crc_engine_t;
+
+static crc_engine_t crc_itu32_engine;
+static crc_engine_t crc_itu16_engine;
+static int crc_engines_ready = FALSE;
+
+static uint32_t crc_itu32_select(const uint8_t *buf, int len, uint32_t crc);
+static uint32_t crc_itu16_select(const uint8_t *buf, int len, uint32_t crc);
+
+/* These start out pointing at routines which pick the real implementation on first use */
+static crc_kernel_t crc_itu32_kernel = crc_itu32_select;
+static crc_kernel_t crc_itu16_kernel = crc_itu16_select;
+static int crc_implementation = CRC_IMPLEMENTATION_AUTO;
+
 static const uint32_t crc_itu32_table[] =
 {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3, 
@@ -73,7 +121,7 @@ static const uint32_t crc_itu32_table[] =
     0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-SPAN_DECLARE(uint32_t) crc_itu32_calc(const uint8_t *buf, int len, uint32_t crc)
+static uint32_t crc_itu32_bytewise(const uint8_t *buf, int len, uint32_t crc)
 {
     int i;
 
@@ -83,37 +131,6 @@ SPAN_DECLARE(uint32_t) crc_itu32_calc(const uint8_t *buf, int len, uint32_t crc)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) crc_itu32_append(uint8_t *buf, int len)
-{
-    uint32_t crc;
-    int new_len;
-    int i;
-
-    crc = 0xFFFFFFFF;
-    new_len = len + 4;
-    for (i = 0;  i < len;  i++)
-        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
-    crc ^= 0xFFFFFFFF;
-    buf[i++] = (uint8_t) crc;
-    buf[i++] = (uint8_t) (crc >> 8);
-    buf[i++] = (uint8_t) (crc >> 16);
-    buf[i++] = (uint8_t) (crc >> 24);
-    return new_len;
-}
-/*- End of function --------------------------------------------------------*/
-
-SPAN_DECLARE(int) crc_itu32_check(const uint8_t *buf, int len)
-{
-    uint32_t crc;
-    int i;
-
-    crc = 0xFFFFFFFF;
-    for (i = 0;  i < len;  i++)
-        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
-    return (crc == 0xDEBB20E3);
-}
-/*- End of function --------------------------------------------------------*/
-
 static const uint16_t crc_itu16_table[] =
 {
     0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
@@ -150,7 +167,7 @@ static const uint16_t crc_itu16_table[] =
     0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
 };
 
-SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
+static uint32_t crc_itu16_bytewise(const uint8_t *buf, int len, uint32_t crc)
 {
     int i;
 
@@ -160,17 +177,299 @@ SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(uint16_t) crc_itu16_bits(uint8_t buf, int len, uint16_t crc)
+/* Slicing by 8. Both CRCs are bit reversed, so the same code serves for both, with
+   the CRC-16 held in the low bits of a 32 bit word. */
+static uint32_t crc_slice8(const crc_engine_t *e, const uint8_t *buf, int len, uint32_t crc)
 {
+    uint32_t one;
+    uint32_t two;
     int i;
 
-    for (i = 0;  i < len;  i++)
+    for (i = 0;  i <= len - 8;  i += 8)
+    {
+        one = crc
+            ^ ((uint32_t) buf[i] | ((uint32_t) buf[i + 1] << 8) | ((uint32_t) buf[i + 2] << 16) | ((uint32_t) buf[i + 3] << 24));
+        two = (uint32_t) buf[i + 4] | ((uint32_t) buf[i + 5] << 8) | ((uint32_t) buf[i + 6] << 16) | ((uint32_t) buf[i + 7] << 24);
+        crc = e->slice[7][one & 0xFF]
+            ^ e->slice[6][(one >> 8) & 0xFF]
+            ^ e->slice[5][(one >> 16) & 0xFF]
+            ^ e->slice[4][one >> 24]
+            ^ e->slice[3][two & 0xFF]
+            ^ e->slice[2][(two >> 8) & 0xFF]
+            ^ e->slice[1][(two >> 16) & 0xFF]
+            ^ e->slice[0][two >> 24];
+    }
+    for (  ;  i < len;  i++)
+        crc = (crc >> 8) ^ e->slice[0][(crc ^ buf[i]) & 0xFF];
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu32_slice8(const uint8_t *buf, int len, uint32_t crc)
+{
+    return crc_slice8(&crc_itu32_engine, buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu16_slice8(const uint8_t *buf, int len, uint32_t crc)
+{
+    return crc_slice8(&crc_itu16_engine, buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(CRC_WITH_PCLMUL)
+/* Fold a 128 bit block forwards by the distance the constants were made for. With the
+   bit reversed data, the low 64 bits of the block are the high order terms. */
+__attribute__((target("pclmul,sse2")))
+static __inline__ __m128i crc_fold(__m128i x, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Fold the frame 64 bytes at a time, then 16 bytes at a time, until it is down to a
+   single 128 bit block with the same CRC as the bytes folded so far. That block, and
+   any odd bytes at the end, are then finished off with the tables. */
+__attribute__((target("pclmul,sse2")))
+static uint32_t crc_pclmul(const crc_engine_t *e, const uint8_t *buf, int len, uint32_t crc)
+{
+    __m128i k;
+    __m128i x1;
+    __m128i x2;
+    __m128i x3;
+    __m128i x4;
+    uint8_t block[16];
+
+    if (len < CRC_PCLMUL_MIN_LEN)
+        return crc_slice8(e, buf, len, crc);
+    x1 = _mm_loadu_si128((const __m128i *) (buf + 0));
+    x2 = _mm_loadu_si128((const __m128i *) (buf + 16));
+    x3 = _mm_loadu_si128((const __m128i *) (buf + 32));
+    x4 = _mm_loadu_si128((const __m128i *) (buf + 48));
+    /* The initial CRC value is equivalent to XORing it into the start of the frame */
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+    buf += 64;
+    len -= 64;
+
+    k = _mm_loadu_si128((const __m128i *) e->fold512);
+    while (len >= 64)
+    {
+        x1 = _mm_xor_si128(crc_fold(x1, k), _mm_loadu_si128((const __m128i *) (buf + 0)));
+        x2 = _mm_xor_si128(crc_fold(x2, k), _mm_loadu_si128((const __m128i *) (buf + 16)));
+        x3 = _mm_xor_si128(crc_fold(x3, k), _mm_loadu_si128((const __m128i *) (buf + 32)));
+        x4 = _mm_xor_si128(crc_fold(x4, k), _mm_loadu_si128((const __m128i *) (buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+
+    k = _mm_loadu_si128((const __m128i *) e->fold128);
+    x2 = _mm_xor_si128(x2, crc_fold(x1, k));
+    x3 = _mm_xor_si128(x3, crc_fold(x2, k));
+    x4 = _mm_xor_si128(x4, crc_fold(x3, k));
+    while (len >= 16)
+    {
+        x4 = _mm_xor_si128(crc_fold(x4, k), _mm_loadu_si128((const __m128i *) buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *) block, x4);
+    crc = crc_slice8(e, block, 16, 0);
+    return crc_slice8(e, buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu32_pclmul(const uint8_t *buf, int len, uint32_t crc)
+{
+    return crc_pclmul(&crc_itu32_engine, buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu16_pclmul(const uint8_t *buf, int len, uint32_t crc)
+{
+    return crc_pclmul(&crc_itu16_engine, buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+/* Bit reversed x^n mod P, placed in the top of a 64 bit word, in the form the folding
+   code needs. */
+static uint64_t crc_fold_constant(const crc_engine_t *e, int n)
+{
+    uint64_t r;
+    uint64_t k;
+    int i;
+
+    r = 1;
+    for (i = 0;  i < n;  i++)
+    {
+        r <<= 1;
+        if ((r >> e->width) & 1)
+            r ^= e->poly;
+    }
+    k = 0;
+    for (i = 0;  i < e->width;  i++)
+    {
+        if ((r >> i) & 1)
+            k |= 1ULL << (63 - i);
+    }
+    return k;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void crc_engine_init(crc_engine_t *e, int width, uint64_t poly, const uint32_t table32[], const uint16_t table16[])
+{
+    int i;
+    int j;
+
+    e->width = width;
+    e->poly = poly;
+    for (i = 0;  i < 256;  i++)
+        e->slice[0][i] = (table32)  ?  table32[i]  :  table16[i];
+    for (j = 1;  j < 8;  j++)
+    {
+        for (i = 0;  i < 256;  i++)
+            e->slice[j][i] = (e->slice[j - 1][i] >> 8) ^ e->slice[0][e->slice[j - 1][i] & 0xFF];
+    }
+    e->fold128[0] = crc_fold_constant(e, 128 + 63);
+    e->fold128[1] = crc_fold_constant(e, 128 - 1);
+    e->fold512[0] = crc_fold_constant(e, 512 + 63);
+    e->fold512[1] = crc_fold_constant(e, 512 - 1);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case CRC_IMPLEMENTATION_BYTEWISE:
+    case CRC_IMPLEMENTATION_SLICE8:
+        return TRUE;
+#if defined(CRC_WITH_PCLMUL)
+    case CRC_IMPLEMENTATION_PCLMUL:
+        return has_PCLMUL();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_set_implementation(int implementation)
+{
+    if (!crc_engines_ready)
+    {
+        crc_engine_init(&crc_itu32_engine, 32, CRC_ITU32_POLY, crc_itu32_table, NULL);
+        crc_engine_init(&crc_itu16_engine, 16, CRC_ITU16_POLY, NULL, crc_itu16_table);
+        crc_engines_ready = TRUE;
+    }
+    if (implementation == CRC_IMPLEMENTATION_AUTO)
+        implementation = (implementation_available(CRC_IMPLEMENTATION_PCLMUL))  ?  CRC_IMPLEMENTATION_PCLMUL  :  CRC_IMPLEMENTATION_SLICE8;
+    else if (!implementation_available(implementation))
+        return -1;
+    switch (implementation)
+    {
+#if defined(CRC_WITH_PCLMUL)
+    case CRC_IMPLEMENTATION_PCLMUL:
+        crc_itu32_kernel = crc_itu32_pclmul;
+        crc_itu16_kernel = crc_itu16_pclmul;
+        break;
+#endif
+    case CRC_IMPLEMENTATION_SLICE8:
+        crc_itu32_kernel = crc_itu32_slice8;
+        crc_itu16_kernel = crc_itu16_slice8;
+        break;
+    default:
+        implementation = CRC_IMPLEMENTATION_BYTEWISE;
+        crc_itu32_kernel = crc_itu32_bytewise;
+        crc_itu16_kernel = crc_itu16_bytewise;
+        break;
+    }
+    crc_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_get_implementation(void)
+{
+    if (crc_implementation == CRC_IMPLEMENTATION_AUTO)
+        crc_set_implementation(CRC_IMPLEMENTATION_AUTO);
+    return crc_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu32_select(const uint8_t *buf, int len, uint32_t crc)
+{
+    crc_set_implementation(CRC_IMPLEMENTATION_AUTO);
+    return crc_itu32_kernel(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t crc_itu16_select(const uint8_t *buf, int len, uint32_t crc)
+{
+    crc_set_implementation(CRC_IMPLEMENTATION_AUTO);
+    return crc_itu16_kernel(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint32_t) crc_itu32_calc(const uint8_t *buf, int len, uint32_t crc)
+{
+    return crc_itu32_kernel(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_itu32_append(uint8_t *buf, int len)
+{
+    uint32_t crc;
+    int new_len;
+    int i;
+
+    new_len = len + 4;
+    crc = crc_itu32_kernel(buf, len, 0xFFFFFFFF);
+    crc ^= 0xFFFFFFFF;
+    i = len;
+    buf[i++] = (uint8_t) crc;
+    buf[i++] = (uint8_t) (crc >> 8);
+    buf[i++] = (uint8_t) (crc >> 16);
+    buf[i++] = (uint8_t) (crc >> 24);
+    return new_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_itu32_check(const uint8_t *buf, int len)
+{
+    uint32_t crc;
+
+    crc = crc_itu32_kernel(buf, len, 0xFFFFFFFF);
+    return (crc == 0xDEBB20E3);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
+{
+    return (uint16_t) crc_itu16_kernel(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint16_t) crc_itu16_bits(uint8_t buf, int len, uint16_t crc)
+{
+    int bits;
+    int x;
+
+    /* Shifting the bits to the top of the table index is the same as feeding in leading
+       zero bits, which have no effect on a zero register. This processes any number of
+       bits, from 0 to 8, in a single table lookup. */
+    if (len <= 0)
+        return crc;
+    bits = (len > 8)  ?  8  :  len;
+    x = (crc ^ buf) & (0xFF >> (8 - bits));
+    crc = (crc >> bits) ^ crc_itu16_table[x << (8 - bits)];
+    /* Any bits beyond the byte are zeros */
+    for (len -= bits;  len > 0;  len--)
     {
-        if (((buf ^ crc) & 1))
+        if ((crc & 1))
             crc = (crc >> 1) ^ 0x8408;
         else
             crc = crc >> 1;
-        buf >>= 1;
     }
     return crc;
 }
@@ -182,11 +481,10 @@ SPAN_DECLARE(int) crc_itu16_append(uint8_t *buf, int len)
     int new_len;
     int i;
 
-    crc = 0xFFFF;
     new_len = len + 2;
-    for (i = 0;  i < len;  i++)
-        crc = (crc >> 8) ^ crc_itu16_table[(crc ^ buf[i]) & 0xFF];
+    crc = (uint16_t) crc_itu16_kernel(buf, len, 0xFFFF);
     crc ^= 0xFFFF;
+    i = len;
     buf[i++] = (uint8_t) crc;
     buf[i++] = (uint8_t) (crc >> 8);
     return new_len;
@@ -196,11 +494,8 @@ SPAN_DECLARE(int) crc_itu16_append(uint8_t *buf, int len)
 SPAN_DECLARE(int) crc_itu16_check(const uint8_t *buf, int len)
 {
     uint16_t crc;
-    int i;
 
-    crc = 0xFFFF;
-    for (i = 0;  i < len;  i++)
-        crc = (crc >> 8) ^ crc_itu16_table[(crc ^ buf[i]) & 0xFF];
+    crc = (uint16_t) crc_itu16_kernel(buf, len, 0xFFFF);
     return (crc & 0xFFFF) == 0xF0B8;
 }
 /*- End of function --------------------------------------------------------*/
@@ -42,7 +42,10 @@
 #include <string.h>
 #include <limits.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/queue.h"
@@ -82,6 +85,33 @@
 #define DTMF_SAMPLES_PER_BLOCK      102
 #endif
 
+/* The receiver bank uses SSE where the compiler's baseline target has it. The AVX
+   routine is built with a per-function target attribute, and is only used when a run
+   time check finds the CPU supports it. */
+#if !defined(SPANDSP_USE_FIXED_POINT)  &&  defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__SSE__)
+#define DTMF_BANK_WITH_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define DTMF_BANK_WITH_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(SPANDSP_USE_FIXED_POINT)
+typedef int16_t dtmf_bank_sample_t;
+#else
+typedef float dtmf_bank_sample_t;
+#endif
+
+typedef void (*dtmf_bank_kernel_t)(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len);
+
+static void dtmf_rx_bank_update_select(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len);
+
+/* This starts out pointing at a routine which picks the real implementation on first use */
+static dtmf_bank_kernel_t dtmf_bank_kernel = dtmf_rx_bank_update_select;
+
 static const float dtmf_row[] =
 {
      697.0f,  770.0f,  852.0f,  941.0f
@@ -99,29 +129,193 @@ static goertzel_descriptor_t dtmf_detect_col[4];
 static int dtmf_tx_inited = FALSE;
 static tone_gen_descriptor_t dtmf_digit_tones[16];
 
+static __inline__ float dtmf_rx_dialtone_filter(dtmf_rx_state_t *s, float famp)
+{
+    float v1;
+
+    /* Sharp notches applied at 350Hz and 440Hz - the two common dialtone frequencies.
+       These are rather high Q, to achieve the required narrowness, without using lots of
+       sections. */
+    v1 = 0.98356f*famp + 1.8954426f*s->z350[0] - 0.9691396f*s->z350[1];
+    famp = v1 - 1.9251480f*s->z350[0] + s->z350[1];
+    s->z350[1] = s->z350[0];
+    s->z350[0] = v1;
+
+    v1 = 0.98456f*famp + 1.8529543f*s->z440[0] - 0.9691396f*s->z440[1];
+    famp = v1 - 1.8819938f*s->z440[0] + s->z440[1];
+    s->z440[1] = s->z440[0];
+    s->z440[0] = v1;
+    return famp;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(SPANDSP_USE_FIXED_POINT)
+static void dtmf_rx_analyse(dtmf_rx_state_t *s, const int32_t row_energy[4], const int32_t col_energy[4])
+#else
+static void dtmf_rx_analyse(dtmf_rx_state_t *s, const float row_energy[4], const float col_energy[4])
+#endif
+{
+    int i;
+    int best_row;
+    int best_col;
+    uint8_t hit;
+
+    /* We are at the end of a DTMF detection block */
+    /* Find the peak row and the peak column */
+    best_row = 0;
+    best_col = 0;
+    for (i = 1;  i < 4;  i++)
+    {
+        if (row_energy[i] > row_energy[best_row])
+            best_row = i;
+        if (col_energy[i] > col_energy[best_col])
+            best_col = i;
+    }
+    hit = 0;
+    /* Basic signal level test and the twist test */
+    if (row_energy[best_row] >= s->threshold
+        &&
+        col_energy[best_col] >= s->threshold)
+    {
+        if (col_energy[best_col] < row_energy[best_row]*s->reverse_twist
+            &&
+            col_energy[best_col]*s->normal_twist > row_energy[best_row])
+        {
+            /* Relative peak test ... */
+            for (i = 0;  i < 4;  i++)
+            {
+                if ((i != best_col  &&  col_energy[i]*DTMF_RELATIVE_PEAK_COL > col_energy[best_col])
+                    ||
+                    (i != best_row  &&  row_energy[i]*DTMF_RELATIVE_PEAK_ROW > row_energy[best_row]))
+                {
+                    break;
+                }
+            }
+            /* ... and fraction of total energy test */
+            if (i >= 4
+                &&
+                (row_energy[best_row] + col_energy[best_col]) > DTMF_TO_TOTAL_ENERGY*s->energy)
+            {
+                /* Got a hit */
+                hit = dtmf_positions[(best_row << 2) + best_col];
+            }
+        }
+        if (span_log_test(&s->logging, SPAN_LOG_FLOW))
+        {
+            /* Log information about the quality of the signal, to aid analysis of detection problems */
+            /* Logging at this point filters the total no-hoper frames out of the log, and leaves
+               anything which might feasibly be a DTMF digit. The log will then contain a list of the
+               total, row and coloumn power levels for detailed analysis of detection problems. */
+            span_log(&s->logging,
+                     SPAN_LOG_FLOW,
+                     "Potentially '%c' - total %.2fdB, row %.2fdB, col %.2fdB, duration %d - %s\n",
+                     dtmf_positions[(best_row << 2) + best_col],
+                     log10f(s->energy)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
+                     log10f(row_energy[best_row]/DTMF_TO_TOTAL_ENERGY)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
+                     log10f(col_energy[best_col]/DTMF_TO_TOTAL_ENERGY)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
+                     s->duration,
+                     (hit)  ?  "hit"  :  "miss");
+        }
+    }
+    /* The logic in the next test should ensure the following for different successive hit patterns:
+            -----ABB = start of digit B.
+            ----B-BB = start of digit B
+            ----A-BB = start of digit B
+            BBBBBABB = still in digit B.
+            BBBBBB-- = end of digit B
+            BBBBBBC- = end of digit B
+            BBBBACBB = B ends, then B starts again.
+            BBBBBBCC = B ends, then C starts.
+            BBBBBCDD = B ends, then D starts.
+       This can work with:
+            - Back to back differing digits. Back-to-back digits should
+              not happen. The spec. says there should be a gap between digits.
+              However, many real phones do not impose a gap, and rolling across
+              the keypad can produce little or no gap.
+            - It tolerates nasty phones that give a very wobbly start to a digit.
+            - VoIP can give sample slips. The phase jumps that produces will cause
+              the block it is in to give no detection. This logic will ride over a
+              single missed block, and not falsely declare a second digit. If the
+              hiccup happens in the wrong place on a minimum length digit, however
+              we would still fail to detect that digit. Could anything be done to
+              deal with that? Packet loss is clearly a no-go zone.
+              Note this is only relevant to VoIP using A-law, u-law or similar.
+              Low bit rate codecs scramble DTMF too much for it to be recognised,
+              and often slip in units larger than a sample. */
+    if (hit != s->in_digit  &&  s->last_hit != s->in_digit)
+    {
+        /* We have two successive indications that something has changed. */
+        /* To declare digit on, the hits must agree. Otherwise we declare tone off. */
+        hit = (hit  &&  hit == s->last_hit)  ?  hit   :  0;
+        if (s->realtime_callback)
+        {
+            /* Avoid reporting multiple no digit conditions on flaky hits */
+            if (s->in_digit  ||  hit)
+            {
+                i = (s->in_digit  &&  !hit)  ?  -99  :  lfastrintf(log10f(s->energy)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER);
+                s->realtime_callback(s->realtime_callback_data, hit, i, s->duration);
+                s->duration = 0;
+            }
+        }
+        else
+        {
+            if (hit)
+            {
+                if (s->current_digits < MAX_DTMF_DIGITS)
+                {
+                    s->digits[s->current_digits++] = (char) hit;
+                    s->digits[s->current_digits] = '\0';
+                    if (s->digits_callback)
+                    {
+                        s->digits_callback(s->digits_callback_data, s->digits, s->current_digits);
+                        s->current_digits = 0;
+                    }
+                }
+                else
+                {
+                    s->lost_digits++;
+                }
+            }
+        }
+        s->in_digit = hit;
+    }
+    s->last_hit = hit;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    s->energy = 0;
+#else
+    s->energy = 0.0f;
+#endif
+    s->current_sample = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void dtmf_rx_deliver_digits(dtmf_rx_state_t *s)
+{
+    if (s->current_digits  &&  s->digits_callback)
+    {
+        s->digits_callback(s->digits_callback_data, s->digits, s->current_digits);
+        s->digits[0] = '\0';
+        s->current_digits = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) dtmf_rx(dtmf_rx_state_t *s, const int16_t amp[], int samples)
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
     int32_t row_energy[4];
     int32_t col_energy[4];
     int16_t xamp;
-    float famp;
 #else
     float row_energy[4];
     float col_energy[4];
     float xamp;
-    float famp;
 #endif
-    float v1;
     int i;
     int j;
     int sample;
-    int best_row;
-    int best_col;
     int limit;
-    uint8_t hit;
 
-    hit = 0;
     for (sample = 0;  sample < samples;  sample = limit)
     {
         /* The block length is optimised to meet the DTMF specs. */
@@ -135,22 +329,7 @@ SPAN_DECLARE(int) dtmf_rx(dtmf_rx_state_t *s, const int16_t amp[], int samples)
         {
             xamp = amp[j];
             if (s->filter_dialtone)
-            {
-                famp = xamp;
-                /* Sharp notches applied at 350Hz and 440Hz - the two common dialtone frequencies.
-                   These are rather high Q, to achieve the required narrowness, without using lots of
-                   sections. */
-                v1 = 0.98356f*famp + 1.8954426f*s->z350[0] - 0.9691396f*s->z350[1];
-                famp = v1 - 1.9251480f*s->z350[0] + s->z350[1];
-                s->z350[1] = s->z350[0];
-                s->z350[0] = v1;
-
-                v1 = 0.98456f*famp + 1.8529543f*s->z440[0] - 0.9691396f*s->z440[1];
-                famp = v1 - 1.8819938f*s->z440[0] + s->z440[1];
-                s->z440[1] = s->z440[0];
-                s->z440[0] = v1;
-                xamp = famp;
-            }
+                xamp = dtmf_rx_dialtone_filter(s, xamp);
             xamp = goertzel_preadjust_amp(xamp);
 #if defined(SPANDSP_USE_FIXED_POINT)
             s->energy += ((int32_t) xamp*xamp);
@@ -172,143 +351,14 @@ SPAN_DECLARE(int) dtmf_rx(dtmf_rx_state_t *s, const int16_t amp[], int samples)
         if (s->current_sample < DTMF_SAMPLES_PER_BLOCK)
             continue;
 
-        /* We are at the end of a DTMF detection block */
-        /* Find the peak row and the peak column */
-        row_energy[0] = goertzel_result(&s->row_out[0]);
-        best_row = 0;
-        col_energy[0] = goertzel_result(&s->col_out[0]);
-        best_col = 0;
-        for (i = 1;  i < 4;  i++)
+        for (i = 0;  i < 4;  i++)
         {
             row_energy[i] = goertzel_result(&s->row_out[i]);
-            if (row_energy[i] > row_energy[best_row])
-                best_row = i;
             col_energy[i] = goertzel_result(&s->col_out[i]);
-            if (col_energy[i] > col_energy[best_col])
-                best_col = i;
-        }
-        hit = 0;
-        /* Basic signal level test and the twist test */
-        if (row_energy[best_row] >= s->threshold
-            &&
-            col_energy[best_col] >= s->threshold)
-        {
-            if (col_energy[best_col] < row_energy[best_row]*s->reverse_twist
-                &&
-                col_energy[best_col]*s->normal_twist > row_energy[best_row])
-            {
-                /* Relative peak test ... */
-                for (i = 0;  i < 4;  i++)
-                {
-                    if ((i != best_col  &&  col_energy[i]*DTMF_RELATIVE_PEAK_COL > col_energy[best_col])
-                        ||
-                        (i != best_row  &&  row_energy[i]*DTMF_RELATIVE_PEAK_ROW > row_energy[best_row]))
-                    {
-                        break;
-                    }
-                }
-                /* ... and fraction of total energy test */
-                if (i >= 4
-                    &&
-                    (row_energy[best_row] + col_energy[best_col]) > DTMF_TO_TOTAL_ENERGY*s->energy)
-                {
-                    /* Got a hit */
-                    hit = dtmf_positions[(best_row << 2) + best_col];
-                }
-            }
-            if (span_log_test(&s->logging, SPAN_LOG_FLOW))
-            {
-                /* Log information about the quality of the signal, to aid analysis of detection problems */
-                /* Logging at this point filters the total no-hoper frames out of the log, and leaves
-                   anything which might feasibly be a DTMF digit. The log will then contain a list of the
-                   total, row and coloumn power levels for detailed analysis of detection problems. */
-                span_log(&s->logging,
-                         SPAN_LOG_FLOW,
-                         "Potentially '%c' - total %.2fdB, row %.2fdB, col %.2fdB, duration %d - %s\n",
-                         dtmf_positions[(best_row << 2) + best_col],
-                         log10f(s->energy)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
-                         log10f(row_energy[best_row]/DTMF_TO_TOTAL_ENERGY)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
-                         log10f(col_energy[best_col]/DTMF_TO_TOTAL_ENERGY)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER,
-                         s->duration,
-                         (hit)  ?  "hit"  :  "miss");
-            }
         }
-        /* The logic in the next test should ensure the following for different successive hit patterns:
-                -----ABB = start of digit B.
-                ----B-BB = start of digit B
-                ----A-BB = start of digit B
-                BBBBBABB = still in digit B.
-                BBBBBB-- = end of digit B
-                BBBBBBC- = end of digit B
-                BBBBACBB = B ends, then B starts again.
-                BBBBBBCC = B ends, then C starts.
-                BBBBBCDD = B ends, then D starts.
-           This can work with:
-                - Back to back differing digits. Back-to-back digits should
-                  not happen. The spec. says there should be a gap between digits.
-                  However, many real phones do not impose a gap, and rolling across
-                  the keypad can produce little or no gap.
-                - It tolerates nasty phones that give a very wobbly start to a digit.
-                - VoIP can give sample slips. The phase jumps that produces will cause
-                  the block it is in to give no detection. This logic will ride over a
-                  single missed block, and not falsely declare a second digit. If the
-                  hiccup happens in the wrong place on a minimum length digit, however
-                  we would still fail to detect that digit. Could anything be done to
-                  deal with that? Packet loss is clearly a no-go zone.
-                  Note this is only relevant to VoIP using A-law, u-law or similar.
-                  Low bit rate codecs scramble DTMF too much for it to be recognised,
-                  and often slip in units larger than a sample. */
-        if (hit != s->in_digit  &&  s->last_hit != s->in_digit)
-        {
-            /* We have two successive indications that something has changed. */
-            /* To declare digit on, the hits must agree. Otherwise we declare tone off. */
-            hit = (hit  &&  hit == s->last_hit)  ?  hit   :  0;
-            if (s->realtime_callback)
-            {
-                /* Avoid reporting multiple no digit conditions on flaky hits */
-                if (s->in_digit  ||  hit)
-                {
-                    i = (s->in_digit  &&  !hit)  ?  -99  :  lfastrintf(log10f(s->energy)*10.0f - DTMF_POWER_OFFSET + DBM0_MAX_POWER);
-                    s->realtime_callback(s->realtime_callback_data, hit, i, s->duration);
-                    s->duration = 0;
-                }
-            }
-            else
-            {
-                if (hit)
-                {
-                    if (s->current_digits < MAX_DTMF_DIGITS)
-                    {
-                        s->digits[s->current_digits++] = (char) hit;
-                        s->digits[s->current_digits] = '\0';
-                        if (s->digits_callback)
-                        {
-                            s->digits_callback(s->digits_callback_data, s->digits, s->current_digits);
-                            s->current_digits = 0;
-                        }
-                    }
-                    else
-                    {
-                        s->lost_digits++;
-                    }
-                }
-            }
-            s->in_digit = hit;
-        }
-        s->last_hit = hit;
-#if defined(SPANDSP_USE_FIXED_POINT)
-        s->energy = 0;
-#else
-        s->energy = 0.0f;
-#endif
-        s->current_sample = 0;
-    }
-    if (s->current_digits  &&  s->digits_callback)
-    {
-        s->digits_callback(s->digits_callback_data, s->digits, s->current_digits);
-        s->digits[0] = '\0';
-        s->current_digits = 0;
+        dtmf_rx_analyse(s, row_energy, col_energy);
     }
+    dtmf_rx_deliver_digits(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -413,7 +463,7 @@ SPAN_DECLARE(dtmf_rx_state_t *) dtmf_rx_init(dtmf_rx_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (dtmf_rx_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (dtmf_rx_state_t *) span_alloc(sizeof (*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -466,7 +516,341 @@ SPAN_DECLARE(int) dtmf_rx_release(dtmf_rx_state_t *s)
 
 SPAN_DECLARE(int) dtmf_rx_free(dtmf_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The bank's Goertzel updates perform the same operations, in the same order, as
+   goertzel_samplex(), so each channel's results match those of a stand alone
+   receiver. They are bit exact, unless the compiler is allowed to reorder floating
+   point operations (e.g. with -ffast-math). */
+static void dtmf_rx_bank_update_generic(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len)
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t v1;
+    int16_t y;
+#else
+    float v1;
+#endif
+    int i;
+    int j;
+    int k;
+
+    for (i = 0;  i < len;  i++)
+    {
+        for (k = 0;  k < s->lanes;  k++)
+        {
+#if defined(SPANDSP_USE_FIXED_POINT)
+            s->energy[k] += ((int32_t) x[i][k]*x[i][k]);
+#else
+            s->energy[k] += x[i][k]*x[i][k];
+#endif
+        }
+        for (j = 0;  j < 8;  j++)
+        {
+            for (k = 0;  k < s->lanes;  k++)
+            {
+                v1 = s->v2[j][k];
+                s->v2[j][k] = s->v3[j][k];
+#if defined(SPANDSP_USE_FIXED_POINT)
+                y = (((int32_t) s->fac[j]*s->v2[j][k]) >> 14);
+                s->v3[j][k] = y - v1 + x[i][k];
+#else
+                s->v3[j][k] = s->fac[j]*s->v2[j][k] - v1 + x[i][k];
+#endif
+            }
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(DTMF_BANK_WITH_SSE)
+static void dtmf_rx_bank_update_sse(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len)
+{
+    __m128 fac[8];
+    __m128 v1;
+    __m128 v2[8];
+    __m128 v3[8];
+    __m128 amp;
+    __m128 energy;
+    int i;
+    int j;
+    int k;
+
+    for (j = 0;  j < 8;  j++)
+        fac[j] = _mm_set1_ps(s->fac[j]);
+    /* Work through the channels 4 at a time, keeping their state in registers
+       for the whole block. */
+    for (k = 0;  k < s->lanes;  k += 4)
+    {
+        energy = _mm_loadu_ps(&s->energy[k]);
+        for (j = 0;  j < 8;  j++)
+        {
+            v2[j] = _mm_loadu_ps(&s->v2[j][k]);
+            v3[j] = _mm_loadu_ps(&s->v3[j][k]);
+        }
+        for (i = 0;  i < len;  i++)
+        {
+            amp = _mm_loadu_ps(&x[i][k]);
+            energy = _mm_add_ps(energy, _mm_mul_ps(amp, amp));
+            for (j = 0;  j < 8;  j++)
+            {
+                v1 = v2[j];
+                v2[j] = v3[j];
+                v3[j] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac[j], v2[j]), v1), amp);
+            }
+        }
+        _mm_storeu_ps(&s->energy[k], energy);
+        for (j = 0;  j < 8;  j++)
+        {
+            _mm_storeu_ps(&s->v2[j][k], v2[j]);
+            _mm_storeu_ps(&s->v3[j][k], v3[j]);
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(DTMF_BANK_WITH_AVX)
+__attribute__((target("avx")))
+static void dtmf_rx_bank_update_avx(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len)
+{
+    __m256 fac[8];
+    __m256 v1;
+    __m256 v2[8];
+    __m256 v3[8];
+    __m256 amp;
+    __m256 energy;
+    int i;
+    int j;
+    int k;
+
+    for (j = 0;  j < 8;  j++)
+        fac[j] = _mm256_set1_ps(s->fac[j]);
+    /* Work through the channels 8 at a time. The multiply and add are kept as
+       separate operations, so the results match the scalar code. When
+       the lanes are not a multiple of 8, the last vector runs over into spare
+       lanes, which only ever see silence. */
+    for (k = 0;  k < s->lanes;  k += 8)
+    {
+        energy = _mm256_loadu_ps(&s->energy[k]);
+        for (j = 0;  j < 8;  j++)
+        {
+            v2[j] = _mm256_loadu_ps(&s->v2[j][k]);
+            v3[j] = _mm256_loadu_ps(&s->v3[j][k]);
+        }
+        for (i = 0;  i < len;  i++)
+        {
+            amp = _mm256_loadu_ps(&x[i][k]);
+            energy = _mm256_add_ps(energy, _mm256_mul_ps(amp, amp));
+            for (j = 0;  j < 8;  j++)
+            {
+                v1 = v2[j];
+                v2[j] = v3[j];
+                v3[j] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fac[j], v2[j]), v1), amp);
+            }
+        }
+        _mm256_storeu_ps(&s->energy[k], energy);
+        for (j = 0;  j < 8;  j++)
+        {
+            _mm256_storeu_ps(&s->v2[j][k], v2[j]);
+            _mm256_storeu_ps(&s->v3[j][k], v3[j]);
+        }
+    }
+    _mm256_zeroupper();
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void dtmf_rx_bank_update_select(dtmf_rx_bank_t *s, dtmf_bank_sample_t x[][DTMF_RX_BANK_MAX_CHANNELS], int len)
+{
+    dtmf_bank_kernel = dtmf_rx_bank_update_generic;
+#if defined(DTMF_BANK_WITH_SSE)
+    dtmf_bank_kernel = dtmf_rx_bank_update_sse;
+#endif
+#if defined(DTMF_BANK_WITH_AVX)
+    if (has_AVX())
+        dtmf_bank_kernel = dtmf_rx_bank_update_avx;
+#endif
+    dtmf_bank_kernel(s, x, len);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int dtmf_rx_bank_lanes(int channels)
+{
+#if defined(DTMF_BANK_WITH_SSE)  ||  defined(DTMF_BANK_WITH_AVX)
+    /* Round up to whole 128 bit vectors. The unused lanes are fed with silence. */
+    return (channels + 3) & ~3;
+#else
+    return channels;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static void dtmf_rx_bank_block_end(dtmf_rx_bank_t *s)
+{
+    goertzel_state_t goertzel;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t row_energy[4];
+    int32_t col_energy[4];
+#else
+    float row_energy[4];
+    float col_energy[4];
+#endif
+    int i;
+    int ch;
+
+    for (ch = 0;  ch < s->channels;  ch++)
+    {
+        /* Finish each Goertzel off with the same code a stand alone receiver uses */
+        for (i = 0;  i < 4;  i++)
+        {
+            goertzel.fac = s->fac[i];
+            goertzel.v2 = s->v2[i][ch];
+            goertzel.v3 = s->v3[i][ch];
+            row_energy[i] = goertzel_result(&goertzel);
+            goertzel.fac = s->fac[i + 4];
+            goertzel.v2 = s->v2[i + 4][ch];
+            goertzel.v3 = s->v3[i + 4][ch];
+            col_energy[i] = goertzel_result(&goertzel);
+        }
+        s->chan[ch].energy = s->energy[ch];
+        dtmf_rx_analyse(&s->chan[ch], row_energy, col_energy);
+    }
+    memset(s->v2, 0, sizeof(s->v2));
+    memset(s->v3, 0, sizeof(s->v3));
+    memset(s->energy, 0, sizeof(s->energy));
+    s->current_sample = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int dtmf_rx_bank_process(dtmf_rx_bank_t *s, const int16_t *amp[], int stride, int samples)
+{
+    dtmf_bank_sample_t x[DTMF_SAMPLES_PER_BLOCK][DTMF_RX_BANK_MAX_CHANNELS];
+    dtmf_rx_state_t *chan;
+    float famp;
+    const int16_t *in;
+    int i;
+    int ch;
+    int sample;
+    int len;
+
+    /* Lanes beyond the last channel are only ever fed with silence */
+    if (s->channels < DTMF_RX_BANK_MAX_CHANNELS)
+    {
+        for (i = 0;  i < DTMF_SAMPLES_PER_BLOCK;  i++)
+            memset(&x[i][s->channels], 0, sizeof(x[0][0])*(DTMF_RX_BANK_MAX_CHANNELS - s->channels));
+    }
+    for (sample = 0;  sample < samples;  sample += len)
+    {
+        /* The block length is optimised to meet the DTMF specs. */
+        len = DTMF_SAMPLES_PER_BLOCK - s->current_sample;
+        if (len > samples - sample)
+            len = samples - sample;
+        /* Transpose the chunk into the bank's layout, applying each channel's own
+           dialtone filter on the way. */
+        for (ch = 0;  ch < s->channels;  ch++)
+        {
+            chan = &s->chan[ch];
+            in = amp[ch] + sample*stride;
+            if (chan->filter_dialtone)
+            {
+                for (i = 0;  i < len;  i++)
+                {
+                    famp = dtmf_rx_dialtone_filter(chan, in[i*stride]);
+                    x[i][ch] = goertzel_preadjust_amp(famp);
+                }
+            }
+            else
+            {
+                for (i = 0;  i < len;  i++)
+                    x[i][ch] = goertzel_preadjust_amp(in[i*stride]);
+            }
+            if (chan->duration < INT_MAX - len)
+                chan->duration += len;
+        }
+        dtmf_bank_kernel(s, x, len);
+        s->current_sample += len;
+        if (s->current_sample >= DTMF_SAMPLES_PER_BLOCK)
+            dtmf_rx_bank_block_end(s);
+    }
+    for (ch = 0;  ch < s->channels;  ch++)
+        dtmf_rx_deliver_digits(&s->chan[ch]);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) dtmf_rx_bank(dtmf_rx_bank_t *s, const int16_t *amp[], int samples)
+{
+    return dtmf_rx_bank_process(s, amp, 1, samples);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) dtmf_rx_bank_interleaved(dtmf_rx_bank_t *s, const int16_t amp[], int samples)
+{
+    const int16_t *chan_amp[DTMF_RX_BANK_MAX_CHANNELS];
+    int ch;
+
+    for (ch = 0;  ch < s->channels;  ch++)
+        chan_amp[ch] = &amp[ch];
+    return dtmf_rx_bank_process(s, chan_amp, s->channels, samples);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(dtmf_rx_state_t *) dtmf_rx_bank_get_channel(dtmf_rx_bank_t *s, int channel)
+{
+    if (channel < 0  ||  channel >= s->channels)
+        return NULL;
+    return &s->chan[channel];
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(dtmf_rx_bank_t *) dtmf_rx_bank_init(dtmf_rx_bank_t *s,
+                                                 int channels,
+                                                 digits_rx_callback_t callback,
+                                                 void *user_data[])
+{
+    int i;
+    int ch;
+
+    if (channels < 1  ||  channels > DTMF_RX_BANK_MAX_CHANNELS)
+        return NULL;
+    if (s == NULL)
+    {
+        if ((s = (dtmf_rx_bank_t *) span_alloc(sizeof (*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->channels = channels;
+    s->lanes = dtmf_rx_bank_lanes(channels);
+    for (ch = 0;  ch < channels;  ch++)
+        dtmf_rx_init(&s->chan[ch], callback, (user_data)  ?  user_data[ch]  :  NULL);
+    /* The receivers' own Goertzel descriptors are set up now */
+    for (i = 0;  i < 4;  i++)
+    {
+        s->fac[i] = dtmf_detect_row[i].fac;
+        s->fac[i + 4] = dtmf_detect_col[i].fac;
+    }
+    s->current_sample = 0;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) dtmf_rx_bank_release(dtmf_rx_bank_t *s)
+{
+    int ch;
+
+    for (ch = 0;  ch < s->channels;  ch++)
+        dtmf_rx_release(&s->chan[ch]);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) dtmf_rx_bank_free(dtmf_rx_bank_t *s)
+{
+    dtmf_rx_bank_release(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -566,7 +950,7 @@ SPAN_DECLARE(dtmf_tx_state_t *) dtmf_tx_init(dtmf_tx_state_t *s)
 {
     if (s == NULL)
     {
-        if ((s = (dtmf_tx_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (dtmf_tx_state_t *) span_alloc(sizeof (*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -589,7 +973,7 @@ SPAN_DECLARE(int) dtmf_tx_release(dtmf_tx_state_t *s)
 
 SPAN_DECLARE(int) dtmf_tx_free(dtmf_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
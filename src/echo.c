@@ -92,9 +92,15 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
+#include "spandsp/complex.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/saturated.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/bit_operations.h"
@@ -112,11 +118,30 @@
 #define TRUE (!FALSE)
 #endif
 
+/* The vector LMS update is built with a per-function target attribute, in the
+   same way as the FIR dot product routines, so the rest of the library can still
+   be built for a baseline CPU. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define ECHO_WITH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
 #define NONUPDATE_DWELL_TIME        600     /* 600 samples, or 75ms */
 
 #define MIN_TX_POWER_FOR_ADAPTION   64*64
 #define MIN_RX_POWER_FOR_ADAPTION   64*64
 
+/* The adaption step size for the frequency domain canceller */
+#define FDAF_STEP_SIZE              0.35f
+/* If the cleaned signal stays this much stronger than the received one for this many
+   blocks in a row, the frequency domain canceller has diverged. A single block is not
+   enough, as the cleaned signal briefly exceeds the received one as an echo dies away
+   while the canceller is still converging. */
+#define FDAF_DIVERGENCE_RATIO       4
+#define FDAF_DIVERGENCE_BLOCKS      8
+
 static int narrowband_detect(echo_can_state_t *ec)
 {
     int k;
@@ -127,16 +152,15 @@ static int narrowband_detect(echo_can_state_t *ec)
     float f_acf[128];
     int32_t acf[28];
     int score;
-    int len = 32;
+    int len = ECHO_CAN_MIN_TAPS;
     int alen = 9;
     
+    /* The FIR history is held twice over, so the latest samples are always
+       contiguous from the current position. echo_can_init() makes sure there
+       are at least this many taps. */
     k = ec->curr_pos;
     for (i = 0;  i < len;  i++)
-    {
-        sf[i] = ec->fir_state.history[k++];
-        if (k >= 256)
-            k = 0;
-    }
+        sf[i] = ec->fir_state.history[k + i];
     for (k = 0;  k < alen;  k++)
     {
         temp = 0;
@@ -165,76 +189,289 @@ static int narrowband_detect(echo_can_state_t *ec)
     return score;
 }
 
-static __inline__ void lms_adapt(echo_can_state_t *ec, int factor)
+typedef void (*lms_adapt_kernel_t)(int32_t taps32[], int16_t taps16[], const int16_t hist[], int factor, int taps);
+
+static void lms_adapt_generic(int32_t taps32[], int16_t taps16[], const int16_t hist[], int factor, int taps)
+{
+    int i;
+
+    for (i = 0;  i < taps;  i++)
+    {
+        taps32[i] += hist[i]*factor;
+        taps16[i] = (int16_t) (taps32[i] >> 15);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(ECHO_WITH_AVX2)
+__attribute__((target("avx2")))
+static void lms_adapt_avx2(int32_t taps32[], int16_t taps16[], const int16_t hist[], int factor, int taps)
 {
+    __m256i f;
+    __m256i mask;
+    __m256i t0;
+    __m256i t1;
     int i;
 
-#if 0
-    mmx_t *mmx_taps;
-    mmx_t *mmx_coeffs;
-    mmx_t *mmx_hist;
-    mmx_t mmx;
-
-    mmx.w[0] =
-    mmx.w[1] =
-    mmx.w[2] =
-    mmx.w[3] = factor;
-    mmx_hist = (mmx_t *) &fir->history[fir->curr_pos];
-    mmx_taps = (mmx_t *) &fir->taps;
-    mmx_coeffs = (mmx_t *) fir->coeffs;
-    i = fir->taps;
-    movq_m2r(mmx, mm0);
-    while (i > 0)
-    {
-        movq_m2r(mmx_hist[0], mm1);
-        movq_m2r(mmx_taps[0], mm0);
-        movq_m2r(mmx_taps[1], mm1);
-        movq_r2r(mm1, mm2);
-        pmulhw(mm0, mm1);
-        pmullw(mm0, mm2);
-
-        pmaddwd_r2r(mm1, mm0);
-        pmaddwd_r2r(mm3, mm2);
-        paddd_r2r(mm0, mm4);
-        paddd_r2r(mm2, mm4);
-        movq_r2m(mm0, mmx_taps[0]);
-        movq_r2m(mm1, mmx_taps[0]);
-        movq_r2m(mm2, mmx_coeffs[0]);
-        mmx_taps += 2;
-        mmx_coeffs += 1;
-        mmx_hist += 1;
-        i -= 4;
-    )
-    emms();
-#elif 0
-    /* Update the FIR taps */
-    for (i = ec->taps - 1;  i >= 0;  i--)
-    {
-        /* Leak to avoid the coefficients drifting beyond the ability of the
-           adaption process to bring them back under control. */
-        ec->fir_taps32[i] -= (ec->fir_taps32[i] >> 23);
-        ec->fir_taps32[i] += (ec->fir_state.history[i + ec->curr_pos]*factor);
-        ec->latest_correction = (ec->fir_state.history[i + ec->curr_pos]*factor);
-        ec->fir_taps16[ec->tap_set][i] = ec->fir_taps32[i] >> 15;
-    }
-#else
-    int offset1;
-    int offset2;
-
-    /* Update the FIR taps */
-    offset2 = ec->curr_pos;
-    offset1 = ec->taps - offset2;
-    for (i = ec->taps - 1;  i >= offset1;  i--)
-    {
-        ec->fir_taps32[i] += (ec->fir_state.history[i - offset1]*factor);
-        ec->fir_taps16[ec->tap_set][i] = (int16_t) (ec->fir_taps32[i] >> 15);
-    }
-    for (  ;  i >= 0;  i--)
-    {
-        ec->fir_taps32[i] += (ec->fir_state.history[i + offset2]*factor);
-        ec->fir_taps16[ec->tap_set][i] = (int16_t) (ec->fir_taps32[i] >> 15);
+    f = _mm256_set1_epi32(factor);
+    mask = _mm256_set1_epi32(0xFFFF);
+    for (i = 0;  i + 16 <= taps;  i += 16)
+    {
+        t0 = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &hist[i])), f);
+        t1 = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &hist[i + 8])), f);
+        t0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) &taps32[i]), t0);
+        t1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) &taps32[i + 8]), t1);
+        _mm256_storeu_si256((__m256i *) &taps32[i], t0);
+        _mm256_storeu_si256((__m256i *) &taps32[i + 8], t1);
+        /* Truncate to 16 bits, as the C cast does, rather than saturating. Masking
+           first lets the unsigned saturating pack do a plain truncation. The pack
+           works within 128 bit lanes, so the quadwords need reordering afterwards. */
+        t0 = _mm256_and_si256(_mm256_srai_epi32(t0, 15), mask);
+        t1 = _mm256_and_si256(_mm256_srai_epi32(t1, 15), mask);
+        t0 = _mm256_permute4x64_epi64(_mm256_packus_epi32(t0, t1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) &taps16[i], t0);
+    }
+    for (  ;  i < taps;  i++)
+    {
+        taps32[i] += hist[i]*factor;
+        taps16[i] = (int16_t) (taps32[i] >> 15);
     }
+}
+/*- End of function --------------------------------------------------------*/
 #endif
+
+static lms_adapt_kernel_t lms_adapt_kernel(void)
+{
+    /* Follow the FIR implementation choice, so the whole canceller can be
+       forced back to plain C for testing. */
+#if defined(ECHO_WITH_AVX2)
+    if (fir_get_implementation() != FIR_IMPLEMENTATION_GENERIC)
+        return lms_adapt_avx2;
+#endif
+    return lms_adapt_generic;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void lms_adapt(echo_can_state_t *ec, lms_adapt_kernel_t kernel, int factor)
+{
+    /* Update the FIR taps. The FIR history is held twice over, so the taps line
+       up with a contiguous run of history from the current position. */
+    kernel(ec->fir_taps32, ec->fir_taps16[ec->tap_set], &ec->fir_state.history[ec->curr_pos], factor, ec->taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fdaf_fft(const echo_can_fdaf_state_t *fd, complexf_t data[])
+{
+    complexf_t t;
+    complexf_t w;
+    complexf_t a0;
+    complexf_t a1;
+    complexf_t a2;
+    complexf_t a3;
+    int half;
+    int step;
+    int i;
+    int j;
+    int k;
+
+    /* A plain iterative radix 2 complex FFT, of half the real transform length.
+       Its twiddle factors are every other entry in the real transform's table. The
+       inverse transform is done by conjugating on the way in and out. */
+    for (i = 0;  i < ECHO_CAN_FDAF_FFT_LEN/2;  i++)
+    {
+        j = fd->bit_rev[i];
+        if (j > i)
+        {
+            t = data[i];
+            data[i] = data[j];
+            data[j] = t;
+        }
+    }
+    /* The twiddle factors of the first two passes are 1 and -j, so do those
+       passes together, as radix 4 butterflies */
+    for (i = 0;  i < ECHO_CAN_FDAF_FFT_LEN/2;  i += 4)
+    {
+        a0.re = data[i].re + data[i + 1].re;
+        a0.im = data[i].im + data[i + 1].im;
+        a1.re = data[i].re - data[i + 1].re;
+        a1.im = data[i].im - data[i + 1].im;
+        a2.re = data[i + 2].re + data[i + 3].re;
+        a2.im = data[i + 2].im + data[i + 3].im;
+        a3.re = data[i + 2].im - data[i + 3].im;
+        a3.im = data[i + 3].re - data[i + 2].re;
+        data[i].re = a0.re + a2.re;
+        data[i].im = a0.im + a2.im;
+        data[i + 2].re = a0.re - a2.re;
+        data[i + 2].im = a0.im - a2.im;
+        data[i + 1].re = a1.re + a3.re;
+        data[i + 1].im = a1.im + a3.im;
+        data[i + 3].re = a1.re - a3.re;
+        data[i + 3].im = a1.im - a3.im;
+    }
+    for (half = 4, step = ECHO_CAN_FDAF_FFT_LEN/8;  half < ECHO_CAN_FDAF_FFT_LEN/2;  half <<= 1, step >>= 1)
+    {
+        for (i = 0;  i < ECHO_CAN_FDAF_FFT_LEN/2;  i += 2*half)
+        {
+            for (j = 0;  j < half;  j++)
+            {
+                w = fd->twiddle[j*step];
+                k = i + j + half;
+                t.re = data[k].re*w.re - data[k].im*w.im;
+                t.im = data[k].re*w.im + data[k].im*w.re;
+                data[k].re = data[i + j].re - t.re;
+                data[k].im = data[i + j].im - t.im;
+                data[i + j].re += t.re;
+                data[i + j].im += t.im;
+            }
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Transform the real signal in fd->buf, leaving the non-redundant half of the
+   spectrum in spec. The even and odd samples are packed into a complex signal
+   of half the length, and the two halves of the result are untangled afterwards. */
+static void fdaf_forward(echo_can_fdaf_state_t *fd, complexf_t spec[])
+{
+    complexf_t a;
+    complexf_t b;
+    complexf_t even;
+    complexf_t odd;
+    int m;
+    int k;
+
+    m = ECHO_CAN_FDAF_FFT_LEN/2;
+    for (k = 0;  k < m;  k++)
+    {
+        fd->work[k].re = fd->buf[2*k];
+        fd->work[k].im = fd->buf[2*k + 1];
+    }
+    fdaf_fft(fd, fd->work);
+    spec[0].re = fd->work[0].re + fd->work[0].im;
+    spec[0].im = 0.0f;
+    spec[m].re = fd->work[0].re - fd->work[0].im;
+    spec[m].im = 0.0f;
+    for (k = 1;  k < m;  k++)
+    {
+        a = fd->work[k];
+        b.re = fd->work[m - k].re;
+        b.im = -fd->work[m - k].im;
+        even.re = 0.5f*(a.re + b.re);
+        even.im = 0.5f*(a.im + b.im);
+        odd.re = 0.5f*(a.im - b.im);
+        odd.im = -0.5f*(a.re - b.re);
+        spec[k].re = even.re + fd->twiddle[k].re*odd.re - fd->twiddle[k].im*odd.im;
+        spec[k].im = even.im + fd->twiddle[k].re*odd.im + fd->twiddle[k].im*odd.re;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Inverse transform the non-redundant half of the spectrum of a real signal,
+   leaving the signal, scaled by half the FFT length, in fd->buf. */
+static void fdaf_inverse(echo_can_fdaf_state_t *fd, const complexf_t spec[])
+{
+    complexf_t a;
+    complexf_t b;
+    complexf_t even;
+    complexf_t odd;
+    complexf_t t;
+    int m;
+    int k;
+
+    m = ECHO_CAN_FDAF_FFT_LEN/2;
+    for (k = 0;  k < m;  k++)
+    {
+        a = spec[k];
+        b.re = spec[m - k].re;
+        b.im = -spec[m - k].im;
+        even.re = 0.5f*(a.re + b.re);
+        even.im = 0.5f*(a.im + b.im);
+        t.re = 0.5f*(a.re - b.re);
+        t.im = 0.5f*(a.im - b.im);
+        odd.re = t.re*fd->twiddle[k].re + t.im*fd->twiddle[k].im;
+        odd.im = t.im*fd->twiddle[k].re - t.re*fd->twiddle[k].im;
+        fd->work[k].re = even.re - odd.im;
+        fd->work[k].im = -(even.im + odd.re);
+    }
+    fdaf_fft(fd, fd->work);
+    for (k = 0;  k < m;  k++)
+    {
+        fd->buf[2*k] = fd->work[k].re;
+        fd->buf[2*k + 1] = -fd->work[k].im;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fdaf_flush(echo_can_fdaf_state_t *fd)
+{
+    int i;
+
+    fd->constrain_partition = 0;
+    fd->diverging_blocks = 0;
+    fd->x_head = 0;
+    fd->pos = 0;
+    fd->tx_peak = 0;
+    fd->rx_peak = 0;
+    memset(fd->tx, 0, sizeof(fd->tx));
+    memset(fd->rx, 0, sizeof(fd->rx));
+    memset(fd->clean, 0, sizeof(fd->clean));
+    memset(fd->tx_old, 0, sizeof(fd->tx_old));
+    for (i = 0;  i < ECHO_CAN_FDAF_BINS;  i++)
+        fd->psd[i] = 0.0f;
+    memset(fd->x, 0, fd->partitions*ECHO_CAN_FDAF_BINS*sizeof(complexf_t));
+    memset(fd->w, 0, fd->partitions*ECHO_CAN_FDAF_BINS*sizeof(complexf_t));
+    memset(fd->tx_peaks, 0, fd->partitions*sizeof(int));
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fdaf_free(echo_can_fdaf_state_t *fd)
+{
+    if (fd->x)
+        span_free(fd->x);
+    if (fd->w)
+        span_free(fd->w);
+    if (fd->tx_peaks)
+        span_free(fd->tx_peaks);
+    span_free(fd);
+}
+/*- End of function --------------------------------------------------------*/
+
+static echo_can_fdaf_state_t *fdaf_create(int len)
+{
+    echo_can_fdaf_state_t *fd;
+    int i;
+    int j;
+    int k;
+
+    if ((fd = (echo_can_fdaf_state_t *) span_alloc(sizeof(*fd))) == NULL)
+        return NULL;
+    memset(fd, 0, sizeof(*fd));
+    fd->partitions = (len + ECHO_CAN_FDAF_BLOCK_LEN - 1)/ECHO_CAN_FDAF_BLOCK_LEN;
+    fd->x = (complexf_t *) span_alloc(fd->partitions*ECHO_CAN_FDAF_BINS*sizeof(complexf_t));
+    fd->w = (complexf_t *) span_alloc(fd->partitions*ECHO_CAN_FDAF_BINS*sizeof(complexf_t));
+    fd->tx_peaks = (int *) span_alloc(fd->partitions*sizeof(int));
+    if (fd->x == NULL  ||  fd->w == NULL  ||  fd->tx_peaks == NULL)
+    {
+        fdaf_free(fd);
+        return NULL;
+    }
+    for (i = 0;  i < ECHO_CAN_FDAF_FFT_LEN/2;  i++)
+    {
+        fd->twiddle[i].re = cosf(2.0f*3.1415926535f*i/ECHO_CAN_FDAF_FFT_LEN);
+        fd->twiddle[i].im = -sinf(2.0f*3.1415926535f*i/ECHO_CAN_FDAF_FFT_LEN);
+    }
+    for (i = 0;  i < ECHO_CAN_FDAF_FFT_LEN/2;  i++)
+    {
+        for (j = 1, k = 0;  j < ECHO_CAN_FDAF_FFT_LEN/2;  j <<= 1)
+        {
+            k <<= 1;
+            if ((i & j))
+                k |= 1;
+        }
+        fd->bit_rev[i] = k;
+    }
+    fdaf_flush(fd);
+    return fd;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -244,33 +481,52 @@ SPAN_DECLARE(echo_can_state_t *) echo_can_init(int len, int adaption_mode)
     int i;
     int j;
 
-    if ((ec = (echo_can_state_t *) malloc(sizeof(*ec))) == NULL)
+    /* The narrowband detector, and the suppressor tests, look back over the
+       latest ECHO_CAN_MIN_TAPS samples in the FIR history */
+    if (len < ECHO_CAN_MIN_TAPS)
+        return  NULL;
+    if ((ec = (echo_can_state_t *) span_alloc(sizeof(*ec))) == NULL)
         return  NULL;
     memset(ec, 0, sizeof(*ec));
     ec->taps = len;
     ec->curr_pos = ec->taps - 1;
     ec->tap_mask = ec->taps - 1;
-    if ((ec->fir_taps32 = (int32_t *) malloc(ec->taps*sizeof(int32_t))) == NULL)
+    if ((adaption_mode & ECHO_CAN_USE_FREQ_DOMAIN))
     {
-        free(ec);
-        return  NULL;
+        /* The frequency domain canceller keeps its own filter, so the time domain
+           taps and history are not needed */
+        if ((ec->fdaf = fdaf_create(len)) == NULL)
+        {
+            span_free(ec);
+            return  NULL;
+        }
     }
-    memset(ec->fir_taps32, 0, ec->taps*sizeof(int32_t));
-    for (i = 0;  i < 4;  i++)
+    else
     {
-        if ((ec->fir_taps16[i] = (int16_t *) malloc(ec->taps*sizeof(int16_t))) == NULL)
+        if ((ec->fir_taps32 = (int32_t *) span_alloc(ec->taps*sizeof(int32_t))) == NULL)
         {
-            for (j = 0;  j < i;  j++)
-                free(ec->fir_taps16[j]);
-            free(ec->fir_taps32);
-            free(ec);
+            span_free(ec);
+            return  NULL;
+        }
+        memset(ec->fir_taps32, 0, ec->taps*sizeof(int32_t));
+        for (i = 0;  i < 4;  i++)
+        {
+            if ((ec->fir_taps16[i] = (int16_t *) span_alloc(ec->taps*sizeof(int16_t))) == NULL)
+            {
+                for (j = 0;  j < i;  j++)
+                    span_free(ec->fir_taps16[j]);
+                span_free(ec->fir_taps32);
+                span_free(ec);
+                return  NULL;
+            }
+            memset(ec->fir_taps16[i], 0, ec->taps*sizeof(int16_t));
+        }
+        if (fir16_create(&ec->fir_state, ec->fir_taps16[0], ec->taps) == NULL)
+        {
+            echo_can_free(ec);
             return  NULL;
         }
-        memset(ec->fir_taps16[i], 0, ec->taps*sizeof(int16_t));
     }
-    fir16_create(&ec->fir_state,
-                 ec->fir_taps16[0],
-                 ec->taps);
     ec->rx_power_threshold = 10000000;
     ec->geigel_max = 0;
     ec->geigel_lag = 0;
@@ -293,11 +549,18 @@ SPAN_DECLARE(int) echo_can_free(echo_can_state_t *ec)
 {
     int i;
     
-    fir16_free(&ec->fir_state);
-    free(ec->fir_taps32);
-    for (i = 0;  i < 4;  i++)
-        free(ec->fir_taps16[i]);
-    free(ec);
+    if (ec->fdaf)
+    {
+        fdaf_free(ec->fdaf);
+    }
+    else
+    {
+        fir16_free(&ec->fir_state);
+        span_free(ec->fir_taps32);
+        for (i = 0;  i < 4;  i++)
+            span_free(ec->fir_taps16[i]);
+    }
+    span_free(ec);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -319,11 +582,14 @@ SPAN_DECLARE(void) echo_can_flush(echo_can_state_t *ec)
     ec->clean_rx_power = 0;
     ec->nonupdate_dwell = 0;
 
-    fir16_flush(&ec->fir_state);
-    ec->fir_state.curr_pos = ec->taps - 1;
-    memset(ec->fir_taps32, 0, ec->taps*sizeof(int32_t));
-    for (i = 0;  i < 4;  i++)
-        memset(ec->fir_taps16[i], 0, ec->taps*sizeof(int16_t));
+    if (ec->fdaf == NULL)
+    {
+        fir16_flush(&ec->fir_state);
+        ec->fir_state.curr_pos = ec->taps - 1;
+        memset(ec->fir_taps32, 0, ec->taps*sizeof(int32_t));
+        for (i = 0;  i < 4;  i++)
+            memset(ec->fir_taps16[i], 0, ec->taps*sizeof(int16_t));
+    }
 
     ec->curr_pos = ec->taps - 1;
 
@@ -346,17 +612,28 @@ SPAN_DECLARE(void) echo_can_flush(echo_can_state_t *ec)
     memset(ec->last_acf, 0, sizeof(ec->last_acf));
     ec->narrowband_count = 0;
     ec->narrowband_score = 0;
+
+    if (ec->fdaf)
+        fdaf_flush(ec->fdaf);
 }
 /*- End of function --------------------------------------------------------*/
 
-int sample_no = 0;
-
 SPAN_DECLARE(void) echo_can_snapshot(echo_can_state_t *ec)
 {
+    /* The frequency domain canceller has no time domain taps to take a copy of */
+    if (ec->fdaf)
+        return;
     memcpy(ec->snapshot, ec->fir_taps16[0], ec->taps*sizeof(int16_t));
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) echo_can_get_stats(echo_can_state_t *ec, span_stats_t *stats)
+{
+    *stats = ec->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int16_t echo_can_hpf(int32_t coeff[2], int16_t amp)
 {
     int32_t z;
@@ -396,7 +673,238 @@ static __inline__ int16_t echo_can_hpf(int32_t coeff[2], int16_t amp)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int16_t) echo_can_update(echo_can_state_t *ec, int16_t tx, int16_t rx)
+static __inline__ int echo_can_nlp(echo_can_state_t *ec, int clean_rx)
+{
+    if ((ec->adaption_mode & ECHO_CAN_USE_NLP))
+    {
+        /* Non-linear processor - a fancy way to say "zap small signals, to avoid
+           residual echo due to (uLaw/ALaw) non-linearity in the channel.". */
+        if (ec->rx_power[1] < 30000000)
+        {
+            if (!ec->cng)
+            {
+                ec->cng_level = ec->clean_rx_power;
+                ec->cng = TRUE;
+            }
+            if ((ec->adaption_mode & ECHO_CAN_USE_CNG))
+            {
+                /* Very elementary comfort noise generation */
+                /* Just random numbers rolled off very vaguely Hoth-like */
+                ec->cng_rndnum = 1664525U*ec->cng_rndnum + 1013904223U;
+                ec->cng_filter = ((ec->cng_rndnum & 0xFFFF) - 32768 + 5*ec->cng_filter) >> 3;
+                clean_rx = (ec->cng_filter*ec->cng_level) >> 17;
+                /* TODO: A better CNG, with more accurate (tracking) spectral shaping! */
+            }
+            else
+            {
+                clean_rx = 0;
+            }
+//clean_rx = -16000;
+        }
+        else
+        {
+            ec->cng = FALSE;
+        }
+    }
+    else
+    {
+        ec->cng = FALSE;
+    }
+    return clean_rx;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fdaf_process_block(echo_can_state_t *ec)
+{
+    echo_can_fdaf_state_t *fd;
+    complexf_t *x;
+    complexf_t *w;
+    complexf_t e[ECHO_CAN_FDAF_BINS];
+    float gain[ECHO_CAN_FDAF_BINS];
+    float scale;
+    int clean_rx;
+    int hold_adaption;
+    int tx_peak;
+    int p;
+    int q;
+    int i;
+    int k;
+
+    fd = ec->fdaf;
+    /* Bring the latest overlapping pair of transmit blocks into the frequency domain,
+       as the newest entry in the ring of partition spectra. */
+    if (--fd->x_head < 0)
+        fd->x_head = fd->partitions - 1;
+    for (i = 0;  i < ECHO_CAN_FDAF_BLOCK_LEN;  i++)
+    {
+        fd->buf[i] = fd->tx_old[i];
+        fd->buf[i + ECHO_CAN_FDAF_BLOCK_LEN] = fd->tx[i];
+        fd->tx_old[i] = fd->tx[i];
+    }
+    fdaf_forward(fd, &fd->x[fd->x_head*ECHO_CAN_FDAF_BINS]);
+    fd->tx_peaks[fd->x_head] = fd->tx_peak;
+
+    /* Estimate the echo, by summing the filtered spectra of all the partitions. At
+       the same time, find the power in each bin across all the partitions, which is
+       the power of the whole tail's worth of transmit signal the update will use. */
+    for (k = 0;  k < ECHO_CAN_FDAF_BINS;  k++)
+    {
+        e[k].re = e[k].im = 0.0f;
+        fd->psd[k] = 0.0f;
+    }
+    q = fd->x_head;
+    for (p = 0;  p < fd->partitions;  p++)
+    {
+        x = &fd->x[q*ECHO_CAN_FDAF_BINS];
+        w = &fd->w[p*ECHO_CAN_FDAF_BINS];
+        for (k = 0;  k < ECHO_CAN_FDAF_BINS;  k++)
+        {
+            e[k].re += w[k].re*x[k].re - w[k].im*x[k].im;
+            e[k].im += w[k].re*x[k].im + w[k].im*x[k].re;
+            fd->psd[k] += x[k].re*x[k].re + x[k].im*x[k].im;
+        }
+        if (++q >= fd->partitions)
+            q = 0;
+    }
+    fdaf_inverse(fd, e);
+
+    /* Only the second half of the inverse transform is free from circular
+       convolution effects (overlap-save). */
+    scale = 2.0f/ECHO_CAN_FDAF_FFT_LEN;
+    for (i = 0;  i < ECHO_CAN_FDAF_BLOCK_LEN;  i++)
+    {
+        clean_rx = fd->rx[i] - (int) lrintf(fd->buf[i + ECHO_CAN_FDAF_BLOCK_LEN]*scale);
+        ec->clean_rx_power += ((clean_rx*clean_rx - ec->clean_rx_power) >> 6);
+        fd->buf[i] = 0.0f;
+        fd->buf[i + ECHO_CAN_FDAF_BLOCK_LEN] = (float) clean_rx;
+        fd->clean[i] = saturate(echo_can_nlp(ec, clean_rx));
+    }
+    if (ec->rx_power[1])
+        ec->vad = (8000*ec->clean_rx_power)/ec->rx_power[1];
+    else
+        ec->vad = 0;
+
+    /* The echo may arrive long after the signal which caused it, so the usual test of
+       the transmitted power against the received power cannot spot near end speech.
+       Instead, use a Geigel style test. The echo path loses at least 6dB, so anything
+       received which is more than half the strongest transmitted signal within the tail
+       must be near end speech. A tail with no transmitted signal contributes nothing to
+       the update, so it needs no special treatment. */
+    tx_peak = 0;
+    for (p = 0;  p < fd->partitions;  p++)
+    {
+        if (fd->tx_peaks[p] > tx_peak)
+            tx_peak = fd->tx_peaks[p];
+    }
+    if (2*fd->rx_peak > tx_peak)
+        ec->nonupdate_dwell = NONUPDATE_DWELL_TIME;
+    hold_adaption = (ec->nonupdate_dwell > 0);
+    ec->nonupdate_dwell -= ECHO_CAN_FDAF_BLOCK_LEN;
+    if (ec->nonupdate_dwell < 0)
+        ec->nonupdate_dwell = 0;
+    fd->tx_peak = 0;
+    fd->rx_peak = 0;
+
+    if (ec->rx_power[1] > MIN_RX_POWER_FOR_ADAPTION  &&  ec->clean_rx_power/FDAF_DIVERGENCE_RATIO > ec->rx_power[1])
+        fd->diverging_blocks++;
+    else
+        fd->diverging_blocks = 0;
+    if (fd->diverging_blocks >= FDAF_DIVERGENCE_BLOCKS)
+    {
+        /* The EC seems to be making things worse, instead of better. Back off. */
+        for (k = 0;  k < fd->partitions*ECHO_CAN_FDAF_BINS;  k++)
+        {
+            fd->w[k].re *= 0.5f;
+            fd->w[k].im *= 0.5f;
+        }
+        fd->diverging_blocks = 0;
+        ec->clean_rx_power = ec->rx_power[1];
+        ec->stats.retrains++;
+    }
+    else if ((ec->adaption_mode & ECHO_CAN_USE_ADAPTION)  &&  !hold_adaption)
+    {
+        /* The error signal, zero padded at the front, gives the gradient */
+        fdaf_forward(fd, e);
+        /* Normalise each bin by its own power. The floor keeps the step size sane
+           in bins with little energy. */
+        for (k = 0;  k < ECHO_CAN_FDAF_BINS;  k++)
+            gain[k] = FDAF_STEP_SIZE/(fd->psd[k] + fd->partitions*ECHO_CAN_FDAF_FFT_LEN*MIN_TX_POWER_FOR_ADAPTION);
+        for (k = 0;  k < ECHO_CAN_FDAF_BINS;  k++)
+        {
+            e[k].re *= gain[k];
+            e[k].im *= gain[k];
+        }
+        q = fd->x_head;
+        for (p = 0;  p < fd->partitions;  p++)
+        {
+            x = &fd->x[q*ECHO_CAN_FDAF_BINS];
+            w = &fd->w[p*ECHO_CAN_FDAF_BINS];
+            for (k = 0;  k < ECHO_CAN_FDAF_BINS;  k++)
+            {
+                /* w += conj(x)*e */
+                w[k].re += x[k].re*e[k].re + x[k].im*e[k].im;
+                w[k].im += x[k].re*e[k].im - x[k].im*e[k].re;
+            }
+            if (++q >= fd->partitions)
+                q = 0;
+        }
+        /* The unconstrained update lets each partition's impulse response spread
+           into the half of its FFT window which should be zero. Constraining every
+           partition on every block would cost two FFTs per partition, so constrain
+           one partition per block, in rotation (alternating MDF). With each bin
+           normalised by the power across the whole tail, the leakage which builds
+           up between a partition's turns is too small to wrap around into the
+           echo estimate. */
+        w = &fd->w[fd->constrain_partition*ECHO_CAN_FDAF_BINS];
+        fdaf_inverse(fd, w);
+        for (i = 0;  i < ECHO_CAN_FDAF_BLOCK_LEN;  i++)
+        {
+            fd->buf[i] *= scale;
+            fd->buf[i + ECHO_CAN_FDAF_BLOCK_LEN] = 0.0f;
+        }
+        fdaf_forward(fd, w);
+        if (++fd->constrain_partition >= fd->partitions)
+            fd->constrain_partition = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int16_t fdaf_update(echo_can_state_t *ec, int16_t tx, int16_t rx)
+{
+    echo_can_fdaf_state_t *fd;
+    int16_t clean_rx;
+
+    fd = ec->fdaf;
+    if (ec->adaption_mode & ECHO_CAN_USE_RX_HPF)
+        rx = echo_can_hpf(ec->rx_hpf, rx);
+
+    /* The same short term power levels as the time domain canceller uses, for the
+       NLP and the divergence check */
+    ec->tx_power[3] += ((abs(tx) - ec->tx_power[3]) >> 5);
+    ec->tx_power[2] += ((tx*tx - ec->tx_power[2]) >> 8);
+    ec->tx_power[1] += ((tx*tx - ec->tx_power[1]) >> 5);
+    ec->tx_power[0] += ((tx*tx - ec->tx_power[0]) >> 3);
+    ec->rx_power[1] += ((rx*rx - ec->rx_power[1]) >> 6);
+    ec->rx_power[0] += ((rx*rx - ec->rx_power[0]) >> 3);
+    if (abs(tx) > fd->tx_peak)
+        fd->tx_peak = abs(tx);
+    if (abs(rx) > fd->rx_peak)
+        fd->rx_peak = abs(rx);
+
+    /* The clean samples come out a block after the samples they came from */
+    clean_rx = fd->clean[fd->pos];
+    fd->tx[fd->pos] = tx;
+    fd->rx[fd->pos] = rx;
+    if (++fd->pos >= ECHO_CAN_FDAF_BLOCK_LEN)
+    {
+        fd->pos = 0;
+        fdaf_process_block(ec);
+    }
+    return clean_rx;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int16_t echo_can_process(echo_can_state_t *ec, lms_adapt_kernel_t lms_kernel, int16_t tx, int16_t rx)
 {
     int32_t echo_value;
     int clean_rx;
@@ -404,7 +912,6 @@ SPAN_DECLARE(int16_t) echo_can_update(echo_can_state_t *ec, int16_t tx, int16_t
     int score;
     int i;
 
-sample_no++;
     if (ec->adaption_mode & ECHO_CAN_USE_RX_HPF)
         rx = echo_can_hpf(ec->rx_hpf, rx);
 
@@ -427,7 +934,6 @@ sample_no++;
 
     /* And the answer is..... */
     clean_rx = rx - echo_value;
-printf("echo is %" PRId32 "\n", echo_value);
     /* That was the easy part. Now we need to adapt! */
     if (ec->nonupdate_dwell > 0)
         ec->nonupdate_dwell--;
@@ -464,7 +970,6 @@ printf("echo is %" PRId32 "\n", echo_value);
                 {
                     ec->narrowband_count = 0;
                     score = narrowband_detect(ec);
-printf("Do the narrowband test %d at %d\n", score, ec->curr_pos);
                     if (score > 6)
                     {
                         if (ec->narrowband_score == 0)
@@ -475,9 +980,8 @@ printf("Do the narrowband test %d at %d\n", score, ec->curr_pos);
                     {
                         if (ec->narrowband_score > 200)
                         {
-printf("Revert to %d at %d\n", (ec->tap_set + 1)%3, sample_no);
                             memcpy(ec->fir_taps16[ec->tap_set], ec->fir_taps16[3], ec->taps*sizeof(int16_t));
-                            memcpy(ec->fir_taps16[(ec->tap_set - 1)%3], ec->fir_taps16[3], ec->taps*sizeof(int16_t));
+                            memcpy(ec->fir_taps16[(ec->tap_set + 2)%3], ec->fir_taps16[3], ec->taps*sizeof(int16_t));
                             for (i = 0;  i < ec->taps;  i++)
                                 ec->fir_taps32[i] = ec->fir_taps16[3][i] << 15;
                             ec->tap_rotate_counter = 1600;
@@ -488,7 +992,6 @@ printf("Revert to %d at %d\n", (ec->tap_set + 1)%3, sample_no);
                 ec->dtd_onset = FALSE;
                 if (--ec->tap_rotate_counter <= 0)
                 {
-printf("Rotate to %d at %d\n", ec->tap_set, sample_no);
                     ec->tap_rotate_counter = 1600;
                     ec->tap_set++;
                     if (ec->tap_set > 2)
@@ -516,7 +1019,7 @@ printf("Rotate to %d at %d\n", ec->tap_set, sample_no);
                         i = top_bit(ec->tx_power[3]) - 8;
                     if (i > 0)
                         nsuppr >>= i;
-                    lms_adapt(ec, nsuppr);
+                    lms_adapt(ec, lms_kernel, nsuppr);
                 }
             }
             //printf("%10d %10d %10d %10d %10d\n", rx, clean_rx, nsuppr, ec->tx_power[1], ec->rx_power[1]);
@@ -526,9 +1029,8 @@ printf("Rotate to %d at %d\n", ec->tap_set, sample_no);
         {
             if (!ec->dtd_onset)
             {
-printf("Revert to %d at %d\n", (ec->tap_set + 1)%3, sample_no);
                 memcpy(ec->fir_taps16[ec->tap_set], ec->fir_taps16[(ec->tap_set + 1)%3], ec->taps*sizeof(int16_t));
-                memcpy(ec->fir_taps16[(ec->tap_set - 1)%3], ec->fir_taps16[(ec->tap_set + 1)%3], ec->taps*sizeof(int16_t));
+                memcpy(ec->fir_taps16[(ec->tap_set + 2)%3], ec->fir_taps16[(ec->tap_set + 1)%3], ec->taps*sizeof(int16_t));
                 for (i = 0;  i < ec->taps;  i++)
                     ec->fir_taps32[i] = ec->fir_taps16[(ec->tap_set + 1)%3][i] << 15;
                 ec->tap_rotate_counter = 1600;
@@ -548,6 +1050,7 @@ printf("Revert to %d at %d\n", (ec->tap_set + 1)%3, sample_no);
         memset(ec->fir_taps32, 0, ec->taps*sizeof(int32_t));
         for (i = 0;  i < 4;  i++)
             memset(ec->fir_taps16[i], 0, ec->taps*sizeof(int16_t));
+        ec->stats.retrains++;
     }
 
 #if defined(XYZZY)
@@ -566,43 +1069,8 @@ printf("Revert to %d at %d\n", (ec->tap_set + 1)%3, sample_no);
     }
 #endif
 
-    if ((ec->adaption_mode & ECHO_CAN_USE_NLP))
-    {
-        /* Non-linear processor - a fancy way to say "zap small signals, to avoid
-           residual echo due to (uLaw/ALaw) non-linearity in the channel.". */
-        if (ec->rx_power[1] < 30000000)
-        {
-            if (!ec->cng)
-            {
-                ec->cng_level = ec->clean_rx_power;
-                ec->cng = TRUE;
-            }
-            if ((ec->adaption_mode & ECHO_CAN_USE_CNG))
-            {
-                /* Very elementary comfort noise generation */
-                /* Just random numbers rolled off very vaguely Hoth-like */
-                ec->cng_rndnum = 1664525U*ec->cng_rndnum + 1013904223U;
-                ec->cng_filter = ((ec->cng_rndnum & 0xFFFF) - 32768 + 5*ec->cng_filter) >> 3;
-                clean_rx = (ec->cng_filter*ec->cng_level) >> 17;
-                /* TODO: A better CNG, with more accurate (tracking) spectral shaping! */
-            }
-            else
-            {
-                clean_rx = 0;
-            }
-//clean_rx = -16000;
-        }
-        else
-        {
-            ec->cng = FALSE;
-        }
-    }
-    else
-    {
-        ec->cng = FALSE;
-    }
+    clean_rx = echo_can_nlp(ec, clean_rx);
 
-printf("Narrowband score %4d %5d at %d\n", ec->narrowband_score, score, sample_no);
     /* Roll around the rolling buffer */
     if (ec->curr_pos <= 0)
         ec->curr_pos = ec->taps;
@@ -611,6 +1079,43 @@ printf("Narrowband score %4d %5d at %d\n", ec->narrowband_score, score, sample_n
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int16_t) echo_can_update(echo_can_state_t *ec, int16_t tx, int16_t rx)
+{
+    ec->stats.samples_in++;
+    if (ec->fdaf)
+        return fdaf_update(ec, tx, rx);
+    return echo_can_process(ec, lms_adapt_kernel(), tx, rx);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) echo_can_update_block(echo_can_state_t *ec, const int16_t tx[], const int16_t rx[], int16_t clean[], int len)
+{
+    lms_adapt_kernel_t lms_kernel;
+    uint64_t start;
+    int i;
+
+    start = span_stats_cycles();
+    /* The echo estimate for each sample depends on the taps as adapted by the
+       previous sample, so the samples must still be taken in turn. The gain
+       here comes from the vector FIR and LMS kernels, and choosing them once
+       per block rather than once per sample. */
+    if (ec->fdaf)
+    {
+        for (i = 0;  i < len;  i++)
+            clean[i] = fdaf_update(ec, tx[i], rx[i]);
+    }
+    else
+    {
+        lms_kernel = lms_adapt_kernel();
+        for (i = 0;  i < len;  i++)
+            clean[i] = echo_can_process(ec, lms_kernel, tx[i], rx[i]);
+    }
+    ec->stats.samples_in += len;
+    ec->stats.cycles += span_stats_cycles() - start;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int16_t) echo_can_hpf_tx(echo_can_state_t *ec, int16_t tx)
 {
     if (ec->adaption_mode & ECHO_CAN_USE_TX_HPF)
@@ -50,7 +50,10 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/vector_int.h"
@@ -123,10 +126,28 @@ static void fax_send_hdlc(void *user_data, const uint8_t *msg, int len)
 
     s = (fax_state_t *) user_data;
 
+    if (len > 0)
+        s->stats.frames_out++;
     fax_modems_hdlc_tx_frame(&s->modems, msg, len);
 }
 /*- End of function --------------------------------------------------------*/
 
+static void fax_hdlc_accept(void *user_data, const uint8_t *msg, int len, int ok)
+{
+    fax_state_t *s;
+
+    s = (fax_state_t *) user_data;
+    if (len >= 0)
+    {
+        if (ok)
+            s->stats.frames_in++;
+        else
+            s->stats.crc_errors++;
+    }
+    t30_hdlc_accept(&s->t30, msg, len, ok);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void tone_detected(void *user_data, int tone, int level, int delay)
 {
     t30_state_t *s;
@@ -188,12 +209,12 @@ static int v17_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v17_rx(&s->fast_modems.v17_rx, amp, len);
+    v17_rx(&s->fast_rx.v17_rx, amp, len);
     if (t->t30.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_modems.v17_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_modems.v17_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_rx.v17_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_rx.v17_rx);
     }
     else
     {
@@ -217,7 +238,7 @@ static int v17_v21_rx_fillin(void *user_data, int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v17_rx_fillin(&s->fast_modems.v17_rx, len);
+    v17_rx_fillin(&s->fast_rx.v17_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -230,12 +251,12 @@ static int v27ter_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v27ter_rx(&s->fast_modems.v27ter_rx, amp, len);
+    v27ter_rx(&s->fast_rx.v27ter_rx, amp, len);
     if (t->t30.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_modems.v27ter_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_modems.v27ter_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_rx.v27ter_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_rx.v27ter_rx);
     }
     else
     {
@@ -259,7 +280,7 @@ static int v27ter_v21_rx_fillin(void *user_data, int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v27ter_rx_fillin(&s->fast_modems.v27ter_rx, len);
+    v27ter_rx_fillin(&s->fast_rx.v27ter_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -272,12 +293,12 @@ static int v29_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v29_rx(&s->fast_modems.v29_rx, amp, len);
+    v29_rx(&s->fast_rx.v29_rx, amp, len);
     if (t->t30.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_modems.v29_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_modems.v29_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_rx.v29_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_rx.v29_rx);
     }
     else
     {
@@ -301,7 +322,7 @@ static int v29_v21_rx_fillin(void *user_data, int len)
 
     t = (fax_state_t *) user_data;
     s = &t->modems;
-    v29_rx_fillin(&s->fast_modems.v29_rx, len);
+    v29_rx_fillin(&s->fast_rx.v29_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -309,8 +330,10 @@ static int v29_v21_rx_fillin(void *user_data, int len)
 
 SPAN_DECLARE_NONSTD(int) fax_rx(fax_state_t *s, int16_t *amp, int len)
 {
+    uint64_t start;
     int i;
 
+    start = span_stats_cycles();
 #if defined(LOG_FAX_AUDIO)
     if (s->modems.audio_rx_log >= 0)
         write(s->modems.audio_rx_log, amp, len*sizeof(int16_t));
@@ -319,6 +342,8 @@ SPAN_DECLARE_NONSTD(int) fax_rx(fax_state_t *s, int16_t *amp, int len)
         amp[i] = dc_restore(&s->modems.dc_restore, amp[i]);
     s->modems.rx_handler(s->modems.rx_user_data, amp, len);
     t30_timer_update(&s->t30, len);
+    s->stats.samples_in += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -347,6 +372,7 @@ SPAN_DECLARE_NONSTD(int) fax_rx_fillin(fax_state_t *s, int len)
     /* Call the fillin function of the current modem (if there is one). */
     s->modems.rx_fillin_handler(s->modems.rx_user_data, len);
     t30_timer_update(&s->t30, len);
+    s->stats.underflows++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -373,12 +399,14 @@ static int set_next_tx_type(fax_state_t *s)
 
 SPAN_DECLARE_NONSTD(int) fax_tx(fax_state_t *s, int16_t *amp, int max_len)
 {
+    uint64_t start;
     int len;
 #if defined(LOG_FAX_AUDIO)
     int required_len;
     
     required_len = max_len;
 #endif
+    start = span_stats_cycles();
     len = 0;
     if (s->modems.transmit)
     {
@@ -416,6 +444,8 @@ SPAN_DECLARE_NONSTD(int) fax_tx(fax_state_t *s, int16_t *amp, int max_len)
         write(s->modems.audio_tx_log, amp, required_len*sizeof(int16_t));
     }
 #endif
+    s->stats.samples_out += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -438,7 +468,7 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
     {
         put_bit_func = (put_bit_func_t) hdlc_rx_put_bit;
         put_bit_user_data = (void *) &t->hdlc_rx;
-        hdlc_rx_init(&t->hdlc_rx, FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, t30_hdlc_accept, &s->t30);
+        hdlc_rx_init(&t->hdlc_rx, FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, fax_hdlc_accept, s);
     }
     else
     {
@@ -453,18 +483,24 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
         set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &t->v21_rx);
         break;
     case T30_MODEM_V27TER:
-        v27ter_rx_restart(&t->fast_modems.v27ter_rx, bit_rate, FALSE);
-        v27ter_rx_set_put_bit(&t->fast_modems.v27ter_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V27TER_RX);
+        v27ter_rx_restart(&t->fast_rx.v27ter_rx, bit_rate, FALSE);
+        s->stats.retrains++;
+        v27ter_rx_set_put_bit(&t->fast_rx.v27ter_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         break;
     case T30_MODEM_V29:
-        v29_rx_restart(&t->fast_modems.v29_rx, bit_rate, FALSE);
-        v29_rx_set_put_bit(&t->fast_modems.v29_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V29_RX);
+        v29_rx_restart(&t->fast_rx.v29_rx, bit_rate, FALSE);
+        s->stats.retrains++;
+        v29_rx_set_put_bit(&t->fast_rx.v29_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         break;
     case T30_MODEM_V17:
-        v17_rx_restart(&t->fast_modems.v17_rx, bit_rate, short_train);
-        v17_rx_set_put_bit(&t->fast_modems.v17_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V17_RX);
+        v17_rx_restart(&t->fast_rx.v17_rx, bit_rate, short_train);
+        s->stats.retrains++;
+        v17_rx_set_put_bit(&t->fast_rx.v17_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         break;
     case T30_MODEM_DONE:
@@ -535,30 +571,33 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         /* For any fast modem, set 200ms of preamble flags */
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
-        v27ter_tx_restart(&t->fast_modems.v27ter_tx, bit_rate, t->use_tep);
-        v27ter_tx_set_get_bit(&t->fast_modems.v27ter_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V27TER_TX);
+        v27ter_tx_restart(&t->fast_tx.v27ter_tx, bit_rate, t->use_tep);
+        v27ter_tx_set_get_bit(&t->fast_tx.v27ter_tx, get_bit_func, get_bit_user_data);
         fax_modems_set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_modems.v27ter_tx);
+        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_tx.v27ter_tx);
         t->transmit = TRUE;
         break;
     case T30_MODEM_V29:
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         /* For any fast modem, set 200ms of preamble flags */
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
-        v29_tx_restart(&t->fast_modems.v29_tx, bit_rate, t->use_tep);
-        v29_tx_set_get_bit(&t->fast_modems.v29_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V29_TX);
+        v29_tx_restart(&t->fast_tx.v29_tx, bit_rate, t->use_tep);
+        v29_tx_set_get_bit(&t->fast_tx.v29_tx, get_bit_func, get_bit_user_data);
         fax_modems_set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_modems.v29_tx);
+        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_tx.v29_tx);
         t->transmit = TRUE;
         break;
     case T30_MODEM_V17:
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         /* For any fast modem, set 200ms of preamble flags */
         hdlc_tx_flags(&t->hdlc_tx, bit_rate/(8*5));
-        v17_tx_restart(&t->fast_modems.v17_tx, bit_rate, t->use_tep, short_train);
-        v17_tx_set_get_bit(&t->fast_modems.v17_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V17_TX);
+        v17_tx_restart(&t->fast_tx.v17_tx, bit_rate, t->use_tep, short_train);
+        v17_tx_set_get_bit(&t->fast_tx.v17_tx, get_bit_func, get_bit_user_data);
         fax_modems_set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_modems.v17_tx);
+        fax_modems_set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_tx.v17_tx);
         t->transmit = TRUE;
         break;
     case T30_MODEM_DONE:
@@ -600,6 +639,19 @@ SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) fax_get_stats(fax_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) fax_get_memory_footprint(fax_state_t *s)
+{
+    return sizeof(*s) - sizeof(s->t30) + t30_get_memory_footprint(&s->t30);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) fax_restart(fax_state_t *s, int calling_party)
 {
 #if 0
@@ -669,7 +721,7 @@ SPAN_DECLARE(fax_state_t *) fax_init(fax_state_t *s, int calling_party)
 
     if (s == NULL)
     {
-        if ((s = (fax_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fax_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -726,7 +778,7 @@ SPAN_DECLARE(int) fax_release(fax_state_t *s)
 SPAN_DECLARE(int) fax_free(fax_state_t *s)
 {
     t30_release(&s->t30);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -48,7 +48,10 @@
 #endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/queue.h"
@@ -160,8 +163,8 @@ static void v17_rx_status_handler(void *user_data, int status)
     switch (status)
     {
     case SIG_STATUS_TRAINING_SUCCEEDED:
-        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_modems.v17_rx));
-        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v17_rx, &s->fast_modems.v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_modems.v17_rx);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_rx.v17_rx));
+        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v17_rx, &s->fast_rx.v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_rx.v17_rx);
         break;
     }
     /*endswitch*/
@@ -173,7 +176,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v17_v21_rx(void *user_data, const int16_t am
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v17_rx(&s->fast_modems.v17_rx, amp, len);
+    v17_rx(&s->fast_rx.v17_rx, amp, len);
     fsk_rx(&s->v21_rx, amp, len);
     if (s->rx_frame_received)
     {
@@ -192,7 +195,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v17_v21_rx_fillin(void *user_data, int len)
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v17_rx_fillin(&s->fast_modems.v17_rx, len);
+    v17_rx_fillin(&s->fast_rx.v17_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -206,8 +209,8 @@ static void v27ter_rx_status_handler(void *user_data, int status)
     switch (status)
     {
     case SIG_STATUS_TRAINING_SUCCEEDED:
-        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_modems.v27ter_rx));
-        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v27ter_rx, &s->fast_modems.v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_modems.v27ter_rx);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_rx.v27ter_rx));
+        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v27ter_rx, &s->fast_rx.v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_rx.v27ter_rx);
         break;
     }
     /*endswitch*/
@@ -219,7 +222,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v27ter_v21_rx(void *user_data, const int16_t
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v27ter_rx(&s->fast_modems.v27ter_rx, amp, len);
+    v27ter_rx(&s->fast_rx.v27ter_rx, amp, len);
     fsk_rx(&s->v21_rx, amp, len);
     if (s->rx_frame_received)
     {
@@ -238,7 +241,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v27ter_v21_rx_fillin(void *user_data, int le
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v27ter_rx_fillin(&s->fast_modems.v27ter_rx, len);
+    v27ter_rx_fillin(&s->fast_rx.v27ter_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -252,8 +255,8 @@ static void v29_rx_status_handler(void *user_data, int status)
     switch (status)
     {
     case SIG_STATUS_TRAINING_SUCCEEDED:
-        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_modems.v29_rx));
-        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v29_rx, &s->fast_modems.v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_modems.v29_rx);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_rx.v29_rx));
+        fax_modems_set_rx_handler(s, (span_rx_handler_t *) &v29_rx, &s->fast_rx.v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_rx.v29_rx);
         break;
     }
     /*endswitch*/
@@ -265,7 +268,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v29_v21_rx(void *user_data, const int16_t am
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v29_rx(&s->fast_modems.v29_rx, amp, len);
+    v29_rx(&s->fast_rx.v29_rx, amp, len);
     fsk_rx(&s->v21_rx, amp, len);
     if (s->rx_frame_received)
     {
@@ -284,7 +287,7 @@ SPAN_DECLARE_NONSTD(int) fax_modems_v29_v21_rx_fillin(void *user_data, int len)
     fax_modems_state_t *s;
 
     s = (fax_modems_state_t *) user_data;
-    v29_rx_fillin(&s->fast_modems.v29_rx, len);
+    v29_rx_fillin(&s->fast_rx.v29_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -295,18 +298,144 @@ static void v21_rx_status_handler(void *user_data, int status)
 }
 /*- End of function --------------------------------------------------------*/
 
+static logging_state_t *fast_rx_logging(fax_modems_state_t *s)
+{
+    switch (s->fast_rx_modem)
+    {
+    case FAX_MODEM_V17_RX:
+        return &s->fast_rx.v17_rx.logging;
+    case FAX_MODEM_V27TER_RX:
+        return &s->fast_rx.v27ter_rx.logging;
+    case FAX_MODEM_V29_RX:
+        return &s->fast_rx.v29_rx.logging;
+    }
+    /*endswitch*/
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static logging_state_t *fast_tx_logging(fax_modems_state_t *s)
+{
+    switch (s->fast_tx_modem)
+    {
+    case FAX_MODEM_V17_TX:
+        return &s->fast_tx.v17_tx.logging;
+    case FAX_MODEM_V27TER_TX:
+        return &s->fast_tx.v27ter_tx.logging;
+    case FAX_MODEM_V29_TX:
+        return &s->fast_tx.v29_tx.logging;
+    }
+    /*endswitch*/
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void inherit_logging(logging_state_t *to, const logging_state_t *from)
+{
+    const char *protocol;
+
+    /* Carry the level, tag and handlers over to the new modem, but keep its own
+       protocol name. */
+    protocol = to->protocol;
+    *to = *from;
+    to->protocol = protocol;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) fax_modems_select_fast_rx_modem(fax_modems_state_t *s, int which)
+{
+    logging_state_t old_logging;
+    logging_state_t *logging;
+    int have_old_logging;
+
+    if (s->fast_rx_modem == which)
+        return;
+    /*endif*/
+    /* The fast receive modems share memory, so a change of modem needs a full
+       initialisation, rather than a restart. */
+    have_old_logging = FALSE;
+    if ((logging = fast_rx_logging(s)))
+    {
+        old_logging = *logging;
+        have_old_logging = TRUE;
+    }
+    /*endif*/
+    switch (which)
+    {
+    case FAX_MODEM_V17_RX:
+        v17_rx_init(&s->fast_rx.v17_rx, 14400, s->fast_put_bit, s->fast_bit_user_data);
+        break;
+    case FAX_MODEM_V27TER_RX:
+        v27ter_rx_init(&s->fast_rx.v27ter_rx, 4800, s->fast_put_bit, s->fast_bit_user_data);
+        break;
+    case FAX_MODEM_V29_RX:
+        v29_rx_init(&s->fast_rx.v29_rx, 9600, s->fast_put_bit, s->fast_bit_user_data);
+        v29_rx_signal_cutoff(&s->fast_rx.v29_rx, s->v29_rx_cutoff);
+        break;
+    default:
+        return;
+    }
+    /*endswitch*/
+    s->fast_rx_modem = which;
+    if (have_old_logging)
+        inherit_logging(fast_rx_logging(s), &old_logging);
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) fax_modems_select_fast_tx_modem(fax_modems_state_t *s, int which)
+{
+    logging_state_t old_logging;
+    logging_state_t *logging;
+    int have_old_logging;
+
+    if (s->fast_tx_modem == which)
+        return;
+    /*endif*/
+    /* The fast transmit modems share memory, so a change of modem needs a full
+       initialisation, rather than a restart. */
+    have_old_logging = FALSE;
+    if ((logging = fast_tx_logging(s)))
+    {
+        old_logging = *logging;
+        have_old_logging = TRUE;
+    }
+    /*endif*/
+    switch (which)
+    {
+    case FAX_MODEM_V17_TX:
+        v17_tx_init(&s->fast_tx.v17_tx, 14400, s->use_tep, s->fast_get_bit, s->fast_bit_user_data);
+        break;
+    case FAX_MODEM_V27TER_TX:
+        v27ter_tx_init(&s->fast_tx.v27ter_tx, 4800, s->use_tep, s->fast_get_bit, s->fast_bit_user_data);
+        break;
+    case FAX_MODEM_V29_TX:
+        v29_tx_init(&s->fast_tx.v29_tx, 9600, s->use_tep, s->fast_get_bit, s->fast_bit_user_data);
+        break;
+    default:
+        return;
+    }
+    /*endswitch*/
+    s->fast_tx_modem = which;
+    if (have_old_logging)
+        inherit_logging(fast_tx_logging(s), &old_logging);
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fax_modems_start_rx_modem(fax_modems_state_t *s, int which)
 {
+    fax_modems_select_fast_rx_modem(s, which);
     switch (which)
     {
     case FAX_MODEM_V17_RX:
-        v17_rx_set_modem_status_handler(&s->fast_modems.v17_rx, v17_rx_status_handler, s);
+        v17_rx_set_modem_status_handler(&s->fast_rx.v17_rx, v17_rx_status_handler, s);
         break;
     case FAX_MODEM_V27TER_RX:
-        v27ter_rx_set_modem_status_handler(&s->fast_modems.v27ter_rx, v27ter_rx_status_handler, s);
+        v27ter_rx_set_modem_status_handler(&s->fast_rx.v27ter_rx, v27ter_rx_status_handler, s);
         break;
     case FAX_MODEM_V29_RX:
-        v29_rx_set_modem_status_handler(&s->fast_modems.v29_rx, v29_rx_status_handler, s);
+        v29_rx_set_modem_status_handler(&s->fast_rx.v29_rx, v29_rx_status_handler, s);
         break;
     }
     /*endswitch*/
@@ -343,7 +472,7 @@ SPAN_DECLARE(fax_modems_state_t *) fax_modems_init(fax_modems_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fax_modems_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fax_modems_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     /*endif*/
@@ -371,13 +500,14 @@ SPAN_DECLARE(fax_modems_state_t *) fax_modems_init(fax_modems_state_t *s,
     fsk_rx_signal_cutoff(&s->v21_rx, -39.09f);
     fsk_tx_init(&s->v21_tx, &preset_fsk_specs[FSK_V21CH2], (get_bit_func_t) hdlc_tx_get_bit, &s->hdlc_tx);
 
-    v17_rx_init(&s->fast_modems.v17_rx, 14400, non_ecm_put_bit, user_data);
-    v17_tx_init(&s->fast_modems.v17_tx, 14400, s->use_tep, non_ecm_get_bit, user_data);
-    v29_rx_init(&s->fast_modems.v29_rx, 9600, non_ecm_put_bit, user_data);
-    v29_rx_signal_cutoff(&s->fast_modems.v29_rx, -45.5f);
-    v29_tx_init(&s->fast_modems.v29_tx, 9600, s->use_tep, non_ecm_get_bit, user_data);
-    v27ter_rx_init(&s->fast_modems.v27ter_rx, 4800, non_ecm_put_bit, user_data);
-    v27ter_tx_init(&s->fast_modems.v27ter_tx, 4800, s->use_tep, non_ecm_get_bit, user_data);
+    s->fast_put_bit = non_ecm_put_bit;
+    s->fast_get_bit = non_ecm_get_bit;
+    s->fast_bit_user_data = user_data;
+    s->v29_rx_cutoff = -45.5f;
+    s->fast_rx_modem = FAX_MODEM_NONE;
+    s->fast_tx_modem = FAX_MODEM_NONE;
+    fax_modems_select_fast_rx_modem(s, FAX_MODEM_V17_RX);
+    fax_modems_select_fast_tx_modem(s, FAX_MODEM_V17_TX);
 
     silence_gen_init(&s->silence_gen, 0);
 
@@ -400,7 +530,7 @@ SPAN_DECLARE(int) fax_modems_release(fax_modems_state_t *s)
 SPAN_DECLARE(int) fax_modems_free(fax_modems_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     /*endif*/
     return 0;
 }
@@ -0,0 +1,496 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * fir.c - General telephony FIR routines, with run time selection of
+ *         the inner loop for the CPU in use.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mmx_sse_decs.h"
+
+#include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
+#include "spandsp/fir.h"
+
+/* The wide vector versions are built with per-function target attributes, so
+   the rest of the library can still be built for a baseline CPU. This needs
+   GCC 4.9 or later, or clang. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define FIR_WITH_AVX2
+#endif
+#if defined(__clang__)  ||  __GNUC__ >= 7
+#define FIR_WITH_AVX512
+#endif
+#endif
+
+#if defined(FIR_WITH_AVX2)  ||  defined(FIR_WITH_AVX512)
+#include <immintrin.h>
+#endif
+
+typedef int32_t (*fir16_kernel_t)(const int16_t coeffs[], const int16_t hist[], int taps);
+typedef int32_t (*fir32_kernel_t)(const int32_t coeffs[], const int16_t hist[], int taps);
+typedef float (*fir_float_kernel_t)(const float coeffs[], const float hist[], int taps);
+
+static int32_t fir16_dot_product_select(const int16_t coeffs[], const int16_t hist[], int taps);
+static int32_t fir32_dot_product_select(const int32_t coeffs[], const int16_t hist[], int taps);
+static float fir_float_dot_product_select(const float coeffs[], const float hist[], int taps);
+
+/* These start out pointing at routines which pick the real implementation on first use */
+static fir16_kernel_t fir16_kernel = fir16_dot_product_select;
+static fir32_kernel_t fir32_kernel = fir32_dot_product_select;
+static fir_float_kernel_t fir_float_kernel = fir_float_dot_product_select;
+static int fir_implementation = FIR_IMPLEMENTATION_AUTO;
+
+static int32_t fir16_dot_product_generic(const int16_t coeffs[], const int16_t hist[], int taps)
+{
+    int32_t y;
+    int i;
+
+    y = 0;
+    for (i = 0;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int32_t fir32_dot_product_generic(const int32_t coeffs[], const int16_t hist[], int taps)
+{
+    int32_t y;
+    int i;
+
+    y = 0;
+    for (i = 0;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+static float fir_float_dot_product_generic(const float coeffs[], const float hist[], int taps)
+{
+    float y;
+    int i;
+
+    y = 0.0f;
+    for (i = 0;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(FIR_WITH_AVX2)
+__attribute__((target("avx2")))
+static __inline__ int32_t hsum_epi32_avx2(__m256i x)
+{
+    __m128i y;
+
+    y = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 0, 3, 2)));
+    y = _mm_add_epi32(y, _mm_shuffle_epi32(y, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(y);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static int32_t fir16_dot_product_avx2(const int16_t coeffs[], const int16_t hist[], int taps)
+{
+    __m256i sum0;
+    __m256i sum1;
+    int32_t y;
+    int i;
+
+    sum0 = _mm256_setzero_si256();
+    sum1 = _mm256_setzero_si256();
+    /* 32 taps per iteration, in two independent chains */
+    for (i = 0;  i + 32 <= taps;  i += 32)
+    {
+        sum0 = _mm256_add_epi32(sum0,
+                                _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) &coeffs[i]),
+                                                  _mm256_loadu_si256((const __m256i *) &hist[i])));
+        sum1 = _mm256_add_epi32(sum1,
+                                _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) &coeffs[i + 16]),
+                                                  _mm256_loadu_si256((const __m256i *) &hist[i + 16])));
+    }
+    if (i + 16 <= taps)
+    {
+        sum0 = _mm256_add_epi32(sum0,
+                                _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) &coeffs[i]),
+                                                  _mm256_loadu_si256((const __m256i *) &hist[i])));
+        i += 16;
+    }
+    y = hsum_epi32_avx2(_mm256_add_epi32(sum0, sum1));
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static int32_t fir32_dot_product_avx2(const int32_t coeffs[], const int16_t hist[], int taps)
+{
+    __m256i sum0;
+    __m256i sum1;
+    __m256i h;
+    int32_t y;
+    int i;
+
+    sum0 = _mm256_setzero_si256();
+    sum1 = _mm256_setzero_si256();
+    for (i = 0;  i + 16 <= taps;  i += 16)
+    {
+        h = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &hist[i]));
+        sum0 = _mm256_add_epi32(sum0, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) &coeffs[i]), h));
+        h = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &hist[i + 8]));
+        sum1 = _mm256_add_epi32(sum1, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) &coeffs[i + 8]), h));
+    }
+    if (i + 8 <= taps)
+    {
+        h = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) &hist[i]));
+        sum0 = _mm256_add_epi32(sum0, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *) &coeffs[i]), h));
+        i += 8;
+    }
+    y = hsum_epi32_avx2(_mm256_add_epi32(sum0, sum1));
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static float fir_float_dot_product_avx2(const float coeffs[], const float hist[], int taps)
+{
+    __m256 sum0;
+    __m256 sum1;
+    __m256 sum2;
+    __m256 sum3;
+    __m128 x;
+    float y;
+    int i;
+
+    /* Four independent chains, to cover the latency of the additions */
+    sum0 = _mm256_setzero_ps();
+    sum1 = _mm256_setzero_ps();
+    sum2 = _mm256_setzero_ps();
+    sum3 = _mm256_setzero_ps();
+    for (i = 0;  i + 32 <= taps;  i += 32)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&coeffs[i]), _mm256_loadu_ps(&hist[i])));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(&coeffs[i + 8]), _mm256_loadu_ps(&hist[i + 8])));
+        sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_loadu_ps(&coeffs[i + 16]), _mm256_loadu_ps(&hist[i + 16])));
+        sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_loadu_ps(&coeffs[i + 24]), _mm256_loadu_ps(&hist[i + 24])));
+    }
+    for (  ;  i + 8 <= taps;  i += 8)
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&coeffs[i]), _mm256_loadu_ps(&hist[i])));
+    sum0 = _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3));
+    x = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    y = _mm_cvtss_f32(x);
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(FIR_WITH_AVX512)
+__attribute__((target("avx512f,avx512bw")))
+static int32_t fir16_dot_product_avx512(const int16_t coeffs[], const int16_t hist[], int taps)
+{
+    __m512i sum0;
+    __m512i sum1;
+    int32_t y;
+    int i;
+
+    sum0 = _mm512_setzero_si512();
+    sum1 = _mm512_setzero_si512();
+    /* 64 taps per iteration, in two independent chains */
+    for (i = 0;  i + 64 <= taps;  i += 64)
+    {
+        sum0 = _mm512_add_epi32(sum0,
+                                _mm512_madd_epi16(_mm512_loadu_si512((const void *) &coeffs[i]),
+                                                  _mm512_loadu_si512((const void *) &hist[i])));
+        sum1 = _mm512_add_epi32(sum1,
+                                _mm512_madd_epi16(_mm512_loadu_si512((const void *) &coeffs[i + 32]),
+                                                  _mm512_loadu_si512((const void *) &hist[i + 32])));
+    }
+    if (i + 32 <= taps)
+    {
+        sum0 = _mm512_add_epi32(sum0,
+                                _mm512_madd_epi16(_mm512_loadu_si512((const void *) &coeffs[i]),
+                                                  _mm512_loadu_si512((const void *) &hist[i])));
+        i += 32;
+    }
+    y = _mm512_reduce_add_epi32(_mm512_add_epi32(sum0, sum1));
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx512f")))
+static int32_t fir32_dot_product_avx512(const int32_t coeffs[], const int16_t hist[], int taps)
+{
+    __m512i sum0;
+    __m512i sum1;
+    __m512i h;
+    int32_t y;
+    int i;
+
+    sum0 = _mm512_setzero_si512();
+    sum1 = _mm512_setzero_si512();
+    for (i = 0;  i + 32 <= taps;  i += 32)
+    {
+        h = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) &hist[i]));
+        sum0 = _mm512_add_epi32(sum0, _mm512_mullo_epi32(_mm512_loadu_si512((const void *) &coeffs[i]), h));
+        h = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) &hist[i + 16]));
+        sum1 = _mm512_add_epi32(sum1, _mm512_mullo_epi32(_mm512_loadu_si512((const void *) &coeffs[i + 16]), h));
+    }
+    if (i + 16 <= taps)
+    {
+        h = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *) &hist[i]));
+        sum0 = _mm512_add_epi32(sum0, _mm512_mullo_epi32(_mm512_loadu_si512((const void *) &coeffs[i]), h));
+        i += 16;
+    }
+    y = _mm512_reduce_add_epi32(_mm512_add_epi32(sum0, sum1));
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx512f")))
+static float fir_float_dot_product_avx512(const float coeffs[], const float hist[], int taps)
+{
+    __m512 sum0;
+    __m512 sum1;
+    __m512 sum2;
+    __m512 sum3;
+    float y;
+    int i;
+
+    sum0 = _mm512_setzero_ps();
+    sum1 = _mm512_setzero_ps();
+    sum2 = _mm512_setzero_ps();
+    sum3 = _mm512_setzero_ps();
+    for (i = 0;  i + 64 <= taps;  i += 64)
+    {
+        sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i]), _mm512_loadu_ps(&hist[i])));
+        sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i + 16]), _mm512_loadu_ps(&hist[i + 16])));
+        sum2 = _mm512_add_ps(sum2, _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i + 32]), _mm512_loadu_ps(&hist[i + 32])));
+        sum3 = _mm512_add_ps(sum3, _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i + 48]), _mm512_loadu_ps(&hist[i + 48])));
+    }
+    for (  ;  i + 16 <= taps;  i += 16)
+        sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i]), _mm512_loadu_ps(&hist[i])));
+    y = _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(sum0, sum1), _mm512_add_ps(sum2, sum3)));
+    for (  ;  i < taps;  i++)
+        y += coeffs[i]*hist[i];
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case FIR_IMPLEMENTATION_GENERIC:
+        return TRUE;
+#if defined(FIR_WITH_AVX2)
+    case FIR_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+#if defined(FIR_WITH_AVX512)
+    case FIR_IMPLEMENTATION_AVX512:
+        return has_AVX512BW();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fir_set_implementation(int implementation)
+{
+    if (implementation == FIR_IMPLEMENTATION_AUTO)
+    {
+        /* AVX-512 is only used on request. The 512 bit operations may lower the
+           clock rate of the whole core, and for the 16 bit filters used by the echo
+           cancellers they are no faster than AVX2. */
+        implementation = (implementation_available(FIR_IMPLEMENTATION_AVX2))  ?  FIR_IMPLEMENTATION_AVX2  :  FIR_IMPLEMENTATION_GENERIC;
+    }
+    else if (!implementation_available(implementation))
+    {
+        return -1;
+    }
+    switch (implementation)
+    {
+#if defined(FIR_WITH_AVX512)
+    case FIR_IMPLEMENTATION_AVX512:
+        fir16_kernel = fir16_dot_product_avx512;
+        fir32_kernel = fir32_dot_product_avx512;
+        fir_float_kernel = fir_float_dot_product_avx512;
+        break;
+#endif
+#if defined(FIR_WITH_AVX2)
+    case FIR_IMPLEMENTATION_AVX2:
+        fir16_kernel = fir16_dot_product_avx2;
+        fir32_kernel = fir32_dot_product_avx2;
+        fir_float_kernel = fir_float_dot_product_avx2;
+        break;
+#endif
+    default:
+        implementation = FIR_IMPLEMENTATION_GENERIC;
+        fir16_kernel = fir16_dot_product_generic;
+        fir32_kernel = fir32_dot_product_generic;
+        fir_float_kernel = fir_float_dot_product_generic;
+        break;
+    }
+    fir_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fir_get_implementation(void)
+{
+    if (fir_implementation == FIR_IMPLEMENTATION_AUTO)
+        fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    return fir_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int32_t fir16_dot_product_select(const int16_t coeffs[], const int16_t hist[], int taps)
+{
+    fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    return fir16_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int32_t fir32_dot_product_select(const int32_t coeffs[], const int16_t hist[], int taps)
+{
+    fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    return fir32_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+static float fir_float_dot_product_select(const float coeffs[], const float hist[], int taps)
+{
+    fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    return fir_float_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int32_t) fir16_dot_product(const int16_t coeffs[], const int16_t hist[], int taps)
+{
+    return fir16_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int32_t) fir32_dot_product(const int32_t coeffs[], const int16_t hist[], int taps)
+{
+    return fir32_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(float) fir_float_dot_product(const float coeffs[], const float hist[], int taps)
+{
+    return fir_float_kernel(coeffs, hist, taps);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fir16_block(fir16_state_t *fir, int16_t out[], const int16_t in[], int len)
+{
+    fir16_kernel_t kernel;
+    int32_t y;
+    int i;
+
+    if (fir_implementation == FIR_IMPLEMENTATION_AUTO)
+        fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    kernel = fir16_kernel;
+    for (i = 0;  i < len;  i++)
+    {
+        fir->history[fir->curr_pos] = in[i];
+        fir->history[fir->curr_pos + fir->taps] = in[i];
+        y = kernel(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
+        if (fir->curr_pos <= 0)
+            fir->curr_pos = fir->taps;
+        fir->curr_pos--;
+        out[i] = (int16_t) (y >> 15);
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fir32_block(fir32_state_t *fir, int16_t out[], const int16_t in[], int len)
+{
+    fir32_kernel_t kernel;
+    int32_t y;
+    int i;
+
+    if (fir_implementation == FIR_IMPLEMENTATION_AUTO)
+        fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    kernel = fir32_kernel;
+    for (i = 0;  i < len;  i++)
+    {
+        fir->history[fir->curr_pos] = in[i];
+        fir->history[fir->curr_pos + fir->taps] = in[i];
+        y = kernel(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
+        if (fir->curr_pos <= 0)
+            fir->curr_pos = fir->taps;
+        fir->curr_pos--;
+        out[i] = (int16_t) (y >> 15);
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fir_float_block(fir_float_state_t *fir, int16_t out[], const int16_t in[], int len)
+{
+    fir_float_kernel_t kernel;
+    float y;
+    int i;
+
+    if (fir_implementation == FIR_IMPLEMENTATION_AUTO)
+        fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    kernel = fir_float_kernel;
+    for (i = 0;  i < len;  i++)
+    {
+        fir->history[fir->curr_pos] = in[i];
+        fir->history[fir->curr_pos + fir->taps] = in[i];
+        y = kernel(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
+        if (fir->curr_pos <= 0)
+            fir->curr_pos = fir->taps;
+        fir->curr_pos--;
+        out[i] = (int16_t) y;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
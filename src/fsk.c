@@ -42,6 +42,7 @@
 #include <assert.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/complex.h"
 #include "spandsp/dds.h"
 #include "spandsp/power_meter.h"
@@ -157,7 +158,7 @@ SPAN_DECLARE(fsk_tx_state_t *) fsk_tx_init(fsk_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fsk_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fsk_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -177,7 +178,7 @@ SPAN_DECLARE(int) fsk_tx_release(fsk_tx_state_t *s)
 
 SPAN_DECLARE(int) fsk_tx_free(fsk_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -319,7 +320,7 @@ SPAN_DECLARE(fsk_rx_state_t *) fsk_rx_init(fsk_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (fsk_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (fsk_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -339,7 +340,7 @@ SPAN_DECLARE(int) fsk_rx_release(fsk_rx_state_t *s)
 
 SPAN_DECLARE(int) fsk_rx_free(fsk_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -374,15 +375,15 @@ SPAN_DECLARE_NONSTD(int) fsk_rx(fsk_rx_state_t *s, const int16_t *amp, int len)
            approach. */
         for (j = 0;  j < 2;  j++)
         {
-            s->dot[j].re -= s->window[j][buf_ptr].re;
-            s->dot[j].im -= s->window[j][buf_ptr].im;
+            s->dot[j].re -= s->window[buf_ptr][j].re;
+            s->dot[j].im -= s->window[buf_ptr][j].im;
 
             ph = dds_complexi(&s->phase_acc[j], s->phase_rate[j]);
-            s->window[j][buf_ptr].re = (ph.re*amp[i]) >> s->scaling_shift;
-            s->window[j][buf_ptr].im = (ph.im*amp[i]) >> s->scaling_shift;
+            s->window[buf_ptr][j].re = (ph.re*amp[i]) >> s->scaling_shift;
+            s->window[buf_ptr][j].im = (ph.im*amp[i]) >> s->scaling_shift;
 
-            s->dot[j].re += s->window[j][buf_ptr].re;
-            s->dot[j].im += s->window[j][buf_ptr].im;
+            s->dot[j].re += s->window[buf_ptr][j].re;
+            s->dot[j].im += s->window[buf_ptr][j].im;
 
             dot = s->dot[j].re >> 15;
             sum[j] = dot*dot;
@@ -34,7 +34,10 @@
 #include <string.h>
 #include <assert.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/g711.h"
 #include "spandsp/private/g711.h"
@@ -83,6 +86,624 @@ static const uint8_t alaw_to_ulaw_table[256] =
     214, 215, 212, 213, 218, 219, 216, 217, 207, 207, 206, 206, 210, 211, 208, 209
 };
 
+/* The vector versions are built with per-function target attributes, so the rest
+   of the library can still be built for a baseline CPU. This needs GCC 4.9 or
+   later, or clang. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define G711_WITH_SSE4_1
+#define G711_WITH_AVX2
+#endif
+#endif
+
+#if defined(G711_WITH_SSE4_1)  ||  defined(G711_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
+typedef void (*g711_encode_kernel_t)(uint8_t g711_data[], const int16_t amp[], int len);
+typedef void (*g711_decode_kernel_t)(int16_t amp[], const uint8_t g711_data[], int len);
+
+typedef struct
+{
+    g711_encode_kernel_t alaw_encode;
+    g711_encode_kernel_t ulaw_encode;
+    g711_decode_kernel_t alaw_decode;
+    g711_decode_kernel_t ulaw_decode;
+} g711_kernels_t;
+
+static const g711_kernels_t *g711_kernels = NULL;
+static int g711_implementation = G711_IMPLEMENTATION_AUTO;
+
+/* The direct lookup tables, which are only filled in if the table driven
+   implementation is selected. */
+static uint8_t linear_to_alaw_table[65536];
+static uint8_t linear_to_ulaw_table[65536];
+static int16_t alaw_to_linear_table[256];
+static int16_t ulaw_to_linear_table[256];
+static int tables_built = FALSE;
+
+static void alaw_encode_generic(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        g711_data[i] = linear_to_alaw(amp[i]);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ulaw_encode_generic(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        g711_data[i] = linear_to_ulaw(amp[i]);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void alaw_decode_generic(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        amp[i] = alaw_to_linear(g711_data[i]);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ulaw_decode_generic(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        amp[i] = ulaw_to_linear(g711_data[i]);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void build_tables(void)
+{
+    int i;
+
+    if (tables_built)
+        return;
+    /*endif*/
+    /* The tables are indexed by the 16 bit pattern of the linear sample */
+    for (i = 0;  i < 65536;  i++)
+    {
+        linear_to_alaw_table[i] = linear_to_alaw((int16_t) i);
+        linear_to_ulaw_table[i] = linear_to_ulaw((int16_t) i);
+    }
+    /*endfor*/
+    for (i = 0;  i < 256;  i++)
+    {
+        alaw_to_linear_table[i] = alaw_to_linear((uint8_t) i);
+        ulaw_to_linear_table[i] = ulaw_to_linear((uint8_t) i);
+    }
+    /*endfor*/
+    tables_built = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void alaw_encode_table(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        g711_data[i] = linear_to_alaw_table[(uint16_t) amp[i]];
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ulaw_encode_table(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        g711_data[i] = linear_to_ulaw_table[(uint16_t) amp[i]];
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void alaw_decode_table(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        amp[i] = alaw_to_linear_table[g711_data[i]];
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void ulaw_decode_table(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        amp[i] = ulaw_to_linear_table[g711_data[i]];
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The vector routines work on 16 bit lanes. The segment number, and the powers of
+   two used to do the per lane shifts as multiplies, are looked up with PSHUFB. The
+   lookup indices have 0x80 in their upper bytes, so the upper byte of each result
+   is zero. The biased u-law magnitude of a full scale sample does not fit in 15
+   bits, but clamping it to 0x7FFF gives the same code as the overflow case in
+   linear_to_ulaw(). The A-law magnitude always fits in 15 bits. */
+#define G711_SEGMENT_LO_LUT     0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4
+#define G711_SEGMENT_HI_LUT     0, 5, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7
+/* Shift left by 7 - seg, before a fixed right shift by 10, for u-law encoding */
+#define G711_ULAW_ENCODE_LUT    128, 64, 32, 16, 8, 4, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0
+/* Shift left by 8 - max(seg, 1), before a fixed right shift by 11, for A-law encoding */
+#define G711_ALAW_ENCODE_LUT    128, 128, 64, 32, 16, 8, 4, 2, 0, 0, 0, 0, 0, 0, 0, 0
+#define G711_ULAW_DECODE_LUT    1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0
+#define G711_ALAW_DECODE_LUT    1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0
+
+#if defined(G711_WITH_SSE4_1)
+__attribute__((target("sse4.1")))
+static __inline__ __m128i segment_sse4_1(__m128i mag)
+{
+    const __m128i lo_lut = _mm_setr_epi8(G711_SEGMENT_LO_LUT);
+    const __m128i hi_lut = _mm_setr_epi8(G711_SEGMENT_HI_LUT);
+    const __m128i top = _mm_set1_epi16((int16_t) 0x8000);
+    __m128i hi;
+
+    /* This is top_bit(mag | 0xFF) - 7, for magnitudes up to 0x7FFF */
+    hi = _mm_srli_epi16(mag, 8);
+    return _mm_max_epi16(_mm_shuffle_epi8(lo_lut, _mm_or_si128(_mm_and_si128(hi, _mm_set1_epi16(0x0F)), top)),
+                         _mm_shuffle_epi8(hi_lut, _mm_or_si128(_mm_srli_epi16(hi, 4), top)));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static __inline__ __m128i linear_to_alaw_sse4_1(__m128i x)
+{
+    const __m128i shift_lut = _mm_setr_epi8(G711_ALAW_ENCODE_LUT);
+    const __m128i top = _mm_set1_epi16((int16_t) 0x8000);
+    __m128i sign;
+    __m128i mag;
+    __m128i seg;
+    __m128i mant;
+    __m128i mask;
+
+    sign = _mm_srai_epi16(x, 15);
+    mag = _mm_xor_si128(x, sign);
+    seg = segment_sse4_1(mag);
+    mant = _mm_mullo_epi16(mag, _mm_shuffle_epi8(shift_lut, _mm_or_si128(seg, top)));
+    mant = _mm_and_si128(_mm_srli_epi16(mant, 11), _mm_set1_epi16(0x0F));
+    mask = _mm_or_si128(_mm_andnot_si128(sign, _mm_set1_epi16(0x80)), _mm_set1_epi16(G711_ALAW_AMI_MASK));
+    return _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(seg, 4), mant), mask);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static __inline__ __m128i linear_to_ulaw_sse4_1(__m128i x)
+{
+    const __m128i shift_lut = _mm_setr_epi8(G711_ULAW_ENCODE_LUT);
+    const __m128i top = _mm_set1_epi16((int16_t) 0x8000);
+    __m128i sign;
+    __m128i mag;
+    __m128i seg;
+    __m128i mant;
+    __m128i mask;
+    __m128i u;
+
+    sign = _mm_srai_epi16(x, 15);
+    mag = _mm_sub_epi16(_mm_xor_si128(x, sign), sign);
+    mag = _mm_add_epi16(mag, _mm_set1_epi16(G711_ULAW_BIAS));
+    mag = _mm_min_epu16(mag, _mm_set1_epi16(0x7FFF));
+    seg = segment_sse4_1(mag);
+    mant = _mm_mullo_epi16(mag, _mm_shuffle_epi8(shift_lut, _mm_or_si128(seg, top)));
+    mant = _mm_and_si128(_mm_srli_epi16(mant, 10), _mm_set1_epi16(0x0F));
+    mask = _mm_or_si128(_mm_andnot_si128(sign, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x7F));
+    u = _mm_xor_si128(_mm_or_si128(_mm_slli_epi16(seg, 4), mant), mask);
+#if defined(G711_ULAW_ZEROTRAP)
+    u = _mm_or_si128(u, _mm_and_si128(_mm_cmpeq_epi16(u, _mm_setzero_si128()), _mm_set1_epi16(0x02)));
+#endif
+    return u;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static __inline__ __m128i alaw_to_linear_sse4_1(__m128i alaw)
+{
+    const __m128i shift_lut = _mm_setr_epi8(G711_ALAW_DECODE_LUT);
+    __m128i seg;
+    __m128i i;
+    __m128i neg;
+
+    alaw = _mm_xor_si128(alaw, _mm_set1_epi16(G711_ALAW_AMI_MASK));
+    seg = _mm_and_si128(_mm_srli_epi16(alaw, 4), _mm_set1_epi16(0x07));
+    i = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(alaw, _mm_set1_epi16(0x0F)), 4), _mm_set1_epi16(8));
+    i = _mm_add_epi16(i, _mm_and_si128(_mm_cmpgt_epi16(seg, _mm_setzero_si128()), _mm_set1_epi16(0x100)));
+    i = _mm_mullo_epi16(i, _mm_shuffle_epi8(shift_lut, _mm_or_si128(seg, _mm_set1_epi16((int16_t) 0x8000))));
+    neg = _mm_cmpeq_epi16(_mm_and_si128(alaw, _mm_set1_epi16(0x80)), _mm_setzero_si128());
+    return _mm_sub_epi16(_mm_xor_si128(i, neg), neg);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static __inline__ __m128i ulaw_to_linear_sse4_1(__m128i ulaw)
+{
+    const __m128i shift_lut = _mm_setr_epi8(G711_ULAW_DECODE_LUT);
+    __m128i seg;
+    __m128i t;
+    __m128i neg;
+
+    ulaw = _mm_xor_si128(ulaw, _mm_set1_epi16(0xFF));
+    seg = _mm_and_si128(_mm_srli_epi16(ulaw, 4), _mm_set1_epi16(0x07));
+    t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(ulaw, _mm_set1_epi16(0x0F)), 3), _mm_set1_epi16(G711_ULAW_BIAS));
+    t = _mm_mullo_epi16(t, _mm_shuffle_epi8(shift_lut, _mm_or_si128(seg, _mm_set1_epi16((int16_t) 0x8000))));
+    t = _mm_sub_epi16(t, _mm_set1_epi16(G711_ULAW_BIAS));
+    neg = _mm_cmpeq_epi16(_mm_and_si128(ulaw, _mm_set1_epi16(0x80)), _mm_set1_epi16(0x80));
+    return _mm_sub_epi16(_mm_xor_si128(t, neg), neg);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static void alaw_encode_sse4_1(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    __m128i a;
+    __m128i b;
+    int i;
+
+    for (i = 0;  i + 16 <= len;  i += 16)
+    {
+        a = linear_to_alaw_sse4_1(_mm_loadu_si128((const __m128i *) &amp[i]));
+        b = linear_to_alaw_sse4_1(_mm_loadu_si128((const __m128i *) &amp[i + 8]));
+        _mm_storeu_si128((__m128i *) &g711_data[i], _mm_packus_epi16(a, b));
+    }
+    /*endfor*/
+    alaw_encode_generic(&g711_data[i], &amp[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static void ulaw_encode_sse4_1(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    __m128i a;
+    __m128i b;
+    int i;
+
+    for (i = 0;  i + 16 <= len;  i += 16)
+    {
+        a = linear_to_ulaw_sse4_1(_mm_loadu_si128((const __m128i *) &amp[i]));
+        b = linear_to_ulaw_sse4_1(_mm_loadu_si128((const __m128i *) &amp[i + 8]));
+        _mm_storeu_si128((__m128i *) &g711_data[i], _mm_packus_epi16(a, b));
+    }
+    /*endfor*/
+    ulaw_encode_generic(&g711_data[i], &amp[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static void alaw_decode_sse4_1(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    __m128i x;
+    int i;
+
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        x = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) &g711_data[i]));
+        _mm_storeu_si128((__m128i *) &amp[i], alaw_to_linear_sse4_1(x));
+    }
+    /*endfor*/
+    alaw_decode_generic(&amp[i], &g711_data[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse4.1")))
+static void ulaw_decode_sse4_1(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    __m128i x;
+    int i;
+
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        x = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) &g711_data[i]));
+        _mm_storeu_si128((__m128i *) &amp[i], ulaw_to_linear_sse4_1(x));
+    }
+    /*endfor*/
+    ulaw_decode_generic(&amp[i], &g711_data[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(G711_WITH_AVX2)
+__attribute__((target("avx2")))
+static __inline__ __m256i segment_avx2(__m256i mag)
+{
+    const __m256i lo_lut = _mm256_setr_epi8(G711_SEGMENT_LO_LUT, G711_SEGMENT_LO_LUT);
+    const __m256i hi_lut = _mm256_setr_epi8(G711_SEGMENT_HI_LUT, G711_SEGMENT_HI_LUT);
+    const __m256i top = _mm256_set1_epi16((int16_t) 0x8000);
+    __m256i hi;
+
+    hi = _mm256_srli_epi16(mag, 8);
+    return _mm256_max_epi16(_mm256_shuffle_epi8(lo_lut, _mm256_or_si256(_mm256_and_si256(hi, _mm256_set1_epi16(0x0F)), top)),
+                            _mm256_shuffle_epi8(hi_lut, _mm256_or_si256(_mm256_srli_epi16(hi, 4), top)));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static __inline__ __m256i linear_to_alaw_avx2(__m256i x)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(G711_ALAW_ENCODE_LUT, G711_ALAW_ENCODE_LUT);
+    const __m256i top = _mm256_set1_epi16((int16_t) 0x8000);
+    __m256i sign;
+    __m256i mag;
+    __m256i seg;
+    __m256i mant;
+    __m256i mask;
+
+    sign = _mm256_srai_epi16(x, 15);
+    mag = _mm256_xor_si256(x, sign);
+    seg = segment_avx2(mag);
+    mant = _mm256_mullo_epi16(mag, _mm256_shuffle_epi8(shift_lut, _mm256_or_si256(seg, top)));
+    mant = _mm256_and_si256(_mm256_srli_epi16(mant, 11), _mm256_set1_epi16(0x0F));
+    mask = _mm256_or_si256(_mm256_andnot_si256(sign, _mm256_set1_epi16(0x80)), _mm256_set1_epi16(G711_ALAW_AMI_MASK));
+    return _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(seg, 4), mant), mask);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static __inline__ __m256i linear_to_ulaw_avx2(__m256i x)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(G711_ULAW_ENCODE_LUT, G711_ULAW_ENCODE_LUT);
+    const __m256i top = _mm256_set1_epi16((int16_t) 0x8000);
+    __m256i sign;
+    __m256i mag;
+    __m256i seg;
+    __m256i mant;
+    __m256i mask;
+    __m256i u;
+
+    sign = _mm256_srai_epi16(x, 15);
+    mag = _mm256_sub_epi16(_mm256_xor_si256(x, sign), sign);
+    mag = _mm256_add_epi16(mag, _mm256_set1_epi16(G711_ULAW_BIAS));
+    mag = _mm256_min_epu16(mag, _mm256_set1_epi16(0x7FFF));
+    seg = segment_avx2(mag);
+    mant = _mm256_mullo_epi16(mag, _mm256_shuffle_epi8(shift_lut, _mm256_or_si256(seg, top)));
+    mant = _mm256_and_si256(_mm256_srli_epi16(mant, 10), _mm256_set1_epi16(0x0F));
+    mask = _mm256_or_si256(_mm256_andnot_si256(sign, _mm256_set1_epi16(0x80)), _mm256_set1_epi16(0x7F));
+    u = _mm256_xor_si256(_mm256_or_si256(_mm256_slli_epi16(seg, 4), mant), mask);
+#if defined(G711_ULAW_ZEROTRAP)
+    u = _mm256_or_si256(u, _mm256_and_si256(_mm256_cmpeq_epi16(u, _mm256_setzero_si256()), _mm256_set1_epi16(0x02)));
+#endif
+    return u;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static __inline__ __m256i alaw_to_linear_avx2(__m256i alaw)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(G711_ALAW_DECODE_LUT, G711_ALAW_DECODE_LUT);
+    __m256i seg;
+    __m256i i;
+    __m256i neg;
+
+    alaw = _mm256_xor_si256(alaw, _mm256_set1_epi16(G711_ALAW_AMI_MASK));
+    seg = _mm256_and_si256(_mm256_srli_epi16(alaw, 4), _mm256_set1_epi16(0x07));
+    i = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(alaw, _mm256_set1_epi16(0x0F)), 4), _mm256_set1_epi16(8));
+    i = _mm256_add_epi16(i, _mm256_and_si256(_mm256_cmpgt_epi16(seg, _mm256_setzero_si256()), _mm256_set1_epi16(0x100)));
+    i = _mm256_mullo_epi16(i, _mm256_shuffle_epi8(shift_lut, _mm256_or_si256(seg, _mm256_set1_epi16((int16_t) 0x8000))));
+    neg = _mm256_cmpeq_epi16(_mm256_and_si256(alaw, _mm256_set1_epi16(0x80)), _mm256_setzero_si256());
+    return _mm256_sub_epi16(_mm256_xor_si256(i, neg), neg);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static __inline__ __m256i ulaw_to_linear_avx2(__m256i ulaw)
+{
+    const __m256i shift_lut = _mm256_setr_epi8(G711_ULAW_DECODE_LUT, G711_ULAW_DECODE_LUT);
+    __m256i seg;
+    __m256i t;
+    __m256i neg;
+
+    ulaw = _mm256_xor_si256(ulaw, _mm256_set1_epi16(0xFF));
+    seg = _mm256_and_si256(_mm256_srli_epi16(ulaw, 4), _mm256_set1_epi16(0x07));
+    t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(ulaw, _mm256_set1_epi16(0x0F)), 3), _mm256_set1_epi16(G711_ULAW_BIAS));
+    t = _mm256_mullo_epi16(t, _mm256_shuffle_epi8(shift_lut, _mm256_or_si256(seg, _mm256_set1_epi16((int16_t) 0x8000))));
+    t = _mm256_sub_epi16(t, _mm256_set1_epi16(G711_ULAW_BIAS));
+    neg = _mm256_cmpeq_epi16(_mm256_and_si256(ulaw, _mm256_set1_epi16(0x80)), _mm256_set1_epi16(0x80));
+    return _mm256_sub_epi16(_mm256_xor_si256(t, neg), neg);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void alaw_encode_avx2(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    __m256i a;
+    __m256i b;
+    int i;
+
+    for (i = 0;  i + 32 <= len;  i += 32)
+    {
+        a = linear_to_alaw_avx2(_mm256_loadu_si256((const __m256i *) &amp[i]));
+        b = linear_to_alaw_avx2(_mm256_loadu_si256((const __m256i *) &amp[i + 16]));
+        /* The pack works within 128 bit lanes, so the 64 bit blocks need reordering */
+        a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *) &g711_data[i], a);
+    }
+    /*endfor*/
+    alaw_encode_generic(&g711_data[i], &amp[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void ulaw_encode_avx2(uint8_t g711_data[], const int16_t amp[], int len)
+{
+    __m256i a;
+    __m256i b;
+    int i;
+
+    for (i = 0;  i + 32 <= len;  i += 32)
+    {
+        a = linear_to_ulaw_avx2(_mm256_loadu_si256((const __m256i *) &amp[i]));
+        b = linear_to_ulaw_avx2(_mm256_loadu_si256((const __m256i *) &amp[i + 16]));
+        a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *) &g711_data[i], a);
+    }
+    /*endfor*/
+    ulaw_encode_generic(&g711_data[i], &amp[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void alaw_decode_avx2(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    __m256i x;
+    int i;
+
+    for (i = 0;  i + 16 <= len;  i += 16)
+    {
+        x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) &g711_data[i]));
+        _mm256_storeu_si256((__m256i *) &amp[i], alaw_to_linear_avx2(x));
+    }
+    /*endfor*/
+    alaw_decode_generic(&amp[i], &g711_data[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void ulaw_decode_avx2(int16_t amp[], const uint8_t g711_data[], int len)
+{
+    __m256i x;
+    int i;
+
+    for (i = 0;  i + 16 <= len;  i += 16)
+    {
+        x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) &g711_data[i]));
+        _mm256_storeu_si256((__m256i *) &amp[i], ulaw_to_linear_avx2(x));
+    }
+    /*endfor*/
+    ulaw_decode_generic(&amp[i], &g711_data[i], len - i);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static const g711_kernels_t generic_kernels =
+{
+    alaw_encode_generic,
+    ulaw_encode_generic,
+    alaw_decode_generic,
+    ulaw_decode_generic
+};
+
+static const g711_kernels_t table_kernels =
+{
+    alaw_encode_table,
+    ulaw_encode_table,
+    alaw_decode_table,
+    ulaw_decode_table
+};
+
+#if defined(G711_WITH_SSE4_1)
+static const g711_kernels_t sse4_1_kernels =
+{
+    alaw_encode_sse4_1,
+    ulaw_encode_sse4_1,
+    alaw_decode_sse4_1,
+    ulaw_decode_sse4_1
+};
+#endif
+
+#if defined(G711_WITH_AVX2)
+static const g711_kernels_t avx2_kernels =
+{
+    alaw_encode_avx2,
+    ulaw_encode_avx2,
+    alaw_decode_avx2,
+    ulaw_decode_avx2
+};
+#endif
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case G711_IMPLEMENTATION_GENERIC:
+    case G711_IMPLEMENTATION_TABLE:
+        return TRUE;
+#if defined(G711_WITH_SSE4_1)
+    case G711_IMPLEMENTATION_SSE4_1:
+        return has_SSE4_1();
+#endif
+#if defined(G711_WITH_AVX2)
+    case G711_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g711_set_implementation(int implementation)
+{
+    if (implementation == G711_IMPLEMENTATION_AUTO)
+    {
+        /* The table driven implementation is only used on request, as its tables
+           compete for the cache with everything else. */
+        if (implementation_available(G711_IMPLEMENTATION_AVX2))
+            implementation = G711_IMPLEMENTATION_AVX2;
+        else if (implementation_available(G711_IMPLEMENTATION_SSE4_1))
+            implementation = G711_IMPLEMENTATION_SSE4_1;
+        else
+            implementation = G711_IMPLEMENTATION_GENERIC;
+        /*endif*/
+    }
+    else if (!implementation_available(implementation))
+    {
+        return -1;
+    }
+    /*endif*/
+    switch (implementation)
+    {
+#if defined(G711_WITH_AVX2)
+    case G711_IMPLEMENTATION_AVX2:
+        g711_kernels = &avx2_kernels;
+        break;
+#endif
+#if defined(G711_WITH_SSE4_1)
+    case G711_IMPLEMENTATION_SSE4_1:
+        g711_kernels = &sse4_1_kernels;
+        break;
+#endif
+    case G711_IMPLEMENTATION_TABLE:
+        /* Make sure the tables are complete before anything can use them */
+        build_tables();
+        g711_kernels = &table_kernels;
+        break;
+    default:
+        implementation = G711_IMPLEMENTATION_GENERIC;
+        g711_kernels = &generic_kernels;
+        break;
+    }
+    /*endswitch*/
+    g711_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g711_get_implementation(void)
+{
+    if (g711_implementation == G711_IMPLEMENTATION_AUTO)
+        g711_set_implementation(G711_IMPLEMENTATION_AUTO);
+    /*endif*/
+    return g711_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ const g711_kernels_t *kernels(void)
+{
+    if (g711_kernels == NULL)
+        g711_set_implementation(G711_IMPLEMENTATION_AUTO);
+    /*endif*/
+    return g711_kernels;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(uint8_t) alaw_to_ulaw(uint8_t alaw)
 {
     return alaw_to_ulaw_table[alaw];
@@ -100,20 +721,10 @@ SPAN_DECLARE(int) g711_decode(g711_state_t *s,
                               const uint8_t g711_data[],
                               int g711_bytes)
 {
-    int i;
-
     if (s->mode == G711_ALAW)
-    {
-        for (i = 0;  i < g711_bytes;  i++)
-            amp[i] = alaw_to_linear(g711_data[i]);
-        /*endfor*/
-    }
+        kernels()->alaw_decode(amp, g711_data, g711_bytes);
     else
-    {
-        for (i = 0;  i < g711_bytes;  i++)
-            amp[i] = ulaw_to_linear(g711_data[i]);
-        /*endfor*/
-    }
+        kernels()->ulaw_decode(amp, g711_data, g711_bytes);
     /*endif*/
     return g711_bytes;
 }
@@ -124,20 +735,10 @@ SPAN_DECLARE(int) g711_encode(g711_state_t *s,
                               const int16_t amp[],
                               int len)
 {
-    int i;
-
     if (s->mode == G711_ALAW)
-    {
-        for (i = 0;  i < len;  i++)
-            g711_data[i] = linear_to_alaw(amp[i]);
-        /*endfor*/
-    }
+        kernels()->alaw_encode(g711_data, amp, len);
     else
-    {
-        for (i = 0;  i < len;  i++)
-            g711_data[i] = linear_to_ulaw(amp[i]);
-        /*endfor*/
-    }
+        kernels()->ulaw_encode(g711_data, amp, len);
     /*endif*/
     return len;
 }
@@ -167,11 +768,73 @@ SPAN_DECLARE(int) g711_transcode(g711_state_t *s,
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) g711_decode_multi(g711_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g711_data[],
+                                    int channels,
+                                    int g711_bytes)
+{
+    const g711_kernels_t *k;
+    int i;
+
+    /* Resolve the implementation once, for the whole batch */
+    k = kernels();
+    for (i = 0;  i < channels;  i++)
+    {
+        if (s[i]->mode == G711_ALAW)
+            k->alaw_decode(amp[i], g711_data[i], g711_bytes);
+        else
+            k->ulaw_decode(amp[i], g711_data[i], g711_bytes);
+        /*endif*/
+    }
+    /*endfor*/
+    return g711_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g711_encode_multi(g711_state_t *s[],
+                                    uint8_t *g711_data[],
+                                    const int16_t *amp[],
+                                    int channels,
+                                    int len)
+{
+    const g711_kernels_t *k;
+    int i;
+
+    k = kernels();
+    for (i = 0;  i < channels;  i++)
+    {
+        if (s[i]->mode == G711_ALAW)
+            k->alaw_encode(g711_data[i], amp[i], len);
+        else
+            k->ulaw_encode(g711_data[i], amp[i], len);
+        /*endif*/
+    }
+    /*endfor*/
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g711_transcode_multi(g711_state_t *s[],
+                                       uint8_t *g711_out[],
+                                       const uint8_t *g711_in[],
+                                       int channels,
+                                       int g711_bytes)
+{
+    int i;
+
+    for (i = 0;  i < channels;  i++)
+        g711_transcode(s[i], g711_out[i], g711_in[i], g711_bytes);
+    /*endfor*/
+    return g711_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(g711_state_t *) g711_init(g711_state_t *s, int mode)
 {
     if (s == NULL)
     {
-        if ((s = (g711_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g711_state_t *) span_alloc(sizeof(*s))) == NULL)
             return  NULL;
     }
     s->mode = mode;
@@ -187,7 +850,7 @@ SPAN_DECLARE(int) g711_release(g711_state_t *s)
 
 SPAN_DECLARE(int) g711_free(g711_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
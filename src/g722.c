@@ -45,23 +45,61 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/saturated.h"
-#include "spandsp/vector_int.h"
 #include "spandsp/g722.h"
 
 #include "spandsp/private/g722.h"
 
-static const int16_t qmf_coeffs_fwd[12] =
+/* The QMF filters work on 12 pairs of samples. They are applied to blocks of sample pairs,
+   held in linear buffers, with the even and odd samples of each pair interleaved. The
+   vector versions work on windows of 16 pairs, so there are 4 extra, older, pairs with zero
+   coefficients, and the history in the buffers covers 15 pairs. */
+#define QMF_TAPS                12
+#define QMF_WINDOW              16
+#define QMF_HISTORY             (QMF_WINDOW - 1)
+/* The number of sample pairs processed at a time */
+#define QMF_CHUNK               80
+
+/* The coefficients for the transmit QMF, interleaved to match the sample pairs. The
+   forward coefficients apply to the even samples and the reversed ones to the odd
+   samples. The lower band is their sum, and the upper band their difference. */
+static const int16_t qmf_analysis_low[2*QMF_WINDOW] =
+{
+       0,    0,    0,    0,    0,    0,    0,    0,
+       3,  -11,  -11,   53,   12, -156,   32,  362,
+    -210, -805,  951, 3876, 3876,  951, -805, -210,
+     362,   32, -156,   12,   53,  -11,  -11,    3
+};
+
+static const int16_t qmf_analysis_high[2*QMF_WINDOW] =
 {
-      3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
+       0,    0,    0,    0,    0,    0,    0,    0,
+      -3,  -11,   11,   53,  -12, -156,  -32,  362,
+     210, -805, -951, 3876,-3876,  951,  805, -210,
+    -362,   32,  156,   12,  -53,  -11,   11,    3
 };
 
-static const int16_t qmf_coeffs_rev[12] =
+/* The coefficients for the receive QMF, which produce the even and odd output samples
+   from the sum and difference of the two bands. */
+static const int16_t qmf_synthesis_even[2*QMF_WINDOW] =
 {
-    -11,   53, -156,  362, -805, 3876,  951, -210,   32,   12,  -11,    3
+       0,    0,    0,    0,    0,    0,    0,    0,
+       0,  -11,    0,   53,    0, -156,    0,  362,
+       0, -805,    0, 3876,    0,  951,    0, -210,
+       0,   32,    0,   12,    0,  -11,    0,    3
+};
+
+static const int16_t qmf_synthesis_odd[2*QMF_WINDOW] =
+{
+       0,    0,    0,    0,    0,    0,    0,    0,
+       3,    0,  -11,    0,   12,    0,   32,    0,
+    -210,    0,  951,    0, 3876,    0, -805,    0,
+     362,    0, -156,    0,   53,    0,  -11,    0
 };
 
 static const int16_t qm2[4] =
@@ -180,23 +218,292 @@ static const int16_t rh2[4] =
     2,  1,  2,  1
 };
 
-static void block4(g722_band_t *s, int16_t dx)
+/* The vector versions are built with per-function target attributes, so the rest
+   of the library can still be built for a baseline CPU. This needs GCC 4.9 or
+   later, or clang. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define G722_WITH_SSE2
+#define G722_WITH_AVX2
+#endif
+#endif
+
+#if defined(G722_WITH_SSE2)  ||  defined(G722_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
+/* Apply two sets of QMF coefficients to a block of sample pairs. xy points to the first
+   new pair, and is preceded by QMF_HISTORY pairs of history. */
+typedef void (*qmf_kernel_t)(int32_t sum0[],
+                             int32_t sum1[],
+                             const int16_t xy[],
+                             const int16_t coeffs0[],
+                             const int16_t coeffs1[],
+                             int pairs);
+
+static void qmf_select(int32_t sum0[], int32_t sum1[], const int16_t xy[], const int16_t coeffs0[], const int16_t coeffs1[], int pairs);
+
+/* This starts out pointing at a routine which picks the real implementation on first use */
+static qmf_kernel_t qmf_kernel = qmf_select;
+static int g722_implementation = G722_IMPLEMENTATION_AUTO;
+
+static void qmf_generic(int32_t sum0[],
+                        int32_t sum1[],
+                        const int16_t xy[],
+                        const int16_t coeffs0[],
+                        const int16_t coeffs1[],
+                        int pairs)
+{
+    const int16_t *w;
+    int32_t z0;
+    int32_t z1;
+    int i;
+    int n;
+
+    for (n = 0;  n < pairs;  n++)
+    {
+        /* Skip the pairs with zero coefficients at the start of the window */
+        w = &xy[2*(n - QMF_HISTORY)];
+        z0 = 0;
+        z1 = 0;
+        for (i = 2*(QMF_WINDOW - QMF_TAPS);  i < 2*QMF_WINDOW;  i++)
+        {
+            z0 += (int32_t) coeffs0[i]*(int32_t) w[i];
+            z1 += (int32_t) coeffs1[i]*(int32_t) w[i];
+        }
+        sum0[n] = z0;
+        sum1[n] = z1;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(G722_WITH_SSE2)
+/* Total 4 vectors of partial sums, giving a vector of 4 sums */
+__attribute__((target("sse2")))
+static __inline__ __m128i hsum4_sse2(__m128i a0, __m128i a1, __m128i a2, __m128i a3)
+{
+    __m128i s01;
+    __m128i s23;
+
+    s01 = _mm_add_epi32(_mm_unpacklo_epi32(a0, a1), _mm_unpackhi_epi32(a0, a1));
+    s23 = _mm_add_epi32(_mm_unpacklo_epi32(a2, a3), _mm_unpackhi_epi32(a2, a3));
+    return _mm_add_epi32(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse2")))
+static void qmf_sse2(int32_t sum0[],
+                     int32_t sum1[],
+                     const int16_t xy[],
+                     const int16_t coeffs0[],
+                     const int16_t coeffs1[],
+                     int pairs)
+{
+    __m128i c0[3];
+    __m128i c1[3];
+    __m128i w[3];
+    __m128i a[4];
+    __m128i b[4];
+    const int16_t *p;
+    int i;
+    int k;
+    int n;
+
+    /* The 12 real pairs of the window fit exactly in 3 vectors */
+    for (k = 0;  k < 3;  k++)
+    {
+        c0[k] = _mm_loadu_si128((const __m128i *) &coeffs0[2*(QMF_WINDOW - QMF_TAPS) + 8*k]);
+        c1[k] = _mm_loadu_si128((const __m128i *) &coeffs1[2*(QMF_WINDOW - QMF_TAPS) + 8*k]);
+    }
+    for (n = 0;  n + 4 <= pairs;  n += 4)
+    {
+        for (i = 0;  i < 4;  i++)
+        {
+            p = &xy[2*(n + i - QMF_TAPS + 1)];
+            for (k = 0;  k < 3;  k++)
+                w[k] = _mm_loadu_si128((const __m128i *) &p[8*k]);
+            a[i] = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(w[0], c0[0]), _mm_madd_epi16(w[1], c0[1])), _mm_madd_epi16(w[2], c0[2]));
+            b[i] = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(w[0], c1[0]), _mm_madd_epi16(w[1], c1[1])), _mm_madd_epi16(w[2], c1[2]));
+        }
+        _mm_storeu_si128((__m128i *) &sum0[n], hsum4_sse2(a[0], a[1], a[2], a[3]));
+        _mm_storeu_si128((__m128i *) &sum1[n], hsum4_sse2(b[0], b[1], b[2], b[3]));
+    }
+    qmf_generic(&sum0[n], &sum1[n], &xy[2*n], coeffs0, coeffs1, pairs - n);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(G722_WITH_AVX2)
+/* Total 8 vectors of partial sums, giving a vector of 8 sums */
+__attribute__((target("avx2")))
+static __inline__ __m256i hsum8_avx2(const __m256i a[8])
+{
+    __m256i g0;
+    __m256i g1;
+
+    g0 = _mm256_hadd_epi32(_mm256_hadd_epi32(a[0], a[1]), _mm256_hadd_epi32(a[2], a[3]));
+    g1 = _mm256_hadd_epi32(_mm256_hadd_epi32(a[4], a[5]), _mm256_hadd_epi32(a[6], a[7]));
+    /* Each 128 bit lane now holds half of each sum */
+    return _mm256_add_epi32(_mm256_permute2x128_si256(g0, g1, 0x20), _mm256_permute2x128_si256(g0, g1, 0x31));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void qmf_avx2(int32_t sum0[],
+                     int32_t sum1[],
+                     const int16_t xy[],
+                     const int16_t coeffs0[],
+                     const int16_t coeffs1[],
+                     int pairs)
+{
+    __m256i c0[2];
+    __m256i c1[2];
+    __m256i w[2];
+    __m256i a[8];
+    __m256i b[8];
+    const int16_t *p;
+    int i;
+    int n;
+
+    /* The whole 16 pair window fits in 2 vectors */
+    c0[0] = _mm256_loadu_si256((const __m256i *) &coeffs0[0]);
+    c0[1] = _mm256_loadu_si256((const __m256i *) &coeffs0[16]);
+    c1[0] = _mm256_loadu_si256((const __m256i *) &coeffs1[0]);
+    c1[1] = _mm256_loadu_si256((const __m256i *) &coeffs1[16]);
+    for (n = 0;  n + 8 <= pairs;  n += 8)
+    {
+        for (i = 0;  i < 8;  i++)
+        {
+            p = &xy[2*(n + i - QMF_HISTORY)];
+            w[0] = _mm256_loadu_si256((const __m256i *) &p[0]);
+            w[1] = _mm256_loadu_si256((const __m256i *) &p[16]);
+            a[i] = _mm256_add_epi32(_mm256_madd_epi16(w[0], c0[0]), _mm256_madd_epi16(w[1], c0[1]));
+            b[i] = _mm256_add_epi32(_mm256_madd_epi16(w[0], c1[0]), _mm256_madd_epi16(w[1], c1[1]));
+        }
+        _mm256_storeu_si256((__m256i *) &sum0[n], hsum8_avx2(a));
+        _mm256_storeu_si256((__m256i *) &sum1[n], hsum8_avx2(b));
+    }
+    qmf_generic(&sum0[n], &sum1[n], &xy[2*n], coeffs0, coeffs1, pairs - n);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case G722_IMPLEMENTATION_GENERIC:
+        return TRUE;
+#if defined(G722_WITH_SSE2)
+    case G722_IMPLEMENTATION_SSE2:
+        return has_SSE2();
+#endif
+#if defined(G722_WITH_AVX2)
+    case G722_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g722_set_implementation(int implementation)
+{
+    if (implementation == G722_IMPLEMENTATION_AUTO)
+    {
+        if (implementation_available(G722_IMPLEMENTATION_AVX2))
+            implementation = G722_IMPLEMENTATION_AVX2;
+        else if (implementation_available(G722_IMPLEMENTATION_SSE2))
+            implementation = G722_IMPLEMENTATION_SSE2;
+        else
+            implementation = G722_IMPLEMENTATION_GENERIC;
+    }
+    else if (!implementation_available(implementation))
+    {
+        return -1;
+    }
+    switch (implementation)
+    {
+#if defined(G722_WITH_AVX2)
+    case G722_IMPLEMENTATION_AVX2:
+        qmf_kernel = qmf_avx2;
+        break;
+#endif
+#if defined(G722_WITH_SSE2)
+    case G722_IMPLEMENTATION_SSE2:
+        qmf_kernel = qmf_sse2;
+        break;
+#endif
+    default:
+        implementation = G722_IMPLEMENTATION_GENERIC;
+        qmf_kernel = qmf_generic;
+        break;
+    }
+    g722_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g722_get_implementation(void)
+{
+    if (g722_implementation == G722_IMPLEMENTATION_AUTO)
+        g722_set_implementation(G722_IMPLEMENTATION_AUTO);
+    return g722_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void qmf_select(int32_t sum0[], int32_t sum1[], const int16_t xy[], const int16_t coeffs0[], const int16_t coeffs1[], int pairs)
+{
+    g722_set_implementation(G722_IMPLEMENTATION_AUTO);
+    qmf_kernel(sum0, sum1, xy, coeffs0, coeffs1, pairs);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Fill in the history at the start of a QMF buffer from the circular history in a
+   context. The oldest pairs in the buffer have zero coefficients, and are simply
+   cleared. */
+static void qmf_load_history(int16_t xy[], const int16_t x[], const int16_t y[], int ptr)
+{
+    int i;
+
+    memset(xy, 0, 2*(QMF_HISTORY - QMF_TAPS)*sizeof(xy[0]));
+    xy += 2*(QMF_HISTORY - QMF_TAPS);
+    for (i = 0;  i < QMF_TAPS;  i++)
+    {
+        xy[2*i] = x[ptr];
+        xy[2*i + 1] = y[ptr];
+        if (++ptr >= QMF_TAPS)
+            ptr = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Save the history at the start of a QMF buffer back to the circular history in a
+   context. */
+static void qmf_save_history(int16_t x[], int16_t y[], int *ptr, const int16_t xy[])
+{
+    int i;
+
+    xy += 2*(QMF_HISTORY - QMF_TAPS);
+    for (i = 0;  i < QMF_TAPS;  i++)
+    {
+        x[i] = xy[2*i];
+        y[i] = xy[2*i + 1];
+    }
+    *ptr = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Update the pole section of a band's predictor (UPPOL2, UPPOL1 and FILTEP), returning
+   the pole prediction. */
+static __inline__ int16_t update_poles(g722_band_t *s, int16_t r, int16_t p)
 {
     int16_t wd1;
     int16_t wd2;
     int16_t wd3;
-    int16_t sp;
-    int16_t r;
-    int16_t p;
-    int16_t ap[2];
+    int16_t ap0;
+    int16_t ap1;
     int32_t wd32;
-    int32_t sz;
-    int i;
-
-    /* RECONS */
-    r = saturated_add16(s->s, dx);
-    /* PARREC */
-    p = saturated_add16(s->sz, dx);
 
     /* UPPOL2 */
     wd1 = saturate((int32_t) s->a[0] << 2);
@@ -208,28 +515,49 @@ static void block4(g722_band_t *s, int16_t dx)
                      + (((int32_t) s->a[1]*(int32_t) 32512) >> 15));
     if (abs(wd3) > 12288)
         wd3 = (wd3 < 0)  ?  -12288  :  12288;
-    ap[1] = wd3;
+    ap1 = wd3;
 
     /* UPPOL1 */
     wd1 = ((p ^ s->p[0]) & 0x8000)  ?  -192  :  192;
     wd2 = (int16_t) (((int32_t) s->a[0]*(int32_t) 32640) >> 15);
-    ap[0] = saturated_add16(wd1, wd2);
+    ap0 = saturated_add16(wd1, wd2);
 
-    wd3 = saturated_sub16(15360, ap[1]);
-    if (abs(ap[0]) > wd3)
-        ap[0] = (ap[0] < 0)  ?  -wd3  :  wd3;
+    wd3 = saturated_sub16(15360, ap1);
+    if (abs(ap0) > wd3)
+        ap0 = (ap0 < 0)  ?  -wd3  :  wd3;
 
     /* FILTEP */
     wd1 = saturated_add16(r, r);
-    wd1 = (int16_t) (((int32_t) ap[0]*(int32_t) wd1) >> 15);
+    wd1 = (int16_t) (((int32_t) ap0*(int32_t) wd1) >> 15);
     wd2 = saturated_add16(s->r, s->r);
-    wd2 = (int16_t) (((int32_t) ap[1]*(int32_t) wd2) >> 15);
-    sp = saturated_add16(wd1, wd2);
+    wd2 = (int16_t) (((int32_t) ap1*(int32_t) wd2) >> 15);
     s->r = r;
-    s->a[1] = ap[1];
-    s->a[0] = ap[0];
+    s->a[1] = ap1;
+    s->a[0] = ap0;
     s->p[1] = s->p[0];
     s->p[0] = p;
+    return saturated_add16(wd1, wd2);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void block4(g722_band_t *s, int16_t dx)
+{
+    int16_t wd1;
+    int16_t wd2;
+    int16_t wd3;
+    int16_t sp;
+    int16_t r;
+    int16_t p;
+    int32_t sz;
+    int i;
+
+    /* RECONS */
+    r = saturated_add16(s->s, dx);
+    /* PARREC */
+    p = saturated_add16(s->sz, dx);
+
+    /* UPPOL2, UPPOL1, FILTEP */
+    sp = update_poles(s, r, p);
 
     /* UPZERO */
     /* DELAYA */
@@ -253,11 +581,76 @@ static void block4(g722_band_t *s, int16_t dx)
 }
 /*- End of function --------------------------------------------------------*/
 
+/* Update the predictors of both bands. The two updates are independent, so the zero
+   section updates, which are the bulk of the work, are done side by side, giving the
+   CPU two separate chains of work to overlap. The results are exactly those of calling
+   block4() for each band. */
+static __inline__ void block4_dual(g722_band_t *lo, int16_t dlo, g722_band_t *hi, int16_t dhi)
+{
+    int16_t r_lo;
+    int16_t r_hi;
+    int16_t p_lo;
+    int16_t p_hi;
+    int16_t sp_lo;
+    int16_t sp_hi;
+    int16_t g_lo;
+    int16_t g_hi;
+    int16_t wd2;
+    int16_t wd3;
+    int32_t sz_lo;
+    int32_t sz_hi;
+    int i;
+
+    /* RECONS */
+    r_lo = saturated_add16(lo->s, dlo);
+    r_hi = saturated_add16(hi->s, dhi);
+    /* PARREC */
+    p_lo = saturated_add16(lo->sz, dlo);
+    p_hi = saturated_add16(hi->sz, dhi);
+
+    /* UPPOL2, UPPOL1, FILTEP */
+    sp_lo = update_poles(lo, r_lo, p_lo);
+    sp_hi = update_poles(hi, r_hi, p_hi);
+
+    /* UPZERO */
+    /* DELAYA */
+    /* FILTEZ */
+    g_lo = (dlo == 0)  ?  0  :  128;
+    g_hi = (dhi == 0)  ?  0  :  128;
+    lo->d[0] = dlo;
+    hi->d[0] = dhi;
+    sz_lo = 0;
+    sz_hi = 0;
+    for (i = 5;  i >= 0;  i--)
+    {
+        wd2 = ((lo->d[i + 1] ^ dlo) & 0x8000)  ?  -g_lo  :  g_lo;
+        wd3 = (int16_t) (((int32_t) lo->b[i]*(int32_t) 32640) >> 15);
+        lo->b[i] = saturated_add16(wd2, wd3);
+        wd3 = saturated_add16(lo->d[i], lo->d[i]);
+        sz_lo += ((int32_t) lo->b[i]*(int32_t) wd3) >> 15;
+        lo->d[i + 1] = lo->d[i];
+
+        wd2 = ((hi->d[i + 1] ^ dhi) & 0x8000)  ?  -g_hi  :  g_hi;
+        wd3 = (int16_t) (((int32_t) hi->b[i]*(int32_t) 32640) >> 15);
+        hi->b[i] = saturated_add16(wd2, wd3);
+        wd3 = saturated_add16(hi->d[i], hi->d[i]);
+        sz_hi += ((int32_t) hi->b[i]*(int32_t) wd3) >> 15;
+        hi->d[i + 1] = hi->d[i];
+    }
+    lo->sz = saturate(sz_lo);
+    hi->sz = saturate(sz_hi);
+
+    /* PREDIC */
+    lo->s = saturated_add16(sp_lo, lo->sz);
+    hi->s = saturated_add16(sp_hi, hi->sz);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(g722_decode_state_t *) g722_decode_init(g722_decode_state_t *s, int rate, int options)
 {
     if (s == NULL)
     {
-        if ((s = (g722_decode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g722_decode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -287,11 +680,31 @@ SPAN_DECLARE(int) g722_decode_release(g722_decode_state_t *s)
 
 SPAN_DECLARE(int) g722_decode_free(g722_decode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+/* Apply the receive QMF to a block of sample pairs, and move the history along */
+static int qmf_synthesis(int16_t amp[], int16_t xy[], int pairs)
+{
+    int32_t sumeven[QMF_CHUNK];
+    int32_t sumodd[QMF_CHUNK];
+    int i;
+
+    qmf_kernel(sumeven, sumodd, &xy[2*QMF_HISTORY], qmf_synthesis_even, qmf_synthesis_odd, pairs);
+    for (i = 0;  i < pairs;  i++)
+    {
+        /* We shift by 12 to allow for the QMF filters (DC gain = 4096), less 1
+           to allow for the 15 bit input to the G.722 algorithm. */
+        amp[2*i] = (int16_t) (sumeven[i] >> 11);
+        amp[2*i + 1] = (int16_t) (sumodd[i] >> 11);
+    }
+    memmove(xy, &xy[2*pairs], 2*QMF_HISTORY*sizeof(xy[0]));
+    return 2*pairs;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[], int len)
 {
     int rlow;
@@ -304,10 +717,17 @@ SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8
     int wd3;
     int code;
     int outlen;
+    int pairs;
+    int qmf;
     int j;
+    int16_t xy[2*(QMF_HISTORY + QMF_CHUNK)];
 
     outlen = 0;
     rhigh = 0;
+    pairs = 0;
+    qmf = (!s->itu_test_mode  &&  !s->eight_k);
+    if (qmf)
+        qmf_load_history(xy, s->x, s->y, s->ptr);
     for (j = 0;  j < len;  )
     {
         if (s->packed)
@@ -374,9 +794,11 @@ SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8
         wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
         s->band[0].det = (int16_t) (wd3 << 2);
 
-        block4(&s->band[0], dlow);
-        
-        if (!s->eight_k)
+        if (s->eight_k)
+        {
+            block4(&s->band[0], dlow);
+        }
+        else
         {
             /* Block 2H, INVQAH */
             wd2 = qm2[ihigh];
@@ -401,7 +823,8 @@ SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8
             wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
             s->band[1].det = (int16_t) (wd3 << 2);
 
-            block4(&s->band[1], dhigh);
+            /* The two bands are independent, so update their predictors together */
+            block4_dual(&s->band[0], dlow, &s->band[1], dhigh);
         }
 
         if (s->itu_test_mode)
@@ -418,18 +841,24 @@ SPAN_DECLARE(int) g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8
             }
             else
             {
-                /* Apply the QMF to build the final signal */
-                s->x[s->ptr] = (int16_t) (rlow + rhigh);
-                s->y[s->ptr] = (int16_t) (rlow - rhigh);
-                if (++s->ptr >= 12)
-                    s->ptr = 0;
-                /* We shift by 12 to allow for the QMF filters (DC gain = 4096), less 1
-                   to allow for the 15 bit input to the G.722 algorithm. */
-                amp[outlen++] = (int16_t) (vec_circular_dot_prodi16(s->y, qmf_coeffs_rev, 12, s->ptr) >> 11);
-                amp[outlen++] = (int16_t) (vec_circular_dot_prodi16(s->x, qmf_coeffs_fwd, 12, s->ptr) >> 11);
+                /* Collect the sums and differences of the bands, and apply the QMF to
+                   build the final signal a block at a time */
+                xy[2*(QMF_HISTORY + pairs)] = (int16_t) (rlow + rhigh);
+                xy[2*(QMF_HISTORY + pairs) + 1] = (int16_t) (rlow - rhigh);
+                if (++pairs >= QMF_CHUNK)
+                {
+                    outlen += qmf_synthesis(&amp[outlen], xy, pairs);
+                    pairs = 0;
+                }
             }
         }
     }
+    if (qmf)
+    {
+        if (pairs > 0)
+            outlen += qmf_synthesis(&amp[outlen], xy, pairs);
+        qmf_save_history(s->x, s->y, &s->ptr, xy);
+    }
     return outlen;
 }
 /*- End of function --------------------------------------------------------*/
@@ -438,7 +867,7 @@ SPAN_DECLARE(g722_encode_state_t *) g722_encode_init(g722_encode_state_t *s, int
 {
     if (s == NULL)
     {
-        if ((s = (g722_encode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g722_encode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -468,12 +897,12 @@ SPAN_DECLARE(int) g722_encode_release(g722_encode_state_t *s)
 
 SPAN_DECLARE(int) g722_encode_free(g722_encode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len)
+static __inline__ int encode_sample(g722_encode_state_t *s, uint8_t g722_data[], int g722_bytes, int16_t xlow, int16_t xhigh)
 {
     int16_t dlow;
     int16_t dhigh;
@@ -486,143 +915,156 @@ SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const
     int ih2;
     int wd3;
     int eh;
-    int g722_bytes;
     int ihigh;
     int ilow;
     int code;
-    /* Low and high band PCM from the QMF */
-    int16_t xlow;
-    int16_t xhigh;
-    int32_t sumeven;
-    int32_t sumodd;
     int mih;
     int i;
-    int j;
 
-    g722_bytes = 0;
-    xhigh = 0;
-    for (j = 0;  j < len;  )
-    {
-        if (s->itu_test_mode)
-        {
-            xlow =
-            xhigh = amp[j++] >> 1;
-        }
-        else
-        {
-            if (s->eight_k)
-            {
-                /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
-                xlow = amp[j++] >> 1;
-            }
-            else
-            {
-                /* Apply the transmit QMF */
-                s->x[s->ptr] = amp[j++];
-                s->y[s->ptr] = amp[j++];
-                if (++s->ptr >= 12)
-                    s->ptr = 0;
-                sumodd = vec_circular_dot_prodi16(s->x, qmf_coeffs_fwd, 12, s->ptr);
-                sumeven = vec_circular_dot_prodi16(s->y, qmf_coeffs_rev, 12, s->ptr);
-                /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
-                   to allow for us summing two filters, plus 1 to allow for the 15 bit
-                   input to the G.722 algorithm. */
-                xlow = (int16_t) ((sumeven + sumodd) >> 14);
-                xhigh = (int16_t) ((sumeven - sumodd) >> 14);
-            }
-        }
-        /* Block 1L, SUBTRA */
-        el = saturated_sub16(xlow, s->band[0].s);
+    /* Block 1L, SUBTRA */
+    el = saturated_sub16(xlow, s->band[0].s);
 
-        /* Block 1L, QUANTL */
-        wd = (el >= 0)  ?  el  :  ~el;
+    /* Block 1L, QUANTL */
+    wd = (el >= 0)  ?  el  :  ~el;
 
-        for (i = 1;  i < 30;  i++)
-        {
-            wd1 = ((int32_t) q6[i]*(int32_t) s->band[0].det) >> 12;
-            if (wd < wd1)
-                break;
-        }
-        ilow = (el < 0)  ?  iln[i]  :  ilp[i];
+    for (i = 1;  i < 30;  i++)
+    {
+        wd1 = ((int32_t) q6[i]*(int32_t) s->band[0].det) >> 12;
+        if (wd < wd1)
+            break;
+    }
+    ilow = (el < 0)  ?  iln[i]  :  ilp[i];
 
-        /* Block 2L, INVQAL */
-        ril = ilow >> 2;
-        wd2 = qm4[ril];
-        dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
+    /* Block 2L, INVQAL */
+    ril = ilow >> 2;
+    wd2 = qm4[ril];
+    dlow = (int16_t) (((int32_t) s->band[0].det*(int32_t) wd2) >> 15);
 
-        /* Block 3L, LOGSCL */
-        il4 = rl42[ril];
-        wd = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
-        s->band[0].nb = (int16_t) (wd + wl[il4]);
-        if (s->band[0].nb < 0)
-            s->band[0].nb = 0;
-        else if (s->band[0].nb > 18432)
-            s->band[0].nb = 18432;
+    /* Block 3L, LOGSCL */
+    il4 = rl42[ril];
+    wd = ((int32_t) s->band[0].nb*(int32_t) 127) >> 7;
+    s->band[0].nb = (int16_t) (wd + wl[il4]);
+    if (s->band[0].nb < 0)
+        s->band[0].nb = 0;
+    else if (s->band[0].nb > 18432)
+        s->band[0].nb = 18432;
 
-        /* Block 3L, SCALEL */
-        wd1 = (s->band[0].nb >> 6) & 31;
-        wd2 = 8 - (s->band[0].nb >> 11);
-        wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-        s->band[0].det = (int16_t) (wd3 << 2);
+    /* Block 3L, SCALEL */
+    wd1 = (s->band[0].nb >> 6) & 31;
+    wd2 = 8 - (s->band[0].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[0].det = (int16_t) (wd3 << 2);
 
+    if (s->eight_k)
+    {
         block4(&s->band[0], dlow);
-        
-        if (s->eight_k)
-        {
-            /* Just leave the high bits as zero */
-            code = (0xC0 | ilow) >> (8 - s->bits_per_sample);
-        }
-        else
-        {
-            /* Block 1H, SUBTRA */
-            eh = saturated_sub16(xhigh, s->band[1].s);
+        /* Just leave the high bits as zero */
+        code = (0xC0 | ilow) >> (8 - s->bits_per_sample);
+    }
+    else
+    {
+        /* Block 1H, SUBTRA */
+        eh = saturated_sub16(xhigh, s->band[1].s);
 
-            /* Block 1H, QUANTH */
-            wd = (eh >= 0)  ?  eh  :  ~eh;
-            wd1 = (564*s->band[1].det) >> 12;
-            mih = (wd >= wd1)  ?  2  :  1;
-            ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
+        /* Block 1H, QUANTH */
+        wd = (eh >= 0)  ?  eh  :  ~eh;
+        wd1 = (564*s->band[1].det) >> 12;
+        mih = (wd >= wd1)  ?  2  :  1;
+        ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
 
-            /* Block 2H, INVQAH */
-            wd2 = qm2[ihigh];
-            dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
+        /* Block 2H, INVQAH */
+        wd2 = qm2[ihigh];
+        dhigh = (int16_t) (((int32_t) s->band[1].det*(int32_t) wd2) >> 15);
 
-            /* Block 3H, LOGSCH */
-            ih2 = rh2[ihigh];
-            wd = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
-            s->band[1].nb = (int16_t) (wd + wh[ih2]);
-            if (s->band[1].nb < 0)
-                s->band[1].nb = 0;
-            else if (s->band[1].nb > 22528)
-                s->band[1].nb = 22528;
+        /* Block 3H, LOGSCH */
+        ih2 = rh2[ihigh];
+        wd = ((int32_t) s->band[1].nb*(int32_t) 127) >> 7;
+        s->band[1].nb = (int16_t) (wd + wh[ih2]);
+        if (s->band[1].nb < 0)
+            s->band[1].nb = 0;
+        else if (s->band[1].nb > 22528)
+            s->band[1].nb = 22528;
 
-            /* Block 3H, SCALEH */
-            wd1 = (s->band[1].nb >> 6) & 31;
-            wd2 = 10 - (s->band[1].nb >> 11);
-            wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-            s->band[1].det = (int16_t) (wd3 << 2);
+        /* Block 3H, SCALEH */
+        wd1 = (s->band[1].nb >> 6) & 31;
+        wd2 = 10 - (s->band[1].nb >> 11);
+        wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+        s->band[1].det = (int16_t) (wd3 << 2);
+
+        /* The two bands are independent, so update their predictors together */
+        block4_dual(&s->band[0], dlow, &s->band[1], dhigh);
+        code = ((ihigh << 6) | ilow) >> (8 - s->bits_per_sample);
+    }
 
-            block4(&s->band[1], dhigh);
-            code = ((ihigh << 6) | ilow) >> (8 - s->bits_per_sample);
+    if (s->packed)
+    {
+        /* Pack the code bits */
+        s->out_buffer |= (code << s->out_bits);
+        s->out_bits += s->bits_per_sample;
+        if (s->out_bits >= 8)
+        {
+            g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
+            s->out_bits -= 8;
+            s->out_buffer >>= 8;
         }
+    }
+    else
+    {
+        g722_data[g722_bytes++] = (uint8_t) code;
+    }
+    return g722_bytes;
+}
+/*- End of function --------------------------------------------------------*/
 
-        if (s->packed)
+SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len)
+{
+    int g722_bytes;
+    int pairs;
+    int i;
+    int j;
+    /* Low and high band PCM from the QMF */
+    int16_t xlow;
+    int16_t xhigh;
+    int32_t sumlow[QMF_CHUNK];
+    int32_t sumhigh[QMF_CHUNK];
+    int16_t xy[2*(QMF_HISTORY + QMF_CHUNK)];
+
+    g722_bytes = 0;
+    if (s->itu_test_mode  ||  s->eight_k)
+    {
+        xhigh = 0;
+        for (j = 0;  j < len;  j++)
         {
-            /* Pack the code bits */
-            s->out_buffer |= (code << s->out_bits);
-            s->out_bits += s->bits_per_sample;
-            if (s->out_bits >= 8)
-            {
-                g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
-                s->out_bits -= 8;
-                s->out_buffer >>= 8;
-            }
+            /* We shift by 1 to allow for the 15 bit input to the G.722 algorithm. */
+            xlow = amp[j] >> 1;
+            if (s->itu_test_mode)
+                xhigh = xlow;
+            g722_bytes = encode_sample(s, g722_data, g722_bytes, xlow, xhigh);
         }
-        else
+        return g722_bytes;
+    }
+
+    /* Apply the transmit QMF a block at a time, and then encode the block */
+    qmf_load_history(xy, s->x, s->y, s->ptr);
+    for (j = 0;  j < len/2;  j += pairs)
+    {
+        pairs = len/2 - j;
+        if (pairs > QMF_CHUNK)
+            pairs = QMF_CHUNK;
+        memcpy(&xy[2*QMF_HISTORY], &amp[2*j], 2*pairs*sizeof(xy[0]));
+        qmf_kernel(sumlow, sumhigh, &xy[2*QMF_HISTORY], qmf_analysis_low, qmf_analysis_high, pairs);
+        for (i = 0;  i < pairs;  i++)
         {
-            g722_data[g722_bytes++] = (uint8_t) code;
+            /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
+               to allow for us summing two filters, plus 1 to allow for the 15 bit
+               input to the G.722 algorithm. */
+            xlow = (int16_t) (sumlow[i] >> 14);
+            xhigh = (int16_t) (sumhigh[i] >> 14);
+            g722_bytes = encode_sample(s, g722_data, g722_bytes, xlow, xhigh);
         }
+        memmove(xy, &xy[2*pairs], 2*QMF_HISTORY*sizeof(xy[0]));
     }
+    qmf_save_history(s->x, s->y, &s->ptr, xy);
     return g722_bytes;
 }
 /*- End of function --------------------------------------------------------*/
@@ -66,7 +66,10 @@
 #endif
 #include "floating_fudge.h"
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/bitstream.h"
 #include "spandsp/bit_operations.h"
@@ -209,6 +212,31 @@ static const int qtab_726_40[15] =
      378, 413, 445, 475, 502, 528, 553
 };
 
+/* The tables and constants for each bit rate, indexed by the number of bits per
+   sample, less 2. These are used by the multi-channel code. */
+typedef struct
+{
+    const int *dqlntab;
+    const int *witab;
+    const int *fitab;
+    const int *qtab;
+    int quantizer_states;
+    /*! The sign bit of a code */
+    int sign;
+    /*! The mask for the magnitude of a negative dq, when reconstructing the signal */
+    int dq_mask;
+    /*! The leak shift for the zero predictor coefficients */
+    int b_leak;
+} g726_params_t;
+
+static const g726_params_t g726_params[4] =
+{
+    {g726_16_dqlntab, g726_16_witab, g726_16_fitab, qtab_726_16,  4, 0x02, 0x3FFF, 8},
+    {g726_24_dqlntab, g726_24_witab, g726_24_fitab, qtab_726_24,  7, 0x04, 0x3FFF, 8},
+    {g726_32_dqlntab, g726_32_witab, g726_32_fitab, qtab_726_32, 15, 0x08, 0x3FFF, 8},
+    {g726_40_dqlntab, g726_40_witab, g726_40_fitab, qtab_726_40, 31, 0x10, 0x7FFF, 9}
+};
+
 /*
  * returns the integer product of the 14-bit integer "an" and
  * "floating point" representation (4-bit exponent, 6-bit mantessa) "srn".
@@ -1003,7 +1031,7 @@ SPAN_DECLARE(g726_state_t *) g726_init(g726_state_t *s, int bit_rate, int ext_co
         return NULL;
     if (s == NULL)
     {
-        if ((s = (g726_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (g726_state_t *) span_alloc(sizeof(*s))) == NULL)
             return  NULL;
     }
     s->yl = 34816;
@@ -1063,11 +1091,100 @@ SPAN_DECLARE(int) g726_release(g726_state_t *s)
 
 SPAN_DECLARE(int) g726_free(g726_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+/* Get the next code from a stream of G.726 data, returning -1 when the data
+   runs out. */
+static __inline__ int unpack_code(g726_state_t *s, const uint8_t g726_data[], int *i, int g726_bytes)
+{
+    int code;
+
+    if (s->packing == G726_PACKING_NONE)
+    {
+        if (*i >= g726_bytes)
+            return -1;
+        return g726_data[(*i)++];
+    }
+    /* Unpack the code bits */
+    if (s->packing != G726_PACKING_LEFT)
+    {
+        if (s->bs.residue < s->bits_per_sample)
+        {
+            if (*i >= g726_bytes)
+                return -1;
+            s->bs.bitstream |= (g726_data[(*i)++] << s->bs.residue);
+            s->bs.residue += 8;
+        }
+        code = (uint8_t) (s->bs.bitstream & ((1 << s->bits_per_sample) - 1));
+        s->bs.bitstream >>= s->bits_per_sample;
+    }
+    else
+    {
+        if (s->bs.residue < s->bits_per_sample)
+        {
+            if (*i >= g726_bytes)
+                return -1;
+            s->bs.bitstream = (s->bs.bitstream << 8) | g726_data[(*i)++];
+            s->bs.residue += 8;
+        }
+        code = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - s->bits_per_sample)) & ((1 << s->bits_per_sample) - 1));
+    }
+    s->bs.residue -= s->bits_per_sample;
+    return code;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Add a code to a stream of G.726 data, returning the new length of the data. */
+static __inline__ int pack_code(g726_state_t *s, uint8_t g726_data[], int g726_bytes, uint8_t code)
+{
+    if (s->packing == G726_PACKING_NONE)
+    {
+        g726_data[g726_bytes++] = (uint8_t) code;
+        return g726_bytes;
+    }
+    /* Pack the code bits */
+    if (s->packing != G726_PACKING_LEFT)
+    {
+        s->bs.bitstream |= (code << s->bs.residue);
+        s->bs.residue += s->bits_per_sample;
+        if (s->bs.residue >= 8)
+        {
+            g726_data[g726_bytes++] = (uint8_t) (s->bs.bitstream & 0xFF);
+            s->bs.bitstream >>= 8;
+            s->bs.residue -= 8;
+        }
+    }
+    else
+    {
+        s->bs.bitstream = (s->bs.bitstream << s->bits_per_sample) | code;
+        s->bs.residue += s->bits_per_sample;
+        if (s->bs.residue >= 8)
+        {
+            g726_data[g726_bytes++] = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - 8)) & 0xFF);
+            s->bs.residue -= 8;
+        }
+    }
+    return g726_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Linearize an input sample to 14-bit PCM */
+static __inline__ int16_t linearize(g726_state_t *s, const int16_t amp[], int i)
+{
+    switch (s->ext_coding)
+    {
+    case G726_ENCODING_ALAW:
+        return alaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
+    case G726_ENCODING_ULAW:
+        return ulaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
+    }
+    return amp[i] >> 2;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) g726_decode(g726_state_t *s,
                               int16_t amp[],
                               const uint8_t g726_data[],
@@ -1075,46 +1192,12 @@ SPAN_DECLARE(int) g726_decode(g726_state_t *s,
 {
     int i;
     int samples;
-    uint8_t code;
+    int code;
     int sl;
 
-    for (samples = i = 0;  ;  )
+    for (samples = i = 0;  (code = unpack_code(s, g726_data, &i, g726_bytes)) >= 0;  )
     {
-        if (s->packing != G726_PACKING_NONE)
-        {
-            /* Unpack the code bits */
-            if (s->packing != G726_PACKING_LEFT)
-            {
-                if (s->bs.residue < s->bits_per_sample)
-                {
-                    if (i >= g726_bytes)
-                        break;
-                    s->bs.bitstream |= (g726_data[i++] << s->bs.residue);
-                    s->bs.residue += 8;
-                }
-                code = (uint8_t) (s->bs.bitstream & ((1 << s->bits_per_sample) - 1));
-                s->bs.bitstream >>= s->bits_per_sample;
-            }
-            else
-            {
-                if (s->bs.residue < s->bits_per_sample)
-                {
-                    if (i >= g726_bytes)
-                        break;
-                    s->bs.bitstream = (s->bs.bitstream << 8) | g726_data[i++];
-                    s->bs.residue += 8;
-                }
-                code = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - s->bits_per_sample)) & ((1 << s->bits_per_sample) - 1));
-            }
-            s->bs.residue -= s->bits_per_sample;
-        }
-        else
-        {
-            if (i >= g726_bytes)
-                break;
-            code = g726_data[i++];
-        }
-        sl = s->dec_func(s, code);
+        sl = s->dec_func(s, (uint8_t) code);
         if (s->ext_coding != G726_ENCODING_LINEAR)
             ((uint8_t *) amp)[samples++] = (uint8_t) sl;
         else
@@ -1131,55 +1214,618 @@ SPAN_DECLARE(int) g726_encode(g726_state_t *s,
 {
     int i;
     int g726_bytes;
-    int16_t sl;
-    uint8_t code;
 
     for (g726_bytes = i = 0;  i < len;  i++)
+        g726_bytes = pack_code(s, g726_data, g726_bytes, s->enc_func(s, linearize(s, amp, i)));
+    return g726_bytes;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The multi-channel code can run a group of channels in lockstep, each in one 32 bit
+   lane of a vector. The vector versions are built with per-function target
+   attributes, so the rest of the library can still be built for a baseline CPU.
+   This needs GCC 4.9 or later, or clang. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define G726_WITH_AVX2
+#endif
+#endif
+
+static int g726_implementation = G726_IMPLEMENTATION_AUTO;
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case G726_IMPLEMENTATION_GENERIC:
+        return TRUE;
+#if defined(G726_WITH_AVX2)
+    case G726_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g726_set_implementation(int implementation)
+{
+    if (implementation == G726_IMPLEMENTATION_AUTO)
+    {
+        if (implementation_available(G726_IMPLEMENTATION_AVX2))
+            implementation = G726_IMPLEMENTATION_AVX2;
+        else
+            implementation = G726_IMPLEMENTATION_GENERIC;
+    }
+    else if (!implementation_available(implementation))
     {
-        /* Linearize the input sample to 14-bit PCM */
-        switch (s->ext_coding)
+        return -1;
+    }
+    g726_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g726_get_implementation(void)
+{
+    if (g726_implementation == G726_IMPLEMENTATION_AUTO)
+        g726_set_implementation(G726_IMPLEMENTATION_AUTO);
+    return g726_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Check a set of channels can be processed together. */
+static int channels_in_step(g726_state_t *s[], int channels)
+{
+    int i;
+
+    if (channels <= 0)
+        return FALSE;
+    for (i = 1;  i < channels;  i++)
+    {
+        if (s[i]->bits_per_sample != s[0]->bits_per_sample  ||  s[i]->packing != s[0]->packing)
+            return FALSE;
+        if (s[0]->packing != G726_PACKING_NONE  &&  s[i]->bs.residue != s[0]->bs.residue)
+            return FALSE;
+    }
+    return TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(G726_WITH_AVX2)
+#include <immintrin.h>
+
+/*! The number of channels processed in lockstep */
+#define G726_LANES                  8
+/*! The number of samples handled for each channel in one pass */
+#define G726_CHUNK                  80
+
+/* The adaptive state of a group of channels, in structure of arrays form, so each
+   variable loads straight into a vector. */
+typedef struct
+{
+    int32_t yl[G726_LANES];
+    int32_t yu[G726_LANES];
+    int32_t dms[G726_LANES];
+    int32_t dml[G726_LANES];
+    int32_t ap[G726_LANES];
+    int32_t a[2][G726_LANES];
+    int32_t b[6][G726_LANES];
+    int32_t pk[2][G726_LANES];
+    int32_t dq[6][G726_LANES];
+    int32_t sr[2][G726_LANES];
+    int32_t td[G726_LANES];
+} g726_lanes_t;
+
+static void load_lanes(g726_lanes_t *l, g726_state_t *s[], int n)
+{
+    g726_state_t *t;
+    int i;
+    int k;
+
+    /* Unused lanes run a copy of the first channel, and their results are discarded */
+    for (k = 0;  k < G726_LANES;  k++)
+    {
+        t = s[(k < n)  ?  k  :  0];
+        l->yl[k] = t->yl;
+        l->yu[k] = t->yu;
+        l->dms[k] = t->dms;
+        l->dml[k] = t->dml;
+        l->ap[k] = t->ap;
+        l->td[k] = t->td;
+        for (i = 0;  i < 2;  i++)
         {
-        case G726_ENCODING_ALAW:
-            sl = alaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
-            break;
-        case G726_ENCODING_ULAW:
-            sl = ulaw_to_linear(((const uint8_t *) amp)[i]) >> 2;
-            break;
-        default:
-            sl = amp[i] >> 2;
-            break;
+            l->a[i][k] = t->a[i];
+            l->pk[i][k] = t->pk[i];
+            l->sr[i][k] = t->sr[i];
         }
-        code = s->enc_func(s, sl);
-        if (s->packing != G726_PACKING_NONE)
+        for (i = 0;  i < 6;  i++)
         {
-            /* Pack the code bits */
-            if (s->packing != G726_PACKING_LEFT)
+            l->b[i][k] = t->b[i];
+            l->dq[i][k] = t->dq[i];
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void save_lanes(g726_state_t *s[], int n, const g726_lanes_t *l)
+{
+    g726_state_t *t;
+    int i;
+    int k;
+
+    for (k = 0;  k < n;  k++)
+    {
+        t = s[k];
+        t->yl = l->yl[k];
+        t->yu = (int16_t) l->yu[k];
+        t->dms = (int16_t) l->dms[k];
+        t->dml = (int16_t) l->dml[k];
+        t->ap = (int16_t) l->ap[k];
+        t->td = l->td[k];
+        for (i = 0;  i < 2;  i++)
+        {
+            t->a[i] = (int16_t) l->a[i][k];
+            t->pk[i] = (int16_t) l->pk[i][k];
+            t->sr[i] = (int16_t) l->sr[i][k];
+        }
+        for (i = 0;  i < 6;  i++)
+        {
+            t->b[i] = (int16_t) l->b[i][k];
+            t->dq[i] = (int16_t) l->dq[i][k];
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Truncate to 16 bits, as the scalar code does when it stores into an int16_t */
+static __inline__ __attribute__((target("avx2"))) __m256i wrap16_avx2(__m256i x)
+{
+    return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* top_bit() for values up to 2^24, through the exponent of a float. Zero gives -1. */
+static __inline__ __attribute__((target("avx2"))) __m256i top_bit_avx2(__m256i x)
+{
+    __m256i e;
+
+    e = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(x)), 23);
+    return _mm256_max_epi32(_mm256_sub_epi32(e, _mm256_set1_epi32(127)), _mm256_set1_epi32(-1));
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The 4-bit exponent, 6-bit mantissa form of a non-zero magnitude, used by FLOAT A
+   and FLOAT B */
+static __inline__ __attribute__((target("avx2"))) __m256i to_float_avx2(__m256i mag)
+{
+    __m256i exp;
+
+    exp = _mm256_add_epi32(top_bit_avx2(mag), _mm256_set1_epi32(1));
+    return _mm256_add_epi32(_mm256_slli_epi32(exp, 6), _mm256_srlv_epi32(_mm256_slli_epi32(mag, 6), exp));
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ __attribute__((target("avx2"))) __m256i fmult_avx2(__m256i an, __m256i srn)
+{
+    __m256i anmag;
+    __m256i tb;
+    __m256i anmant;
+    __m256i wanexp;
+    __m256i wanmant;
+    __m256i retval;
+    __m256i sign;
+
+    anmag = _mm256_blendv_epi8(_mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), an), _mm256_set1_epi32(0x1FFF)),
+                               an,
+                               _mm256_cmpgt_epi32(an, _mm256_setzero_si256()));
+    /* anexp is top_bit(anmag) - 5, so shifting anmag up by 5 lets one right shift
+       normalise the mantissa, whichever way anexp goes. */
+    tb = top_bit_avx2(anmag);
+    anmant = _mm256_srlv_epi32(_mm256_slli_epi32(anmag, 5), tb);
+    anmant = _mm256_or_si256(anmant, _mm256_and_si256(_mm256_cmpeq_epi32(anmag, _mm256_setzero_si256()), _mm256_set1_epi32(32)));
+    wanexp = _mm256_add_epi32(tb, _mm256_and_si256(_mm256_srai_epi32(srn, 6), _mm256_set1_epi32(0xF)));
+    wanexp = _mm256_sub_epi32(wanexp, _mm256_set1_epi32(18));
+    wanmant = _mm256_mullo_epi16(anmant, _mm256_and_si256(srn, _mm256_set1_epi32(0x3F)));
+    wanmant = _mm256_srli_epi32(_mm256_add_epi32(wanmant, _mm256_set1_epi32(0x30)), 4);
+    /* Out of range shift counts give zero, so only one of these contributes */
+    retval = _mm256_or_si256(_mm256_and_si256(_mm256_sllv_epi32(wanmant, wanexp), _mm256_set1_epi32(0x7FFF)),
+                             _mm256_srlv_epi32(wanmant, _mm256_sub_epi32(_mm256_setzero_si256(), wanexp)));
+    sign = _mm256_srai_epi32(_mm256_xor_si256(an, srn), 31);
+    return _mm256_sub_epi32(_mm256_xor_si256(retval, sign), sign);
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Run a group of channels in lockstep. This follows the single channel encoder and
+   decoder step for step. When encoding, x holds the 14-bit input samples and the
+   codes are written to code. When decoding, x is NULL, the codes are read from code,
+   and the reconstructed signal, the signal estimate and the step size are written
+   out, for the final conversion of each channel's output. All the buffers hold
+   G726_LANES values per sample. */
+static __attribute__((target("avx2"))) void lanes_avx2(g726_lanes_t *l,
+                                                       const g726_params_t *p,
+                                                       int bits,
+                                                       int32_t code[],
+                                                       const int32_t x[],
+                                                       int32_t sr_out[],
+                                                       int32_t se_out[],
+                                                       int32_t y_out[],
+                                                       int len)
+{
+    __m256i zero;
+    __m256i one;
+    __m256i yl;
+    __m256i yu;
+    __m256i dms;
+    __m256i dml;
+    __m256i ap;
+    __m256i a[2];
+    __m256i b[6];
+    __m256i pk[2];
+    __m256i dq[6];
+    __m256i sr[2];
+    __m256i td;
+    __m256i sezi;
+    __m256i sei;
+    __m256i se;
+    __m256i y;
+    __m256i t;
+    __m256i d;
+    __m256i c;
+    __m256i i;
+    __m256i neg;
+    __m256i dql;
+    __m256i dqm;
+    __m256i sgn;
+    __m256i dqv;
+    __m256i srv;
+    __m256i dqsez;
+    __m256i wi;
+    __m256i fi;
+    __m256i pk0;
+    __m256i pks1;
+    __m256i mag;
+    __m256i magnz;
+    __m256i ylint;
+    __m256i thr;
+    __m256i tr;
+    __m256i dqnz;
+    __m256i a2p;
+    __m256i a2pn;
+    __m256i a0;
+    __m256i a1ul;
+    __m256i fast;
+    int size;
+    int j;
+    int k;
+
+    zero = _mm256_setzero_si256();
+    one = _mm256_set1_epi32(1);
+    yl = _mm256_loadu_si256((const __m256i *) l->yl);
+    yu = _mm256_loadu_si256((const __m256i *) l->yu);
+    dms = _mm256_loadu_si256((const __m256i *) l->dms);
+    dml = _mm256_loadu_si256((const __m256i *) l->dml);
+    ap = _mm256_loadu_si256((const __m256i *) l->ap);
+    td = _mm256_loadu_si256((const __m256i *) l->td);
+    for (k = 0;  k < 2;  k++)
+    {
+        a[k] = _mm256_loadu_si256((const __m256i *) l->a[k]);
+        pk[k] = _mm256_loadu_si256((const __m256i *) l->pk[k]);
+        sr[k] = _mm256_loadu_si256((const __m256i *) l->sr[k]);
+    }
+    for (k = 0;  k < 6;  k++)
+    {
+        b[k] = _mm256_loadu_si256((const __m256i *) l->b[k]);
+        dq[k] = _mm256_loadu_si256((const __m256i *) l->dq[k]);
+    }
+    size = (p->quantizer_states - 1) >> 1;
+
+    for (j = 0;  j < len;  j++)
+    {
+        /* The zero and pole predictors */
+        sezi = fmult_avx2(_mm256_srai_epi32(b[0], 2), dq[0]);
+        for (k = 1;  k < 6;  k++)
+            sezi = _mm256_add_epi32(sezi, fmult_avx2(_mm256_srai_epi32(b[k], 2), dq[k]));
+        sezi = wrap16_avx2(sezi);
+        t = wrap16_avx2(_mm256_add_epi32(fmult_avx2(_mm256_srai_epi32(a[1], 2), sr[1]),
+                                         fmult_avx2(_mm256_srai_epi32(a[0], 2), sr[0])));
+        sei = wrap16_avx2(_mm256_add_epi32(sezi, t));
+        se = _mm256_srai_epi32(sei, 1);
+
+        /* The quantizer step size */
+        y = _mm256_srai_epi32(yl, 6);
+        d = _mm256_sub_epi32(yu, y);
+        t = _mm256_mullo_epi32(d, _mm256_srai_epi32(ap, 2));
+        t = _mm256_add_epi32(t, _mm256_and_si256(_mm256_cmpgt_epi32(zero, d), _mm256_set1_epi32(0x3F)));
+        y = _mm256_add_epi32(y, _mm256_srai_epi32(t, 6));
+        y = _mm256_blendv_epi8(y, yu, _mm256_cmpgt_epi32(ap, _mm256_set1_epi32(255)));
+
+        if (x)
+        {
+            /* Quantize the prediction difference */
+            d = wrap16_avx2(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) &x[j*G726_LANES]), se));
+            dqm = _mm256_abs_epi32(d);
+            t = _mm256_add_epi32(top_bit_avx2(_mm256_srai_epi32(dqm, 1)), one);
+            dql = _mm256_and_si256(_mm256_srlv_epi32(_mm256_slli_epi32(dqm, 7), t), _mm256_set1_epi32(0x7F));
+            dql = _mm256_sub_epi32(_mm256_add_epi32(_mm256_slli_epi32(t, 7), dql), _mm256_srai_epi32(y, 2));
+            i = zero;
+            for (k = 0;  k < size;  k++)
+                i = _mm256_sub_epi32(i, _mm256_cmpgt_epi32(dql, _mm256_set1_epi32(p->qtab[k] - 1)));
+            neg = _mm256_cmpgt_epi32(zero, d);
+            c = _mm256_blendv_epi8(i, _mm256_sub_epi32(_mm256_set1_epi32((size << 1) + 1), i), neg);
+            if ((p->quantizer_states & 1))
+                c = _mm256_blendv_epi8(c, _mm256_set1_epi32(p->quantizer_states), _mm256_andnot_si256(neg, _mm256_cmpeq_epi32(i, zero)));
+            _mm256_storeu_si256((__m256i *) &code[j*G726_LANES], c);
+        }
+        else
+        {
+            c = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &code[j*G726_LANES]), _mm256_set1_epi32((1 << bits) - 1));
+        }
+
+        /* Reconstruct the quantized difference, and the signal */
+        dql = _mm256_add_epi32(_mm256_i32gather_epi32(p->dqlntab, c, 4), _mm256_srai_epi32(y, 2));
+        t = _mm256_and_si256(_mm256_srai_epi32(dql, 7), _mm256_set1_epi32(15));
+        dqm = _mm256_add_epi32(_mm256_and_si256(dql, _mm256_set1_epi32(127)), _mm256_set1_epi32(128));
+        dqm = _mm256_srlv_epi32(_mm256_slli_epi32(dqm, 7), _mm256_sub_epi32(_mm256_set1_epi32(14), t));
+        dqm = _mm256_andnot_si256(_mm256_cmpgt_epi32(zero, dql), dqm);
+        sgn = _mm256_cmpeq_epi32(_mm256_and_si256(c, _mm256_set1_epi32(p->sign)), _mm256_set1_epi32(p->sign));
+        dqv = _mm256_sub_epi32(dqm, _mm256_and_si256(sgn, _mm256_set1_epi32(0x8000)));
+        srv = _mm256_blendv_epi8(_mm256_add_epi32(se, dqv),
+                                 _mm256_sub_epi32(se, _mm256_and_si256(dqv, _mm256_set1_epi32(p->dq_mask))),
+                                 sgn);
+        srv = wrap16_avx2(srv);
+        dqsez = wrap16_avx2(_mm256_sub_epi32(_mm256_add_epi32(srv, _mm256_srai_epi32(sezi, 1)), se));
+        if (x == NULL)
+        {
+            _mm256_storeu_si256((__m256i *) &sr_out[j*G726_LANES], srv);
+            _mm256_storeu_si256((__m256i *) &se_out[j*G726_LANES], se);
+            _mm256_storeu_si256((__m256i *) &y_out[j*G726_LANES], y);
+        }
+        wi = _mm256_i32gather_epi32(p->witab, c, 4);
+        fi = _mm256_i32gather_epi32(p->fitab, c, 4);
+
+        /* Update the state, as update() does */
+        pk0 = _mm256_srli_epi32(dqsez, 31);
+        mag = _mm256_and_si256(dqv, _mm256_set1_epi32(0x7FFF));
+        magnz = _mm256_xor_si256(_mm256_cmpeq_epi32(mag, zero), _mm256_set1_epi32(-1));
+        ylint = _mm256_srai_epi32(yl, 15);
+        thr = _mm256_sllv_epi32(_mm256_add_epi32(_mm256_and_si256(_mm256_srai_epi32(yl, 10), _mm256_set1_epi32(0x1F)), _mm256_set1_epi32(32)), ylint);
+        thr = _mm256_blendv_epi8(thr, _mm256_set1_epi32(31 << 10), _mm256_cmpgt_epi32(ylint, _mm256_set1_epi32(9)));
+        thr = _mm256_srai_epi32(_mm256_add_epi32(thr, _mm256_srai_epi32(thr, 1)), 1);
+        tr = _mm256_and_si256(_mm256_cmpgt_epi32(td, zero), _mm256_cmpgt_epi32(mag, thr));
+
+        yu = _mm256_add_epi32(y, _mm256_srai_epi32(_mm256_sub_epi32(wi, y), 5));
+        yu = _mm256_min_epi32(_mm256_max_epi32(yu, _mm256_set1_epi32(544)), _mm256_set1_epi32(5120));
+        yl = _mm256_add_epi32(yl, _mm256_add_epi32(yu, _mm256_srai_epi32(_mm256_sub_epi32(zero, yl), 6)));
+
+        /* UPA2 */
+        pks1 = _mm256_xor_si256(pk0, pk[0]);
+        dqnz = _mm256_xor_si256(_mm256_cmpeq_epi32(dqsez, zero), _mm256_set1_epi32(-1));
+        a2p = _mm256_sub_epi32(a[1], _mm256_srai_epi32(a[1], 7));
+        /* fa1 is a[0], negated when pks1 is zero. Its contribution is clipped to
+           -256 to 255, which is the same as the limits on fa1 itself. */
+        t = _mm256_cmpeq_epi32(pks1, zero);
+        t = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_xor_si256(a[0], t), t), 5);
+        t = _mm256_min_epi32(_mm256_max_epi32(t, _mm256_set1_epi32(-256)), _mm256_set1_epi32(255));
+        /* LIMC reduces to a symmetric clip, after the +/-0x80 step */
+        t = _mm256_add_epi32(t, _mm256_sub_epi32(_mm256_set1_epi32(0x80), _mm256_slli_epi32(_mm256_xor_si256(pk0, pk[1]), 8)));
+        a2pn = _mm256_add_epi32(a2p, t);
+        a2pn = _mm256_min_epi32(_mm256_max_epi32(a2pn, _mm256_set1_epi32(-12288)), _mm256_set1_epi32(12288));
+        a2p = _mm256_blendv_epi8(a2p, a2pn, dqnz);
+
+        /* UPA1 */
+        a0 = _mm256_sub_epi32(a[0], _mm256_srai_epi32(a[0], 8));
+        t = _mm256_blendv_epi8(_mm256_set1_epi32(-192), _mm256_set1_epi32(192), _mm256_cmpeq_epi32(pks1, zero));
+        a0 = _mm256_add_epi32(a0, _mm256_and_si256(t, dqnz));
+        a1ul = _mm256_sub_epi32(_mm256_set1_epi32(15360), a2p);
+        a0 = _mm256_min_epi32(_mm256_max_epi32(a0, _mm256_sub_epi32(zero, a1ul)), a1ul);
+        a[0] = _mm256_andnot_si256(tr, a0);
+        a[1] = _mm256_andnot_si256(tr, a2p);
+
+        /* UPB */
+        for (k = 0;  k < 6;  k++)
+        {
+            t = _mm256_srai_epi32(_mm256_xor_si256(dqv, dq[k]), 31);
+            t = _mm256_sub_epi32(_mm256_xor_si256(_mm256_set1_epi32(128), t), t);
+            t = _mm256_add_epi32(_mm256_sub_epi32(b[k], _mm256_srai_epi32(b[k], p->b_leak)), _mm256_and_si256(t, magnz));
+            b[k] = _mm256_andnot_si256(tr, wrap16_avx2(t));
+        }
+        for (k = 5;  k > 0;  k--)
+            dq[k] = dq[k - 1];
+        /* FLOAT A */
+        t = _mm256_or_si256(to_float_avx2(mag), _mm256_andnot_si256(magnz, _mm256_set1_epi32(0x20)));
+        dq[0] = _mm256_sub_epi32(t, _mm256_and_si256(sgn, _mm256_set1_epi32(0x400)));
+        /* FLOAT B */
+        sr[1] = sr[0];
+        d = _mm256_abs_epi32(srv);
+        t = _mm256_or_si256(to_float_avx2(d), _mm256_and_si256(_mm256_cmpeq_epi32(d, zero), _mm256_set1_epi32(0x20)));
+        t = _mm256_sub_epi32(t, _mm256_and_si256(_mm256_cmpgt_epi32(zero, srv), _mm256_set1_epi32(0x400)));
+        sr[0] = _mm256_blendv_epi8(t, _mm256_set1_epi32(-992), _mm256_cmpeq_epi32(srv, _mm256_set1_epi32(-32768)));
+        /* DELAY A */
+        pk[1] = pk[0];
+        pk[0] = pk0;
+        /* TONE */
+        td = _mm256_andnot_si256(tr, _mm256_cmpgt_epi32(_mm256_set1_epi32(-11776), a2p));
+
+        /* Adaptation speed control */
+        dms = _mm256_add_epi32(dms, _mm256_srai_epi32(_mm256_sub_epi32(fi, dms), 5));
+        dml = _mm256_add_epi32(dml, _mm256_srai_epi32(_mm256_sub_epi32(_mm256_slli_epi32(fi, 2), dml), 7));
+        t = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_slli_epi32(dms, 2), dml));
+        fast = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(1536), y), td);
+        fast = _mm256_or_si256(fast, _mm256_xor_si256(_mm256_cmpgt_epi32(_mm256_srai_epi32(dml, 3), t), _mm256_set1_epi32(-1)));
+        ap = _mm256_blendv_epi8(_mm256_add_epi32(ap, _mm256_srai_epi32(_mm256_sub_epi32(zero, ap), 4)),
+                                _mm256_add_epi32(ap, _mm256_srai_epi32(_mm256_sub_epi32(_mm256_set1_epi32(0x200), ap), 4)),
+                                fast);
+        ap = _mm256_blendv_epi8(ap, _mm256_set1_epi32(256), tr);
+        td = _mm256_and_si256(td, one);
+    }
+
+    _mm256_storeu_si256((__m256i *) l->yl, yl);
+    _mm256_storeu_si256((__m256i *) l->yu, yu);
+    _mm256_storeu_si256((__m256i *) l->dms, dms);
+    _mm256_storeu_si256((__m256i *) l->dml, dml);
+    _mm256_storeu_si256((__m256i *) l->ap, ap);
+    _mm256_storeu_si256((__m256i *) l->td, td);
+    for (k = 0;  k < 2;  k++)
+    {
+        _mm256_storeu_si256((__m256i *) l->a[k], a[k]);
+        _mm256_storeu_si256((__m256i *) l->pk[k], pk[k]);
+        _mm256_storeu_si256((__m256i *) l->sr[k], sr[k]);
+    }
+    for (k = 0;  k < 6;  k++)
+    {
+        _mm256_storeu_si256((__m256i *) l->b[k], b[k]);
+        _mm256_storeu_si256((__m256i *) l->dq[k], dq[k]);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_lanes(g726_state_t *s[], uint8_t *g726_data[], const int16_t *amp[], int n, int len)
+{
+    g726_lanes_t lanes;
+    int32_t x[G726_CHUNK*G726_LANES];
+    int32_t code[G726_CHUNK*G726_LANES];
+    int g726_bytes[G726_LANES];
+    int i;
+    int j;
+    int k;
+    int chunk;
+
+    load_lanes(&lanes, s, n);
+    memset(x, 0, sizeof(x));
+    for (k = 0;  k < n;  k++)
+        g726_bytes[k] = 0;
+    for (i = 0;  i < len;  i += chunk)
+    {
+        chunk = (len - i < G726_CHUNK)  ?  (len - i)  :  G726_CHUNK;
+        for (k = 0;  k < n;  k++)
+        {
+            for (j = 0;  j < chunk;  j++)
+                x[j*G726_LANES + k] = linearize(s[k], amp[k], i + j);
+        }
+        lanes_avx2(&lanes, &g726_params[s[0]->bits_per_sample - 2], s[0]->bits_per_sample, code, x, NULL, NULL, NULL, chunk);
+        for (k = 0;  k < n;  k++)
+        {
+            for (j = 0;  j < chunk;  j++)
+                g726_bytes[k] = pack_code(s[k], g726_data[k], g726_bytes[k], (uint8_t) code[j*G726_LANES + k]);
+        }
+    }
+    save_lanes(s, n, &lanes);
+    return g726_bytes[0];
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_lanes(g726_state_t *s[], int16_t *amp[], const uint8_t *g726_data[], int n, int g726_bytes)
+{
+    g726_lanes_t lanes;
+    const g726_params_t *p;
+    int32_t code[G726_CHUNK*G726_LANES];
+    int32_t sr[G726_CHUNK*G726_LANES];
+    int32_t se[G726_CHUNK*G726_LANES];
+    int32_t y[G726_CHUNK*G726_LANES];
+    int pos[G726_LANES];
+    int samples;
+    int chunk;
+    int c;
+    int i;
+    int j;
+    int k;
+
+    p = &g726_params[s[0]->bits_per_sample - 2];
+    load_lanes(&lanes, s, n);
+    memset(code, 0, sizeof(code));
+    for (k = 0;  k < n;  k++)
+        pos[k] = 0;
+    for (samples = 0;  ;  samples += chunk)
+    {
+        /* The channels are in step, so they all unpack the same number of codes */
+        for (k = 0;  k < n;  k++)
+        {
+            for (j = 0;  j < G726_CHUNK;  j++)
             {
-                s->bs.bitstream |= (code << s->bs.residue);
-                s->bs.residue += s->bits_per_sample;
-                if (s->bs.residue >= 8)
-                {
-                    g726_data[g726_bytes++] = (uint8_t) (s->bs.bitstream & 0xFF);
-                    s->bs.bitstream >>= 8;
-                    s->bs.residue -= 8;
-                }
+                if ((c = unpack_code(s[k], g726_data[k], &pos[k], g726_bytes)) < 0)
+                    break;
+                code[j*G726_LANES + k] = c;
             }
-            else
+            chunk = j;
+        }
+        if (chunk == 0)
+            break;
+        lanes_avx2(&lanes, p, s[0]->bits_per_sample, code, NULL, sr, se, y, chunk);
+        for (k = 0;  k < n;  k++)
+        {
+            for (j = 0;  j < chunk;  j++)
             {
-                s->bs.bitstream = (s->bs.bitstream << s->bits_per_sample) | code;
-                s->bs.residue += s->bits_per_sample;
-                if (s->bs.residue >= 8)
+                i = j*G726_LANES + k;
+                switch (s[k]->ext_coding)
                 {
-                    g726_data[g726_bytes++] = (uint8_t) ((s->bs.bitstream >> (s->bs.residue - 8)) & 0xFF);
-                    s->bs.residue -= 8;
+                case G726_ENCODING_ALAW:
+                    ((uint8_t *) amp[k])[samples + j] = (uint8_t) tandem_adjust_alaw((int16_t) sr[i], se[i], y[i], code[i] & ((1 << s[k]->bits_per_sample) - 1), p->sign, p->qtab, p->quantizer_states);
+                    break;
+                case G726_ENCODING_ULAW:
+                    ((uint8_t *) amp[k])[samples + j] = (uint8_t) tandem_adjust_ulaw((int16_t) sr[i], se[i], y[i], code[i] & ((1 << s[k]->bits_per_sample) - 1), p->sign, p->qtab, p->quantizer_states);
+                    break;
+                default:
+                    amp[k][samples + j] = (int16_t) (sr[i] << 2);
+                    break;
                 }
             }
         }
-        else
-        {
-            g726_data[g726_bytes++] = (uint8_t) code;
-        }
     }
+    save_lanes(s, n, &lanes);
+    return samples;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE(int) g726_decode_multi(g726_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g726_data[],
+                                    int channels,
+                                    int g726_bytes)
+{
+    int samples;
+    int i;
+
+    if (!channels_in_step(s, channels))
+        return -1;
+    samples = 0;
+#if defined(G726_WITH_AVX2)
+    if (g726_get_implementation() == G726_IMPLEMENTATION_AVX2)
+    {
+        for (i = 0;  i < channels;  i += G726_LANES)
+            samples = decode_lanes(&s[i], &amp[i], &g726_data[i], (channels - i < G726_LANES)  ?  (channels - i)  :  G726_LANES, g726_bytes);
+        return samples;
+    }
+#endif
+    for (i = 0;  i < channels;  i++)
+        samples = g726_decode(s[i], amp[i], g726_data[i], g726_bytes);
+    return samples;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) g726_encode_multi(g726_state_t *s[],
+                                    uint8_t *g726_data[],
+                                    const int16_t *amp[],
+                                    int channels,
+                                    int len)
+{
+    int g726_bytes;
+    int i;
+
+    if (!channels_in_step(s, channels))
+        return -1;
+    g726_bytes = 0;
+#if defined(G726_WITH_AVX2)
+    if (g726_get_implementation() == G726_IMPLEMENTATION_AVX2)
+    {
+        for (i = 0;  i < channels;  i += G726_LANES)
+            g726_bytes = encode_lanes(&s[i], &g726_data[i], &amp[i], (channels - i < G726_LANES)  ?  (channels - i)  :  G726_LANES, len);
+        return g726_bytes;
+    }
+#endif
+    for (i = 0;  i < channels;  i++)
+        g726_bytes = g726_encode(s[i], g726_data[i], amp[i], len);
     return g726_bytes;
 }
 /*- End of function --------------------------------------------------------*/
@@ -45,11 +45,13 @@
 #include <memory.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/bitstream.h"
 #include "spandsp/saturated.h"
 #include "spandsp/gsm0610.h"
 
+#include "mmx_sse_decs.h"
 #include "gsm0610_local.h"
 
 /* 4.2 FIXED POINT IMPLEMENTATION OF THE RPE-LTP CODER */
@@ -104,6 +106,59 @@ static void encode_a_frame(gsm0610_state_t *s, gsm0610_frame_t *f, const int16_t
 }
 /*- End of function --------------------------------------------------------*/
 
+static int gsm0610_implementation = GSM0610_IMPLEMENTATION_AUTO;
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case GSM0610_IMPLEMENTATION_GENERIC:
+        return TRUE;
+#if defined(GSM0610_WITH_SSE2)
+    case GSM0610_IMPLEMENTATION_SSE2:
+        return has_SSE2();
+#endif
+#if defined(GSM0610_WITH_AVX2)
+    case GSM0610_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    /*endswitch*/
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) gsm0610_set_implementation(int implementation)
+{
+    if (implementation == GSM0610_IMPLEMENTATION_AUTO)
+    {
+        if (implementation_available(GSM0610_IMPLEMENTATION_AVX2))
+            implementation = GSM0610_IMPLEMENTATION_AVX2;
+        else if (implementation_available(GSM0610_IMPLEMENTATION_SSE2))
+            implementation = GSM0610_IMPLEMENTATION_SSE2;
+        else
+            implementation = GSM0610_IMPLEMENTATION_GENERIC;
+        /*endif*/
+    }
+    else if (!implementation_available(implementation))
+    {
+        return -1;
+    }
+    /*endif*/
+    gsm0610_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) gsm0610_get_implementation(void)
+{
+    if (gsm0610_implementation == GSM0610_IMPLEMENTATION_AUTO)
+        gsm0610_set_implementation(GSM0610_IMPLEMENTATION_AUTO);
+    /*endif*/
+    return gsm0610_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) gsm0610_set_packing(gsm0610_state_t *s, int packing)
 {
     s->packing = packing;
@@ -115,7 +170,7 @@ SPAN_DECLARE(gsm0610_state_t *) gsm0610_init(gsm0610_state_t *s, int packing)
 {
     if (s == NULL)
     {
-        if ((s = (gsm0610_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (gsm0610_state_t *) span_alloc(sizeof (*s))) == NULL)
             return  NULL;
         /*endif*/
     }
@@ -136,7 +191,7 @@ SPAN_DECLARE(int) gsm0610_release(gsm0610_state_t *s)
 SPAN_DECLARE(int) gsm0610_free(gsm0610_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     /*endif*/
     return 0;
 }
@@ -35,6 +35,13 @@
 
 #include "spandsp/private/gsm0610.h"
 
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define GSM0610_WITH_SSE2
+#define GSM0610_WITH_AVX2
+#endif
+#endif
+
 static __inline__ int16_t gsm_add(int16_t a, int16_t b)
 {
 #if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
@@ -51,6 +51,10 @@
 
 #include "gsm0610_local.h"
 
+#if defined(GSM0610_WITH_SSE2)  ||  defined(GSM0610_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
 /* Table 4.3a  Decision level of the LTP gain quantizer */
 static const int16_t gsm_DLB[4] =
 {
@@ -65,7 +69,7 @@ static const int16_t gsm_QLB[4] =
 
 /* 4.2.11 .. 4.2.12 LONG TERM PREDICTOR (LTP) SECTION */
 
-static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int16_t *index_out)
+static int32_t max_cross_corr_generic(const int16_t *wt, const int16_t *dp, int16_t *index_out)
 {
     int32_t max;
     int32_t index;
@@ -77,109 +81,6 @@ static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int1
 
     for (i = 40;  i <= 120;  i++)
     {
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__x86_64__)
-        __asm__ __volatile__(
-            " emms;\n"
-            " .p2align 2;\n"
-            " movq (%%rdi),%%mm0;\n"
-            " movq (%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm0;\n"
-            " movq 8(%%rdi),%%mm1;\n"
-            " movq 8(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 16(%%rdi),%%mm1;\n"
-            " movq 16(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 24(%%rdi),%%mm1;\n"
-            " movq 24(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 32(%%rdi),%%mm1;\n"
-            " movq 32(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 40(%%rdi),%%mm1;\n"
-            " movq 40(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 48(%%rdi),%%mm1;\n"
-            " movq 48(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 56(%%rdi),%%mm1;\n"
-            " movq 56(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 64(%%rdi),%%mm1;\n"
-            " movq 64(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 72(%%rdi),%%mm1;\n"
-            " movq 72(%%rsi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq %%mm0,%%mm1;\n"
-            " punpckhdq %%mm0,%%mm1;\n"         /* mm1 has high int32 of mm0 dup'd */
-            " paddd %%mm1,%%mm0;\n"
-            " movd %%mm0,%[res];\n"
-            " emms;\n"
-            : [res] "=r" (res)
-            : "D" (wt), "S" (&dp[-i])
-        );
-#elif defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__i386__)
-        __asm__ __volatile__(
-            " emms;\n"
-            " .p2align 2;\n"
-            " movq (%%edi),%%mm0;\n"
-            " movq (%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm0;\n"
-            " movq 8(%%edi),%%mm1;\n"
-            " movq 8(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 16(%%edi),%%mm1;\n"
-            " movq 16(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 24(%%edi),%%mm1;\n"
-            " movq 24(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 32(%%edi),%%mm1;\n"
-            " movq 32(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 40(%%edi),%%mm1;\n"
-            " movq 40(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 48(%%edi),%%mm1;\n"
-            " movq 48(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 56(%%edi),%%mm1;\n"
-            " movq 56(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 64(%%edi),%%mm1;\n"
-            " movq 64(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq 72(%%edi),%%mm1;\n"
-            " movq 72(%%esi),%%mm2;\n"
-            " pmaddwd %%mm2,%%mm1;\n"
-            " paddd %%mm1,%%mm0;\n"
-            " movq %%mm0,%%mm1;\n"
-            " punpckhdq %%mm0,%%mm1;\n"         /* mm1 has high int32 of mm0 dup'd */
-            " paddd %%mm1,%%mm0;\n"
-            " movd %%mm0,%[res];\n"
-            " emms;\n"
-            : [res] "=r" (res)
-            : "D" (wt), "S" (&dp[-i])
-        );
-#else
         res  = (wt[0]*dp[0 - i])
              + (wt[1]*dp[1 - i])
              + (wt[2]*dp[2 - i])
@@ -220,7 +121,6 @@ static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int1
              + (wt[37]*dp[37 - i])
              + (wt[38]*dp[38 - i])
              + (wt[39]*dp[39 - i]);
-#endif
         if (res > max)
         {
             max = res;
@@ -234,6 +134,145 @@ static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int1
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(GSM0610_WITH_SSE2)  ||  defined(GSM0610_WITH_AVX2)
+/* Find the first lag with the greatest cross-correlation, exactly as the generic code does. */
+static int32_t pick_max_cross_corr(const int32_t res[81], int16_t *index_out)
+{
+    int32_t max;
+    int32_t index;
+    int i;
+
+    max = 0;
+    index = 40;
+    for (i = 0;  i <= 80;  i++)
+    {
+        if (res[i] > max)
+        {
+            max = res[i];
+            index = i + 40;
+        }
+        /*endif*/
+    }
+    /*endfor*/
+    *index_out = index;
+    return max;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Add up the 4 partial sums in each of 4 vectors, giving the 4 totals in one vector. */
+__attribute__((target("sse2"))) static __inline__ __m128i sum4_i32_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i ab;
+    __m128i cd;
+
+    ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+    return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(GSM0610_WITH_SSE2)
+__attribute__((target("sse2"))) static __inline__ __m128i cross_corr_sse2(const __m128i w[5], const int16_t *dp)
+{
+    __m128i acc;
+
+    acc = _mm_madd_epi16(w[0], _mm_loadu_si128((const __m128i *) &dp[0]));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(w[1], _mm_loadu_si128((const __m128i *) &dp[8])));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(w[2], _mm_loadu_si128((const __m128i *) &dp[16])));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(w[3], _mm_loadu_si128((const __m128i *) &dp[24])));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(w[4], _mm_loadu_si128((const __m128i *) &dp[32])));
+    return acc;
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse2"))) static int32_t max_cross_corr_sse2(const int16_t *wt, const int16_t *dp, int16_t *index_out)
+{
+    int32_t res[81] __attribute__((aligned(16)));
+    __m128i w[5];
+    __m128i sum;
+    int i;
+
+    for (i = 0;  i < 5;  i++)
+        w[i] = _mm_loadu_si128((const __m128i *) &wt[8*i]);
+    /*endfor*/
+    for (i = 40;  i < 120;  i += 4)
+    {
+        sum = sum4_i32_sse2(cross_corr_sse2(w, &dp[-i]),
+                            cross_corr_sse2(w, &dp[-i - 1]),
+                            cross_corr_sse2(w, &dp[-i - 2]),
+                            cross_corr_sse2(w, &dp[-i - 3]));
+        _mm_store_si128((__m128i *) &res[i - 40], sum);
+    }
+    /*endfor*/
+    sum = cross_corr_sse2(w, &dp[-120]);
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    res[80] = _mm_cvtsi128_si32(sum);
+    return pick_max_cross_corr(res, index_out);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(GSM0610_WITH_AVX2)
+__attribute__((target("avx2"))) static __inline__ __m128i cross_corr_avx2(const __m256i w[2], __m128i w32, const int16_t *dp)
+{
+    __m256i acc;
+
+    acc = _mm256_madd_epi16(w[0], _mm256_loadu_si256((const __m256i *) &dp[0]));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(w[1], _mm256_loadu_si256((const __m256i *) &dp[16])));
+    return _mm_add_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)),
+                         _mm_madd_epi16(w32, _mm_loadu_si128((const __m128i *) &dp[32])));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("avx2"))) static int32_t max_cross_corr_avx2(const int16_t *wt, const int16_t *dp, int16_t *index_out)
+{
+    int32_t res[81] __attribute__((aligned(16)));
+    __m256i w[2];
+    __m128i w32;
+    __m128i sum;
+    int i;
+
+    w[0] = _mm256_loadu_si256((const __m256i *) &wt[0]);
+    w[1] = _mm256_loadu_si256((const __m256i *) &wt[16]);
+    w32 = _mm_loadu_si128((const __m128i *) &wt[32]);
+    for (i = 40;  i < 120;  i += 4)
+    {
+        sum = sum4_i32_sse2(cross_corr_avx2(w, w32, &dp[-i]),
+                            cross_corr_avx2(w, w32, &dp[-i - 1]),
+                            cross_corr_avx2(w, w32, &dp[-i - 2]),
+                            cross_corr_avx2(w, w32, &dp[-i - 3]));
+        _mm_store_si128((__m128i *) &res[i - 40], sum);
+    }
+    /*endfor*/
+    sum = cross_corr_avx2(w, w32, &dp[-120]);
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    res[80] = _mm_cvtsi128_si32(sum);
+    return pick_max_cross_corr(res, index_out);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static int32_t gsm0610_max_cross_corr(const int16_t *wt, const int16_t *dp, int16_t *index_out)
+{
+    switch (gsm0610_get_implementation())
+    {
+#if defined(GSM0610_WITH_AVX2)
+    case GSM0610_IMPLEMENTATION_AVX2:
+        return max_cross_corr_avx2(wt, dp, index_out);
+#endif
+#if defined(GSM0610_WITH_SSE2)
+    case GSM0610_IMPLEMENTATION_SSE2:
+        return max_cross_corr_sse2(wt, dp, index_out);
+#endif
+    }
+    /*endswitch*/
+    return max_cross_corr_generic(wt, dp, index_out);
+}
+/*- End of function --------------------------------------------------------*/
+
 /* This procedure computes the LTP gain (bc) and the LTP lag (Nc)
    for the long term analysis filter.   This is done by calculating a
    maximum of the cross-correlation function between the current
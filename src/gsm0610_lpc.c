@@ -49,11 +49,14 @@
 #include "spandsp/bitstream.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/saturated.h"
-#include "spandsp/vector_int.h"
 #include "spandsp/gsm0610.h"
 
 #include "gsm0610_local.h"
 
+#if defined(GSM0610_WITH_SSE2)  ||  defined(GSM0610_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
 /* 4.2.4 .. 4.2.7 LPC ANALYSIS SECTION */
 
 /* The number of left shifts needed to normalize the 32 bit
@@ -132,166 +135,34 @@ static int16_t gsm_div(int16_t num, int16_t denom)
 }
 /*- End of function --------------------------------------------------------*/
 
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)
-static void gsm0610_vec_vsraw(const int16_t *p, int n, int bits)
+/* Computation of the scaling factor for the autocorrelation, from the maximum
+   magnitude of the signal. */
+static __inline__ int16_t scaling_factor(int16_t smax)
 {
-    static const int64_t ones = 0x0001000100010001LL;
-
-    if (n == 0)
-        return;
+    if (smax == 0)
+        return 0;
     /*endif*/
-#if defined(__x86_64__)
-    __asm__ __volatile__(
-        " leaq -16(%%rsi,%%rax,2),%%rdx;\n"         /* edx = top - 16 */
-        " emms;\n"
-        " movd %%ecx,%%mm3;\n"
-        " movq %[ones],%%mm2;\n"
-        " psllw %%mm3,%%mm2;\n"
-        " psrlw $1,%%mm2;\n"
-        " cmpq %%rdx,%%rsi;"
-        " ja 4f;\n"
-
-         " .p2align 2;\n"
-        /* 8 words per iteration */
-        "6:\n"
-        " movq (%%rsi),%%mm0;\n"
-        " movq 8(%%rsi),%%mm1;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " paddsw %%mm2,%%mm1;\n"
-        " psraw %%mm3,%%mm1;\n"
-        " movq %%mm0,(%%rsi);\n"
-        " movq %%mm1,8(%%rsi);\n"
-        " addq $16,%%rsi;\n"
-        " cmpq %%rdx,%%rsi;\n"
-        " jbe 6b;\n"
-
-        " .p2align 2;\n"
-        "4:\n"
-        " addq $12,%%rdx;\n"                        /* now edx = top-4 */
-        " cmpq %%rdx,%%rsi;\n"
-        " ja 3f;\n"
-
-        " .p2align 2;\n"
-        /* do up to 6 words, two per iteration */
-        "5:\n"
-        " movd (%%rsi),%%mm0;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " movd %%mm0,(%%rsi);\n"
-        " addq $4,%%rsi;\n"
-        " cmpq %%rdx,%%rsi;\n"
-        " jbe 5b;\n"
-
-        " .p2align 2;\n"
-        "3:\n"
-        " addq $2,%%rdx;\n"                        /* now edx = top-2 */
-        " cmpq %%rdx,%%rsi;\n"
-        " ja 2f;\n"
-        
-        " movzwl (%%rsi),%%eax;\n"
-        " movd %%eax,%%mm0;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " movd %%mm0,%%eax;\n"
-        " movw %%ax,(%%rsi);\n"
-
-        " .p2align 2;\n"
-        "2:\n"
-        " emms;\n"
-        :
-        : "S" (p), "a" (n), "c" (bits), [ones] "m" (ones)
-        : "edx"
-    );
-#else
-    __asm__ __volatile__(
-        " leal -16(%%esi,%%eax,2),%%edx;\n"         /* edx = top - 16 */
-        " emms;\n"
-        " movd %%ecx,%%mm3;\n"
-        " movq %[ones],%%mm2;\n"
-        " psllw %%mm3,%%mm2;\n"
-        " psrlw $1,%%mm2;\n"
-        " cmpl %%edx,%%esi;"
-        " ja 4f;\n"
-
-         " .p2align 2;\n"
-        /* 8 words per iteration */
-        "6:\n"
-        " movq (%%esi),%%mm0;\n"
-        " movq 8(%%esi),%%mm1;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " paddsw %%mm2,%%mm1;\n"
-        " psraw %%mm3,%%mm1;\n"
-        " movq %%mm0,(%%esi);\n"
-        " movq %%mm1,8(%%esi);\n"
-        " addl $16,%%esi;\n"
-        " cmpl %%edx,%%esi;\n"
-        " jbe 6b;\n"
-
-        " .p2align 2;\n"
-        "4:\n"
-        " addl $12,%%edx;\n"                        /* now edx = top-4 */
-        " cmpl %%edx,%%esi;\n"
-        " ja 3f;\n"
-
-        " .p2align 2;\n"
-        /* do up to 6 words, two per iteration */
-        "5:\n"
-        " movd (%%esi),%%mm0;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " movd %%mm0,(%%esi);\n"
-        " addl $4,%%esi;\n"
-        " cmpl %%edx,%%esi;\n"
-        " jbe 5b;\n"
-
-        " .p2align 2;\n"
-        "3:\n"
-        " addl $2,%%edx;\n"                        /* now edx = top-2 */
-        " cmpl %%edx,%%esi;\n"
-        " ja 2f;\n"
-        
-        " movzwl (%%esi),%%eax;\n"
-        " movd %%eax,%%mm0;\n"
-        " paddsw %%mm2,%%mm0;\n"
-        " psraw %%mm3,%%mm0;\n"
-        " movd %%mm0,%%eax;\n"
-        " movw %%ax,(%%esi);\n"
-
-        " .p2align 2;\n"
-        "2:\n"
-        " emms;\n"
-        :
-        : "S" (p), "a" (n), "c" (bits), [ones] "m" (ones)
-        : "edx"
-    );
-#endif
+    assert(smax > 0);
+    return (int16_t) (4 - gsm0610_norm((int32_t) smax << 16));
 }
 /*- End of function --------------------------------------------------------*/
-#endif
 
 /* 4.2.4 */
-static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
+static void autocorrelation_generic(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
 {
     int k;
     int16_t smax;
     int16_t scalauto;
-#if !(defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX))
     int i;
     int temp;
     int16_t *sp;
     int16_t sl;
-#endif
     
     /* The goal is to compute the array L_ACF[k].  The signal s[i] must
        be scaled in order to avoid an overflow situation. */
 
     /* Dynamic scaling of the array  s[0..159] */
     /* Search for the maximum. */
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)
-    smax = saturate(vec_min_maxi16(amp, GSM0610_FRAME_LEN, NULL));
-#else
     for (smax = 0, k = 0;  k < GSM0610_FRAME_LEN;  k++)
     {
         temp = saturated_abs16(amp[k]);
@@ -300,26 +171,11 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
         /*endif*/
     }
     /*endfor*/
-#endif
 
     /* Computation of the scaling factor. */
-    if (smax == 0)
-    {
-        scalauto = 0;
-    }
-    else
-    {
-        assert(smax > 0);
-        scalauto = (int16_t) (4 - gsm0610_norm((int32_t) smax << 16));
-    }
-    /*endif*/
+    scalauto = scaling_factor(smax);
 
     /* Scaling of the array s[0...159] */
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)
-    if (scalauto > 0)
-        gsm0610_vec_vsraw(amp, GSM0610_FRAME_LEN, scalauto);
-    /*endif*/
-#else
     if (scalauto > 0)
     {
         for (k = 0;  k < GSM0610_FRAME_LEN;  k++)
@@ -327,14 +183,8 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
         /*endfor*/
     }
     /*endif*/
-#endif
 
     /* Compute the L_ACF[..]. */
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)
-    for (k = 0;  k < 9;  k++)
-        L_ACF[k] = vec_dot_prodi16(amp, amp + k, GSM0610_FRAME_LEN - k) << 1;
-    /*endfor*/
-#else
     sp = amp;
     sl = *sp;
     L_ACF[0] = ((int32_t) sl*(int32_t) sp[0]);
@@ -407,7 +257,6 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
     for (k = 0;  k < 9;  k++)
         L_ACF[k] <<= 1;
     /*endfor*/
-#endif
     /* Rescaling of the array s[0..159] */
     if (scalauto > 0)
     {
@@ -420,6 +269,189 @@ static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(GSM0610_WITH_SSE2)
+__attribute__((target("sse2"))) static __inline__ int16_t max_i16_sse2(__m128i x)
+{
+    x = _mm_max_epi16(x, _mm_srli_si128(x, 8));
+    x = _mm_max_epi16(x, _mm_srli_si128(x, 4));
+    x = _mm_max_epi16(x, _mm_srli_si128(x, 2));
+    return (int16_t) _mm_cvtsi128_si32(x);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse2"))) static __inline__ int32_t sum_i32_sse2(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4E));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xB1));
+    return _mm_cvtsi128_si32(x);
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse2"))) static void autocorrelation_sse2(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
+{
+    int16_t sp[GSM0610_FRAME_LEN + 8] __attribute__((aligned(16)));
+    __m128i x;
+    __m128i max;
+    __m128i acc;
+    __m128i shift;
+    __m128i shift_less_one;
+    __m128i ones;
+    int16_t scalauto;
+    int i;
+    int k;
+
+    /* The saturating subtraction makes the magnitude of -32768 come out as 32767, just
+       like saturated_abs16() */
+    max = _mm_setzero_si128();
+    for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+    {
+        x = _mm_loadu_si128((const __m128i *) &amp[i]);
+        max = _mm_max_epi16(max, _mm_max_epi16(x, _mm_subs_epi16(_mm_setzero_si128(), x)));
+    }
+    /*endfor*/
+    scalauto = scaling_factor(max_i16_sse2(max));
+
+    /* Scale into a copy, padded with zeros so every lag can use whole vectors. The
+       rounding is done as a separate step, so it cannot overflow, and matches gsm_mult_r()
+       exactly. */
+    /* The same shift is used to undo the scaling, at the end */
+    shift = _mm_cvtsi32_si128(scalauto);
+    if (scalauto > 0)
+    {
+        shift_less_one = _mm_cvtsi32_si128(scalauto - 1);
+        ones = _mm_set1_epi16(1);
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+        {
+            x = _mm_loadu_si128((const __m128i *) &amp[i]);
+            x = _mm_add_epi16(_mm_sra_epi16(x, shift), _mm_and_si128(_mm_sra_epi16(x, shift_less_one), ones));
+            _mm_store_si128((__m128i *) &sp[i], x);
+        }
+        /*endfor*/
+    }
+    else
+    {
+        memcpy(sp, amp, sizeof(int16_t)*GSM0610_FRAME_LEN);
+    }
+    /*endif*/
+    _mm_store_si128((__m128i *) &sp[GSM0610_FRAME_LEN], _mm_setzero_si128());
+
+    for (k = 0;  k < 9;  k++)
+    {
+        acc = _mm_setzero_si128();
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_load_si128((const __m128i *) &sp[i]), _mm_loadu_si128((const __m128i *) &sp[i + k])));
+        /*endfor*/
+        L_ACF[k] = sum_i32_sse2(acc) << 1;
+    }
+    /*endfor*/
+
+    /* Rescaling of the array s[0..159] */
+    if (scalauto > 0)
+    {
+        assert(scalauto <= 4);
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 8)
+        {
+            x = _mm_sll_epi16(_mm_load_si128((const __m128i *) &sp[i]), shift);
+            _mm_storeu_si128((__m128i *) &amp[i], x);
+        }
+        /*endfor*/
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(GSM0610_WITH_AVX2)
+__attribute__((target("avx2"))) static void autocorrelation_avx2(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
+{
+    int16_t sp[GSM0610_FRAME_LEN + 16] __attribute__((aligned(32)));
+    __m256i x;
+    __m256i max;
+    __m256i acc;
+    __m256i ones;
+    __m128i shift;
+    __m128i shift_less_one;
+    int16_t scalauto;
+    int i;
+    int k;
+
+    max = _mm256_setzero_si256();
+    for (i = 0;  i < GSM0610_FRAME_LEN;  i += 16)
+    {
+        x = _mm256_loadu_si256((const __m256i *) &amp[i]);
+        max = _mm256_max_epi16(max, _mm256_max_epi16(x, _mm256_subs_epi16(_mm256_setzero_si256(), x)));
+    }
+    /*endfor*/
+    scalauto = scaling_factor(max_i16_sse2(_mm_max_epi16(_mm256_castsi256_si128(max), _mm256_extracti128_si256(max, 1))));
+
+    /* The same shift is used to undo the scaling, at the end */
+    shift = _mm_cvtsi32_si128(scalauto);
+    if (scalauto > 0)
+    {
+        shift_less_one = _mm_cvtsi32_si128(scalauto - 1);
+        ones = _mm256_set1_epi16(1);
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 16)
+        {
+            x = _mm256_loadu_si256((const __m256i *) &amp[i]);
+            x = _mm256_add_epi16(_mm256_sra_epi16(x, shift), _mm256_and_si256(_mm256_sra_epi16(x, shift_less_one), ones));
+            _mm256_store_si256((__m256i *) &sp[i], x);
+        }
+        /*endfor*/
+    }
+    else
+    {
+        memcpy(sp, amp, sizeof(int16_t)*GSM0610_FRAME_LEN);
+    }
+    /*endif*/
+    _mm256_store_si256((__m256i *) &sp[GSM0610_FRAME_LEN], _mm256_setzero_si256());
+
+    for (k = 0;  k < 9;  k++)
+    {
+        acc = _mm256_setzero_si256();
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 16)
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_load_si256((const __m256i *) &sp[i]), _mm256_loadu_si256((const __m256i *) &sp[i + k])));
+        /*endfor*/
+        L_ACF[k] = sum_i32_sse2(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1))) << 1;
+    }
+    /*endfor*/
+
+    if (scalauto > 0)
+    {
+        assert(scalauto <= 4);
+        for (i = 0;  i < GSM0610_FRAME_LEN;  i += 16)
+        {
+            x = _mm256_sll_epi16(_mm256_load_si256((const __m256i *) &sp[i]), shift);
+            _mm256_storeu_si256((__m256i *) &amp[i], x);
+        }
+        /*endfor*/
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void autocorrelation(int16_t amp[GSM0610_FRAME_LEN], int32_t L_ACF[9])
+{
+    switch (gsm0610_get_implementation())
+    {
+#if defined(GSM0610_WITH_AVX2)
+    case GSM0610_IMPLEMENTATION_AVX2:
+        autocorrelation_avx2(amp, L_ACF);
+        break;
+#endif
+#if defined(GSM0610_WITH_SSE2)
+    case GSM0610_IMPLEMENTATION_SSE2:
+        autocorrelation_sse2(amp, L_ACF);
+        break;
+#endif
+    default:
+        autocorrelation_generic(amp, L_ACF);
+        break;
+    }
+    /*endswitch*/
+}
+/*- End of function --------------------------------------------------------*/
+
 /* 4.2.5 */
 static void reflection_coefficients(int32_t L_ACF[9], int16_t r[8])
 {
@@ -43,8 +43,6 @@
 #include "floating_fudge.h"
 #include <stdlib.h>
 
-#include "mmx_sse_decs.h"
-
 #include "spandsp/telephony.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/bitstream.h"
@@ -53,123 +51,16 @@
 
 #include "gsm0610_local.h"
 
+#if defined(GSM0610_WITH_SSE2)  ||  defined(GSM0610_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
 /* 4.2.13 .. 4.2.17  RPE ENCODING SECTION */
 
 /* 4.2.13 */
-static void weighting_filter(int16_t x[40],
-                             const int16_t *e)      // signal [-5..0.39.44] IN)
+static void weighting_filter_generic(int16_t x[40],
+                                     const int16_t *e)      // signal [-5..0.39.44] IN)
 {
-#if defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__x86_64__)
-    /* Table 4.4   Coefficients of the weighting filter */
-    /* This must be padded to a multiple of 4 for MMX to work */
-    static const union
-    {
-        int16_t gsm_H[12];
-        __m64 x[3];
-    } gsm_H =
-    {
-        {
-            -134, -374, 0, 2054, 5741, 8192, 5741, 2054, 0, -374, -134, 0
-        }
-
-    };
-
-    __asm__ __volatile__(
-        " emms;\n"
-        " addq $-10,%%rcx;\n"
-        " leaq %[gsm_H],%%rax;\n"
-        " movq (%%rax),%%mm1;\n"
-        " movq 8(%%rax),%%mm2;\n"
-        " movq 16(%%rax),%%mm3;\n"
-        " movq $0x1000,%%rax;\n"
-        " movq %%rax,%%mm5;\n"              /* For rounding */
-        " xorq %%rsi,%%rsi;\n"
-        " .p2align 2;\n"
-        "1:\n"
-        " movq (%%rcx,%%rsi,2),%%mm0;\n"
-        " pmaddwd %%mm1,%%mm0;\n"
- 
-        " movq 8(%%rcx,%%rsi,2),%%mm4;\n"
-        " pmaddwd %%mm2,%%mm4;\n"
-        " paddd %%mm4,%%mm0;\n"
-
-        " movq 16(%%rcx,%%rsi,2),%%mm4;\n"
-        " pmaddwd %%mm3,%%mm4;\n"
-        " paddd %%mm4,%%mm0;\n"
-
-        " movq %%mm0,%%mm4;\n"
-        " punpckhdq %%mm0,%%mm4;\n"         /* mm4 has high int32 of mm0 dup'd */
-        " paddd %%mm4,%%mm0;\n"
-
-        " paddd %%mm5,%%mm0;\n"             /* Add for roundoff */
-        " psrad $13,%%mm0;\n"
-        " packssdw %%mm0,%%mm0;\n"        
-        " movd %%mm0,%%eax;\n"              /* eax has result */
-        " movw %%ax,(%%rdi,%%rsi,2);\n"
-        " incq %%rsi;\n"
-        " cmpq $39,%%rsi;\n"
-        " jle 1b;\n"
-        " emms;\n"
-        :
-        : "c" (e), "D" (x), [gsm_H] "X" (gsm_H)
-        : "rax", "rdx", "rsi", "memory"
-    );
-#elif defined(__GNUC__)  &&  defined(SPANDSP_USE_MMX)  &&  defined(__i386__)
-    /* Table 4.4   Coefficients of the weighting filter */
-    /* This must be padded to a multiple of 4 for MMX to work */
-    static const union
-    {
-        int16_t gsm_H[12];
-        __m64 x[3];
-    } gsm_H =
-    {
-        {
-            -134, -374, 0, 2054, 5741, 8192, 5741, 2054, 0, -374, -134, 0
-        }
-
-    };
-
-    __asm__ __volatile__(
-        " emms;\n"
-        " addl $-10,%%ecx;\n"
-        " leal %[gsm_H],%%eax;\n"
-        " movq (%%eax),%%mm1;\n"
-        " movq 8(%%eax),%%mm2;\n"
-        " movq 16(%%eax),%%mm3;\n"
-        " movl $0x1000,%%eax;\n"
-        " movd %%eax,%%mm5;\n"              /* For rounding */
-        " xorl %%esi,%%esi;\n"
-        " .p2align 2;\n"
-        "1:\n"
-        " movq (%%ecx,%%esi,2),%%mm0;\n"
-        " pmaddwd %%mm1,%%mm0;\n"
- 
-        " movq 8(%%ecx,%%esi,2),%%mm4;\n"
-        " pmaddwd %%mm2,%%mm4;\n"
-        " paddd %%mm4,%%mm0;\n"
-
-        " movq 16(%%ecx,%%esi,2),%%mm4;\n"
-        " pmaddwd %%mm3,%%mm4;\n"
-        " paddd %%mm4,%%mm0;\n"
-
-        " movq %%mm0,%%mm4;\n"
-        " punpckhdq %%mm0,%%mm4;\n"         /* mm4 has high int32 of mm0 dup'd */
-        " paddd %%mm4,%%mm0;\n"
-
-        " paddd %%mm5,%%mm0;\n"             /* Add for roundoff */
-        " psrad $13,%%mm0;\n"
-        " packssdw %%mm0,%%mm0;\n"        
-        " movd %%mm0,%%eax;\n"              /* eax has result */
-        " movw %%ax,(%%edi,%%esi,2);\n"
-        " incl %%esi;\n"
-        " cmpl $39,%%esi;\n"
-        " jle 1b;\n"
-        " emms;\n"
-        :
-        : "c" (e), "D" (x), [gsm_H] "X" (gsm_H)
-        : "eax", "edx", "esi", "memory"
-    );
-#else
     int32_t result;
     int k;
 
@@ -226,7 +117,124 @@ static void weighting_filter(int16_t x[40],
         x[k] = saturate(result);
     }
     /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
+
+#if defined(GSM0610_WITH_SSE2)  ||  defined(GSM0610_WITH_AVX2)
+/* Pack a pair of filter coefficients, for use with the multiply-add instructions */
+#define H_PAIR(a,b)     ((int32_t) (((uint32_t) (uint16_t) (b) << 16) | (uint16_t) (a)))
+
+/* Each multiply-add applies a pair of taps. The taps with zero coefficients are skipped,
+   and the last tap is paired with itself, with a zero coefficient for the copy, so
+   nothing beyond e[44] is read. */
+static const int32_t weighting_taps[5][3] =
+{
+    { 0,  1, H_PAIR(-134, -374)},
+    { 3,  4, H_PAIR(2054, 5741)},
+    { 5,  6, H_PAIR(8192, 5741)},
+    { 7,  9, H_PAIR(2054, -374)},
+    {10, 10, H_PAIR(-134, 0)}
+};
+#endif
+
+#if defined(GSM0610_WITH_SSE2)
+__attribute__((target("sse2"))) static __inline__ void weighting_filter_8_sse2(int16_t x[8], const int16_t *e)
+{
+    __m128i lo;
+    __m128i hi;
+    __m128i a;
+    __m128i b;
+    __m128i h;
+    int i;
+
+    lo = _mm_set1_epi32(8192 >> 1);
+    hi = lo;
+    for (i = 0;  i < 5;  i++)
+    {
+        a = _mm_loadu_si128((const __m128i *) &e[weighting_taps[i][0]]);
+        b = _mm_loadu_si128((const __m128i *) &e[weighting_taps[i][1]]);
+        h = _mm_set1_epi32(weighting_taps[i][2]);
+        lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), h));
+        hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), h));
+    }
+    /*endfor*/
+    /* The saturating pack does the job of saturate() */
+    lo = _mm_srai_epi32(lo, 13);
+    hi = _mm_srai_epi32(hi, 13);
+    _mm_storeu_si128((__m128i *) x, _mm_packs_epi32(lo, hi));
+}
+/*- End of function --------------------------------------------------------*/
+
+__attribute__((target("sse2"))) static void weighting_filter_sse2(int16_t x[40], const int16_t *e)
+{
+    int k;
+
+    e -= 5;
+    for (k = 0;  k < 40;  k += 8)
+        weighting_filter_8_sse2(&x[k], &e[k]);
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
 #endif
+
+#if defined(GSM0610_WITH_AVX2)
+__attribute__((target("avx2"))) static void weighting_filter_avx2(int16_t x[40], const int16_t *e)
+{
+    __m256i lo;
+    __m256i hi;
+    __m256i a;
+    __m256i b;
+    __m256i h;
+    int i;
+    int k;
+
+    e -= 5;
+    /* The unpacks and the pack both work within 128 bit lanes, so the outputs come
+       out in order. */
+    for (k = 0;  k < 32;  k += 16)
+    {
+        lo = _mm256_set1_epi32(8192 >> 1);
+        hi = lo;
+        for (i = 0;  i < 5;  i++)
+        {
+            a = _mm256_loadu_si256((const __m256i *) &e[k + weighting_taps[i][0]]);
+            b = _mm256_loadu_si256((const __m256i *) &e[k + weighting_taps[i][1]]);
+            h = _mm256_set1_epi32(weighting_taps[i][2]);
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), h));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), h));
+        }
+        /*endfor*/
+        lo = _mm256_srai_epi32(lo, 13);
+        hi = _mm256_srai_epi32(hi, 13);
+        _mm256_storeu_si256((__m256i *) &x[k], _mm256_packs_epi32(lo, hi));
+    }
+    /*endfor*/
+    weighting_filter_8_sse2(&x[32], &e[32]);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void weighting_filter(int16_t x[40],
+                             const int16_t *e)      // signal [-5..0.39.44] IN)
+{
+    switch (gsm0610_get_implementation())
+    {
+#if defined(GSM0610_WITH_AVX2)
+    case GSM0610_IMPLEMENTATION_AVX2:
+        weighting_filter_avx2(x, e);
+        break;
+#endif
+#if defined(GSM0610_WITH_SSE2)
+    case GSM0610_IMPLEMENTATION_SSE2:
+        weighting_filter_sse2(x, e);
+        break;
+#endif
+    default:
+        weighting_filter_generic(x, e);
+        break;
+    }
+    /*endswitch*/
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -40,12 +40,121 @@
 #endif
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/async.h"
 #include "spandsp/crc.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/hdlc.h"
 #include "spandsp/private/hdlc.h"
 
+enum
+{
+    HDLC_OCTET_DATA_ONLY = 0,
+    HDLC_OCTET_FLAG = 1,
+    HDLC_OCTET_ABORT = 2
+};
+
+/* How a received octet breaks down, for a given run of ones leading into it.
+   An octet holds at most two flags or aborts, which split it into at most
+   three sections of destuffed data bits. */
+typedef struct
+{
+    /*! \brief The destuffed data bits of each section, with the first bit in the LSB. */
+    uint8_t bits[3];
+    /*! \brief The number of destuffed data bits in each section. */
+    uint8_t len[3];
+    /*! \brief The flag or abort which ends each of the first two sections. */
+    uint8_t event[2];
+} hdlc_rx_octet_t;
+
+/* The received octets, indexed by the run of ones (0 to 7) leading into the octet */
+static hdlc_rx_octet_t rx_octet_table[8][256];
+/* The stuffed bits for each transmitted octet, indexed by the run of ones (0 to 4)
+   leading into the octet. The low 10 bits hold the stuffed bits, and the top bits
+   hold the number of stuffing bits inserted. */
+static uint16_t tx_octet_table[5][256];
+/* The length of the run of ones at the bottom of a 7 bit value */
+static uint8_t ones_run[128];
+static int octet_tables_ready = false;
+
+static void build_octet_tables(void)
+{
+    hdlc_rx_octet_t *t;
+    uint32_t bits;
+    int ones;
+    int run;
+    int byte;
+    int bit;
+    int section;
+    int len;
+    int i;
+
+    if (octet_tables_ready)
+        return;
+    for (i = 0;  i < 128;  i++)
+    {
+        for (run = 0;  run < 7  &&  (i & (1 << run));  run++)
+            ;
+        ones_run[i] = (uint8_t) run;
+    }
+    for (run = 0;  run < 8;  run++)
+    {
+        for (byte = 0;  byte < 256;  byte++)
+        {
+            /* Follow hdlc_rx_put_bit_core() through the octet, MSB first */
+            t = &rx_octet_table[run][byte];
+            memset(t, 0, sizeof(*t));
+            ones = run;
+            section = 0;
+            for (i = 7;  i >= 0;  i--)
+            {
+                bit = (byte >> i) & 1;
+                if (bit)
+                {
+                    if (ones < 7)
+                        ones++;
+                }
+                else
+                {
+                    if (ones >= 5)
+                    {
+                        if (ones >= 6)
+                            t->event[section++] = (ones == 6)  ?  HDLC_OCTET_FLAG  :  HDLC_OCTET_ABORT;
+                        /* A stuffing bit just disappears */
+                        ones = 0;
+                        continue;
+                    }
+                    ones = 0;
+                }
+                t->bits[section] |= (uint8_t) (bit << t->len[section]);
+                t->len[section]++;
+            }
+        }
+    }
+    for (run = 0;  run < 5;  run++)
+    {
+        for (byte = 0;  byte < 256;  byte++)
+        {
+            /* Follow the stuffing in hdlc_tx_get_byte() through the octet, LSB first */
+            bits = (1 << run) - 1;
+            len = 0;
+            for (i = 0;  i < 8;  i++)
+            {
+                bits = (bits << 1) | ((byte >> i) & 1);
+                len++;
+                if ((bits & 0x1F) == 0x1F)
+                {
+                    bits <<= 1;
+                    len++;
+                }
+            }
+            tx_octet_table[run][byte] = (uint16_t) (((len - 8) << 12) | (bits & ((1 << len) - 1)));
+        }
+    }
+    octet_tables_ready = true;
+}
+/*- End of function --------------------------------------------------------*/
+
 static void report_status_change(hdlc_rx_state_t *s, int status)
 {
     if (s->status_handler)
@@ -123,9 +232,9 @@ static __inline__ void octet_count(hdlc_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static void rx_flag_or_abort(hdlc_rx_state_t *s)
+static void rx_flag_or_abort(hdlc_rx_state_t *s, int abort)
 {
-    if ((s->raw_bit_stream & 0x8000))
+    if (abort)
     {
         /* Hit HDLC abort */
         s->rx_aborts++;
@@ -219,6 +328,26 @@ static void rx_flag_or_abort(hdlc_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void rx_octet(hdlc_rx_state_t *s)
+{
+    /* Ensure we do not accept an overlength frame, and especially that
+       we do not overflow our buffer */
+    if (s->len < s->max_frame_len)
+    {
+        s->buffer[s->len++] = (uint8_t) s->byte_in_progress;
+    }
+    else
+    {
+        /* This is too long. Abandon the frame, and wait for the next
+           flag octet. */
+        s->len = sizeof(s->buffer) + 1;
+        s->flags_seen = s->framing_ok_threshold - 1;
+        octet_set_and_count(s);
+    }
+    s->num_bits = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ void hdlc_rx_put_bit_core(hdlc_rx_state_t *s)
 {
     if ((s->raw_bit_stream & 0x3F00) == 0x3E00)
@@ -226,7 +355,7 @@ static __inline__ void hdlc_rx_put_bit_core(hdlc_rx_state_t *s)
         /* Its time to either skip a bit, for stuffing, or process a
            flag or abort */
         if ((s->raw_bit_stream & 0x4000))
-            rx_flag_or_abort(s);
+            rx_flag_or_abort(s, s->raw_bit_stream & 0x8000);
         return;
     }
     s->num_bits++;
@@ -238,26 +367,66 @@ static __inline__ void hdlc_rx_put_bit_core(hdlc_rx_state_t *s)
     }
     s->byte_in_progress = (s->byte_in_progress | (s->raw_bit_stream & 0x100)) >> 1;
     if (s->num_bits == 8)
+        rx_octet(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void rx_data_bits(hdlc_rx_state_t *s, unsigned int bits, int len)
+{
+    int n;
+
+    /* This has the same effect as feeding the destuffed bits, first bit in the LSB,
+       through hdlc_rx_put_bit_core() one at a time, but works in steps of up to an octet. */
+    while (len > 0)
     {
-        /* Ensure we do not accept an overlength frame, and especially that
-           we do not overflow our buffer */
-        if (s->len < s->max_frame_len)
+        if (s->flags_seen < s->framing_ok_threshold)
         {
-            s->buffer[s->len++] = (uint8_t) s->byte_in_progress;
+            n = 8 - (s->num_bits & 0x7);
+            if (len < n)
+            {
+                s->num_bits += len;
+                return;
+            }
+            s->num_bits += n;
+            bits >>= n;
+            len -= n;
+            octet_count(s);
+            continue;
         }
-        else
+        n = 8 - s->num_bits;
+        if (len < n)
         {
-            /* This is too long. Abandon the frame, and wait for the next
-               flag octet. */
-            s->len = sizeof(s->buffer) + 1;
-            s->flags_seen = s->framing_ok_threshold - 1;
-            octet_set_and_count(s);
+            s->byte_in_progress = (s->byte_in_progress >> len) | (bits << (8 - len));
+            s->num_bits += len;
+            return;
         }
-        s->num_bits = 0;
+        s->byte_in_progress = (s->byte_in_progress >> n) | ((bits << (8 - n)) & 0xFF);
+        bits >>= n;
+        len -= n;
+        rx_octet(s);
     }
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void hdlc_rx_put_octet(hdlc_rx_state_t *s, int new_byte)
+{
+    const hdlc_rx_octet_t *t;
+
+    t = &rx_octet_table[ones_run[(s->raw_bit_stream >> 8) & 0x7F]][new_byte];
+    /* Leave the raw bit stream just as the bit by bit code would */
+    s->raw_bit_stream = (s->raw_bit_stream | new_byte) << 8;
+    rx_data_bits(s, t->bits[0], t->len[0]);
+    if (t->event[0] == HDLC_OCTET_DATA_ONLY)
+        return;
+    rx_flag_or_abort(s, t->event[0] == HDLC_OCTET_ABORT);
+    rx_data_bits(s, t->bits[1], t->len[1]);
+    if (t->event[1] == HDLC_OCTET_DATA_ONLY)
+        return;
+    rx_flag_or_abort(s, t->event[1] == HDLC_OCTET_ABORT);
+    rx_data_bits(s, t->bits[2], t->len[2]);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bit(hdlc_rx_state_t *s, int new_bit)
 {
     if (new_bit < 0)
@@ -279,6 +448,11 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put_byte(hdlc_rx_state_t *s, int new_byte)
         rx_special_condition(s, new_byte);
         return;
     }
+    if (s->octet_tables)
+    {
+        hdlc_rx_put_octet(s, new_byte);
+        return;
+    }
     s->raw_bit_stream |= new_byte;
     for (i = 0;  i < 8;  i++)
     {
@@ -292,11 +466,23 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put(hdlc_rx_state_t *s, const uint8_t buf[], i
 {
     int i;
 
+    if (s->octet_tables)
+    {
+        for (i = 0;  i < len;  i++)
+            hdlc_rx_put_octet(s, buf[i]);
+        return;
+    }
     for (i = 0;  i < len;  i++)
         hdlc_rx_put_byte(s, buf[i]);
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) hdlc_rx_set_octet_tables(hdlc_rx_state_t *s, int use_tables)
+{
+    s->octet_tables = use_tables;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) hdlc_rx_set_max_frame_len(hdlc_rx_state_t *s, size_t max_len)
 {
     max_len += s->crc_bytes;
@@ -333,7 +519,7 @@ SPAN_DECLARE(hdlc_rx_state_t *) hdlc_rx_init(hdlc_rx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (hdlc_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (hdlc_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -343,6 +529,8 @@ SPAN_DECLARE(hdlc_rx_state_t *) hdlc_rx_init(hdlc_rx_state_t *s,
     s->report_bad_frames = report_bad_frames;
     s->framing_ok_threshold = (framing_ok_threshold < 1)  ?  1  :  framing_ok_threshold;
     s->max_frame_len = sizeof(s->buffer);
+    build_octet_tables();
+    s->octet_tables = true;
     return s;
 }
 /*- End of function --------------------------------------------------------*/
@@ -369,7 +557,7 @@ SPAN_DECLARE(int) hdlc_rx_release(hdlc_rx_state_t *s)
 
 SPAN_DECLARE(int) hdlc_rx_free(hdlc_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -465,6 +653,7 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_byte(hdlc_tx_state_t *s)
     int i;
     int byte_in_progress;
     int txbyte;
+    uint16_t stuffed;
 
     if (s->flag_octets > 0)
     {
@@ -538,6 +727,14 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_byte(hdlc_tx_state_t *s)
             }
         }
         byte_in_progress = s->buffer[s->pos++];
+        if (s->octet_tables)
+        {
+            /* Only the last 4 bits sent can contribute to a run of 5 ones */
+            stuffed = tx_octet_table[ones_run[s->octets_in_progress & 0x0F]][byte_in_progress];
+            s->octets_in_progress = (s->octets_in_progress << (8 + (stuffed >> 12))) | (stuffed & 0x3FF);
+            s->num_bits += (stuffed >> 12);
+            return (s->octets_in_progress >> s->num_bits) & 0xFF;
+        }
         i = bottom_bit(byte_in_progress | 0x100);
         s->octets_in_progress <<= i;
         byte_in_progress >>= i;
@@ -596,6 +793,12 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get(hdlc_tx_state_t *s, uint8_t buf[], size_t m
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) hdlc_tx_set_octet_tables(hdlc_tx_state_t *s, int use_tables)
+{
+    s->octet_tables = use_tables;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) hdlc_tx_set_max_frame_len(hdlc_tx_state_t *s, size_t max_len)
 {
     s->max_frame_len = (max_len <= HDLC_MAXFRAME_LEN)  ?  max_len  :  HDLC_MAXFRAME_LEN;
@@ -632,7 +835,7 @@ SPAN_DECLARE(hdlc_tx_state_t *) hdlc_tx_init(hdlc_tx_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (hdlc_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (hdlc_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -652,6 +855,8 @@ SPAN_DECLARE(hdlc_tx_state_t *) hdlc_tx_init(hdlc_tx_state_t *s,
     s->idle_octet = 0x7E;
     s->progressive = progressive;
     s->max_frame_len = HDLC_MAXFRAME_LEN;
+    build_octet_tables();
+    s->octet_tables = true;
     return s;
 }
 /*- End of function --------------------------------------------------------*/
@@ -664,7 +869,7 @@ SPAN_DECLARE(int) hdlc_tx_release(hdlc_tx_state_t *s)
 
 SPAN_DECLARE(int) hdlc_tx_free(hdlc_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -101,6 +101,10 @@ SOURCE=.\adsi.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\alloc.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\async.c
 # End Source File
 # Begin Source File
@@ -169,6 +173,10 @@ SOURCE=.\fax_modems.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\fir.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\fsk.c
 # End Source File
 # Begin Source File
@@ -297,6 +305,10 @@ SOURCE=.\silence_gen.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\stats.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\super_tone_rx.c
 # End Source File
 # Begin Source File
@@ -631,6 +643,10 @@ SOURCE=.\spandsp/silence_gen.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/stats.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/super_tone_rx.h
 # End Source File
 # Begin Source File
@@ -35,6 +35,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
@@ -42,10 +43,17 @@
 #include <time.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/queue.h"
 
 #include "spandsp/private/logging.h"
 
+#if defined(__GNUC__)  &&  defined(__ATOMIC_ACQUIRE)
+#define SPAN_LOG_ASYNC_SUPPORTED
+#define THREAD_LOCAL __thread
+#endif
+
 static void default_message_handler(int level, const char *text);
 
 static message_handler_func_t __span_message = &default_message_handler;
@@ -73,7 +81,7 @@ static void default_message_handler(int level, const char *text)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) span_log_test(logging_state_t *s, int level)
+SPAN_DECLARE(int) (span_log_test)(logging_state_t *s, int level)
 {
     if (s  &&  (s->level & SPAN_LOG_SEVERITY_MASK) >= (level & SPAN_LOG_SEVERITY_MASK))
         return TRUE;
@@ -81,72 +89,807 @@ SPAN_DECLARE(int) span_log_test(logging_state_t *s, int level)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) span_log(logging_state_t *s, int level, const char *format, ...)
+static int format_labels(char msg[],
+                         int level,
+                         int show,
+                         const struct timeval *nowx,
+                         int64_t elapsed_samples,
+                         int samples_per_second,
+                         const char *protocol,
+                         const char *tag)
 {
-    char msg[1024 + 1];
-    va_list arg_ptr;
     int len;
     struct tm *tim;
-    struct timeval nowx;
     time_t now;
 
-    if (span_log_test(s, level))
+    len = 0;
+    if ((level & SPAN_LOG_SUPPRESS_LABELLING) == 0)
     {
-        va_start(arg_ptr, format);
-        len = 0;
-        if ((level & SPAN_LOG_SUPPRESS_LABELLING) == 0)
+        if ((show & SPAN_LOG_SHOW_DATE))
+        {
+            now = nowx->tv_sec;
+            tim = gmtime(&now);
+            len += snprintf(msg + len,
+                            1024 - len,
+                            "%04d/%02d/%02d %02d:%02d:%02d.%03d ",
+                            tim->tm_year + 1900,
+                            tim->tm_mon + 1,
+                            tim->tm_mday,
+                            tim->tm_hour,
+                            tim->tm_min,
+                            tim->tm_sec,
+                            (int) nowx->tv_usec/1000);
+        }
+        /*endif*/
+        if ((show & SPAN_LOG_SHOW_SAMPLE_TIME))
+        {
+            now = elapsed_samples/samples_per_second;
+            tim = gmtime(&now);
+            len += snprintf(msg + len,
+                            1024 - len,
+                            "%02d:%02d:%02d.%03d ",
+                            tim->tm_hour,
+                            tim->tm_min,
+                            tim->tm_sec,
+                            (int) (elapsed_samples%samples_per_second)*1000/samples_per_second);
+        }
+        /*endif*/
+        if ((show & SPAN_LOG_SHOW_SEVERITY)  &&  (level & SPAN_LOG_SEVERITY_MASK) <= SPAN_LOG_DEBUG_3)
+            len += snprintf(msg + len, 1024 - len, "%s ", severities[level & SPAN_LOG_SEVERITY_MASK]);
+        /*endif*/
+        if ((show & SPAN_LOG_SHOW_PROTOCOL)  &&  protocol)
+            len += snprintf(msg + len, 1024 - len, "%s ", protocol);
+        /*endif*/
+        if ((show & SPAN_LOG_SHOW_TAG)  &&  tag)
+            len += snprintf(msg + len, 1024 - len, "%s ", tag);
+        /*endif*/
+    }
+    /*endif*/
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void deliver(int level, const char *msg, message_handler_func_t span_message, error_handler_func_t span_error)
+{
+    if (span_error  &&  level == SPAN_LOG_ERROR)
+        span_error(msg);
+    else if (__span_error  &&  level == SPAN_LOG_ERROR)
+        __span_error(msg);
+    else if (span_message)
+        span_message(level, msg);
+    else if (__span_message)
+        __span_message(level, msg);
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(SPAN_LOG_ASYNC_SUPPORTED)
+/* Asynchronous logging.
+
+   A log entry is captured on the calling thread as a record holding the labelling
+   information, the format string, and the arguments, packed according to the types
+   the format says they have. Strings are copied, so nothing the record refers to
+   can vanish before it is formatted. Each thread writing log entries has its own
+   lock free ring, so no thread ever waits for another. span_log_async_drain()
+   formats the records, one conversion at a time, and passes them to the message
+   handlers, on whatever thread the application chooses. */
+
+enum
+{
+    ARG_NONE = 0,
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_INTMAX,
+    ARG_SIZE,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR
+};
+
+#define MAX_SPEC_LEN        32
+#define MAX_RECORD_LEN      2048
+
+/* The precisions parse_conversion() reports when there is none, and when it is
+   given by a '*' argument */
+#define PRECISION_NONE      -1
+#define PRECISION_STAR      -2
+
+typedef struct
+{
+    int level;
+    int show;
+    int samples_per_second;
+    int64_t elapsed_samples;
+    struct timeval when;
+    message_handler_func_t span_message;
+    error_handler_func_t span_error;
+    /*! The lengths of the strings which follow the header, including their terminating nulls.
+        A zero length means a NULL pointer. */
+    uint16_t protocol_len;
+    uint16_t tag_len;
+    uint16_t format_len;
+    /*! TRUE if the format is actually fully formatted text, because it uses conversions
+        the capture code cannot handle. */
+    uint16_t preformatted;
+} log_record_t;
+
+/* A buffer for a record, aligned to suit the header */
+typedef union
+{
+    log_record_t rec;
+    uint8_t buf[MAX_RECORD_LEN];
+} log_record_buf_t;
+
+typedef struct span_log_ring_s
+{
+    queue_state_t *queue;
+    /*! Non-zero while a thread owns this ring. */
+    int in_use;
+    /*! The number of records dropped because the ring was full. Only the owning thread
+        changes this. */
+    volatile int dropped;
+    /*! The number of dropped records already reported by the drain. */
+    int dropped_reported;
+    struct span_log_ring_s *next;
+} span_log_ring_t;
+
+static span_log_ring_t *async_rings = NULL;
+static int async_ring_size = 0;
+static volatile int async_enabled = FALSE;
+static int async_generation = 0;
+
+static THREAD_LOCAL span_log_ring_t *thread_ring = NULL;
+static THREAD_LOCAL int thread_ring_generation = -1;
+
+/* Parse the conversion specification starting just after a '%'. Return its length,
+   the number of '*' width and precision arguments it takes, its precision, and the
+   type of its main argument. Return -1 for conversions which cannot be replayed later. */
+static int parse_conversion(const char *fmt, int *stars, int *precision, int *type)
+{
+    const char *p;
+    int size;
+
+    p = fmt;
+    *stars = 0;
+    *precision = PRECISION_NONE;
+    *type = ARG_NONE;
+    if (*p == '%')
+        return 1;
+    /*endif*/
+    while (*p  &&  strchr("-+ #0'", *p))
+        p++;
+    /*endwhile*/
+    if (*p == '*')
+    {
+        (*stars)++;
+        p++;
+    }
+    /*endif*/
+    while (*p >= '0'  &&  *p <= '9')
+        p++;
+    /*endwhile*/
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            (*stars)++;
+            *precision = PRECISION_STAR;
+            p++;
+        }
+        else
         {
-            if ((s->level & SPAN_LOG_SHOW_DATE))
+            *precision = 0;
+            while (*p >= '0'  &&  *p <= '9')
             {
-                gettimeofday(&nowx, NULL);
-                now = nowx.tv_sec;
-                tim = gmtime(&now);
-                len += snprintf(msg + len,
-                                1024 - len,
-                                "%04d/%02d/%02d %02d:%02d:%02d.%03d ",
-                                tim->tm_year + 1900,
-                                tim->tm_mon + 1,
-                                tim->tm_mday,
-                                tim->tm_hour,
-                                tim->tm_min,
-                                tim->tm_sec,
-                                (int) nowx.tv_usec/1000);
+                if (*precision < MAX_RECORD_LEN)
+                    *precision = *precision*10 + (*p - '0');
+                /*endif*/
+                p++;
             }
+            /*endwhile*/
+        }
+        /*endif*/
+    }
+    /*endif*/
+    size = ARG_INT;
+    switch (*p)
+    {
+    case 'h':
+        if (*++p == 'h')
+            p++;
+        /*endif*/
+        break;
+    case 'l':
+        size = ARG_LONG;
+        if (*++p == 'l')
+        {
+            size = ARG_LLONG;
+            p++;
+        }
+        /*endif*/
+        break;
+    case 'q':
+        size = ARG_LLONG;
+        p++;
+        break;
+    case 'j':
+        size = ARG_INTMAX;
+        p++;
+        break;
+    case 'z':
+        size = ARG_SIZE;
+        p++;
+        break;
+    case 't':
+        size = ARG_PTRDIFF;
+        p++;
+        break;
+    case 'L':
+        size = ARG_LDOUBLE;
+        p++;
+        break;
+    }
+    /*endswitch*/
+    switch (*p)
+    {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        if (size == ARG_LDOUBLE)
+            return -1;
+        /*endif*/
+        *type = size;
+        break;
+    case 'c':
+        if (size != ARG_INT)
+            return -1;
+        /*endif*/
+        *type = ARG_INT;
+        break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *type = (size == ARG_LDOUBLE)  ?  ARG_LDOUBLE  :  ARG_DOUBLE;
+        break;
+    case 's':
+        if (size != ARG_INT)
+            return -1;
+        /*endif*/
+        *type = ARG_STR;
+        break;
+    case 'p':
+        *type = ARG_PTR;
+        break;
+    default:
+        /* %n, wide characters, and anything unknown */
+        return -1;
+    }
+    /*endswitch*/
+    if (p - fmt + 2 > MAX_SPEC_LEN)
+        return -1;
+    /*endif*/
+    return p - fmt + 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+#define PACK(type, value) \
+    { \
+        type v = (value); \
+        if (len + 1 + (int) sizeof(v) > MAX_RECORD_LEN) \
+            return -1; \
+        buf[len++] = (uint8_t) arg_type; \
+        memcpy(buf + len, &v, sizeof(v)); \
+        len += sizeof(v); \
+    }
+
+/* Pack the arguments for a format into buf. Return the packed length, or -1 if the
+   format cannot be captured. */
+static int pack_args(uint8_t buf[], int len, const char *format, va_list arg_ptr)
+{
+    const char *p;
+    const char *s;
+    int spec_len;
+    int stars;
+    int precision;
+    int star_value;
+    int arg_type;
+    int str_len;
+
+    for (p = format;  *p;  p++)
+    {
+        if (*p != '%')
+            continue;
+        /*endif*/
+        if ((spec_len = parse_conversion(p + 1, &stars, &precision, &arg_type)) < 0)
+            return -1;
+        /*endif*/
+        p += spec_len;
+        star_value = 0;
+        while (stars--)
+        {
+            int star_type;
+
+            star_type = arg_type;
+            arg_type = ARG_INT;
+            star_value = va_arg(arg_ptr, int);
+            PACK(int, star_value);
+            arg_type = star_type;
+        }
+        /*endwhile*/
+        /* A '*' precision is always the last '*' argument. A negative one counts as
+           no precision at all. */
+        if (precision == PRECISION_STAR)
+            precision = (star_value >= 0)  ?  star_value  :  PRECISION_NONE;
+        /*endif*/
+        switch (arg_type)
+        {
+        case ARG_NONE:
+            break;
+        case ARG_INT:
+            PACK(int, va_arg(arg_ptr, int));
+            break;
+        case ARG_LONG:
+            PACK(long int, va_arg(arg_ptr, long int));
+            break;
+        case ARG_LLONG:
+            PACK(long long int, va_arg(arg_ptr, long long int));
+            break;
+        case ARG_INTMAX:
+            PACK(intmax_t, va_arg(arg_ptr, intmax_t));
+            break;
+        case ARG_SIZE:
+            PACK(size_t, va_arg(arg_ptr, size_t));
+            break;
+        case ARG_PTRDIFF:
+            PACK(ptrdiff_t, va_arg(arg_ptr, ptrdiff_t));
+            break;
+        case ARG_DOUBLE:
+            PACK(double, va_arg(arg_ptr, double));
+            break;
+        case ARG_LDOUBLE:
+            PACK(long double, va_arg(arg_ptr, long double));
+            break;
+        case ARG_PTR:
+            PACK(void *, va_arg(arg_ptr, void *));
+            break;
+        case ARG_STR:
+            if ((s = va_arg(arg_ptr, const char *)) == NULL)
+                s = "(null)";
+            /*endif*/
+            /* With a precision, the string need not be null terminated, so only look
+               as far as the precision allows */
+            str_len = (precision >= 0)  ?  strnlen(s, precision)  :  strlen(s);
+            if (len + 1 + str_len + 1 > MAX_RECORD_LEN)
+                return -1;
             /*endif*/
-            if ((s->level & SPAN_LOG_SHOW_SAMPLE_TIME))
+            buf[len++] = (uint8_t) arg_type;
+            memcpy(buf + len, s, str_len);
+            len += str_len;
+            buf[len++] = '\0';
+            break;
+        }
+        /*endswitch*/
+    }
+    /*endfor*/
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+#define UNPACK(type, value) \
+    { \
+        if (buf[len++] != arg_type) \
+            return -1; \
+        memcpy(&(value), buf + len, sizeof(type)); \
+        len += sizeof(type); \
+    }
+
+#define REPLAY(type) \
+    { \
+        type v; \
+        UNPACK(type, v); \
+        if (nstars == 2) \
+            out_len += snprintf(out + out_len, 1024 - out_len, spec, star[0], star[1], v); \
+        else if (nstars == 1) \
+            out_len += snprintf(out + out_len, 1024 - out_len, spec, star[0], v); \
+        else \
+            out_len += snprintf(out + out_len, 1024 - out_len, spec, v); \
+    }
+
+/* Format the packed arguments in buf, according to format, appending to out. */
+static int replay_args(char out[], int out_len, const char *format, const uint8_t buf[], int len)
+{
+    const char *p;
+    char spec[MAX_SPEC_LEN];
+    int spec_len;
+    int stars;
+    int nstars;
+    int star[2];
+    int precision;
+    int arg_type;
+    int str_len;
+
+    for (p = format;  *p  &&  out_len < 1024;  p++)
+    {
+        if (*p != '%')
+        {
+            out[out_len++] = *p;
+            continue;
+        }
+        /*endif*/
+        if ((spec_len = parse_conversion(p + 1, &stars, &precision, &arg_type)) < 0)
+            return -1;
+        /*endif*/
+        memcpy(spec, p, spec_len + 1);
+        spec[spec_len + 1] = '\0';
+        p += spec_len;
+        for (nstars = 0;  nstars < stars;  nstars++)
+        {
+            int star_type;
+
+            star_type = arg_type;
+            arg_type = ARG_INT;
+            UNPACK(int, star[nstars]);
+            arg_type = star_type;
+        }
+        /*endfor*/
+        switch (arg_type)
+        {
+        case ARG_NONE:
+            out[out_len++] = '%';
+            break;
+        case ARG_INT:
+            REPLAY(int);
+            break;
+        case ARG_LONG:
+            REPLAY(long int);
+            break;
+        case ARG_LLONG:
+            REPLAY(long long int);
+            break;
+        case ARG_INTMAX:
+            REPLAY(intmax_t);
+            break;
+        case ARG_SIZE:
+            REPLAY(size_t);
+            break;
+        case ARG_PTRDIFF:
+            REPLAY(ptrdiff_t);
+            break;
+        case ARG_DOUBLE:
+            REPLAY(double);
+            break;
+        case ARG_LDOUBLE:
+            REPLAY(long double);
+            break;
+        case ARG_PTR:
+            REPLAY(void *);
+            break;
+        case ARG_STR:
             {
-                now = s->elapsed_samples/s->samples_per_second;
-                tim = gmtime(&now);
-                len += snprintf(msg + len,
-                                1024 - len,
-                                "%02d:%02d:%02d.%03d ",
-                                tim->tm_hour,
-                                tim->tm_min,
-                                tim->tm_sec,
-                                (int) (s->elapsed_samples%s->samples_per_second)*1000/s->samples_per_second);
+                const char *v;
+
+                if (buf[len++] != arg_type)
+                    return -1;
+                /*endif*/
+                v = (const char *) buf + len;
+                str_len = strlen(v) + 1;
+                len += str_len;
+                if (nstars == 2)
+                    out_len += snprintf(out + out_len, 1024 - out_len, spec, star[0], star[1], v);
+                else if (nstars == 1)
+                    out_len += snprintf(out + out_len, 1024 - out_len, spec, star[0], v);
+                else
+                    out_len += snprintf(out + out_len, 1024 - out_len, spec, v);
+                /*endif*/
             }
-            /*endif*/
-            if ((s->level & SPAN_LOG_SHOW_SEVERITY)  &&  (level & SPAN_LOG_SEVERITY_MASK) <= SPAN_LOG_DEBUG_3)
-                len += snprintf(msg + len, 1024 - len, "%s ", severities[level & SPAN_LOG_SEVERITY_MASK]);
-            /*endif*/
-            if ((s->level & SPAN_LOG_SHOW_PROTOCOL)  &&  s->protocol)
-                len += snprintf(msg + len, 1024 - len, "%s ", s->protocol);
-            /*endif*/
-            if ((s->level & SPAN_LOG_SHOW_TAG)  &&  s->tag)
-                len += snprintf(msg + len, 1024 - len, "%s ", s->tag);
-            /*endif*/
+            break;
         }
+        /*endswitch*/
+    }
+    /*endfor*/
+    if (out_len > 1024)
+        out_len = 1024;
+    /*endif*/
+    out[out_len] = '\0';
+    return out_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static span_log_ring_t *get_thread_ring(void)
+{
+    span_log_ring_t *ring;
+    int generation;
+
+    generation = __atomic_load_n(&async_generation, __ATOMIC_ACQUIRE);
+    if (thread_ring  &&  thread_ring_generation == generation)
+        return thread_ring;
+    /*endif*/
+    /* Adopt a ring given up by a thread which has finished logging, or make a new one. */
+    for (ring = __atomic_load_n(&async_rings, __ATOMIC_ACQUIRE);  ring;  ring = ring->next)
+    {
+        int expected;
+
+        expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
         /*endif*/
-        len += vsnprintf(msg + len, 1024 - len, format, arg_ptr);
-        if (s->span_error  &&  level == SPAN_LOG_ERROR)
-            s->span_error(msg);
-        else if (__span_error  &&  level == SPAN_LOG_ERROR)
-            __span_error(msg);
-        else if (s->span_message)
-            s->span_message(level, msg);
-        else if (__span_message)
-            __span_message(level, msg);
+    }
+    /*endfor*/
+    if (ring == NULL)
+    {
+        if ((ring = (span_log_ring_t *) span_alloc(sizeof(*ring))) == NULL)
+            return NULL;
+        /*endif*/
+        memset(ring, 0, sizeof(*ring));
+        if ((ring->queue = queue_init(NULL, async_ring_size, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC | QUEUE_ATOMIC)) == NULL)
+        {
+            span_free(ring);
+            return NULL;
+        }
+        /*endif*/
+        ring->in_use = 1;
+        ring->next = __atomic_load_n(&async_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&async_rings, &ring->next, ring, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+        /*endwhile*/
+    }
+    /*endif*/
+    thread_ring = ring;
+    thread_ring_generation = generation;
+    return ring;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int log_async(logging_state_t *s, int level, const char *format, va_list arg_ptr)
+{
+    log_record_buf_t record;
+    uint8_t *buf;
+    log_record_t *rec;
+    span_log_ring_t *ring;
+    va_list arg_ptr2;
+    int len;
+    int packed_len;
+
+    if ((ring = get_thread_ring()) == NULL)
+        return -1;
+    /*endif*/
+    buf = record.buf;
+    rec = &record.rec;
+    rec->level = level;
+    rec->show = s->level;
+    rec->samples_per_second = s->samples_per_second;
+    rec->elapsed_samples = s->elapsed_samples;
+    if ((s->level & SPAN_LOG_SHOW_DATE))
+        gettimeofday(&rec->when, NULL);
+    /*endif*/
+    rec->span_message = s->span_message;
+    rec->span_error = s->span_error;
+    rec->protocol_len = (s->protocol)  ?  strlen(s->protocol) + 1  :  0;
+    rec->tag_len = (s->tag)  ?  strlen(s->tag) + 1  :  0;
+    rec->format_len = strlen(format) + 1;
+    rec->preformatted = FALSE;
+    len = sizeof(*rec);
+    if (len + rec->protocol_len + rec->tag_len + rec->format_len > MAX_RECORD_LEN)
+        return -1;
+    /*endif*/
+    if (s->protocol)
+        memcpy(buf + len, s->protocol, rec->protocol_len);
+    /*endif*/
+    len += rec->protocol_len;
+    if (s->tag)
+        memcpy(buf + len, s->tag, rec->tag_len);
+    /*endif*/
+    len += rec->tag_len;
+    memcpy(buf + len, format, rec->format_len);
+    len += rec->format_len;
+    va_copy(arg_ptr2, arg_ptr);
+    packed_len = pack_args(buf, len, format, arg_ptr2);
+    va_end(arg_ptr2);
+    if (packed_len < 0)
+    {
+        /* This one has to be formatted here and now */
+        len -= rec->format_len;
+        packed_len = vsnprintf((char *) buf + len, MAX_RECORD_LEN - len, format, arg_ptr);
+        if (packed_len >= MAX_RECORD_LEN - len)
+            packed_len = MAX_RECORD_LEN - len - 1;
+        /*endif*/
+        rec->format_len = packed_len + 1;
+        rec->preformatted = TRUE;
+        packed_len = len + rec->format_len;
+    }
+    /*endif*/
+    if (queue_write_msg(ring->queue, buf, packed_len) != packed_len)
+        ring->dropped++;
+    /*endif*/
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void replay_record(const uint8_t buf[], int len)
+{
+    const log_record_t *rec;
+    const char *protocol;
+    const char *tag;
+    const char *format;
+    char msg[1024 + 1];
+    int msg_len;
+    int i;
+
+    rec = (const log_record_t *) buf;
+    i = sizeof(*rec);
+    protocol = (rec->protocol_len)  ?  (const char *) buf + i  :  NULL;
+    i += rec->protocol_len;
+    tag = (rec->tag_len)  ?  (const char *) buf + i  :  NULL;
+    i += rec->tag_len;
+    format = (const char *) buf + i;
+    i += rec->format_len;
+    msg_len = format_labels(msg, rec->level, rec->show, &rec->when, rec->elapsed_samples, rec->samples_per_second, protocol, tag);
+    if (msg_len > 1024)
+        msg_len = 1024;
+    /*endif*/
+    if (rec->preformatted)
+        snprintf(msg + msg_len, 1024 - msg_len, "%s", format);
+    else if (replay_args(msg, msg_len, format, buf, i) < 0)
+        snprintf(msg + msg_len, 1024 - msg_len, "Corrupt log record\n");
+    /*endif*/
+    deliver(rec->level, msg, rec->span_message, rec->span_error);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_init(int ring_size)
+{
+    if (async_enabled)
+        return -1;
+    /*endif*/
+    async_ring_size = (ring_size > 0)  ?  ring_size  :  SPAN_LOG_ASYNC_DEFAULT_RING_SIZE;
+    __atomic_store_n(&async_enabled, TRUE, __ATOMIC_RELEASE);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_drain(void)
+{
+    log_record_buf_t record;
+    char msg[100];
+    span_log_ring_t *ring;
+    int dropped;
+    int len;
+    int n;
+
+    n = 0;
+    for (ring = __atomic_load_n(&async_rings, __ATOMIC_ACQUIRE);  ring;  ring = ring->next)
+    {
+        while ((len = queue_read_msg(ring->queue, record.buf, MAX_RECORD_LEN)) > 0)
+        {
+            replay_record(record.buf, len);
+            n++;
+        }
+        /*endwhile*/
+        if ((dropped = ring->dropped) != ring->dropped_reported)
+        {
+            snprintf(msg, sizeof(msg), "%d log messages dropped\n", dropped - ring->dropped_reported);
+            ring->dropped_reported = dropped;
+            deliver(SPAN_LOG_WARNING, msg, NULL, NULL);
+        }
         /*endif*/
+    }
+    /*endfor*/
+    return n;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_get_dropped(void)
+{
+    span_log_ring_t *ring;
+    int dropped;
+
+    dropped = 0;
+    for (ring = __atomic_load_n(&async_rings, __ATOMIC_ACQUIRE);  ring;  ring = ring->next)
+        dropped += ring->dropped;
+    /*endfor*/
+    return dropped;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_log_async_thread_done(void)
+{
+    if (thread_ring  &&  thread_ring_generation == __atomic_load_n(&async_generation, __ATOMIC_ACQUIRE))
+        __atomic_store_n(&thread_ring->in_use, 0, __ATOMIC_RELEASE);
+    /*endif*/
+    thread_ring = NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_release(void)
+{
+    span_log_ring_t *ring;
+    span_log_ring_t *next;
+
+    if (!async_enabled)
+        return -1;
+    /*endif*/
+    __atomic_store_n(&async_enabled, FALSE, __ATOMIC_RELEASE);
+    span_log_async_drain();
+    for (ring = async_rings;  ring;  ring = next)
+    {
+        next = ring->next;
+        queue_free(ring->queue);
+        span_free(ring);
+    }
+    /*endfor*/
+    async_rings = NULL;
+    /* Make any rings threads still point to stale */
+    __atomic_add_fetch(&async_generation, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+#else
+SPAN_DECLARE(int) span_log_async_init(int ring_size)
+{
+    return -1;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_drain(void)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_get_dropped(void)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_log_async_thread_done(void)
+{
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_log_async_release(void)
+{
+    return -1;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE(int) (span_log)(logging_state_t *s, int level, const char *format, ...)
+{
+    char msg[1024 + 1];
+    va_list arg_ptr;
+    int len;
+    struct timeval nowx;
+
+    if (span_log_test(s, level))
+    {
+        va_start(arg_ptr, format);
+#if defined(SPAN_LOG_ASYNC_SUPPORTED)
+        if (async_enabled  &&  log_async(s, level, format, arg_ptr) == 0)
+        {
+            va_end(arg_ptr);
+            return  1;
+        }
+        /*endif*/
+#endif
+        if ((s->level & SPAN_LOG_SHOW_DATE))
+            gettimeofday(&nowx, NULL);
+        /*endif*/
+        len = format_labels(msg, level, s->level, &nowx, s->elapsed_samples, s->samples_per_second, s->protocol, s->tag);
+        len += vsnprintf(msg + len, 1024 - len, format, arg_ptr);
+        deliver(level, msg, s->span_message, s->span_error);
         va_end(arg_ptr);
         return  1;
     }
@@ -155,7 +898,7 @@ SPAN_DECLARE(int) span_log(logging_state_t *s, int level, const char *format, ..
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) span_log_buf(logging_state_t *s, int level, const char *tag, const uint8_t *buf, int len)
+SPAN_DECLARE(int) (span_log_buf)(logging_state_t *s, int level, const char *tag, const uint8_t *buf, int len)
 {
     char msg[1024];
     int i;
@@ -175,6 +918,40 @@ SPAN_DECLARE(int) span_log_buf(logging_state_t *s, int level, const char *tag, c
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) (span_log_event)(logging_state_t *s, int level, int event, int32_t field0, int32_t field1, const uint8_t *buf, int len)
+{
+    span_log_event_t ev;
+
+    if (!span_log_test(s, level)  ||  s->span_event == NULL)
+        return 0;
+    /*endif*/
+    ev.level = level;
+    ev.event = event;
+    ev.protocol = s->protocol;
+    ev.tag = s->tag;
+    ev.elapsed_samples = s->elapsed_samples;
+    ev.field[0] = field0;
+    ev.field[1] = field1;
+    ev.data = buf;
+    ev.len = len;
+    s->span_event(s->span_event_user_data, &ev);
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) (span_log_event_test)(logging_state_t *s, int level)
+{
+    return (span_log_test(s, level)  &&  s->span_event);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_log_set_event_handler(logging_state_t *s, span_log_event_handler_func_t func, void *user_data)
+{
+    s->span_event = func;
+    s->span_event_user_data = user_data;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) span_log_set_level(logging_state_t *s, int level)
 {
     s->level = level;
@@ -243,11 +1020,13 @@ SPAN_DECLARE(logging_state_t *) span_log_init(logging_state_t *s, int level, con
 {
     if (s == NULL)
     {
-        if ((s = (logging_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (logging_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     s->span_error = __span_error;
     s->span_message = __span_message;
+    s->span_event = NULL;
+    s->span_event_user_data = NULL;
     s->level = level;
     s->tag = tag;
     s->protocol = NULL;
@@ -267,7 +1046,7 @@ SPAN_DECLARE(int) span_log_release(logging_state_t *s)
 SPAN_DECLARE(int) span_log_free(logging_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
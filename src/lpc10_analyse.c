@@ -50,6 +50,29 @@
 
 #include "lpc10_encdecs.h"
 
+#if defined(LPC10_WITH_SSE2)  ||  defined(LPC10_WITH_AVX2)
+#include <immintrin.h>
+#endif
+
+/* The log spaced lags used for the coarse AMDF pitch search */
+static const int32_t amdf_tau[60] =
+{
+    20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+    35, 36, 37, 38, 39, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58,
+    60, 62, 64, 66, 68, 70, 72, 74, 76, 78, 80, 84, 88, 92, 96,
+    100, 104, 108, 112, 116, 120, 124, 128, 132, 136, 140, 144,
+    148, 152, 156
+};
+
+/* The coefficients of the 31 point low pass filter, which is symmetric */
+static const float lpfilt_coeffs[16] =
+{
+    -0.0097201988f, -0.0105179986f, -0.0083479648f, 5.860774e-4f,
+    0.0130892089f, 0.0217052232f, 0.0184161253f, 3.39723e-4f,
+    -0.0260797087f, -0.0455563702f, -0.040306855f, 5.029835e-4f,
+    0.0729262903f, 0.1572008878f, 0.2247288674f, 0.250535965f
+};
+
 static __inline__ float energyf(float amp[], int len)
 {
     int i;
@@ -77,6 +100,22 @@ static void remove_dc_bias(float speech[], int len, float sigout[])
 }
 /*- End of function --------------------------------------------------------*/
 
+static void find_amdf_extremes(float amdf[], int32_t ltau, int32_t *minptr, int32_t *maxptr)
+{
+    int i;
+
+    *minptr = 0;
+    *maxptr = 0;
+    for (i = 0;  i < ltau;  i++)
+    {
+        if (amdf[i] < amdf[*minptr])
+            *minptr = i;
+        if (amdf[i] > amdf[*maxptr])
+            *maxptr = i;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 static void eval_amdf(float speech[],
                       int32_t lpita,
                       const int32_t tau[], 
@@ -92,8 +131,6 @@ static void eval_amdf(float speech[],
     int n1;
     int n2;
 
-    *minptr = 0;
-    *maxptr = 0;
     for (i = 0;  i < ltau;  i++)
     {
         n1 = (maxlag - tau[i])/2 + 1;
@@ -102,11 +139,8 @@ static void eval_amdf(float speech[],
         for (j = n1;  j <= n2;  j += 4)
             sum += fabsf(speech[j - 1] - speech[j + tau[i] - 1]);
         amdf[i] = sum;
-        if (amdf[i] < amdf[*minptr])
-            *minptr = i;
-        if (amdf[i] > amdf[*maxptr])
-            *maxptr = i;
     }
+    find_amdf_extremes(amdf, ltau, minptr, maxptr);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -129,8 +163,8 @@ static void eval_highres_amdf(float speech[],
     int i2;
     int ptr;
 
-    /* Compute full AMDF using log spaced lags, find coarse minimum */
-    eval_amdf(speech, lpita, tau, ltau, tau[ltau - 1], amdf, minptr, maxptr);
+    /* The full AMDF, using the log spaced lags, and its coarse minimum and maximum, have
+       already been found */
     *mintau = tau[*minptr];
     minamd = (int32_t) amdf[*minptr];
 
@@ -193,6 +227,132 @@ static void eval_highres_amdf(float speech[],
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(LPC10_WITH_SSE2)  ||  defined(LPC10_WITH_AVX2)
+/* Copy the inverse filtered speech of a group of channels into a single buffer, with the
+   channels interleaved, so each lane of a vector can work on a different channel. */
+static void interleave_ivbuf(float buf[][LPC10_LANES], lpc10_encode_state_t *s[], int channels, int len)
+{
+    int i;
+    int ch;
+
+    for (i = 0;  i < len;  i++)
+    {
+        for (ch = 0;  ch < channels;  ch++)
+            buf[i][ch] = s[ch]->ivbuf[i];
+        for (  ;  ch < LPC10_LANES;  ch++)
+            buf[i][ch] = 0.0f;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#endif
+
+#if defined(LPC10_WITH_SSE2)
+__attribute__((target("sse2"))) static void amdf_lanes_sse2(lpc10_encode_state_t *s[],
+                                                            int channels,
+                                                            float amdf[][60],
+                                                            int32_t minptr[],
+                                                            int32_t maxptr[])
+{
+    float buf[312][LPC10_LANES] __attribute__((aligned(16)));
+    float sums[60][LPC10_LANES] __attribute__((aligned(16)));
+    __m128 mask;
+    __m128 sum_lo;
+    __m128 sum_hi;
+    int i;
+    int j;
+    int n1;
+    int n2;
+    int ch;
+
+    interleave_ivbuf(buf, s, channels, 312);
+    mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (i = 0;  i < 60;  i++)
+    {
+        n1 = (156 - amdf_tau[i])/2 + 1;
+        n2 = n1 + 156 - 1;
+        sum_lo = _mm_setzero_ps();
+        sum_hi = _mm_setzero_ps();
+        for (j = n1;  j <= n2;  j += 4)
+        {
+            sum_lo = _mm_add_ps(sum_lo, _mm_and_ps(_mm_sub_ps(_mm_load_ps(&buf[j - 1][0]), _mm_load_ps(&buf[j + amdf_tau[i] - 1][0])), mask));
+            sum_hi = _mm_add_ps(sum_hi, _mm_and_ps(_mm_sub_ps(_mm_load_ps(&buf[j - 1][4]), _mm_load_ps(&buf[j + amdf_tau[i] - 1][4])), mask));
+        }
+        _mm_store_ps(&sums[i][0], sum_lo);
+        _mm_store_ps(&sums[i][4], sum_hi);
+    }
+    for (ch = 0;  ch < channels;  ch++)
+    {
+        for (i = 0;  i < 60;  i++)
+            amdf[ch][i] = sums[i][ch];
+        find_amdf_extremes(amdf[ch], 60, &minptr[ch], &maxptr[ch]);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(LPC10_WITH_AVX2)
+__attribute__((target("avx2"))) static void amdf_lanes_avx2(lpc10_encode_state_t *s[],
+                                                            int channels,
+                                                            float amdf[][60],
+                                                            int32_t minptr[],
+                                                            int32_t maxptr[])
+{
+    float buf[312][LPC10_LANES] __attribute__((aligned(32)));
+    float sums[60][LPC10_LANES] __attribute__((aligned(32)));
+    __m256 mask;
+    __m256 sum;
+    int i;
+    int j;
+    int n1;
+    int n2;
+    int ch;
+
+    interleave_ivbuf(buf, s, channels, 312);
+    mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    for (i = 0;  i < 60;  i++)
+    {
+        n1 = (156 - amdf_tau[i])/2 + 1;
+        n2 = n1 + 156 - 1;
+        sum = _mm256_setzero_ps();
+        for (j = n1;  j <= n2;  j += 4)
+            sum = _mm256_add_ps(sum, _mm256_and_ps(_mm256_sub_ps(_mm256_load_ps(&buf[j - 1][0]), _mm256_load_ps(&buf[j + amdf_tau[i] - 1][0])), mask));
+        _mm256_store_ps(&sums[i][0], sum);
+    }
+    for (ch = 0;  ch < channels;  ch++)
+    {
+        for (i = 0;  i < 60;  i++)
+            amdf[ch][i] = sums[i][ch];
+        find_amdf_extremes(amdf[ch], 60, &minptr[ch], &maxptr[ch]);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+void lpc10_amdf_lanes(lpc10_encode_state_t *s[], int channels, float amdf[][60], int32_t minptr[], int32_t maxptr[])
+{
+    int ch;
+
+    switch (lpc10_get_implementation())
+    {
+#if defined(LPC10_WITH_AVX2)
+    case LPC10_IMPLEMENTATION_AVX2:
+        amdf_lanes_avx2(s, channels, amdf, minptr, maxptr);
+        break;
+#endif
+#if defined(LPC10_WITH_SSE2)
+    case LPC10_IMPLEMENTATION_SSE2:
+        amdf_lanes_sse2(s, channels, amdf, minptr, maxptr);
+        break;
+#endif
+    default:
+        for (ch = 0;  ch < channels;  ch++)
+            eval_amdf(s[ch]->ivbuf, 156, amdf_tau, 60, 156, amdf[ch], &minptr[ch], &maxptr[ch]);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 static void dynamic_pitch_tracking(lpc10_encode_state_t *s,
                                    float amdf[],
                                    int32_t ltau,
@@ -364,6 +524,69 @@ static void onset(lpc10_encode_state_t *s,
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(LPC10_WITH_SSE2)
+/* Vectors of the lagged speech, loaded in reverse lag order, let each lane accumulate
+   one element of the first column of phi, with the same sequence of operations as the
+   generic code. */
+__attribute__((target("sse2"))) static void mload_phi_sse2(int32_t start, int32_t awinf, float speech[], float phi[])
+{
+    float t[12];
+    __m128 x;
+    __m128 phi1_4;
+    __m128 phi5_8;
+    __m128 phi7_10;
+    int i;
+    int r;
+
+    phi1_4 = _mm_setzero_ps();
+    phi5_8 = _mm_setzero_ps();
+    phi7_10 = _mm_setzero_ps();
+    for (i = start;  i <= awinf;  i++)
+    {
+        x = _mm_set1_ps(speech[i - 2]);
+        phi1_4 = _mm_add_ps(phi1_4, _mm_mul_ps(x, _mm_loadu_ps(&speech[i - 5])));
+        phi5_8 = _mm_add_ps(phi5_8, _mm_mul_ps(x, _mm_loadu_ps(&speech[i - 9])));
+        phi7_10 = _mm_add_ps(phi7_10, _mm_mul_ps(x, _mm_loadu_ps(&speech[i - 11])));
+    }
+    _mm_storeu_ps(&t[0], phi1_4);
+    _mm_storeu_ps(&t[4], phi5_8);
+    _mm_storeu_ps(&t[8], phi7_10);
+    for (r = 1;  r <= 4;  r++)
+        phi[r - 1] = t[4 - r];
+    for (r = 5;  r <= 8;  r++)
+        phi[r - 1] = t[12 - r];
+    phi[8] = t[9];
+    phi[9] = t[8];
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(LPC10_WITH_AVX2)
+__attribute__((target("avx2"))) static void mload_phi_avx2(int32_t start, int32_t awinf, float speech[], float phi[])
+{
+    float t[12];
+    __m256 phi1_8;
+    __m128 phi7_10;
+    int i;
+    int r;
+
+    phi1_8 = _mm256_setzero_ps();
+    phi7_10 = _mm_setzero_ps();
+    for (i = start;  i <= awinf;  i++)
+    {
+        phi1_8 = _mm256_add_ps(phi1_8, _mm256_mul_ps(_mm256_set1_ps(speech[i - 2]), _mm256_loadu_ps(&speech[i - 9])));
+        phi7_10 = _mm_add_ps(phi7_10, _mm_mul_ps(_mm_set1_ps(speech[i - 2]), _mm_loadu_ps(&speech[i - 11])));
+    }
+    _mm256_storeu_ps(&t[0], phi1_8);
+    _mm_storeu_ps(&t[8], phi7_10);
+    for (r = 1;  r <= 8;  r++)
+        phi[r - 1] = t[8 - r];
+    phi[8] = t[9];
+    phi[9] = t[8];
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
 /* Load a covariance matrix. */
 static void mload(int32_t order, int32_t awins, int32_t awinf, float speech[], float phi[], float psi[])
 {
@@ -372,11 +595,26 @@ static void mload(int32_t order, int32_t awins, int32_t awinf, float speech[], f
     int r;
 
     start = awins + order;
-    for (r = 1;  r <= order;  r++)
+    switch ((order == LPC10_ORDER)  ?  lpc10_get_implementation()  :  LPC10_IMPLEMENTATION_GENERIC)
     {
-        phi[r - 1] = 0.0f;
-        for (i = start;  i <= awinf;  i++)
-            phi[r - 1] += speech[i - 2]*speech[i - r - 1];
+#if defined(LPC10_WITH_AVX2)
+    case LPC10_IMPLEMENTATION_AVX2:
+        mload_phi_avx2(start, awinf, speech, phi);
+        break;
+#endif
+#if defined(LPC10_WITH_SSE2)
+    case LPC10_IMPLEMENTATION_SSE2:
+        mload_phi_sse2(start, awinf, speech, phi);
+        break;
+#endif
+    default:
+        for (r = 1;  r <= order;  r++)
+        {
+            phi[r - 1] = 0.0f;
+            for (i = start;  i <= awinf;  i++)
+                phi[r - 1] += speech[i - 2]*speech[i - r - 1];
+        }
+        break;
     }
 
     /* Load last element of vector PSI */
@@ -475,7 +713,7 @@ static int rcchk(int order, float rc1f[], float rc2f[])
 }
 /*- End of function --------------------------------------------------------*/
 
-static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
+static void lpfilt_generic(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
 {
     int32_t j;
     float t;
@@ -508,6 +746,70 @@ static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(LPC10_WITH_SSE2)
+/* Each lane of each vector carries out exactly the same sequence of operations as the
+   generic code does for one output sample, so the results are identical. */
+__attribute__((target("sse2"))) static void lpfilt_sse2(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
+{
+    int32_t j;
+    int k;
+    __m128 t;
+
+    for (j = len - nsamp;  j < len;  j += 4)
+    {
+        t = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&inbuf[j]), _mm_loadu_ps(&inbuf[j - 30])), _mm_set1_ps(lpfilt_coeffs[0]));
+        for (k = 1;  k < 15;  k++)
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&inbuf[j - k]), _mm_loadu_ps(&inbuf[j - 30 + k])), _mm_set1_ps(lpfilt_coeffs[k])));
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(&inbuf[j - 15]), _mm_set1_ps(lpfilt_coeffs[15])));
+        _mm_storeu_ps(&lpbuf[j], t);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+#if defined(LPC10_WITH_AVX2)
+__attribute__((target("avx2"))) static void lpfilt_avx2(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
+{
+    int32_t j;
+    int k;
+    __m256 t;
+
+    for (j = len - nsamp;  j <= len - 8;  j += 8)
+    {
+        t = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(&inbuf[j]), _mm256_loadu_ps(&inbuf[j - 30])), _mm256_set1_ps(lpfilt_coeffs[0]));
+        for (k = 1;  k < 15;  k++)
+            t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(&inbuf[j - k]), _mm256_loadu_ps(&inbuf[j - 30 + k])), _mm256_set1_ps(lpfilt_coeffs[k])));
+        t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_loadu_ps(&inbuf[j - 15]), _mm256_set1_ps(lpfilt_coeffs[15])));
+        _mm256_storeu_ps(&lpbuf[j], t);
+    }
+    /* A frame is not a whole number of 8 sample blocks, but it is of 4 sample ones */
+    if (j < len)
+        lpfilt_sse2(inbuf, lpbuf, len, len - j);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void lpfilt(float inbuf[], float lpbuf[], int32_t len, int32_t nsamp)
+{
+    switch (lpc10_get_implementation())
+    {
+#if defined(LPC10_WITH_AVX2)
+    case LPC10_IMPLEMENTATION_AVX2:
+        lpfilt_avx2(inbuf, lpbuf, len, nsamp);
+        break;
+#endif
+#if defined(LPC10_WITH_SSE2)
+    case LPC10_IMPLEMENTATION_SSE2:
+        lpfilt_sse2(inbuf, lpbuf, len, nsamp);
+        break;
+#endif
+    default:
+        lpfilt_generic(inbuf, lpbuf, len, nsamp);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 /* 2nd order inverse filter, speech is decimated 4:1 */
 static void ivfilt(float lpbuf[], float ivbuf[], int32_t len, int32_t nsamp, float ivrc[])
 {
@@ -544,38 +846,13 @@ static void ivfilt(float lpbuf[], float ivbuf[], int32_t len, int32_t nsamp, flo
 }
 /*- End of function --------------------------------------------------------*/
 
-void lpc10_analyse(lpc10_encode_state_t *s, float speech[], int32_t voice[], int32_t *pitch, float *rms, float rc[])
+void lpc10_analyse_start(lpc10_encode_state_t *s, float speech[], float ivrc[])
 {
-    static const int32_t tau[60] =
-    {
-        20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 
-        35, 36, 37, 38, 39, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58,
-        60, 62, 64, 66, 68, 70, 72, 74, 76, 78, 80, 84, 88, 92, 96,
-        100, 104, 108, 112, 116, 120, 124, 128, 132, 136, 140, 144,
-        148, 152, 156
-    };
-    static const int32_t buflim[4] =
-    {
-        181, 720, 25, 720
-    };
     static const float precoef = 0.9375f;
 
-    float amdf[60];
-    float abuf[156];
-    float ivrc[2];
     float temp;
-    float phi[100]    /* was [10][10] */;
-    float psi[10];
-    int32_t half;
-    int32_t midx;
-    int32_t ewin[3][2];
     int32_t i;
     int32_t j;
-    int32_t lanal;
-    int32_t ipitch;
-    int32_t mintau;
-    int32_t minptr;
-    int32_t maxptr;
 
     /* Calculations are done on future frame due to requirements
        of the pitch tracker.  Delay RMS and RC's 2 frames to give
@@ -649,10 +926,39 @@ void lpc10_analyse(lpc10_encode_state_t *s, float speech[], int32_t voice[], int
        of LPBUF, and writes indices (PWINH-LFRAME+1) = 361 through
        PWINH = 540 of IVBUF. */
     ivfilt(&s->lpbuf[204], s->ivbuf, 312, LPC10_SAMPLES_PER_FRAME, ivrc);
+}
+/*- End of function --------------------------------------------------------*/
+
+void lpc10_analyse_finish(lpc10_encode_state_t *s,
+                          float amdf[],
+                          int32_t minptr,
+                          int32_t maxptr,
+                          float ivrc[],
+                          int32_t voice[],
+                          int32_t *pitch,
+                          float *rms,
+                          float rc[])
+{
+    static const int32_t buflim[4] =
+    {
+        181, 720, 25, 720
+    };
+
+    float abuf[156];
+    float phi[100]    /* was [10][10] */;
+    float psi[10];
+    int32_t half;
+    int32_t midx;
+    int32_t ewin[3][2];
+    int32_t i;
+    int32_t lanal;
+    int32_t ipitch;
+    int32_t mintau;
+
     /* eval_highres_amdf reads indices PWINL = 229 through
        (PWINL-1)+MAXWIN+(TAU(LTAU)-TAU(1))/2 = 452 of IVBUF, and writes
        indices 1 through LTAU = 60 of AMDF. */
-    eval_highres_amdf(s->ivbuf, 156, tau, 60, amdf, &minptr, &maxptr, &mintau);
+    eval_highres_amdf(s->ivbuf, 156, amdf_tau, 60, amdf, &minptr, &maxptr, &mintau);
     /* Voicing decisions are made for each half frame of input speech.
        An initial voicing classification is made for each half of the
        analysis frame, and the voicing decisions for the present frame
@@ -683,7 +989,7 @@ void lpc10_analyse(lpc10_encode_state_t *s, float speech[], int32_t voice[], int
        given the current voicing decision and the AMDF array */
     minptr++;
     dynamic_pitch_tracking(s, amdf, 60, &minptr, s->voibuf[3][1], pitch, &midx);
-    ipitch = tau[midx - 1];
+    ipitch = amdf_tau[midx - 1];
     /* Place spectrum analysis and energy windows */
     lpc10_placea(&ipitch, s->voibuf, &s->obound[2], 3, s->vwin, s->awin, ewin, LPC10_SAMPLES_PER_FRAME, 156);
     /* Remove short term DC bias over the analysis window. */
@@ -705,4 +1011,18 @@ void lpc10_analyse(lpc10_encode_state_t *s, float speech[], int32_t voice[], int
         rc[i] = s->rcbuf[0][i];
 }
 /*- End of function --------------------------------------------------------*/
+
+void lpc10_analyse(lpc10_encode_state_t *s, float speech[], int32_t voice[], int32_t *pitch, float *rms, float rc[])
+{
+    float amdf[60];
+    float ivrc[2];
+    int32_t minptr;
+    int32_t maxptr;
+
+    lpc10_analyse_start(s, speech, ivrc);
+    /* Compute full AMDF using log spaced lags, find coarse minimum */
+    eval_amdf(s->ivbuf, 156, amdf_tau, 60, 156, amdf, &minptr, &maxptr);
+    lpc10_analyse_finish(s, amdf, minptr, maxptr, ivrc, voice, pitch, rms, rc);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
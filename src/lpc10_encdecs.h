@@ -25,6 +25,16 @@
 
 #define LPC10_ORDER     10
 
+/*! The number of channels whose pitch analysis can be done in lockstep */
+#define LPC10_LANES     8
+
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define LPC10_WITH_SSE2
+#define LPC10_WITH_AVX2
+#endif
+#endif
+
 #if !defined(min)
 #define min(a,b) ((a) <= (b) ? (a) : (b))
 #endif
@@ -68,6 +78,22 @@ void lpc10_voicing(lpc10_encode_state_t *st,
 
 void lpc10_analyse(lpc10_encode_state_t *st, float *speech, int32_t *voice, int32_t *pitch, float *rms, float rc[]);
 
+/* The analysis may also be done in three steps, so the AMDF pitch search of a group of
+   channels can be done together, by lpc10_amdf_lanes(). */
+void lpc10_analyse_start(lpc10_encode_state_t *st, float *speech, float ivrc[]);
+
+void lpc10_amdf_lanes(lpc10_encode_state_t *st[], int channels, float amdf[][60], int32_t minptr[], int32_t maxptr[]);
+
+void lpc10_analyse_finish(lpc10_encode_state_t *st,
+                          float amdf[],
+                          int32_t minptr,
+                          int32_t maxptr,
+                          float ivrc[],
+                          int32_t *voice,
+                          int32_t *pitch,
+                          float *rms,
+                          float rc[]);
+
 static __inline__ int32_t pow_ii(int32_t x, int32_t n)
 {
     int32_t pow;
@@ -44,10 +44,12 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/lpc10.h"
 #include "spandsp/private/lpc10.h"
 
+#include "mmx_sse_decs.h"
 #include "lpc10_encdecs.h"
 
 static void lpc10_pack(lpc10_encode_state_t *s, uint8_t ibits[], lpc10_frame_t *t)
@@ -241,26 +243,38 @@ static int encode(lpc10_encode_state_t *s,
 }
 /*- End of function --------------------------------------------------------*/
 
-static void high_pass_100hz(lpc10_encode_state_t *s, float speech[], int start, int len)
+static __inline__ void high_pass_100hz(lpc10_encode_state_t *s, float speech[], int start, int len)
 {
     float si;
     float err;
+    float z11;
+    float z21;
+    float z12;
+    float z22;
     int i;
 
     /* 100 Hz high pass filter */
+    z11 = s->z11;
+    z21 = s->z21;
+    z12 = s->z12;
+    z22 = s->z22;
     for (i = start;  i < len;  i++)
     {
         si = speech[i];
-        err = si + s->z11*1.859076f - s->z21*0.8648249f;
-        si = err - s->z11*2.0f + s->z21;
-        s->z21 = s->z11;
-        s->z11 = err;
-        err = si + s->z12*1.935715f - s->z22*0.9417004f;
-        si = err - s->z12*2.0f + s->z22;
-        s->z22 = s->z12;
-        s->z12 = err;
+        err = si + z11*1.859076f - z21*0.8648249f;
+        si = err - z11*2.0f + z21;
+        z21 = z11;
+        z11 = err;
+        err = si + z12*1.935715f - z22*0.9417004f;
+        si = err - z12*2.0f + z22;
+        z22 = z12;
+        z12 = err;
         speech[i] = si*0.902428f;
     }
+    s->z11 = z11;
+    s->z21 = z21;
+    s->z12 = z12;
+    s->z22 = z22;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -271,7 +285,7 @@ SPAN_DECLARE(lpc10_encode_state_t *) lpc10_encode_init(lpc10_encode_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (lpc10_encode_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (lpc10_encode_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
 
@@ -369,7 +383,7 @@ SPAN_DECLARE(int) lpc10_encode_release(lpc10_encode_state_t *s)
 
 SPAN_DECLARE(int) lpc10_encode_free(lpc10_encode_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -398,4 +412,117 @@ SPAN_DECLARE(int) lpc10_encode(lpc10_encode_state_t *s, uint8_t code[], const in
     return len*7;
 }
 /*- End of function --------------------------------------------------------*/
+
+/* Encode one frame for each of a group of up to LPC10_LANES channels */
+static void encode_lanes(lpc10_encode_state_t *s[],
+                         uint8_t *code[],
+                         const int16_t *amp[],
+                         int channels,
+                         int frame_no)
+{
+    int32_t voice[2];
+    int32_t pitch;
+    int32_t minptr[LPC10_LANES];
+    int32_t maxptr[LPC10_LANES];
+    float speech[LPC10_SAMPLES_PER_FRAME];
+    float amdf[LPC10_LANES][60];
+    float ivrc[LPC10_LANES][2];
+    float rc[LPC10_ORDER];
+    float rms;
+    lpc10_frame_t frame;
+    int ch;
+    int j;
+
+    for (ch = 0;  ch < channels;  ch++)
+    {
+        for (j = 0;  j < LPC10_SAMPLES_PER_FRAME;  j++)
+            speech[j] = (float) amp[ch][frame_no*LPC10_SAMPLES_PER_FRAME + j]/32768.0f;
+        high_pass_100hz(s[ch], speech, 0, LPC10_SAMPLES_PER_FRAME);
+        lpc10_analyse_start(s[ch], speech, ivrc[ch]);
+    }
+    lpc10_amdf_lanes(s, channels, amdf, minptr, maxptr);
+    for (ch = 0;  ch < channels;  ch++)
+    {
+        lpc10_analyse_finish(s[ch], amdf[ch], minptr[ch], maxptr[ch], ivrc[ch], voice, &pitch, &rms, rc);
+        encode(s[ch], &frame, voice, pitch, rms, rc);
+        lpc10_pack(s[ch], &code[ch][7*frame_no], &frame);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) lpc10_encode_multi(lpc10_encode_state_t *s[],
+                                     uint8_t *code[],
+                                     const int16_t *amp[],
+                                     int channels,
+                                     int len)
+{
+    int i;
+    int ch;
+
+    if (channels <= 0  ||  len%LPC10_SAMPLES_PER_FRAME)
+        return -1;
+    len /= LPC10_SAMPLES_PER_FRAME;
+    if (lpc10_get_implementation() == LPC10_IMPLEMENTATION_GENERIC)
+    {
+        for (ch = 0;  ch < channels;  ch++)
+            lpc10_encode(s[ch], code[ch], amp[ch], len*LPC10_SAMPLES_PER_FRAME);
+        return len*7;
+    }
+    for (i = 0;  i < len;  i++)
+    {
+        for (ch = 0;  ch < channels;  ch += LPC10_LANES)
+            encode_lanes(&s[ch], &code[ch], &amp[ch], (channels - ch < LPC10_LANES)  ?  (channels - ch)  :  LPC10_LANES, i);
+    }
+    return len*7;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int lpc10_implementation = LPC10_IMPLEMENTATION_AUTO;
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case LPC10_IMPLEMENTATION_GENERIC:
+        return TRUE;
+#if defined(LPC10_WITH_SSE2)
+    case LPC10_IMPLEMENTATION_SSE2:
+        return has_SSE2();
+#endif
+#if defined(LPC10_WITH_AVX2)
+    case LPC10_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) lpc10_set_implementation(int implementation)
+{
+    if (implementation == LPC10_IMPLEMENTATION_AUTO)
+    {
+        if (implementation_available(LPC10_IMPLEMENTATION_AVX2))
+            implementation = LPC10_IMPLEMENTATION_AVX2;
+        else if (implementation_available(LPC10_IMPLEMENTATION_SSE2))
+            implementation = LPC10_IMPLEMENTATION_SSE2;
+        else
+            implementation = LPC10_IMPLEMENTATION_GENERIC;
+    }
+    else if (!implementation_available(implementation))
+    {
+        return -1;
+    }
+    lpc10_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) lpc10_get_implementation(void)
+{
+    if (lpc10_implementation == LPC10_IMPLEMENTATION_AUTO)
+        lpc10_set_implementation(LPC10_IMPLEMENTATION_AUTO);
+    return lpc10_implementation;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
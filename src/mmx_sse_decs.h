@@ -54,6 +54,18 @@
 #include <bmmintrin.h>
 #endif
 
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+/* Run time CPU feature checks, from testcpuid.c. These allow code compiled for a
+   baseline CPU to switch to faster routines where the CPU supports them. */
+int has_AVX(void);
+int has_PCLMUL(void);
+int has_SSE2(void);
+int has_SSE4_1(void);
+int has_AVX2(void);
+int has_AVX512F(void);
+int has_AVX512BW(void);
+#endif
+
 #endif
 
 /*- End of include ---------------------------------------------------------*/
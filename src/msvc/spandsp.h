@@ -55,6 +55,7 @@
 #include <spandsp/schedule.h>
 #include <spandsp/g711.h>
 #include <spandsp/timing.h>
+#include <spandsp/stats.h>
 #include <spandsp/math_fixed.h>
 #include <spandsp/vector_float.h>
 #include <spandsp/complex_vector_float.h>
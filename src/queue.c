@@ -39,13 +39,119 @@
 
 #define SPANDSP_FULLY_DEFINE_QUEUE_STATE_T
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/queue.h"
 
 #include "spandsp/private/queue.h"
 
+/* In QUEUE_ATOMIC mode each end of the queue publishes its pointer with release
+   semantics, and picks up the other end's pointer with acquire semantics, so the
+   data in the buffer is always visible before the pointer which hands it over. */
+#if defined(__ATOMIC_ACQUIRE)
+#define load_acquire(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#elif defined(HAVE_STDATOMIC_H)
+#include <stdatomic.h>
+#define load_acquire(p)         atomic_load_explicit((volatile _Atomic int *) (p), memory_order_acquire)
+#define store_release(p, v)     atomic_store_explicit((volatile _Atomic int *) (p), (v), memory_order_release)
+#else
+/* Fall back on the volatile pointers, which is sufficient for compilers, like MSVC,
+   which give volatile accesses acquire and release semantics. */
+#define load_acquire(p)         (*(p))
+#define store_release(p, v)     (*(p) = (v))
+#endif
+
+static __inline__ int get_iptr(queue_state_t *s)
+{
+    if ((s->flags & QUEUE_ATOMIC))
+        return load_acquire(&s->iptr);
+    /*endif*/
+    return s->iptr;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int get_optr(queue_state_t *s)
+{
+    if ((s->flags & QUEUE_ATOMIC))
+        return load_acquire(&s->optr);
+    /*endif*/
+    return s->optr;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void set_iptr(queue_state_t *s, int iptr)
+{
+    if ((s->flags & QUEUE_ATOMIC))
+        store_release(&s->iptr, iptr);
+    else
+        s->iptr = iptr;
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void set_optr(queue_state_t *s, int optr)
+{
+    if ((s->flags & QUEUE_ATOMIC))
+        store_release(&s->optr, optr);
+    else
+        s->optr = optr;
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Find the input pointer, as seen by the reader, when the reader needs len bytes.
+   In QUEUE_ATOMIC mode the writer's cache line is only touched when the contents
+   already known about are insufficient. */
+static __inline__ int reader_iptr(queue_state_t *s, int optr, int len)
+{
+    int iptr;
+    int real_len;
+
+    if (!(s->flags & QUEUE_ATOMIC))
+        return s->iptr;
+    /*endif*/
+    iptr = s->iptr_cache;
+    if ((real_len = iptr - optr) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (real_len < len)
+    {
+        iptr = load_acquire(&s->iptr);
+        s->iptr_cache = iptr;
+    }
+    /*endif*/
+    return iptr;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Find the output pointer, as seen by the writer, when the writer needs len bytes.
+   The output pointer only ever moves on, so an old sight of it can only understate
+   the free space. */
+static __inline__ int writer_optr(queue_state_t *s, int iptr, int len)
+{
+    int optr;
+    int real_len;
+
+    if (!(s->flags & QUEUE_ATOMIC))
+        return s->optr;
+    /*endif*/
+    optr = s->optr_cache;
+    if ((real_len = optr - iptr - 1) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (real_len < len)
+    {
+        optr = load_acquire(&s->optr);
+        s->optr_cache = optr;
+    }
+    /*endif*/
+    return optr;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) queue_empty(queue_state_t *s)
 {
-    return (s->iptr == s->optr);
+    return (get_iptr(s) == get_optr(s));
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -53,7 +159,7 @@ SPAN_DECLARE(int) queue_free_space(queue_state_t *s)
 {
     int len;
     
-    if ((len = s->optr - s->iptr - 1) < 0)
+    if ((len = get_optr(s) - get_iptr(s) - 1) < 0)
         len += s->len;
     /*endif*/
     return len;
@@ -64,7 +170,7 @@ SPAN_DECLARE(int) queue_contents(queue_state_t *s)
 {
     int len;
     
-    if ((len = s->iptr - s->optr) < 0)
+    if ((len = get_iptr(s) - get_optr(s)) < 0)
         len += s->len;
     /*endif*/
     return len;
@@ -73,7 +179,11 @@ SPAN_DECLARE(int) queue_contents(queue_state_t *s)
 
 SPAN_DECLARE(void) queue_flush(queue_state_t *s)
 {
-    s->optr = s->iptr;
+    int iptr;
+
+    iptr = get_iptr(s);
+    s->iptr_cache = iptr;
+    set_optr(s, iptr);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -85,8 +195,8 @@ SPAN_DECLARE(int) queue_view(queue_state_t *s, uint8_t *buf, int len)
     int optr;
     
     /* Snapshot the values (although only iptr should be changeable during this processing) */
-    iptr = s->iptr;
     optr = s->optr;
+    iptr = reader_iptr(s, optr, len);
     if ((real_len = iptr - optr) < 0)
         real_len += s->len;
     /*endif*/
@@ -136,8 +246,8 @@ SPAN_DECLARE(int) queue_read(queue_state_t *s, uint8_t *buf, int len)
     int optr;
     
     /* Snapshot the values (although only iptr should be changeable during this processing) */
-    iptr = s->iptr;
     optr = s->optr;
+    iptr = reader_iptr(s, optr, len);
     if ((real_len = iptr - optr) < 0)
         real_len += s->len;
     /*endif*/
@@ -180,7 +290,7 @@ SPAN_DECLARE(int) queue_read(queue_state_t *s, uint8_t *buf, int len)
     }
     /*endif*/
     /* Only change the pointer now we have really finished */
-    s->optr = new_optr;
+    set_optr(s, new_optr);
     return real_len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -193,8 +303,8 @@ SPAN_DECLARE(int) queue_read_byte(queue_state_t *s)
     int byte;
     
     /* Snapshot the values (although only iptr should be changeable during this processing) */
-    iptr = s->iptr;
     optr = s->optr;
+    iptr = reader_iptr(s, optr, 1);
     if ((real_len = iptr - optr) < 0)
         real_len += s->len;
     /*endif*/
@@ -206,7 +316,7 @@ SPAN_DECLARE(int) queue_read_byte(queue_state_t *s)
         optr = 0;
     /*endif*/
     /* Only change the pointer now we have really finished */
-    s->optr = optr;
+    set_optr(s, optr);
     return byte;
 }
 /*- End of function --------------------------------------------------------*/
@@ -221,7 +331,7 @@ SPAN_DECLARE(int) queue_write(queue_state_t *s, const uint8_t *buf, int len)
 
     /* Snapshot the values (although only optr should be changeable during this processing) */
     iptr = s->iptr;
-    optr = s->optr;
+    optr = writer_optr(s, iptr, len);
 
     if ((real_len = optr - iptr - 1) < 0)
         real_len += s->len;
@@ -259,7 +369,7 @@ SPAN_DECLARE(int) queue_write(queue_state_t *s, const uint8_t *buf, int len)
     }
     /*endif*/
     /* Only change the pointer now we have really finished */
-    s->iptr = new_iptr;
+    set_iptr(s, new_iptr);
     return real_len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -272,7 +382,7 @@ SPAN_DECLARE(int) queue_write_byte(queue_state_t *s, uint8_t byte)
 
     /* Snapshot the values (although only optr should be changeable during this processing) */
     iptr = s->iptr;
-    optr = s->optr;
+    optr = writer_optr(s, iptr, 1);
 
     if ((real_len = optr - iptr - 1) < 0)
         real_len += s->len;
@@ -290,11 +400,135 @@ SPAN_DECLARE(int) queue_write_byte(queue_state_t *s, uint8_t byte)
         iptr = 0;
     /*endif*/
     /* Only change the pointer now we have really finished */
-    s->iptr = iptr;
+    set_iptr(s, iptr);
     return 1;
 }
 /*- End of function --------------------------------------------------------*/
 
+/* Describe len bytes of the buffer, starting at ptr, as up to two contiguous spans */
+static __inline__ void make_spans(queue_state_t *s, int ptr, int len, uint8_t *buf[2], int buf_len[2])
+{
+    int to_end;
+
+    if (ptr >= s->len)
+        ptr -= s->len;
+    /*endif*/
+    to_end = s->len - ptr;
+    buf[0] = s->data + ptr;
+    if (len <= to_end)
+    {
+        buf_len[0] = len;
+        buf[1] = NULL;
+        buf_len[1] = 0;
+    }
+    else
+    {
+        buf_len[0] = to_end;
+        buf[1] = s->data;
+        buf_len[1] = len - to_end;
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_write_reserve(queue_state_t *s, uint8_t *buf[2], int buf_len[2], int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+
+    iptr = s->iptr;
+    optr = writer_optr(s, iptr, len);
+    if ((real_len = optr - iptr - 1) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (real_len < len)
+    {
+        if (s->flags & QUEUE_WRITE_ATOMIC)
+            return -1;
+        /*endif*/
+    }
+    else
+    {
+        real_len = len;
+    }
+    /*endif*/
+    make_spans(s, iptr, real_len, buf, buf_len);
+    return real_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_write_commit(queue_state_t *s, int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+
+    iptr = s->iptr;
+    optr = writer_optr(s, iptr, len);
+    if ((real_len = optr - iptr - 1) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (len < 0  ||  len > real_len)
+        return -1;
+    /*endif*/
+    if ((iptr += len) >= s->len)
+        iptr -= s->len;
+    /*endif*/
+    set_iptr(s, iptr);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_read_peek(queue_state_t *s, const uint8_t *buf[2], int buf_len[2], int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+
+    optr = s->optr;
+    iptr = reader_iptr(s, optr, len);
+    if ((real_len = iptr - optr) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (real_len < len)
+    {
+        if (s->flags & QUEUE_READ_ATOMIC)
+            return -1;
+        /*endif*/
+    }
+    else
+    {
+        real_len = len;
+    }
+    /*endif*/
+    make_spans(s, optr, real_len, (uint8_t **) buf, buf_len);
+    return real_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_read_consume(queue_state_t *s, int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+
+    optr = s->optr;
+    iptr = reader_iptr(s, optr, len);
+    if ((real_len = iptr - optr) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (len < 0  ||  len > real_len)
+        return -1;
+    /*endif*/
+    if ((optr += len) >= s->len)
+        optr -= s->len;
+    /*endif*/
+    set_optr(s, optr);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) queue_state_test_msg(queue_state_t *s)
 {
     uint16_t lenx;
@@ -343,7 +577,7 @@ SPAN_DECLARE(int) queue_write_msg(queue_state_t *s, const uint8_t *buf, int len)
 
     /* Snapshot the values (although only optr should be changeable during this processing) */
     iptr = s->iptr;
-    optr = s->optr;
+    optr = writer_optr(s, iptr, len + (int) sizeof(uint16_t));
 
     if ((real_len = optr - iptr - 1) < 0)
         real_len += s->len;
@@ -386,20 +620,103 @@ SPAN_DECLARE(int) queue_write_msg(queue_state_t *s, const uint8_t *buf, int len)
     }
     /*endif*/
     /* Only change the pointer now we have really finished */
-    s->iptr = new_iptr;
+    set_iptr(s, new_iptr);
     return len;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) queue_write_msg_reserve(queue_state_t *s, uint8_t *buf[2], int buf_len[2], int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+
+    if (len < 0  ||  len > 0xFFFF)
+        return -1;
+    /*endif*/
+    iptr = s->iptr;
+    optr = writer_optr(s, iptr, len + (int) sizeof(uint16_t));
+    if ((real_len = optr - iptr - 1) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (real_len < len + (int) sizeof(uint16_t))
+        return -1;
+    /*endif*/
+    /* The message body goes after the length, which is filled in by the commit */
+    make_spans(s, iptr + sizeof(uint16_t), len, buf, buf_len);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_write_msg_commit(queue_state_t *s, int len)
+{
+    int real_len;
+    int iptr;
+    int optr;
+    uint16_t lenx;
+    uint8_t *buf[2];
+    int buf_len[2];
+
+    iptr = s->iptr;
+    optr = writer_optr(s, iptr, len + (int) sizeof(uint16_t));
+    if ((real_len = optr - iptr - 1) < 0)
+        real_len += s->len;
+    /*endif*/
+    if (len < 0  ||  len > 0xFFFF  ||  real_len < len + (int) sizeof(uint16_t))
+        return -1;
+    /*endif*/
+    lenx = (uint16_t) len;
+    make_spans(s, iptr, sizeof(uint16_t), buf, buf_len);
+    memcpy(buf[0], &lenx, buf_len[0]);
+    if (buf_len[1])
+        memcpy(buf[1], ((uint8_t *) &lenx) + buf_len[0], buf_len[1]);
+    /*endif*/
+    if ((iptr += len + sizeof(uint16_t)) >= s->len)
+        iptr -= s->len;
+    /*endif*/
+    set_iptr(s, iptr);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_read_msg_peek(queue_state_t *s, const uint8_t *buf[2], int buf_len[2])
+{
+    uint16_t lenx;
+
+    if (queue_view(s, (uint8_t *) &lenx, sizeof(uint16_t)) != sizeof(uint16_t))
+        return -1;
+    /*endif*/
+    /* If the length is there, the whole message must be there. */
+    make_spans(s, s->optr + sizeof(uint16_t), lenx, (uint8_t **) buf, buf_len);
+    return lenx;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) queue_read_msg_consume(queue_state_t *s)
+{
+    uint16_t lenx;
+
+    if (queue_view(s, (uint8_t *) &lenx, sizeof(uint16_t)) != sizeof(uint16_t))
+        return -1;
+    /*endif*/
+    if (queue_read_consume(s, lenx + sizeof(uint16_t)) < 0)
+        return -1;
+    /*endif*/
+    return lenx;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(queue_state_t *) queue_init(queue_state_t *s, int len, int flags)
 {
     if (s == NULL)
     {
-        if ((s = (queue_state_t *) malloc(sizeof(*s) + len + 1)) == NULL)
+        if ((s = (queue_state_t *) span_alloc(sizeof(*s) + len + 1)) == NULL)
             return NULL;
     }
     s->iptr =
     s->optr = 0;
+    s->iptr_cache =
+    s->optr_cache = 0;
     s->flags = flags;
     s->len = len + 1;
     return s;
@@ -414,7 +731,7 @@ SPAN_DECLARE(int) queue_release(queue_state_t *s)
 
 SPAN_DECLARE(int) queue_free(queue_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
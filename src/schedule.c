@@ -33,53 +33,163 @@
 #include <memory.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/schedule.h"
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/schedule.h"
 
-SPAN_DECLARE(int) span_schedule_event(span_sched_state_t *s, int us, span_sched_callback_func_t function, void *user_data)
+#define SCHED_INITIAL_ALLOCATION    16
+
+static __inline__ int heap_before(const span_sched_heap_entry_t *a, const span_sched_heap_entry_t *b)
 {
-    int i;
+    if (a->when != b->when)
+        return (a->when < b->when);
+    /*endif*/
+    return ((int32_t) (a->seq - b->seq) < 0);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void heap_sift_up(span_sched_state_t *s, int pos)
+{
+    span_sched_heap_entry_t entry;
+    int parent;
 
-    for (i = 0;  i < s->max_to_date;  i++)
+    entry = s->heap[pos];
+    while (pos > 0)
     {
-        if (s->sched[i].callback == NULL)
+        parent = (pos - 1) >> 1;
+        if (!heap_before(&entry, &s->heap[parent]))
             break;
         /*endif*/
+        s->heap[pos] = s->heap[parent];
+        s->sched[s->heap[pos].slot].pos = pos;
+        pos = parent;
+    }
+    /*endwhile*/
+    s->heap[pos] = entry;
+    s->sched[entry.slot].pos = pos;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void heap_sift_down(span_sched_state_t *s, int pos)
+{
+    span_sched_heap_entry_t entry;
+    int child;
+
+    entry = s->heap[pos];
+    for (;;)
+    {
+        child = 2*pos + 1;
+        if (child >= s->entries)
+            break;
+        /*endif*/
+        if (child + 1 < s->entries  &&  heap_before(&s->heap[child + 1], &s->heap[child]))
+            child++;
+        /*endif*/
+        if (!heap_before(&s->heap[child], &entry))
+            break;
+        /*endif*/
+        s->heap[pos] = s->heap[child];
+        s->sched[s->heap[pos].slot].pos = pos;
+        pos = child;
     }
     /*endfor*/
-    if (i >= s->allocated)
+    s->heap[pos] = entry;
+    s->sched[entry.slot].pos = pos;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void heap_remove(span_sched_state_t *s, int pos)
+{
+    int slot;
+
+    slot = s->heap[pos].slot;
+    if (--s->entries > pos)
     {
-        s->allocated += 5;
-        s->sched = (span_sched_t *) realloc(s->sched, sizeof(span_sched_t)*s->allocated);
+        /* Fill the hole with the last entry, and move that to wherever it belongs */
+        s->heap[pos] = s->heap[s->entries];
+        if (pos > 0  &&  heap_before(&s->heap[pos], &s->heap[(pos - 1) >> 1]))
+            heap_sift_up(s, pos);
+        else
+            heap_sift_down(s, pos);
+        /*endif*/
     }
     /*endif*/
-    if (i >= s->max_to_date)
-        s->max_to_date = i + 1;
-    /*endif*/
-    s->sched[i].when = s->ticker + us;
-    s->sched[i].callback = function;
-    s->sched[i].user_data = user_data;
-    return i;
+    /* Return the slot to the free list */
+    s->sched[slot].callback = NULL;
+    s->sched[slot].user_data = NULL;
+    s->sched[slot].pos = s->free_slot;
+    s->free_slot = slot;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(uint64_t) span_schedule_next(span_sched_state_t *s)
+static int grow(span_sched_state_t *s)
 {
+    span_sched_t *sched;
+    span_sched_heap_entry_t *heap;
+    int allocated;
     int i;
-    uint64_t earliest;
 
-    earliest = ~((uint64_t) 0);
-    for (i = 0;  i < s->max_to_date;  i++)
+    allocated = (s->allocated)  ?  2*s->allocated  :  SCHED_INITIAL_ALLOCATION;
+    if ((sched = (span_sched_t *) span_realloc(s->sched, sizeof(span_sched_t)*allocated)) == NULL)
+        return -1;
+    /*endif*/
+    s->sched = sched;
+    if ((heap = (span_sched_heap_entry_t *) span_realloc(s->heap, sizeof(span_sched_heap_entry_t)*allocated)) == NULL)
+        return -1;
+    /*endif*/
+    s->heap = heap;
+    /* Chain the new slots onto the free list, lowest first, so IDs are handed out
+       in the same order the old linear table used them. */
+    for (i = allocated - 1;  i >= s->allocated;  i--)
     {
-        if (s->sched[i].callback  &&  earliest > s->sched[i].when)
-            earliest = s->sched[i].when;
-        /*endif*/
+        s->sched[i].callback = NULL;
+        s->sched[i].user_data = NULL;
+        s->sched[i].pos = s->free_slot;
+        s->free_slot = i;
     }
     /*endfor*/
-    return earliest;
+    s->allocated = allocated;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_schedule_event(span_sched_state_t *s, int us, span_sched_callback_func_t function, void *user_data)
+{
+    int i;
+    int pos;
+
+    if (s->free_slot < 0  &&  grow(s) < 0)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Unable to allocate a scheduled event\n");
+        return -1;
+    }
+    /*endif*/
+    i = s->free_slot;
+    s->free_slot = s->sched[i].pos;
+    s->sched[i].callback = function;
+    s->sched[i].user_data = user_data;
+    /* An event cannot be due before now */
+    if (us < 0)
+        us = 0;
+    /*endif*/
+    pos = s->entries++;
+    s->heap[pos].when = s->ticker + us;
+    s->heap[pos].seq = s->seq++;
+    s->heap[pos].slot = i;
+    heap_sift_up(s, pos);
+    return i;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint64_t) span_schedule_next(span_sched_state_t *s)
+{
+    if (s->entries == 0)
+        return ~((uint64_t) 0);
+    /*endif*/
+    return s->heap[0].when;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -91,30 +201,36 @@ SPAN_DECLARE(uint64_t) span_schedule_time(span_sched_state_t *s)
 
 SPAN_DECLARE(void) span_schedule_update(span_sched_state_t *s, int us)
 {
-    int i;
     span_sched_callback_func_t callback;
     void *user_data;
+    uint32_t seq_limit;
+    int slot;
 
     s->ticker += us;
-    for (i = 0;  i < s->max_to_date;  i++)
+    /* Events scheduled by the callbacks we make here are left for the next update,
+       so a callback which keeps rescheduling itself with no delay cannot lock us up.
+       Such events are always due no earlier than the ticker, so everything behind
+       one of them at the top of the heap is either new too, or not yet due. */
+    seq_limit = s->seq;
+    while (s->entries > 0
+           &&
+           s->heap[0].when <= s->ticker
+           &&
+           (int32_t) (s->heap[0].seq - seq_limit) < 0)
     {
-        if (s->sched[i].callback  &&  s->sched[i].when <= s->ticker)
-        {
-            callback = s->sched[i].callback;
-            user_data = s->sched[i].user_data;
-            s->sched[i].callback = NULL;
-            s->sched[i].user_data = NULL;
-            callback(s, user_data);
-        }
-        /*endif*/
+        slot = s->heap[0].slot;
+        callback = s->sched[slot].callback;
+        user_data = s->sched[slot].user_data;
+        heap_remove(s, 0);
+        callback(s, user_data);
     }
-    /*endfor*/
+    /*endwhile*/
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(void) span_schedule_del(span_sched_state_t *s, int i)
 {
-    if (i >= s->max_to_date
+    if (i >= s->allocated
         ||
         i < 0
         ||
@@ -124,13 +240,21 @@ SPAN_DECLARE(void) span_schedule_del(span_sched_state_t *s, int i)
         return;
     }
     /*endif*/
-    s->sched[i].callback = NULL;
+    heap_remove(s, s->sched[i].pos);
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(span_sched_state_t *) span_schedule_init(span_sched_state_t *s)
 {
+    if (s == NULL)
+    {
+        if ((s = (span_sched_state_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+        /*endif*/
+    }
+    /*endif*/
     memset(s, 0, sizeof(*s));
+    s->free_slot = -1;
     span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
     span_log_set_protocol(&s->logging, "SCHEDULE");
     return s;
@@ -141,18 +265,31 @@ SPAN_DECLARE(int) span_schedule_release(span_sched_state_t *s)
 {
     if (s->sched)
     {
-        free(s->sched);
+        span_free(s->sched);
         s->sched = NULL;
     }
+    /*endif*/
+    if (s->heap)
+    {
+        span_free(s->heap);
+        s->heap = NULL;
+    }
+    /*endif*/
+    s->allocated = 0;
+    s->entries = 0;
+    s->free_slot = -1;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) span_schedule_free(span_sched_state_t *s)
 {
-    span_schedule_release(s);
     if (s)
-        free(s);
+    {
+        span_schedule_release(s);
+        span_free(s);
+    }
+    /*endif*/
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -0,0 +1,148 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc.h - memory allocation handling.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page alloc_page Memory allocation
+\section alloc_page_sec_1 What does it do?
+All the memory spandsp allocates, whether for a context created by an *_init()
+function, or for a buffer which grows while a call is in progress, is obtained
+through span_alloc(), span_realloc() and span_free(). By default these use the C
+library's malloc(), realloc() and free(). span_set_allocator() lets an application
+substitute its own routines, for example to draw memory from pools which are safe
+to use on real time media threads.
+
+An arena is a single contiguous block of memory, from which many allocations can
+be made. While an arena is selected for the current thread with span_arena_select(),
+every allocation spandsp makes on that thread is carved from the arena, rather than
+the heap. All the contexts for a call can, therefore, come from one block, which
+is released in one shot with span_arena_reset() or span_arena_free() when the call
+ends. Nothing is ever returned to the system while the call is in progress.
+
+\section alloc_page_sec_2 How does it work?
+Each allocation carries a small header, recording the arena it came from (if any)
+and its size. The header, and every allocation from an arena, is padded to 16
+bytes, so memory from an arena is 16 byte aligned on every platform. span_free() on memory from an arena does nothing, as the memory is
+recovered when the whole arena is reset. span_realloc() on memory from an arena
+grows the allocation in place if it was the last one made, and otherwise moves it
+to a new allocation in the same arena. An arena never grows. When it is exhausted,
+allocations from it fail, just as they would if the heap were exhausted.
+*/
+
+#if !defined(_SPANDSP_ALLOC_H_)
+#define _SPANDSP_ALLOC_H_
+
+typedef void *(*span_alloc_t)(size_t size);
+
+typedef void *(*span_realloc_t)(void *ptr, size_t size);
+
+typedef void (*span_free_t)(void *ptr);
+
+/*! A memory arena. */
+typedef struct span_arena_s span_arena_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Allocate memory, from the currently selected arena, or from the heap.
+    \param size The number of bytes required.
+    \return A pointer to the memory, or NULL if none could be allocated. */
+SPAN_DECLARE(void *) span_alloc(size_t size);
+
+/*! \brief Change the size of memory previously allocated by span_alloc() or span_realloc().
+    \param ptr The memory. NULL is treated as a new allocation.
+    \param size The number of bytes required.
+    \return A pointer to the memory, or NULL if none could be allocated. In that case
+            the original memory is untouched. */
+SPAN_DECLARE(void *) span_realloc(void *ptr, size_t size);
+
+/*! \brief Free memory previously allocated by span_alloc() or span_realloc().
+    \param ptr The memory. NULL is ignored. */
+SPAN_DECLARE(void) span_free(void *ptr);
+
+/*! \brief Duplicate a string, using span_alloc().
+    \param s The string.
+    \return A pointer to the copy, or NULL if no memory could be allocated. */
+SPAN_DECLARE(char *) span_strdup(const char *s);
+
+/*! Set the routines used to obtain memory from the heap. This should be done
+    before any spandsp contexts are created, and not changed while any exist.
+    \brief Set the heap allocation routines.
+    \param custom_alloc The allocation routine. NULL selects malloc().
+    \param custom_realloc The reallocation routine. NULL selects realloc().
+    \param custom_free The free routine. NULL selects free().
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) span_set_allocator(span_alloc_t custom_alloc,
+                                     span_realloc_t custom_realloc,
+                                     span_free_t custom_free);
+
+/*! Select the arena which will be used for all allocations made by spandsp on
+    the calling thread.
+    \brief Select an arena for the current thread.
+    \param s The arena context, or NULL to allocate from the heap.
+    \return The previously selected arena, or NULL if it was the heap. */
+SPAN_DECLARE(span_arena_t *) span_arena_select(span_arena_t *s);
+
+/*! \brief Recover all the memory in an arena, in one shot. Any contexts allocated
+           from the arena must not be used again.
+    \param s The arena context. */
+SPAN_DECLARE(void) span_arena_reset(span_arena_t *s);
+
+/*! \brief Find how much of an arena is in use.
+    \param s The arena context.
+    \return The number of bytes in use, including the allocation headers. */
+SPAN_DECLARE(size_t) span_arena_get_used(span_arena_t *s);
+
+/*! \brief Find the size of an arena.
+    \param s The arena context.
+    \return The size of the arena, in bytes. */
+SPAN_DECLARE(size_t) span_arena_get_size(span_arena_t *s);
+
+/*! \brief Initialise a memory arena.
+    \param s The arena context.
+    \param buf The memory to be used for the arena. If this is NULL, a block of
+           the requested size is obtained from the heap.
+    \param size The size of the arena, in bytes.
+    \return A pointer to the arena context, or NULL if there was a problem. */
+SPAN_DECLARE(span_arena_t *) span_arena_init(span_arena_t *s, void *buf, size_t size);
+
+/*! \brief Release a memory arena.
+    \param s The arena context.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) span_arena_release(span_arena_t *s);
+
+/*! \brief Free a memory arena.
+    \param s The arena context.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) span_arena_free(span_arena_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
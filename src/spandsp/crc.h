@@ -29,17 +29,53 @@
 
 \section crc_page_sec_1 What does it do?
 
+The CRC module calculates the ITU/CCITT CRC-16 and CRC-32 values used by HDLC,
+and the protocols built on it.
+
 \section crc_page_sec_2 How does it work?
+Three implementations are available, and give identical results. The simplest
+uses one 256 entry table lookup per byte. Slicing by 8 uses eight such tables,
+to process 8 bytes with 8 independent lookups. On x86 CPUs with the PCLMULQDQ
+instruction, long frames are folded 64 bytes at a time with carry-less
+multiplies, and the last 16 bytes of the fold, and any odd bytes, are finished
+off with the tables. By default the fastest available implementation is used.
+crc_set_implementation() can force a particular one, for testing.
 */
 
 #if !defined(_SPANDSP_CRC_H_)
 #define _SPANDSP_CRC_H_
 
+/*! The CRC implementations which may be selected. */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    CRC_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C, one table lookup per byte */
+    CRC_IMPLEMENTATION_BYTEWISE = 1,
+    /*! Plain C, slicing by 8 bytes */
+    CRC_IMPLEMENTATION_SLICE8 = 2,
+    /*! x86 carry-less multiply (PCLMULQDQ) folding */
+    CRC_IMPLEMENTATION_PCLMUL = 3
+};
+
 #if defined(__cplusplus)
 extern "C"
 {
 #endif
 
+/*! Select the implementation used for the ITU/CCITT CRC-16 and CRC-32 calculations.
+    All the implementations give identical results.
+    \brief Select the CRC implementation.
+    \param implementation The required implementation. CRC_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) crc_set_implementation(int implementation);
+
+/*! \brief Get the implementation used for the CRC calculations.
+    \return The implementation in use. */
+SPAN_DECLARE(int) crc_get_implementation(void);
+
 /*! \brief Calculate the ITU/CCITT CRC-32 value in buffer.
     \param buf The buffer containing the data.
     \param len The length of the frame.
@@ -75,7 +111,8 @@ SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
 
 /*! \brief Calculate the ITU/CCITT CRC-16 value of some bits from a byte.
     \param buf The buffer containing the byte of data.
-    \param len The number of bits, starting from the LSB.
+    \param len The number of bits, starting from the LSB. Any bits beyond the 8 in the byte
+           are taken to be zeros.
     \param crc The initial CRC value. This is usually 0xFFFF, or 0 for a new block (it depends on
            the application). It is previous returned CRC value for the continuation of a block.
     \return The CRC value.
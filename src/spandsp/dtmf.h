@@ -59,6 +59,16 @@ Basic DTMF specs:
     - Attenuation <= 26dB will detect OK
     - Frequency tolerance +- 1.5% will detect, +-3.5% will reject
 
+\section dtmf_rx_page_sec_3 Receiver banks
+Trunk equipment often needs to look for DTMF on every channel at once. A DTMF
+receiver bank holds the Goertzel filter states for up to DTMF_RX_BANK_MAX_CHANNELS
+channels, laid out so that one SIMD operation updates the same filter for several
+channels. The channels are processed in step, from either a separate buffer
+for each channel, or a single interleaved buffer. The detection decisions for
+each channel are made by a normal DTMF receiver context, so each channel
+delivers exactly the same digits, through the same callbacks and dtmf_rx_get(),
+as it would have done through its own dtmf_rx() call.
+
 TODO:
 */
 
@@ -73,6 +83,9 @@ repertoire of 16 DTMF dual tones.
 
 #define MAX_DTMF_DIGITS 128
 
+/*! The maximum number of channels a DTMF receiver bank can handle. */
+#define DTMF_RX_BANK_MAX_CHANNELS 16
+
 typedef void (*digits_rx_callback_t)(void *user_data, const char *digits, int len);
 
 /*!
@@ -86,6 +99,12 @@ typedef struct dtmf_tx_state_s dtmf_tx_state_t;
 */
 typedef struct dtmf_rx_state_s dtmf_rx_state_t;
 
+/*!
+    DTMF digit detector bank descriptor. This holds a set of DTMF receivers,
+    for channels which are processed in step with each other.
+*/
+typedef struct dtmf_rx_bank_s dtmf_rx_bank_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -221,6 +240,58 @@ SPAN_DECLARE(int) dtmf_rx_release(dtmf_rx_state_t *s);
     \return 0 for OK, else -1. */
 SPAN_DECLARE(int) dtmf_rx_free(dtmf_rx_state_t *s);
 
+/*! Process a block of received DTMF audio samples for each channel of a DTMF
+    receiver bank, with a separate buffer for each channel.
+    \brief Process a block of received DTMF audio samples for a DTMF receiver bank.
+    \param s The DTMF receiver bank context.
+    \param amp The audio sample buffers, one per channel.
+    \param samples The number of samples in each of the buffers.
+    \return The number of samples unprocessed. */
+SPAN_DECLARE(int) dtmf_rx_bank(dtmf_rx_bank_t *s, const int16_t *amp[], int samples);
+
+/*! Process a block of received DTMF audio samples for each channel of a DTMF
+    receiver bank, with the channels interleaved in a single buffer.
+    \brief Process a block of interleaved DTMF audio samples for a DTMF receiver bank.
+    \param s The DTMF receiver bank context.
+    \param amp The audio sample buffer. Sample i of channel ch is at amp[i*channels + ch].
+    \param samples The number of samples for each channel.
+    \return The number of samples unprocessed. */
+SPAN_DECLARE(int) dtmf_rx_bank_interleaved(dtmf_rx_bank_t *s, const int16_t amp[], int samples);
+
+/*! \brief Get the DTMF receiver context for one channel of a DTMF receiver bank.
+           This may be used with dtmf_rx_get(), dtmf_rx_status(), dtmf_rx_parms(),
+           dtmf_rx_set_realtime_callback() and dtmf_rx_get_logging_state(), but it
+           must not be passed to dtmf_rx(), dtmf_rx_fillin(), dtmf_rx_init(),
+           dtmf_rx_release() or dtmf_rx_free().
+    \param s The DTMF receiver bank context.
+    \param channel The channel number, starting from zero.
+    \return A pointer to the DTMF receiver context, or NULL for an invalid channel. */
+SPAN_DECLARE(dtmf_rx_state_t *) dtmf_rx_bank_get_channel(dtmf_rx_bank_t *s, int channel);
+
+/*! \brief Initialise a DTMF receiver bank context.
+    \param s The DTMF receiver bank context.
+    \param channels The number of channels, up to DTMF_RX_BANK_MAX_CHANNELS.
+    \param callback An optional callback routine, used to report received digits. If
+           no callback routine is set, digits may be collected, using the dtmf_rx_get()
+           function on each channel's context.
+    \param user_data An optional array of opaque pointers, one per channel, which are
+           supplied in the callbacks for each channel.
+    \return A pointer to the DTMF receiver bank context, or NULL on error. */
+SPAN_DECLARE(dtmf_rx_bank_t *) dtmf_rx_bank_init(dtmf_rx_bank_t *s,
+                                                 int channels,
+                                                 digits_rx_callback_t callback,
+                                                 void *user_data[]);
+
+/*! \brief Release a DTMF receiver bank context.
+    \param s The DTMF receiver bank context.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) dtmf_rx_bank_release(dtmf_rx_bank_t *s);
+
+/*! \brief Free a DTMF receiver bank context.
+    \param s The DTMF receiver bank context.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) dtmf_rx_bank_free(dtmf_rx_bank_t *s);
+
 #if defined(__cplusplus)
 }
 #endif
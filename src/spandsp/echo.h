@@ -110,6 +110,26 @@ The echo cancellor processes both the transmit and receive streams sample by
 sample. The processing function is not declared inline. Unfortunately,
 cancellation requires many operations per sample, so the call overhead is only a
 minor burden. 
+
+Where the audio is already handled in blocks, echo_can_update_block() processes a
+whole block in one call. It produces exactly the same output as the sample by
+sample function, but selects the SIMD versions of the FIR and LMS adaption
+routines once per block, rather than once per sample.
+
+\section echo_can_page_sec_4 Long tails
+The time domain canceller adapts slowly on long tails, and on signals with a strongly
+coloured spectrum, such as speech, it may never settle at all on the 256ms to 512ms
+tails needed for satellite and some VoIP paths. If ECHO_CAN_USE_FREQ_DOMAIN is given
+to echo_can_init(), the canceller uses a partitioned block frequency domain adaptive
+filter instead. The tail is split into partitions of ECHO_CAN_FDAF_BLOCK_LEN samples.
+The echo estimate and the adaption are calculated with FFTs, once per block. Each
+frequency bin is normalised by its power across the whole tail, so this canceller
+converges quickly and stably on coloured signals. Only one partition per block is
+constrained to a linear response, in rotation, so the cost per sample is about the
+same as the time domain canceller at 128ms, and lower on longer tails. The time domain
+taps are not allocated in this mode. The API is the same as for the time domain canceller,
+but the received signal is delayed by ECHO_CAN_FDAF_BLOCK_LEN samples, as the
+canceller works on whole blocks.
 */
 
 #include "fir.h"
@@ -124,9 +144,19 @@ enum
     ECHO_CAN_USE_SUPPRESSOR = 0x10,
     ECHO_CAN_USE_TX_HPF = 0x20,
     ECHO_CAN_USE_RX_HPF = 0x40,
-    ECHO_CAN_DISABLE = 0x80
+    ECHO_CAN_DISABLE = 0x80,
+    /*! Use a partitioned block frequency domain adaptive filter, rather than a
+        time domain NLMS filter. This can only be selected in echo_can_init(). */
+    ECHO_CAN_USE_FREQ_DOMAIN = 0x100
 };
 
+/*! The shortest tail, in samples, an echo canceller can be created with. */
+#define ECHO_CAN_MIN_TAPS           32
+
+/*! The length of the blocks, in samples, used by the frequency domain canceller.
+    This is also the delay it adds to the received signal. */
+#define ECHO_CAN_FDAF_BLOCK_LEN     64
+
 /*!
     G.168 echo canceller descriptor. This defines the working state for a line
     echo canceller.
@@ -139,7 +169,7 @@ extern "C"
 #endif
 
 /*! Create a voice echo canceller context.
-    \param len The length of the canceller, in samples.
+    \param len The length of the canceller, in samples. This must be at least ECHO_CAN_MIN_TAPS.
     \return The new canceller context, or NULL if the canceller could not be created.
 */
 SPAN_DECLARE(echo_can_state_t *) echo_can_init(int len, int adaption_mode);
@@ -175,6 +205,18 @@ SPAN_DECLARE(void) echo_can_adaption_mode(echo_can_state_t *ec, int adaption_mod
 */
 SPAN_DECLARE(int16_t) echo_can_update(echo_can_state_t *ec, int16_t tx, int16_t rx);
 
+/*! Process a block of samples through a voice echo canceller. The result is
+    identical to passing the samples through echo_can_update() one at a time.
+    \param ec The echo canceller context.
+    \param tx The transmitted audio samples.
+    \param rx The received audio samples.
+    \param clean The clean (echo cancelled) received samples. This may be the
+           same buffer as rx.
+    \param len The number of samples in each of the buffers.
+    \return The number of samples processed.
+*/
+SPAN_DECLARE(int) echo_can_update_block(echo_can_state_t *ec, const int16_t tx[], const int16_t rx[], int16_t clean[], int len);
+
 /*! Process to high pass filter the tx signal.
     \param ec The echo canceller context.
     \param tx The transmitted auio sample.
@@ -184,6 +226,13 @@ SPAN_DECLARE(int16_t) echo_can_hpf_tx(echo_can_state_t *ec, int16_t tx);
 
 SPAN_DECLARE(void) echo_can_snapshot(echo_can_state_t *ec);
 
+/*! Get a snapshot of the performance counters of a voice echo canceller context.
+    \param ec The echo canceller context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) echo_can_get_stats(echo_can_state_t *ec, span_stats_t *stats);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -31,6 +31,7 @@
 #if !defined(_SPANDSP_EXPOSE_H_)
 #define _SPANDSP_EXPOSE_H_
 
+#include <spandsp/private/alloc.h>
 #include <spandsp/private/logging.h>
 #include <spandsp/private/schedule.h>
 #include <spandsp/private/bitstream.h>
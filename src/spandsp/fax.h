@@ -102,6 +102,21 @@ SPAN_DECLARE(t30_state_t *) fax_get_t30_state(fax_state_t *s);
 */
 SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s);
 
+/*! Get a snapshot of the performance counters of a FAX context.
+    \brief Get a snapshot of the performance counters of a FAX context.
+    \param s The FAX context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) fax_get_stats(fax_state_t *s, span_stats_t *stats);
+
+/*! Find how much memory a FAX context is using, including any ECM buffer
+    allocated by its T.30 engine.
+    \brief Get the memory footprint of a FAX context.
+    \param s The FAX context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(size_t) fax_get_memory_footprint(fax_state_t *s);
+
 /*! Restart a FAX context.
     \brief Restart a FAX context.
     \param s The FAX context.
@@ -75,6 +75,23 @@ SPAN_DECLARE_NONSTD(void) fax_modems_hdlc_tx_frame(void *user_data, const uint8_
 
 SPAN_DECLARE(void) fax_modems_start_rx_modem(fax_modems_state_t *s, int which);
 
+/*! Select the fast receive modem to be used next. The fast receive modems share
+    memory, so if this is not the modem selected last time, it is completely
+    initialised. Otherwise it is left untouched, so a short train can follow a long
+    one. The modem should then be restarted at the required bit rate.
+    \brief Select the fast receive modem.
+    \param s The FAX modems context.
+    \param which The modem required - FAX_MODEM_V17_RX, FAX_MODEM_V27TER_RX or FAX_MODEM_V29_RX. */
+SPAN_DECLARE(void) fax_modems_select_fast_rx_modem(fax_modems_state_t *s, int which);
+
+/*! Select the fast transmit modem to be used next. The fast transmit modems share
+    memory, so if this is not the modem selected last time, it is completely
+    initialised. The modem should then be restarted at the required bit rate.
+    \brief Select the fast transmit modem.
+    \param s The FAX modems context.
+    \param which The modem required - FAX_MODEM_V17_TX, FAX_MODEM_V27TER_TX or FAX_MODEM_V29_TX. */
+SPAN_DECLARE(void) fax_modems_select_fast_tx_modem(fax_modems_state_t *s, int which);
+
 SPAN_DECLARE(void) fax_modems_set_tep_mode(fax_modems_state_t *s, int use_tep);
 
 SPAN_DECLARE(int) fax_modems_restart(fax_modems_state_t *s);
@@ -25,10 +25,24 @@
 
 /*! \page fir_page FIR filtering
 \section fir_page_sec_1 What does it do?
-???.
+These are general purpose FIR filters, with 16 bit integer, 32 bit integer, and
+floating point coefficients. They are the inner loops of the echo cancellers,
+and several of the test tools.
 
 \section fir_page_sec_2 How does it work?
-???.
+Each filter keeps two copies of its history, one after the other, so the most
+recent "taps" samples are always contiguous in memory, whatever the current
+position in the circular buffer. The dot product of the coefficients and that
+window is then a simple linear operation. Unless the library was built with
+USE_MMX or USE_SSE2, the dot product is performed by fir16_dot_product(),
+fir32_dot_product() or fir_float_dot_product(). On first use these select AVX2
+if the CPU supports it, and generic C otherwise. This means a single binary built
+for a baseline x86 CPU still gets the wide vector code on machines which have it.
+fir_set_implementation() can force a particular implementation, including AVX-512,
+which is never selected automatically.
+
+The block functions, fir16_block(), fir32_block() and fir_float_block(), filter
+a whole buffer in one call, avoiding the per-sample call overhead.
 */
 
 #if !defined(_SPANDSP_FIR_H_)
@@ -38,6 +52,19 @@
 #include "mmx.h"
 #endif
 
+/*! The FIR dot product implementations which may be selected */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    FIR_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C */
+    FIR_IMPLEMENTATION_GENERIC = 1,
+    /*! x86 AVX2 */
+    FIR_IMPLEMENTATION_AVX2 = 2,
+    /*! x86 AVX-512 (F and BW) */
+    FIR_IMPLEMENTATION_AVX512 = 3
+};
+
 /*!
     16 bit integer FIR descriptor. This defines the working state for a single
     instance of an FIR filter using 16 bit integer coefficients.
@@ -80,6 +107,64 @@ extern "C"
 {
 #endif
 
+/*! Select the implementation used for the FIR dot products.
+    \brief Select the FIR dot product implementation.
+    \param implementation The required implementation. FIR_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) fir_set_implementation(int implementation);
+
+/*! Find which implementation is being used for the FIR dot products.
+    \brief Get the FIR dot product implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) fir_get_implementation(void);
+
+/*! Calculate the dot product of 16 bit coefficients and 16 bit history.
+    \param coeffs The coefficients.
+    \param hist The history, with the most recent sample first.
+    \param taps The number of taps.
+    \return The dot product, with Q15 scaling where the coefficients are Q15. */
+SPAN_DECLARE(int32_t) fir16_dot_product(const int16_t coeffs[], const int16_t hist[], int taps);
+
+/*! Calculate the dot product of 32 bit coefficients and 16 bit history.
+    \param coeffs The coefficients.
+    \param hist The history, with the most recent sample first.
+    \param taps The number of taps.
+    \return The dot product. */
+SPAN_DECLARE(int32_t) fir32_dot_product(const int32_t coeffs[], const int16_t hist[], int taps);
+
+/*! Calculate the dot product of floating point coefficients and history.
+    \param coeffs The coefficients.
+    \param hist The history, with the most recent sample first.
+    \param taps The number of taps.
+    \return The dot product. */
+SPAN_DECLARE(float) fir_float_dot_product(const float coeffs[], const float hist[], int taps);
+
+/*! Filter a block of samples with a 16 bit FIR filter.
+    \param fir The FIR filter context.
+    \param out The filtered samples. This may be the same buffer as in.
+    \param in The samples to be filtered.
+    \param len The number of samples.
+    \return The number of samples filtered. */
+SPAN_DECLARE(int) fir16_block(fir16_state_t *fir, int16_t out[], const int16_t in[], int len);
+
+/*! Filter a block of samples with a 32 bit FIR filter.
+    \param fir The FIR filter context.
+    \param out The filtered samples. This may be the same buffer as in.
+    \param in The samples to be filtered.
+    \param len The number of samples.
+    \return The number of samples filtered. */
+SPAN_DECLARE(int) fir32_block(fir32_state_t *fir, int16_t out[], const int16_t in[], int len);
+
+/*! Filter a block of samples with a floating point FIR filter.
+    \param fir The FIR filter context.
+    \param out The filtered samples. This may be the same buffer as in.
+    \param in The samples to be filtered.
+    \param len The number of samples.
+    \return The number of samples filtered. */
+SPAN_DECLARE(int) fir_float_block(fir_float_state_t *fir, int16_t out[], const int16_t in[], int len);
+
 static __inline__ const int16_t *fir16_create(fir16_state_t *fir,
                                               const int16_t *coeffs,
                                               int taps)
@@ -87,38 +172,30 @@ static __inline__ const int16_t *fir16_create(fir16_state_t *fir,
     fir->taps = taps;
     fir->curr_pos = taps - 1;
     fir->coeffs = coeffs;
-#if defined(USE_MMX)  ||  defined(USE_SSE2)
-    if ((fir->history = malloc(2*taps*sizeof(int16_t))))
+    /* The history is kept twice over, so the most recent "taps" samples are always contiguous */
+    if ((fir->history = (int16_t *) span_alloc(2*taps*sizeof(int16_t))))
         memset(fir->history, 0, 2*taps*sizeof(int16_t));
-#else
-    if ((fir->history = (int16_t *) malloc(taps*sizeof(int16_t))))
-        memset(fir->history, 0, taps*sizeof(int16_t));
-#endif
     return fir->history;
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ void fir16_flush(fir16_state_t *fir)
 {
-#if defined(USE_MMX)  ||  defined(USE_SSE2)
     memset(fir->history, 0, 2*fir->taps*sizeof(int16_t));
-#else
-    memset(fir->history, 0, fir->taps*sizeof(int16_t));
-#endif
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ void fir16_free(fir16_state_t *fir)
 {
-    free(fir->history);
+    span_free(fir->history);
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ int16_t fir16(fir16_state_t *fir, int16_t sample)
 {
-    int i;
     int32_t y;
 #if defined(USE_MMX)
+    int i;
     mmx_t *mmx_coeffs;
     mmx_t *mmx_hist;
 
@@ -150,6 +227,7 @@ static __inline__ int16_t fir16(fir16_state_t *fir, int16_t sample)
     movd_r2m(mm4, y);
     emms();
 #elif defined(USE_SSE2)
+    int i;
     xmm_t *xmm_coeffs;
     xmm_t *xmm_hist;
 
@@ -183,18 +261,9 @@ static __inline__ int16_t fir16(fir16_state_t *fir, int16_t sample)
     paddd_r2r(xmm0, xmm4);
     movd_r2m(xmm4, y);
 #else
-    int offset1;
-    int offset2;
-
     fir->history[fir->curr_pos] = sample;
-
-    offset2 = fir->curr_pos;
-    offset1 = fir->taps - offset2;
-    y = 0;
-    for (i = fir->taps - 1;  i >= offset1;  i--)
-        y += fir->coeffs[i]*fir->history[i - offset1];
-    for (  ;  i >= 0;  i--)
-        y += fir->coeffs[i]*fir->history[i + offset2];
+    fir->history[fir->curr_pos + fir->taps] = sample;
+    y = fir16_dot_product(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
 #endif
     if (fir->curr_pos <= 0)
     	fir->curr_pos = fir->taps;
@@ -210,40 +279,31 @@ static __inline__ const int16_t *fir32_create(fir32_state_t *fir,
     fir->taps = taps;
     fir->curr_pos = taps - 1;
     fir->coeffs = coeffs;
-    fir->history = (int16_t *) malloc(taps*sizeof(int16_t));
-    if (fir->history)
-    	memset(fir->history, '\0', taps*sizeof(int16_t));
+    if ((fir->history = (int16_t *) span_alloc(2*taps*sizeof(int16_t))))
+        memset(fir->history, 0, 2*taps*sizeof(int16_t));
     return fir->history;
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ void fir32_flush(fir32_state_t *fir)
 {
-    memset(fir->history, 0, fir->taps*sizeof(int16_t));
+    memset(fir->history, 0, 2*fir->taps*sizeof(int16_t));
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ void fir32_free(fir32_state_t *fir)
 {
-    free(fir->history);
+    span_free(fir->history);
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ int16_t fir32(fir32_state_t *fir, int16_t sample)
 {
-    int i;
     int32_t y;
-    int offset1;
-    int offset2;
 
     fir->history[fir->curr_pos] = sample;
-    offset2 = fir->curr_pos;
-    offset1 = fir->taps - offset2;
-    y = 0;
-    for (i = fir->taps - 1;  i >= offset1;  i--)
-        y += fir->coeffs[i]*fir->history[i - offset1];
-    for (  ;  i >= 0;  i--)
-        y += fir->coeffs[i]*fir->history[i + offset2];
+    fir->history[fir->curr_pos + fir->taps] = sample;
+    y = fir32_dot_product(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
     if (fir->curr_pos <= 0)
     	fir->curr_pos = fir->taps;
     fir->curr_pos--;
@@ -258,35 +318,25 @@ static __inline__ const float *fir_float_create(fir_float_state_t *fir,
     fir->taps = taps;
     fir->curr_pos = taps - 1;
     fir->coeffs = coeffs;
-    fir->history = (float *) malloc(taps*sizeof(float));
-    if (fir->history)
-        memset(fir->history, '\0', taps*sizeof(float));
+    if ((fir->history = (float *) span_alloc(2*taps*sizeof(float))))
+        memset(fir->history, 0, 2*taps*sizeof(float));
     return fir->history;
 }
 /*- End of function --------------------------------------------------------*/
     
 static __inline__ void fir_float_free(fir_float_state_t *fir)
 {
-    free(fir->history);
+    span_free(fir->history);
 }
 /*- End of function --------------------------------------------------------*/
 
 static __inline__ int16_t fir_float(fir_float_state_t *fir, int16_t sample)
 {
-    int i;
     float y;
-    int offset1;
-    int offset2;
 
     fir->history[fir->curr_pos] = sample;
-
-    offset2 = fir->curr_pos;
-    offset1 = fir->taps - offset2;
-    y = 0;
-    for (i = fir->taps - 1;  i >= offset1;  i--)
-        y += fir->coeffs[i]*fir->history[i - offset1];
-    for (  ;  i >= 0;  i--)
-        y += fir->coeffs[i]*fir->history[i + offset2];
+    fir->history[fir->curr_pos + fir->taps] = sample;
+    y = fir_float_dot_product(fir->coeffs, &fir->history[fir->curr_pos], fir->taps);
     if (fir->curr_pos <= 0)
     	fir->curr_pos = fir->taps;
     fir->curr_pos--;
@@ -45,6 +45,15 @@ favourite processor.
 Look up tables are used for transcoding between A-law and u-law, since it is
 difficult to achieve the precise transcoding procedure laid down in the G.711
 specification by other means.
+
+The block functions - g711_encode(), g711_decode() and their multi-channel forms -
+can convert many samples at a time with the SIMD instructions of modern x86 CPUs.
+These do the conversions by calculation, for 8, 16 or 32 samples at once, with no
+branches, and give exactly the same results as the single sample routines. The best
+implementation the CPU supports is picked on first use, but another may be selected
+with g711_set_implementation(). This includes a table driven implementation, which
+uses 64k byte direct lookup tables for encoding. Those tables are only built, and
+only take up memory and cache space, if that implementation is requested.
 */
 
 #if !defined(_SPANDSP_G711_H_)
@@ -62,6 +71,21 @@ enum
     G711_ULAW
 };
 
+/*! The implementations of the G.711 block conversion routines */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    G711_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C, converting a sample at a time */
+    G711_IMPLEMENTATION_GENERIC = 1,
+    /*! Plain C, with 64k byte direct lookup tables for encoding */
+    G711_IMPLEMENTATION_TABLE = 2,
+    /*! x86 SSE4.1 */
+    G711_IMPLEMENTATION_SSE4_1 = 3,
+    /*! x86 AVX2 */
+    G711_IMPLEMENTATION_AVX2 = 4
+};
+
 /*!
     G.711 state
  */
@@ -301,6 +325,62 @@ SPAN_DECLARE(int) g711_transcode(g711_state_t *s,
                                  const uint8_t g711_in[],
                                  int g711_bytes);
 
+/*! \brief Decode blocks of u-law or A-law for a number of channels.
+    \param s The G.711 contexts, one per channel.
+    \param amp The linear audio buffers, one per channel.
+    \param g711_data The G.711 data buffers, one per channel.
+    \param channels The number of channels.
+    \param g711_bytes The number of G.711 samples to decode for each channel.
+    \return The number of samples of linear audio produced for each channel.
+*/
+SPAN_DECLARE(int) g711_decode_multi(g711_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g711_data[],
+                                    int channels,
+                                    int g711_bytes);
+
+/*! \brief Encode blocks of linear audio to u-law or A-law for a number of channels.
+    \param s The G.711 contexts, one per channel.
+    \param g711_data The G.711 data buffers, one per channel.
+    \param amp The linear audio buffers, one per channel.
+    \param channels The number of channels.
+    \param len The number of samples to encode for each channel.
+    \return The number of G.711 samples produced for each channel.
+*/
+SPAN_DECLARE(int) g711_encode_multi(g711_state_t *s[],
+                                    uint8_t *g711_data[],
+                                    const int16_t *amp[],
+                                    int channels,
+                                    int len);
+
+/*! \brief Transcode blocks between u-law and A-law for a number of channels.
+    \param s The G.711 contexts, one per channel.
+    \param g711_out The resulting G.711 data buffers, one per channel.
+    \param g711_in The original G.711 data buffers, one per channel.
+    \param channels The number of channels.
+    \param g711_bytes The number of G.711 samples to transcode for each channel.
+    \return The number of G.711 samples produced for each channel.
+*/
+SPAN_DECLARE(int) g711_transcode_multi(g711_state_t *s[],
+                                       uint8_t *g711_out[],
+                                       const uint8_t *g711_in[],
+                                       int channels,
+                                       int g711_bytes);
+
+/*! Select the implementation used for G.711 block encoding and decoding.
+    \brief Select the G.711 block implementation.
+    \param implementation The required implementation. G711_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports. This never selects G711_IMPLEMENTATION_TABLE,
+           which must be requested explicitly.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) g711_set_implementation(int implementation);
+
+/*! Find which implementation is being used for G.711 block encoding and decoding.
+    \brief Get the G.711 block implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) g711_get_implementation(void);
+
 /*! Initialise a G.711 encode or decode context.
     \param s The G.711 context.
     \param mode The G.711 mode.
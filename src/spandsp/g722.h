@@ -46,6 +46,12 @@ codec is considerably faster, and still fully compatible with wideband terminals
 
 \section g722_page_sec_2 How does it work?
 ???.
+
+When working at 16k samples/second, the QMF filters, which split the audio into the lower
+and upper sub-bands, and recombine them, are applied a block of sample pairs at a time.
+On x86 CPUs with SSE2 or AVX2 this is done with vector instructions. The best implementation
+the CPU supports is picked on first use, but another may be selected with
+g722_set_implementation(). All the implementations give exactly the same results.
 */
 
 enum
@@ -54,6 +60,19 @@ enum
     G722_PACKED = 0x0002
 };
 
+/*! The implementations of the G.722 QMF filters */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    G722_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C */
+    G722_IMPLEMENTATION_GENERIC = 1,
+    /*! x86 SSE2 */
+    G722_IMPLEMENTATION_SSE2 = 2,
+    /*! x86 AVX2 */
+    G722_IMPLEMENTATION_AVX2 = 3
+};
+
 /*!
     G.722 encode state
  */
@@ -69,6 +88,19 @@ extern "C"
 {
 #endif
 
+/*! Select the implementation used for the G.722 QMF filters.
+    \brief Select the G.722 QMF implementation.
+    \param implementation The required implementation. G722_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) g722_set_implementation(int implementation);
+
+/*! Find which implementation is being used for the G.722 QMF filters.
+    \brief Get the G.722 QMF implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) g722_get_implementation(void);
+
 /*! Initialise an G.722 encode context.
     \param s The G.722 encode context.
     \param rate The required bit rate for the G.722 data.
@@ -91,7 +123,8 @@ SPAN_DECLARE(int) g722_encode_free(g722_encode_state_t *s);
     \param s The G.722 context.
     \param g722_data The G.722 data produced.
     \param amp The audio sample buffer.
-    \param len The number of samples in the buffer.
+    \param len The number of samples in the buffer. At 16k samples/second this should be
+           even, as the samples are processed in pairs. An odd final sample is ignored.
     \return The number of bytes of G.722 data produced. */
 SPAN_DECLARE(int) g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[], int len);
 
@@ -41,6 +41,15 @@ It passes the ITU tests.
 
 \section g726_page_sec_2 How does it work?
 ???.
+
+\section g726_page_sec_3 Processing many channels
+A G.726 codec is strictly sequential within a channel, as every sample depends on
+the adapted state left by the one before it. Where many channels are being handled,
+g726_encode_multi() and g726_decode_multi() can process a group of channels together,
+running up to 8 of them in lockstep, one per SIMD lane, on CPUs with AVX2. The results
+are exactly the same as those from g726_encode() and g726_decode() on each channel in
+turn. The best implementation the CPU supports is picked on first use, but another
+may be selected with g726_set_implementation().
 */
 
 enum
@@ -57,6 +66,17 @@ enum
     G726_PACKING_RIGHT = 2
 };
 
+/*! The implementations of the multi-channel G.726 functions */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    G726_IMPLEMENTATION_AUTO = 0,
+    /*! Process the channels one at a time */
+    G726_IMPLEMENTATION_GENERIC = 1,
+    /*! Process up to 8 channels in lockstep, with AVX2 */
+    G726_IMPLEMENTATION_AVX2 = 2
+};
+
 /*!
     G.726 state
  */
@@ -112,6 +132,54 @@ SPAN_DECLARE(int) g726_encode(g726_state_t *s,
                               const int16_t amp[],
                               int len);
 
+/*! Decode buffers of G.726 ADPCM data for a number of channels. All the channels must
+    use the same bit rate and packing, and hold the same number of residual packed bits,
+    which is the case for channels which have always been fed with the same amounts of
+    data since they were initialised.
+    \brief Decode G.726 ADPCM data for a number of channels.
+    \param s The G.726 contexts, one per channel.
+    \param amp The audio sample buffers, one per channel.
+    \param g726_data The G.726 data buffers, one per channel.
+    \param channels The number of channels.
+    \param g726_bytes The number of bytes of G.726 data for each channel.
+    \return The number of samples returned for each channel, or -1 if the channels
+            are not in step. */
+SPAN_DECLARE(int) g726_decode_multi(g726_state_t *s[],
+                                    int16_t *amp[],
+                                    const uint8_t *g726_data[],
+                                    int channels,
+                                    int g726_bytes);
+
+/*! Encode buffers of linear PCM data to G.726 ADPCM for a number of channels. All the
+    channels must use the same bit rate and packing, and hold the same number of
+    residual packed bits.
+    \brief Encode G.726 ADPCM data for a number of channels.
+    \param s The G.726 contexts, one per channel.
+    \param g726_data The G.726 data buffers, one per channel.
+    \param amp The audio sample buffers, one per channel.
+    \param channels The number of channels.
+    \param len The number of samples to encode for each channel.
+    \return The number of bytes of G.726 data produced for each channel, or -1 if the
+            channels are not in step. */
+SPAN_DECLARE(int) g726_encode_multi(g726_state_t *s[],
+                                    uint8_t *g726_data[],
+                                    const int16_t *amp[],
+                                    int channels,
+                                    int len);
+
+/*! Select the implementation used by g726_encode_multi() and g726_decode_multi().
+    \brief Select the multi-channel G.726 implementation.
+    \param implementation The required implementation. G726_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) g726_set_implementation(int implementation);
+
+/*! Find which implementation is used by g726_encode_multi() and g726_decode_multi().
+    \brief Get the multi-channel G.726 implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) g726_get_implementation(void);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -32,9 +32,11 @@
 The GSM 06.10 module is an version of the widely used GSM FR codec software
 available from http://kbs.cs.tu-berlin.de/~jutta/toast.html. This version
 was produced since some versions of this codec are not bit exact, or not
-very efficient on modern processors. This implementation can use MMX instructions
-on Pentium class processors, or alternative methods on other processors. It
-passes all the ETSI test vectors. That is, it is a tested bit exact implementation.
+very efficient on modern processors. This implementation can use SSE2 or AVX2
+instructions for the autocorrelation, long term predictor lag search and RPE
+weighting filter on x86 processors, selected at run time to suit the CPU, or
+alternative methods on other processors. It passes all the ETSI test vectors,
+whichever implementation is in use. That is, it is a tested bit exact implementation.
 
 This implementation supports encoded data in one of three packing formats:
     - Unpacked, with the 76 parameters of a GSM 06.10 code frame each occupying a
@@ -53,6 +55,19 @@ enum
     GSM0610_PACKING_VOIP
 };
 
+/*! The implementations of the GSM 06.10 encoder's vector operations */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    GSM0610_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C */
+    GSM0610_IMPLEMENTATION_GENERIC = 1,
+    /*! SSE2 */
+    GSM0610_IMPLEMENTATION_SSE2 = 2,
+    /*! AVX2 */
+    GSM0610_IMPLEMENTATION_AVX2 = 3
+};
+
 /*!
     GSM 06.10 FR codec unpacked frame.
 */
@@ -115,6 +130,20 @@ SPAN_DECLARE(int) gsm0610_encode(gsm0610_state_t *s, uint8_t code[], const int16
     \return The number of samples returned. */
 SPAN_DECLARE(int) gsm0610_decode(gsm0610_state_t *s, int16_t amp[], const uint8_t code[], int len);
 
+/*! Select the implementation used for the vector operations of the GSM 06.10 encoder.
+    All implementations produce exactly the same results.
+    \brief Select the GSM 06.10 implementation.
+    \param implementation The required implementation. GSM0610_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) gsm0610_set_implementation(int implementation);
+
+/*! Find which implementation is used for the vector operations of the GSM 06.10 encoder.
+    \brief Get the GSM 06.10 implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) gsm0610_get_implementation(void);
+
 SPAN_DECLARE(int) gsm0610_pack_none(uint8_t c[], const gsm0610_frame_t *s);
 
 /*! Pack a pair of GSM 06.10 frames in the format used for wave files (wave type 49).
@@ -175,6 +175,15 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put_byte(hdlc_rx_state_t *s, int new_byte);
 */
 SPAN_DECLARE_NONSTD(void) hdlc_rx_put(hdlc_rx_state_t *s, const uint8_t buf[], int len);
 
+/*! \brief Select how an HDLC receiver processes whole octets, from hdlc_rx_put_byte() and
+           hdlc_rx_put(). Flag detection, destuffing, abort detection and octet counting
+           can be done for a whole octet in a few table lookups, or bit by bit. Both give
+           identical results. The tables are used by default.
+    \param s A pointer to an HDLC receiver context.
+    \param use_tables TRUE to use the octet tables. FALSE to work bit by bit.
+*/
+SPAN_DECLARE(void) hdlc_rx_set_octet_tables(hdlc_rx_state_t *s, int use_tables);
+
 /*! Initialise an HDLC transmitter context.
     \brief Initialise an HDLC transmitter context.
     \param s A pointer to an HDLC transmitter context.
@@ -217,6 +226,14 @@ SPAN_DECLARE(int) hdlc_tx_free(hdlc_tx_state_t *s);
 */
 SPAN_DECLARE(void) hdlc_tx_set_max_frame_len(hdlc_tx_state_t *s, size_t max_len);
 
+/*! \brief Select how an HDLC transmitter bit stuffs octets of frame data. This can be
+           done for a whole octet in a single table lookup, or bit by bit. Both give
+           identical results. The table is used by default.
+    \param s A pointer to an HDLC transmitter context.
+    \param use_tables TRUE to use the octet table. FALSE to work bit by bit.
+*/
+SPAN_DECLARE(void) hdlc_tx_set_octet_tables(hdlc_tx_state_t *s, int use_tables);
+
 /*! \brief Transmit a frame.
     \param s A pointer to an HDLC transmitter context.
     \param frame A pointer to the frame to be transmitted.
@@ -27,7 +27,22 @@
 
 /*! \page logging_page Logging
 \section logging_page_sec_1 What does it do?
-???.
+The logging module provides a common way for all the spandsp modules to report
+errors, protocol events, and debug information. Each module instance has its own
+logging context, with its own severity level, labelling options, and optional
+message handlers, so logging can be enabled for just the instances of interest.
+
+\section logging_page_sec_2 How does it work?
+Normally a log entry is formatted, and passed to the message handler, immediately,
+on the thread which generated it. That thread may be a media thread, which cannot
+afford to stall while a message is formatted and written out. Calling
+span_log_async_init() switches all logging to an asynchronous mode. An entry is then
+captured as a compact record, with its arguments packed according to the format, and
+put in a lock free ring belonging to the calling thread. The application calls
+span_log_async_drain() from a thread of its choosing, typically a low priority
+background thread, to format the queued records and pass them to the message handlers.
+If a ring fills, further entries are dropped and counted, and the drain reports how
+many were lost. Message handlers must be safe to call from the draining thread.
 */
 
 #if !defined(_SPANDSP_LOGGING_H_)
@@ -68,6 +83,61 @@ enum
     SPAN_LOG_DEBUG_3                    = 10
 };
 
+/*! The least severe level of log message which is compiled into the code. Calls to
+    span_log(), span_log_buf(), span_log_event() and span_log_test() for any less
+    severe level are removed by the compiler, along with the evaluation of their
+    arguments, when the level is a constant. By default everything is compiled in.
+    Define this to a lower level, such as SPAN_LOG_PROTOCOL_WARNING, when building
+    to strip the cost of flow and debug logging from the signal processing paths. */
+#if !defined(SPAN_LOG_COMPILE_LEVEL)
+#define SPAN_LOG_COMPILE_LEVEL              SPAN_LOG_DEBUG_3
+#endif
+
+/*! Test if a severity level is compiled in. */
+#define span_log_compiled(level)            (((level) & SPAN_LOG_SEVERITY_MASK) <= SPAN_LOG_COMPILE_LEVEL)
+
+/* Binary log event identifiers */
+enum
+{
+    /*! A frame received by a protocol. field[0] is a sequence number, where the protocol has one. */
+    SPAN_LOG_EVENT_FRAME_RX             = 1,
+    /*! A frame sent by a protocol. field[0] is a sequence number, where the protocol has one. */
+    SPAN_LOG_EVENT_FRAME_TX             = 2,
+    /*! A T.38 IFP packet received. field[0] is the sequence number. */
+    SPAN_LOG_EVENT_T38_IFP_RX           = 3,
+    /*! A T.38 IFP packet sent. field[0] is the sequence number. */
+    SPAN_LOG_EVENT_T38_IFP_TX           = 4
+};
+
+/*! A binary log event. This carries the raw facts of a high volume event, such as a
+    frame passing through a protocol, so it can be recorded without being formatted
+    as text. Any pointers are only valid for the duration of the handler call. */
+typedef struct
+{
+    /*! The severity level of the event. */
+    int level;
+    /*! The type of event. */
+    int event;
+    /*! The protocol name of the logging context, or NULL. */
+    const char *protocol;
+    /*! The tag of the logging context, or NULL. */
+    const char *tag;
+    /*! The sample time of the event. */
+    int64_t elapsed_samples;
+    /*! Fixed fields, whose meaning depends on the type of event. */
+    int32_t field[2];
+    /*! Any data carried by the event, such as the contents of a frame. */
+    const uint8_t *data;
+    /*! The length of data. */
+    int len;
+} span_log_event_t;
+
+/*! Binary event logging function for spandsp logging. */
+typedef void (*span_log_event_handler_func_t)(void *user_data, const span_log_event_t *event);
+
+/*! The default size of each thread's ring of records, in asynchronous mode. */
+#define SPAN_LOG_ASYNC_DEFAULT_RING_SIZE    65536
+
 /*!
     Logging descriptor. This defines the working state for a single instance of
     the logging facility for spandsp.
@@ -107,6 +177,37 @@ SPAN_DECLARE(int) span_log(logging_state_t *s, int level, const char *format, ..
 */
 SPAN_DECLARE(int) span_log_buf(logging_state_t *s, int level, const char *tag, const uint8_t *buf, int len);
 
+/*! Generate a binary log event. If the logging context has no event handler, nothing
+    is logged, and the caller should fall back on text logging.
+    \brief Generate a binary log event.
+    \param s The logging context.
+    \param level The severity level of the event.
+    \param event The type of event.
+    \param field0 The first fixed field of the event.
+    \param field1 The second fixed field of the event.
+    \param buf Any data carried by the event, or NULL.
+    \param len The length of buf.
+    \return 0 if no event generated, else 1.
+*/
+SPAN_DECLARE(int) span_log_event(logging_state_t *s, int level, int event, int32_t field0, int32_t field1, const uint8_t *buf, int len);
+
+/*! Test if binary log events of a specified severity level will be delivered.
+    \brief Test if binary log events are enabled.
+    \param s The logging context.
+    \param level The severity level to be tested.
+    \return TRUE if there is an event handler, and the level is enabled, else FALSE.
+*/
+SPAN_DECLARE(int) span_log_event_test(logging_state_t *s, int level);
+
+/*! Set a handler for binary log events. Events are delivered synchronously, so the
+    handler should do no more than record them.
+    \brief Set the binary log event handler.
+    \param s The logging context.
+    \param func The handler, or NULL to stop binary logging.
+    \param user_data An opaque pointer passed to the handler.
+*/
+SPAN_DECLARE(void) span_log_set_event_handler(logging_state_t *s, span_log_event_handler_func_t func, void *user_data);
+
 SPAN_DECLARE(int) span_log_set_level(logging_state_t *s, int level);
 
 SPAN_DECLARE(int) span_log_set_tag(logging_state_t *s, const char *tag);
@@ -125,6 +226,38 @@ SPAN_DECLARE(void) span_set_message_handler(message_handler_func_t func);
 
 SPAN_DECLARE(void) span_set_error_handler(error_handler_func_t func);
 
+/*! Switch all logging to the asynchronous mode.
+    \brief Start asynchronous logging.
+    \param ring_size The size of the ring of records created for each thread which
+           logs, in bytes. Zero selects SPAN_LOG_ASYNC_DEFAULT_RING_SIZE.
+    \return 0 if OK, or -1 if asynchronous logging is already running, or is not
+            supported on this platform. */
+SPAN_DECLARE(int) span_log_async_init(int ring_size);
+
+/*! Format the records queued by all threads in asynchronous mode, and pass them to
+    their message handlers. Only one thread may drain at a time.
+    \brief Deliver queued asynchronous log records.
+    \return The number of records delivered. */
+SPAN_DECLARE(int) span_log_async_drain(void);
+
+/*! Get the total number of log records dropped, because their thread's ring was full,
+    since asynchronous logging started.
+    \brief Get the number of dropped asynchronous log records.
+    \return The number of dropped records. */
+SPAN_DECLARE(int) span_log_async_get_dropped(void);
+
+/*! Give up the calling thread's ring of asynchronous log records, so it can be reused
+    by another thread. A thread should call this before it exits. Any records still in
+    the ring will be delivered by the drain as normal.
+    \brief Finish asynchronous logging from the calling thread. */
+SPAN_DECLARE(void) span_log_async_thread_done(void);
+
+/*! Deliver any outstanding records, and switch back to synchronous logging. This must
+    not be called while other threads might be logging.
+    \brief Stop asynchronous logging.
+    \return 0 if OK, or -1 if asynchronous logging was not running. */
+SPAN_DECLARE(int) span_log_async_release(void);
+
 SPAN_DECLARE(logging_state_t *) span_log_init(logging_state_t *s, int level, const char *tag);
 
 SPAN_DECLARE(int) span_log_release(logging_state_t *s);
@@ -135,5 +268,27 @@ SPAN_DECLARE(int) span_log_free(logging_state_t *s);
 }
 #endif
 
+/* Remove calls for levels which are not compiled in. These expand to the real
+   functions, so the functions can still be called through pointers, or with
+   the names in parentheses. */
+static __inline__ int span_log_not_compiled(void)
+{
+    /* A function call, rather than a bare 0, keeps the compiler from complaining
+       about statements with no effect when a call is removed. */
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+#define span_log_test(s, level) \
+    (span_log_compiled(level)  &&  (span_log_test)((s), (level)))
+#define span_log(s, level, ...) \
+    (span_log_compiled(level)  ?  (span_log)((s), (level), __VA_ARGS__)  :  span_log_not_compiled())
+#define span_log_buf(s, level, tag, buf, len) \
+    (span_log_compiled(level)  ?  (span_log_buf)((s), (level), (tag), (buf), (len))  :  span_log_not_compiled())
+#define span_log_event(s, level, event, field0, field1, buf, len) \
+    (span_log_compiled(level)  ?  (span_log_event)((s), (level), (event), (field0), (field1), (buf), (len))  :  span_log_not_compiled())
+#define span_log_event_test(s, level) \
+    (span_log_compiled(level)  &&  (span_log_event_test)((s), (level)))
+
 #endif
 /*- End of file ------------------------------------------------------------*/
@@ -36,11 +36,35 @@ or other restrictions.
 
 \section lpc10_page_sec_2 How does it work?
 ???.
+
+\section lpc10_page_sec_3 Processing many channels
+An LPC10 encoder is sequential within a channel, as each frame's analysis depends on the
+state left by the frames before it. Where many channels are being handled,
+lpc10_encode_multi() can encode a block of frames for each of a group of channels in one
+call. The channels are processed a frame at a time, in lockstep, and the AMDF pitch
+search, the most costly part of the analysis, is done for up to 8 channels at once, one
+per SIMD lane. The low pass filtering and covariance calculations use SIMD for single
+channels too. The results are exactly the same as those from plain C. The best
+implementation the CPU supports is picked on first use, but another may be selected
+with lpc10_set_implementation().
 */
 
 #define LPC10_SAMPLES_PER_FRAME 180
 #define LPC10_BITS_IN_COMPRESSED_FRAME 54
 
+/*! The implementations of the LPC10 encoder's vector operations */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    LPC10_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C, with channels processed one at a time */
+    LPC10_IMPLEMENTATION_GENERIC = 1,
+    /*! SSE2 */
+    LPC10_IMPLEMENTATION_SSE2 = 2,
+    /*! AVX2 */
+    LPC10_IMPLEMENTATION_AVX2 = 3
+};
+
 /*!
     LPC10 codec unpacked frame.
 */
@@ -90,6 +114,36 @@ SPAN_DECLARE(int) lpc10_encode_free(lpc10_encode_state_t *s);
     \return The number of bytes of LPC10e data produced. */
 SPAN_DECLARE(int) lpc10_encode(lpc10_encode_state_t *s, uint8_t code[], const int16_t amp[], int len);
 
+/*! Encode a buffer of linear PCM data to LPC10e for each of a group of channels. The
+    results are exactly the same as calling lpc10_encode() for each channel in turn.
+    \brief Encode several channels of linear PCM data to LPC10e.
+    \param s The LPC10e contexts, one per channel.
+    \param code The LPC10e data produced, one buffer per channel.
+    \param amp The audio sample buffers, one per channel.
+    \param channels The number of channels.
+    \param len The number of samples in each buffer. This must be a multiple of 180, as
+           this is the number of samples on a frame.
+    \return The number of bytes of LPC10e data produced for each channel, or -1 for error,
+            including a length which is not a whole number of frames. */
+SPAN_DECLARE(int) lpc10_encode_multi(lpc10_encode_state_t *s[],
+                                     uint8_t *code[],
+                                     const int16_t *amp[],
+                                     int channels,
+                                     int len);
+
+/*! Select the implementation used for the vector operations of the LPC10e encoder.
+    \brief Select the LPC10e encoder implementation.
+    \param implementation The required implementation. LPC10_IMPLEMENTATION_AUTO selects
+           the best one the CPU supports.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this CPU, or in this build. */
+SPAN_DECLARE(int) lpc10_set_implementation(int implementation);
+
+/*! Find which implementation is used for the vector operations of the LPC10e encoder.
+    \brief Get the LPC10e encoder implementation.
+    \return The implementation in use. */
+SPAN_DECLARE(int) lpc10_get_implementation(void);
+
 /*! Initialise an LPC10e decode context.
     \param s The LPC10e context
     \param error_correction ???
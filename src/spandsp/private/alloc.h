@@ -0,0 +1,48 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/alloc.h - memory allocation handling.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_ALLOC_H_)
+#define _SPANDSP_PRIVATE_ALLOC_H_
+
+/*! A memory arena. */
+struct span_arena_s
+{
+    /*! \brief The memory supplied for, or allocated for, the arena. */
+    void *base;
+    /*! \brief The memory of the arena, aligned to the allocation alignment. */
+    uint8_t *buf;
+    /*! \brief The size of the arena, in bytes. */
+    size_t size;
+    /*! \brief The number of bytes in use. */
+    size_t used;
+    /*! \brief The offset of the most recent allocation, which can be grown in place. */
+    size_t last;
+    /*! \brief TRUE if the memory of the arena was obtained from the heap, and must be
+               returned to it when the arena is released. */
+    int own_buf;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
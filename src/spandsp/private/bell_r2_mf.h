@@ -52,7 +52,7 @@ struct bell_mf_rx_state_s
     /*! An opaque pointer passed to the callback function. */
     void *digits_callback_data;
     /*! Tone detector working states */
-    goertzel_state_t out[6];
+    goertzel_bank_state_t out;
     /*! Short term history of results from the tone detection, using in persistence checking */
     uint8_t hits[5];
     /*! The current sample number within a processing block. */
@@ -91,7 +91,7 @@ struct r2_mf_rx_state_s
     /*! TRUE is we are detecting forward tones. FALSE if we are detecting backward tones */
     int fwd;
     /*! Tone detector working states */
-    goertzel_state_t out[6];
+    goertzel_bank_state_t out;
     /*! The current sample number within a processing block. */
     int current_sample;
     /*! The currently detected digit. */
@@ -111,5 +111,40 @@ struct dtmf_rx_state_s
     logging_state_t logging;
 };
 
+/*!
+    DTMF digit detector bank descriptor. The Goertzel filter states are held in
+    structure of arrays form, with the channels as the innermost index, so one
+    vector operation updates the same filter for a group of channels.
+*/
+struct dtmf_rx_bank_s
+{
+    /*! The number of channels in use. */
+    int channels;
+    /*! The number of channels processed, rounded up to a whole number of vectors. */
+    int lanes;
+    /*! The current sample number within a processing block. This is common to all
+        the channels. */
+    int current_sample;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    /*! The Goertzel filter coefficients, rows then columns. */
+    int16_t fac[8];
+    /*! The Goertzel filter states, rows then columns. */
+    int16_t v2[8][DTMF_RX_BANK_MAX_CHANNELS];
+    int16_t v3[8][DTMF_RX_BANK_MAX_CHANNELS];
+    /*! The accumlating total energy for each channel. */
+    int32_t energy[DTMF_RX_BANK_MAX_CHANNELS];
+#else
+    /*! The Goertzel filter coefficients, rows then columns. */
+    float fac[8];
+    /*! The Goertzel filter states, rows then columns. */
+    float v2[8][DTMF_RX_BANK_MAX_CHANNELS];
+    float v3[8][DTMF_RX_BANK_MAX_CHANNELS];
+    /*! The accumlating total energy for each channel. */
+    float energy[DTMF_RX_BANK_MAX_CHANNELS];
+#endif
+    /*! The receiver contexts which make the detection decisions for each channel. */
+    dtmf_rx_state_t chan[DTMF_RX_BANK_MAX_CHANNELS];
+};
+
 #endif
 /*- End of file ------------------------------------------------------------*/
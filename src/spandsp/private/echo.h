@@ -30,6 +30,56 @@
 #if !defined(_SPANDSP_PRIVATE_ECHO_H_)
 #define _SPANDSP_PRIVATE_ECHO_H_
 
+/*! The FFT length used by the frequency domain canceller. */
+#define ECHO_CAN_FDAF_FFT_LEN       (2*ECHO_CAN_FDAF_BLOCK_LEN)
+/*! The number of FFT bins kept for each partition. The inputs are real, so the
+    upper half of each spectrum is just the complex conjugate of the lower half. */
+#define ECHO_CAN_FDAF_BINS          (ECHO_CAN_FDAF_BLOCK_LEN + 1)
+
+/*!
+    Partitioned block frequency domain adaptive filter state, for the long
+    tail echo cancellation mode.
+*/
+typedef struct
+{
+    /*! The number of partitions the tail is split into */
+    int partitions;
+    /*! The partition which will next have its gradient constrained */
+    int constrain_partition;
+    /*! The number of blocks in a row for which the canceller has looked to be diverging */
+    int diverging_blocks;
+    /*! The position of the newest spectrum in the ring of transmit spectra */
+    int x_head;
+    /*! The position in the current block */
+    int pos;
+    /*! The peak transmit and receive magnitudes so far in the current block */
+    int tx_peak;
+    int rx_peak;
+    /*! The transmit, receive and clean samples for the current block */
+    int16_t tx[ECHO_CAN_FDAF_BLOCK_LEN];
+    int16_t rx[ECHO_CAN_FDAF_BLOCK_LEN];
+    int16_t clean[ECHO_CAN_FDAF_BLOCK_LEN];
+    /*! The transmit samples for the previous block */
+    float tx_old[ECHO_CAN_FDAF_BLOCK_LEN];
+    /*! The power of the transmit signal in each frequency bin, summed over the partitions */
+    float psd[ECHO_CAN_FDAF_BINS];
+    /*! FFT twiddle factors */
+    complexf_t twiddle[ECHO_CAN_FDAF_FFT_LEN/2];
+    /*! FFT bit reversal table, for the half length complex FFT */
+    int bit_rev[ECHO_CAN_FDAF_FFT_LEN/2];
+    /*! Real signal working space */
+    float buf[ECHO_CAN_FDAF_FFT_LEN];
+    /*! FFT working space */
+    complexf_t work[ECHO_CAN_FDAF_FFT_LEN/2];
+    /*! The ring of transmit spectra, one per partition */
+    complexf_t *x;
+    /*! The filter weights, one spectrum per partition */
+    complexf_t *w;
+    /*! The peak transmit magnitude of each block in the tail, in step with the ring
+        of transmit spectra */
+    int *tx_peaks;
+} echo_can_fdaf_state_t;
+
 /*!
     G.168 echo canceller descriptor. This defines the working state for a line
     echo canceller.
@@ -86,6 +136,12 @@ struct echo_can_state_s
     
     /* Snapshot sample of coeffs used for development */
     int16_t *snapshot;       
+
+    /*! The frequency domain canceller, or NULL when the time domain canceller is in use */
+    echo_can_fdaf_state_t *fdaf;
+
+    /*! Performance counters */
+    span_stats_t stats;
 };
 
 #endif
@@ -42,6 +42,9 @@ struct fax_state_s
     /*! \brief V.8 */
     //v8_state_t v8;
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
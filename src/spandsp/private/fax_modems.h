@@ -30,92 +30,122 @@
 
 /*!
     The set of modems needed for FAX, plus the auxilliary stuff, like tone generation.
+
+    The structure is laid out with the state used for every block of audio first, so
+    the dispatch of a block touches as few cache lines as possible. The modem contexts
+    follow, and the configuration, which is only touched when modems are changed, is at
+    the end. FAX is half duplex, so only one fast receive modem, and one fast transmit
+    modem, is ever in use at a time. The fast modems of each direction share memory,
+    and fax_modems_select_fast_rx_modem() and fax_modems_select_fast_tx_modem()
+    initialise the one required when the modem type changes.
 */
 struct fax_modems_state_s
 {
-    /*! TRUE is talker echo protection should be sent for the image modems */
-    int use_tep;
+    /*! \brief The current receive signal handler */
+    span_rx_handler_t *rx_handler;
+    /*! \brief The current receive missing signal fill-in handler */
+    span_rx_fillin_handler_t *rx_fillin_handler;
+    void *rx_user_data;
+
+    /*! \brief The current transmit signal handler */
+    span_tx_handler_t *tx_handler;
+    void *tx_user_data;
 
-    /*! If TRUE, transmit silence when there is nothing else to transmit. If FALSE return only
+    /*! \brief The next transmit signal handler, for two stage transmit operations.
+               E.g. a short silence followed by a modem signal. */
+    span_tx_handler_t *next_tx_handler;
+    void *next_tx_user_data;
+
+    /*! \brief If TRUE, transmission is in progress */
+    int transmit;
+    /*! \brief If TRUE, transmit silence when there is nothing else to transmit. If FALSE return only
         the actual generated audio. Note that this only affects untimed silences. Timed silences
         (e.g. the 75ms silence between V.21 and a high speed modem) will alway be transmitted as
         silent audio. */
     int transmit_on_idle;
 
-    /*! \brief An HDLC context used when transmitting HDLC messages. */
-    hdlc_tx_state_t hdlc_tx;
+    /*! \brief The currently selected receiver type */
+    int current_rx_type;
+    /*! \brief The currently selected transmitter type */
+    int current_tx_type;
+
+    /*! \brief TRUE if a carrier is present. Otherwise FALSE. */
+    int rx_signal_present;
+    /*! \brief TRUE if a modem has trained correctly. */
+    int rx_trained;
+    /*! \brief TRUE if an HDLC frame has been received correctly. */
+    int rx_frame_received;
+
+    /*! \brief */
+    dc_restore_state_t dc_restore;
+
     /*! \brief An HDLC context used when receiving HDLC messages. */
     hdlc_rx_state_t hdlc_rx;
-    /*! \brief A V.21 FSK modem context used when transmitting HDLC over V.21
-               messages. */
-    fsk_tx_state_t v21_tx;
     /*! \brief A V.21 FSK modem context used when receiving HDLC over V.21
                messages. */
     fsk_rx_state_t v21_rx;
-    struct
+    /*! \brief The fast receive modem. Which one is in use is given by fast_rx_modem. */
+    union
+    {
+        /*! \brief A V.17 modem context used when receiving FAXes at 7200bps, 9600bps
+                   12000bps or 14400bps */
+        v17_rx_state_t v17_rx;
+        /*! \brief A V.29 modem context used when receiving FAXes at 7200bps or
+                   9600bps */
+        v29_rx_state_t v29_rx;
+        /*! \brief A V.27ter modem context used when receiving FAXes at 2400bps or
+                   4800bps */
+        v27ter_rx_state_t v27ter_rx;
+    } fast_rx;
+    /*! \brief CED or CNG detector */
+    modem_connect_tones_rx_state_t connect_rx;
+
+    /*! \brief An HDLC context used when transmitting HDLC messages. */
+    hdlc_tx_state_t hdlc_tx;
+    /*! \brief A V.21 FSK modem context used when transmitting HDLC over V.21
+               messages. */
+    fsk_tx_state_t v21_tx;
+    /*! \brief The fast transmit modem. Which one is in use is given by fast_tx_modem. */
+    union
     {
         /*! \brief A V.17 modem context used when sending FAXes at 7200bps, 9600bps
                    12000bps or 14400bps */
         v17_tx_state_t v17_tx;
-        /*! \brief A V.29 modem context used when receiving FAXes at 7200bps, 9600bps
-                   12000bps or 14400bps */
-        v17_rx_state_t v17_rx;
         /*! \brief A V.29 modem context used when sending FAXes at 7200bps or
                    9600bps */
         v29_tx_state_t v29_tx;
-        /*! \brief A V.29 modem context used when receiving FAXes at 7200bps or
-                   9600bps */
-        v29_rx_state_t v29_rx;
         /*! \brief A V.27ter modem context used when sending FAXes at 2400bps or
                    4800bps */
         v27ter_tx_state_t v27ter_tx;
-        /*! \brief A V.27ter modem context used when receiving FAXes at 2400bps or
-                   4800bps */
-        v27ter_rx_state_t v27ter_rx;
-    } fast_modems;
+    } fast_tx;
     /*! \brief Used to insert timed silences. */
     silence_gen_state_t silence_gen;
     /*! \brief CED or CNG generator */
     modem_connect_tones_tx_state_t connect_tx;
-    /*! \brief CED or CNG detector */
-    modem_connect_tones_rx_state_t connect_rx;
-    /*! \brief */
-    dc_restore_state_t dc_restore;
-
-    /*! \brief The currently selected receiver type */
-    int current_rx_type;
-    /*! \brief The currently selected transmitter type */
-    int current_tx_type;
-
-    /*! \brief TRUE if a carrier is present. Otherwise FALSE. */
-    int rx_signal_present;
-    /*! \brief TRUE if a modem has trained correctly. */
-    int rx_trained;
-    /*! \brief TRUE if an HDLC frame has been received correctly. */
-    int rx_frame_received;
 
-    /*! \brief The current receive signal handler */
-    span_rx_handler_t *rx_handler;
-    /*! \brief The current receive missing signal fill-in handler */
-    span_rx_fillin_handler_t *rx_fillin_handler;
-    void *rx_user_data;
-
-    /*! \brief The current transmit signal handler */
-    span_tx_handler_t *tx_handler;
-    void *tx_user_data;
-
-    /*! \brief The next transmit signal handler, for two stage transmit operations.
-               E.g. a short silence followed by a modem signal. */
-    span_tx_handler_t *next_tx_handler;
-    void *next_tx_user_data;
+    /*! \brief The fast receive modem currently occupying fast_rx (e.g. FAX_MODEM_V17_RX). */
+    int fast_rx_modem;
+    /*! \brief The fast transmit modem currently occupying fast_tx (e.g. FAX_MODEM_V17_TX). */
+    int fast_tx_modem;
 
     /*! \brief The current bit rate of the transmitter. */
     int tx_bit_rate;
     /*! \brief The current bit rate of the receiver. */
     int rx_bit_rate;
 
-    /*! \brief If TRUE, transmission is in progress */
-    int transmit;
+    /*! TRUE is talker echo protection should be sent for the image modems */
+    int use_tep;
+    /*! \brief The signal cutoff level for the V.29 receiver, in dBm0. This is applied each time
+               the V.29 receiver is selected. */
+    float v29_rx_cutoff;
+
+    /*! \brief The bit sink used by a newly selected fast receive modem. */
+    put_bit_func_t fast_put_bit;
+    /*! \brief The bit source used by a newly selected fast transmit modem. */
+    get_bit_func_t fast_get_bit;
+    /*! \brief An opaque pointer passed to fast_put_bit and fast_get_bit. */
+    void *fast_bit_user_data;
+
     /*! \brief Audio logging file handle for received audio. */
     int audio_rx_log;
     /*! \brief Audio logging file handle for transmitted audio. */
@@ -83,7 +83,6 @@ struct fsk_rx_state_s
 
     int correlation_span;
 
-    complexi32_t window[2][FSK_MAX_WINDOW_LEN];
     complexi32_t dot[2];
     int buf_ptr;
 
@@ -92,6 +91,11 @@ struct fsk_rx_state_s
     int baud_phase;
     int last_bit;
     int scaling_shift;
+
+    /*! \brief The correlation history for the two tones. The entries for the two tones
+               are interleaved, so each sample only touches one small span of memory, and
+               only the first correlation_span entries are ever touched. */
+    complexi32_t window[FSK_MAX_WINDOW_LEN][2];
 };
 
 #endif
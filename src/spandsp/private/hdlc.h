@@ -66,6 +66,9 @@ struct hdlc_rx_state_s
     int octet_count;
     /*! \brief The number of octets to be allowed between octet count reports. */
     int octet_count_report_interval;
+    /*! \brief TRUE if whole octets are destuffed through lookup tables, rather than
+               bit by bit. */
+    int octet_tables;
 
     /*! \brief Buffer for a frame in progress. */
     uint8_t buffer[HDLC_MAXFRAME_LEN + 4];
@@ -115,6 +118,9 @@ struct hdlc_tx_state_s
     int abort_octets;
     /*! \brief TRUE if the next underflow of timed flag octets should be reported */
     int report_flag_underflow;
+    /*! \brief TRUE if whole octets are stuffed through a lookup table, rather than
+               bit by bit. */
+    int octet_tables;
 
     /*! \brief The current message being transmitted, with its CRC attached. */
     uint8_t buffer[HDLC_MAXFRAME_LEN + 4];
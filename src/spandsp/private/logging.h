@@ -40,6 +40,8 @@ struct logging_state_s
 
     message_handler_func_t span_message;
     error_handler_func_t span_error;
+    span_log_event_handler_func_t span_event;
+    void *span_event_user_data;
 };
 
 #endif
@@ -26,6 +26,11 @@
 #if !defined(_SPANDSP_PRIVATE_QUEUE_H_)
 #define _SPANDSP_PRIVATE_QUEUE_H_
 
+/*! The separation used to keep the fields owned by the writer and the reader of a queue
+    in different cache lines, so the two ends of a queue shared between threads do not
+    keep stealing a cache line from each other. */
+#define QUEUE_CACHE_LINE_SEPARATION 64
+
 /*!
     Queue descriptor. This defines the working state for a single instance of
     a byte stream or message oriented queue.
@@ -36,10 +41,16 @@ struct queue_state_s
     int flags;
     /*! \brief The length of the data buffer. */
     int len;
-    /*! \brief The buffer input pointer. */
+    /*! \brief The buffer input pointer. This is only changed by the writer. */
     volatile int iptr;
-    /*! \brief The buffer output pointer. */
+    /*! \brief The writer's last sight of the output pointer, used in QUEUE_ATOMIC mode. */
+    int optr_cache;
+    uint8_t pad1[QUEUE_CACHE_LINE_SEPARATION - 4*sizeof(int)];
+    /*! \brief The buffer output pointer. This is only changed by the reader. */
     volatile int optr;
+    /*! \brief The reader's last sight of the input pointer, used in QUEUE_ATOMIC mode. */
+    int iptr_cache;
+    uint8_t pad2[QUEUE_CACHE_LINE_SEPARATION - 2*sizeof(int)];
 #if defined(SPANDSP_FULLY_DEFINE_QUEUE_STATE_T)
     /*! \brief The data buffer, sized at the time the structure is created. */
     uint8_t data[];
@@ -26,21 +26,44 @@
 #if !defined(_SPANDSP_PRIVATE_SCHEDULE_H_)
 #define _SPANDSP_PRIVATE_SCHEDULE_H_
 
-/*! A scheduled event entry. */
+/*! A scheduled event entry. Entries live in a slot table, and the slot index is the
+    ID handed back to the caller, so an ID stays valid until its event fires or is
+    deleted, however the heap is reordered. */
 struct span_sched_s
 {
-    uint64_t when;
     span_sched_callback_func_t callback;
     void *user_data;
+    /*! The entry's position in the heap while the event is pending, or the next
+        free slot while the entry is unused. */
+    int pos;
 };
 
+/*! An entry in the heap of pending events. The time is kept here, rather than in
+    the slot, so the heap can be reordered without touching the slot table. */
+typedef struct
+{
+    uint64_t when;
+    /*! A sequence number, used to fire events due at the same time in the order
+        they were scheduled. */
+    uint32_t seq;
+    int slot;
+} span_sched_heap_entry_t;
+
 /*! A scheduled event queue. */
 struct span_sched_state_s
 {
     uint64_t ticker;
+    uint32_t seq;
+    /*! The number of entries allocated in the slot table and the heap. */
     int allocated;
-    int max_to_date;
+    /*! The number of pending events. */
+    int entries;
+    /*! The head of the list of free slots, or -1 if there are none. */
+    int free_slot;
+    /*! The slot table. */
     span_sched_t *sched;
+    /*! A binary min-heap of pending events, ordered by time and sequence. */
+    span_sched_heap_entry_t *heap;
     logging_state_t logging;
 };
 
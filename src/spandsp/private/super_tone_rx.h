@@ -58,7 +58,7 @@ struct super_tone_rx_state_s
     tone_segment_func_t segment_callback;
     void *callback_data;
     super_tone_rx_segment_t segments[11];
-    goertzel_state_t state[];
+    goertzel_bank_state_t state;
 };
 
 #endif
@@ -246,8 +246,11 @@ struct t30_state_s
     int receiver_not_ready_count;
     /*! \brief The number of octets to be used per ECM frame. */
     int octets_per_ecm_frame;
-    /*! \brief The ECM partial page buffer. */
-    uint8_t ecm_data[256][260];
+    /*! \brief The ECM partial page buffer, holding 256 frames. This is only allocated
+               when ECM is used, and is sized for the frame length in use. */
+    uint8_t *ecm_buf;
+    /*! \brief The spacing of the frames in the ECM partial page buffer. */
+    int ecm_frame_stride;
     /*! \brief The lengths of the frames in the ECM partial page buffer. */
     int16_t ecm_len[256];
     /*! \brief A bit map of the OK ECM frames, constructed as a PPR frame. */
@@ -190,6 +190,9 @@ struct t31_state_s
     int short_train;
     queue_state_t *rx_queue;
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
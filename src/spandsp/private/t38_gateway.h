@@ -200,6 +200,9 @@ struct t38_gateway_state_s
     /*! T.38 core state */
     t38_gateway_core_state_t core;
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -115,6 +115,9 @@ struct t38_terminal_state_s
     /*! \brief The T.38 front-end */
     t38_terminal_front_end_state_t t38_fe;
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
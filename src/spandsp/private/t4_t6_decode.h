@@ -77,6 +77,12 @@ struct t4_t6_decode_state_s
     int rx_bits;
     /*! \brief The number of bits to be skipped before trying to match the next code word. */
     int rx_skip_bits;
+    /*! \brief TRUE if whole code words may be dropped at once, rather than scanning every
+               bit position within them for an EOL. */
+    int fast_decode;
+    /*! \brief TRUE while fast decoding is in step with the code words. A bad code clears
+               this, and the bit by bit scan for EOLs takes over until the next EOL. */
+    int codes_in_step;
 
     /*! \brief Decoded pixel buffer. */
     //uint32_t pixel_stream;
@@ -234,6 +234,9 @@ struct v17_rx_state_s
                from the last states of the trellis. */
     float distances[8];
 #endif
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -188,6 +188,9 @@ struct v27ter_rx_state_s
     /*! \brief History list of phase angle differences for the coarse carrier aquisition step. */
     int32_t diff_angles[16];
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -193,6 +193,9 @@ struct v29_rx_state_s
                differential decoding. */
     int constellation_state;
 
+    /*! \brief Performance counters */
+    span_stats_t stats;
+
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -34,7 +34,18 @@ threads writing or many threads reading. Those things would require locking,
 to avoid conflicts between the multiple threads acting on one end of the queue.
 
 \section queue_page_sec_2 How does it work?
-???.
+The queue is a circular buffer, with an input pointer which only the writer changes,
+and an output pointer which only the reader changes. Each end only moves its own
+pointer once it has completely finished with the data involved.
+
+If the two ends of a queue are used from different threads, the queue should be
+created with the QUEUE_ATOMIC flag. The pointers are then handed between the threads
+with acquire and release semantics, so the queue is safe on processors with weakly
+ordered memory, such as ARM and POWER, without the need for a mutex. The writer's and
+reader's pointers live in separate cache lines, and each end works from its last
+sight of the other end's pointer, only refreshing it when that shows too little data
+or space. This keeps the two threads from constantly contending for the same cache
+lines.
 */
 
 #if !defined(_SPANDSP_QUEUE_H_)
@@ -46,6 +57,10 @@ to avoid conflicts between the multiple threads acting on one end of the queue.
 /*! Flag bit to indicate queue writes are atomic operations. This must be set
     if the queue is to be used with the message oriented functions. */
 #define QUEUE_WRITE_ATOMIC  0x0002
+/*! Flag bit to indicate the queue is shared between a writer thread and a reader
+    thread, and should operate as a lock free single producer, single consumer queue,
+    with proper memory ordering between the threads. */
+#define QUEUE_ATOMIC        0x0004
 
 /*!
     Queue descriptor. This defines the working state for a single instance of
@@ -121,6 +136,48 @@ SPAN_DECLARE(int) queue_write(queue_state_t *s, const uint8_t *buf, int len);
     \return the number of bytes actually written. */
 SPAN_DECLARE(int) queue_write_byte(queue_state_t *s, uint8_t byte);
 
+/*! Get direct access to free space in a queue, so data can be written in place, rather
+    than copied in from another buffer. The space is returned as up to two contiguous
+    spans, the second being used when the space wraps around the end of the queue's
+    buffer. Nothing is added to the queue until queue_write_commit() is called. Only
+    the thread writing to the queue may use this.
+    \brief Reserve space in a queue for writing in place.
+    \param s The queue context.
+    \param buf Returns pointers to the start of the spans. The second is NULL if unused.
+    \param buf_len Returns the lengths of the spans.
+    \param len The amount of space wanted.
+    \return The total length of the spans, or -1 if len bytes are not available
+            and the queue has QUEUE_WRITE_ATOMIC set. */
+SPAN_DECLARE(int) queue_write_reserve(queue_state_t *s, uint8_t *buf[2], int buf_len[2], int len);
+
+/*! Add bytes written in place, in space obtained from queue_write_reserve(), to a queue.
+    \brief Commit bytes written in place to a queue.
+    \param s The queue context.
+    \param len The number of bytes to add, which may be less than was reserved.
+    \return len, or -1 if there is not that much free space in the queue. */
+SPAN_DECLARE(int) queue_write_commit(queue_state_t *s, int len);
+
+/*! Get direct access to the data in a queue, so it can be parsed in place, rather
+    than copied out to another buffer. The data is returned as up to two contiguous
+    spans, the second being used when the data wraps around the end of the queue's
+    buffer. Nothing is removed from the queue until queue_read_consume() is called.
+    Only the thread reading from the queue may use this.
+    \brief Look at data in a queue in place.
+    \param s The queue context.
+    \param buf Returns pointers to the start of the spans. The second is NULL if unused.
+    \param buf_len Returns the lengths of the spans.
+    \param len The amount of data wanted.
+    \return The total length of the spans, or -1 if len bytes are not available
+            and the queue has QUEUE_READ_ATOMIC set. */
+SPAN_DECLARE(int) queue_read_peek(queue_state_t *s, const uint8_t *buf[2], int buf_len[2], int len);
+
+/*! Remove bytes, typically those examined with queue_read_peek(), from a queue.
+    \brief Remove bytes from a queue.
+    \param s The queue context.
+    \param len The number of bytes to remove.
+    \return len, or -1 if the queue does not contain that much data. */
+SPAN_DECLARE(int) queue_read_consume(queue_state_t *s, int len);
+
 /*! Test the length of the message at the head of a queue.
     \brief Test message length.
     \param s The queue context.
@@ -147,6 +204,43 @@ SPAN_DECLARE(int) queue_read_msg(queue_state_t *s, uint8_t *buf, int len);
     \return The number of bytes actually written. */
 SPAN_DECLARE(int) queue_write_msg(queue_state_t *s, const uint8_t *buf, int len);
 
+/*! Get direct access to space for a message in a queue, so the message can be built
+    in place. The space is returned as for queue_write_reserve(). The message is not
+    added to the queue until queue_write_msg_commit() is called.
+    \brief Reserve space in a queue for a message.
+    \param s The queue context.
+    \param buf Returns pointers to the start of the spans. The second is NULL if unused.
+    \param buf_len Returns the lengths of the spans.
+    \param len The length of the message.
+    \return len, or -1 if there is not room for the message. */
+SPAN_DECLARE(int) queue_write_msg_reserve(queue_state_t *s, uint8_t *buf[2], int buf_len[2], int len);
+
+/*! Add a message built in place, in space obtained from queue_write_msg_reserve(),
+    to a queue.
+    \brief Commit a message built in place to a queue.
+    \param s The queue context.
+    \param len The length of the message, which may be less than was reserved.
+    \return len, or -1 if there is not room for the message. */
+SPAN_DECLARE(int) queue_write_msg_commit(queue_state_t *s, int len);
+
+/*! Get direct access to the message at the head of a queue, so it can be parsed in
+    place. The message is returned as for queue_read_peek(). It is not removed from
+    the queue until queue_read_msg_consume() is called.
+    \brief Look at the message at the head of a queue in place.
+    \param s The queue context.
+    \param buf Returns pointers to the start of the spans. The second is NULL if unused.
+    \param buf_len Returns the lengths of the spans.
+    \return The length of the message. If there are no messages in the queue, -1 is
+            returned. */
+SPAN_DECLARE(int) queue_read_msg_peek(queue_state_t *s, const uint8_t *buf[2], int buf_len[2]);
+
+/*! Remove the message at the head of a queue.
+    \brief Remove a message from a queue.
+    \param s The queue context.
+    \return The length of the message removed. If there are no messages in the queue,
+            -1 is returned. */
+SPAN_DECLARE(int) queue_read_msg_consume(queue_state_t *s);
+
 /*! Initialise a queue.
     \brief Initialise a queue.
     \param s The queue context. If is imperative that the context this
@@ -154,7 +248,7 @@ SPAN_DECLARE(int) queue_write_msg(queue_state_t *s, const uint8_t *buf, int len)
            size + 1 octet.
     \param len The length of the queue's buffer.
     \param flags Flags controlling the operation of the queue.
-           Valid flags are QUEUE_READ_ATOMIC and QUEUE_WRITE_ATOMIC.
+           Valid flags are QUEUE_READ_ATOMIC, QUEUE_WRITE_ATOMIC and QUEUE_ATOMIC.
     \return A pointer to the context if OK, else NULL. */
 SPAN_DECLARE(queue_state_t *) queue_init(queue_state_t *s, int len, int flags);
 
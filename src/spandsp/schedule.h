@@ -27,10 +27,18 @@
 
 /*! \page schedule_page Scheduling
 \section schedule_page_sec_1 What does it do?
-???.
+The scheduler calls back functions at requested times, measured in microseconds on a
+time line which is advanced by the application. It is intended for driving timers in
+simulations, where there may be a large number of events pending at any one time.
 
 \section schedule_page_sec_2 How does it work?
-???.
+Pending events are kept in a binary min-heap, ordered by their due time, so scheduling,
+deleting, and dispatching an event all cost O(log n), and finding the next event due
+costs O(1). Events due at the same time are dispatched in the order they were
+scheduled. The ID returned when an event is scheduled indexes a slot table, which
+tracks where the event currently sits in the heap. The ID stays valid until the event
+fires or is deleted, after which it may be reused. Events scheduled from within a
+callback are never dispatched until the next update, even if they are already due.
 */
 
 #if !defined(_SPANDSP_SCHEDULE_H_)
@@ -49,11 +57,33 @@ extern "C"
 {
 #endif
 
+/*! Find the time at which the next scheduled event is due.
+    \param s The scheduler context.
+    \return The time, in microseconds. If there are no events pending, the maximum
+            possible time is returned. */
 SPAN_DECLARE(uint64_t) span_schedule_next(span_sched_state_t *s);
+
+/*! Get the scheduler's current time.
+    \param s The scheduler context.
+    \return The time, in microseconds. */
 SPAN_DECLARE(uint64_t) span_schedule_time(span_sched_state_t *s);
 
+/*! Schedule an event.
+    \param s The scheduler context.
+    \param us The delay from now until the event is due, in microseconds.
+    \param function The callback function for the event.
+    \param user_data An opaque pointer passed to the callback function.
+    \return The ID of the event, or -1 if it could not be scheduled. */
 SPAN_DECLARE(int) span_schedule_event(span_sched_state_t *s, int us, span_sched_callback_func_t function, void *user_data);
+
+/*! Advance the scheduler's time, and call back any events which fall due.
+    \param s The scheduler context.
+    \param us The time step, in microseconds. */
 SPAN_DECLARE(void) span_schedule_update(span_sched_state_t *s, int us);
+
+/*! Delete a scheduled event, before it falls due.
+    \param s The scheduler context.
+    \param id The ID of the event. */
 SPAN_DECLARE(void) span_schedule_del(span_sched_state_t *s, int id);
 
 SPAN_DECLARE(span_sched_state_t *) span_schedule_init(span_sched_state_t *s);
@@ -0,0 +1,141 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * stats.h - Per object performance counters
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page stats_page Performance counters
+
+\section stats_page_sec_1 What does it do?
+The larger processing objects - the FAX, T.31, T.38 gateway and T.38 terminal engines,
+the V.17, V.29 and V.27ter receivers, and the echo canceller - each keep a small block
+of counters, describing how much work they have done, and how well it has gone. A
+snapshot of these counters can be taken at any time with the object's
+xxx_get_stats() function. When a system is running many channels, the snapshots can
+be gathered, and formatted in the Prometheus text exposition format by
+span_stats_format(), ready to be scraped by a monitoring system.
+
+The counters are:
+    - samples_in - the number of audio samples received. For a T.38 terminal, or T.31
+      working in T.38 mode, which have no audio, this is the elapsed time, in samples,
+      passed to its xxx_send_timeout() function.
+    - samples_out - the number of audio samples generated.
+    - cycles - the CPU time spent in the object's block processing functions, in CPU
+      clock cycles. This is only measured on machines with a suitable cycle counter, and
+      is zero elsewhere.
+    - frames_in - the number of good HDLC frames received.
+    - frames_out - the number of HDLC frames sent.
+    - crc_errors - the number of HDLC frames received with a bad CRC.
+    - retrains - the number of times a receive modem has been (re)started, to train its
+      equalizer. For the echo canceller, this is the number of times the adapted taps
+      have been thrown away, because the canceller diverged.
+    - underflows - the number of times input did not arrive in time. This covers calls to
+      the xxx_rx_fillin() functions, to cover for lost audio, and missing T.38 packets.
+
+\section stats_page_sec_2 How does it work?
+The counters are simple integers, bumped at the points where the events occur, so
+they cost very little. They are never reset while the object is in use, so they behave
+as monotonic counters. They are not updated atomically. A snapshot taken from another
+thread, while the object is running, may be very slightly inconsistent, but this is
+not significant for monitoring purposes.
+*/
+
+#if !defined(_SPANDSP_STATS_H_)
+#define _SPANDSP_STATS_H_
+
+/*!
+    Performance counters for a processing object.
+*/
+typedef struct
+{
+    /*! \brief The number of audio samples received. */
+    uint64_t samples_in;
+    /*! \brief The number of audio samples generated. */
+    uint64_t samples_out;
+    /*! \brief The number of CPU cycles spent processing. */
+    uint64_t cycles;
+    /*! \brief The number of good HDLC frames received. */
+    uint64_t frames_in;
+    /*! \brief The number of HDLC frames sent. */
+    uint64_t frames_out;
+    /*! \brief The number of HDLC frames received with a bad CRC. */
+    uint64_t crc_errors;
+    /*! \brief The number of times a receiver has been (re)trained. */
+    uint64_t retrains;
+    /*! \brief The number of times input did not arrive in time. */
+    uint64_t underflows;
+} span_stats_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Read the cycle counter used to time processing.
+    \return The current cycle count, or zero where there is no suitable counter. */
+static __inline__ uint64_t span_stats_cycles(void)
+{
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+    return rdtscll();
+#else
+    return 0;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+/*! \brief Clear a set of performance counters.
+    \param s The counters. */
+SPAN_DECLARE(void) span_stats_reset(span_stats_t *s);
+
+/*! \brief Add one set of performance counters into another. This may be used to
+           total the counters for a group of channels.
+    \param total The counters to be added to.
+    \param s The counters to be added. */
+SPAN_DECLARE(void) span_stats_accumulate(span_stats_t *total, const span_stats_t *s);
+
+/*! \brief Format a set of snapshots of performance counters in the Prometheus text
+           exposition format. Each counter becomes a metric family, with one sample
+           for each snapshot.
+    \param buf The buffer for the text.
+    \param len The length of the buffer.
+    \param prefix The prefix for the metric names (e.g. "spandsp_fax").
+    \param labels An array of label sets, one per snapshot (e.g. "channel=\"3\""). This
+           may be NULL, and any individual entry may be NULL, where no labels are needed.
+    \param stats An array of counter snapshots.
+    \param entries The number of snapshots.
+    \return The length of the text, excluding the terminating nul, or -1 if the buffer
+            is too small. */
+SPAN_DECLARE(int) span_stats_format(char *buf,
+                                    int len,
+                                    const char *prefix,
+                                    const char *labels[],
+                                    const span_stats_t stats[],
+                                    int entries);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -606,6 +606,13 @@ SPAN_DECLARE(int) t30_restart(t30_state_t *s);
     \return TRUE for call still active, or FALSE for call completed. */
 SPAN_DECLARE(int) t30_call_active(t30_state_t *s);
 
+/*! Find how much memory a T.30 context is using. This is the context itself, plus
+    the ECM partial page buffer, which is only allocated while ECM is in use.
+    \brief Get the memory footprint of a T.30 context.
+    \param s The T.30 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(size_t) t30_get_memory_footprint(t30_state_t *s);
+
 /*! Cleanup a T.30 context if the call terminates.
     \brief Cleanup a T.30 context if the call terminates.
     \param s The T.30 context. */
@@ -119,6 +119,20 @@ SPAN_DECLARE(void) t31_set_mode(t31_state_t *s, int t38_mode);
 */
 SPAN_DECLARE(logging_state_t *) t31_get_logging_state(t31_state_t *s);
 
+/*! Get a snapshot of the performance counters of a T.31 context.
+    \brief Get a snapshot of the performance counters of a T.31 context.
+    \param s The T.31 context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) t31_get_stats(t31_state_t *s, span_stats_t *stats);
+
+/*! Find how much memory a T.31 context is using, including its receive queue.
+    \brief Get the memory footprint of a T.31 context.
+    \param s The T.31 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(size_t) t31_get_memory_footprint(t31_state_t *s);
+
 SPAN_DECLARE(t38_core_state_t *) t31_get_t38_core_state(t31_state_t *s);
 
 /*! Initialise a T.31 context. This must be called before the first
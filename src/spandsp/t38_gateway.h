@@ -205,6 +205,20 @@ SPAN_DECLARE(t38_core_state_t *) t38_gateway_get_t38_core_state(t38_gateway_stat
 */
 SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_t *s);
 
+/*! Get a snapshot of the performance counters of a T.38 gateway context.
+    \brief Get a snapshot of the performance counters of a T.38 gateway context.
+    \param s The T.38 context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) t38_gateway_get_stats(t38_gateway_state_t *s, span_stats_t *stats);
+
+/*! Find how much memory a T.38 gateway context is using.
+    \brief Get the memory footprint of a T.38 gateway context.
+    \param s The T.38 gateway context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(size_t) t38_gateway_get_memory_footprint(t38_gateway_state_t *s);
+
 /*! Set a callback function for T.30 frame exchange monitoring. This is called from the heart
     of the signal processing, so don't take too long in the handler routine.
     \brief Set a callback function for T.30 frame exchange monitoring.
@@ -106,6 +106,21 @@ SPAN_DECLARE(t38_core_state_t *) t38_terminal_get_t38_core_state(t38_terminal_st
 */
 SPAN_DECLARE(logging_state_t *) t38_terminal_get_logging_state(t38_terminal_state_t *s);
 
+/*! Get a snapshot of the performance counters of a T.38 terminal context.
+    \brief Get a snapshot of the performance counters of a T.38 terminal context.
+    \param s The T.38 context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1.
+*/
+SPAN_DECLARE(int) t38_terminal_get_stats(t38_terminal_state_t *s, span_stats_t *stats);
+
+/*! Find how much memory a termination mode T.38 context is using, including any
+    ECM buffer allocated by its T.30 engine.
+    \brief Get the memory footprint of a T.38 context.
+    \param s The T.38 context.
+    \return The number of bytes in use. */
+SPAN_DECLARE(size_t) t38_terminal_get_memory_footprint(t38_terminal_state_t *s);
+
 /*! \brief Reinitialise a termination mode T.38 context.
     \param s The T.38 context.
     \param calling_party TRUE if the context is for a calling party. FALSE if the
@@ -273,6 +273,16 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_rx_state_t *s);
     \return 0 for success, otherwise -1. */
 SPAN_DECLARE(int) t4_rx_set_row_write_handler(t4_rx_state_t *s, t4_row_write_handler_t handler, void *user_data);
 
+/*! \brief Select fast decoding of T.4 1D, T.4 2D and T.6 data. Normally the decoder scans
+           for an EOL at every bit position, so it recovers as quickly as possible from bit
+           errors. In fast decode mode each code word is dropped whole, and EOLs are only
+           sought between code words. When a bad code word is seen the decoder falls back
+           to the bit by bit scan, until the next EOL puts it back in step. This suits
+           error free data, such as stored images, where throughput is what matters.
+    \param s The T.4 context.
+    \param fast TRUE to use fast decoding. */
+SPAN_DECLARE(void) t4_rx_set_fast_decode(t4_rx_state_t *s, int fast);
+
 /*! \brief Set the encoding for the received data.
     \param s The T.4 context.
     \param encoding The encoding. */
@@ -35,6 +35,20 @@
     \return len for OK, or zero to indicate the end of the image data. */
 typedef int (*t4_row_read_handler_t)(void *user_data, uint8_t buf[], size_t len);
 
+/*! The implementations of the row to run length conversion, used by the T.4 1D, T.4 2D
+    and T.6 encoders, which may be selected */
+enum
+{
+    /*! Pick the best implementation the CPU supports */
+    T4_TX_IMPLEMENTATION_AUTO = 0,
+    /*! Plain C, stepping through the row 32 bits at a time */
+    T4_TX_IMPLEMENTATION_WORD32 = 1,
+    /*! Plain C, stepping through the row 64 bits at a time */
+    T4_TX_IMPLEMENTATION_WORD64 = 2,
+    /*! As WORD64, with x86 AVX2 skipping of long all white or all black stretches */
+    T4_TX_IMPLEMENTATION_AVX2 = 3
+};
+
 #if defined(SPANDSP_SUPPORT_TIFF_FX)
 /* TIFF-FX related extensions to the tag set supported by libtiff */
 
@@ -335,6 +349,20 @@ SPAN_DECLARE(int) t4_tx_get_current_page_in_file(t4_tx_state_t *s);
     \param t A pointer to a statistics structure. */
 SPAN_DECLARE(void) t4_tx_get_transfer_statistics(t4_tx_state_t *s, t4_stats_t *t);
 
+/*! Select the implementation used to find the colour transitions in each row to be
+    encoded. All the implementations give identical results. By default the fastest
+    available one is picked on first use.
+    \brief Select the row to run length implementation.
+    \param implementation The required implementation. T4_TX_IMPLEMENTATION_AUTO selects
+           the best one available.
+    \return The implementation selected, or -1 if the requested one is not available
+            on this machine. */
+SPAN_DECLARE(int) t4_tx_set_implementation(int implementation);
+
+/*! \brief Get the implementation used to find the colour transitions in each row.
+    \return The implementation in use. */
+SPAN_DECLARE(int) t4_tx_get_implementation(void);
+
 /*! \brief Prepare for transmission of a document.
     \param s The T.4 context.
     \param file The name of the file to be sent.
@@ -57,6 +57,39 @@ struct goertzel_state_s
     int current_sample;
 };
 
+/*! The maximum number of frequencies a Goertzel bank can evaluate. */
+#define GOERTZEL_BANK_MAX_FREQS 64
+
+/*!
+    Goertzel filter bank state descriptor. This evaluates a set of Goertzel
+    filters, all with the same block length, over the same signal. The filter
+    states are held as arrays, so one vector operation updates several filters.
+*/
+struct goertzel_bank_state_s
+{
+    /*! The number of frequencies being evaluated. */
+    int freqs;
+    /*! The number of frequencies rounded up to the vector length in use. */
+    int lanes;
+    /*! The number of samples in a Goertzel block. */
+    int samples;
+    /*! The current sample number within the block. */
+    int current_sample;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t fac[GOERTZEL_BANK_MAX_FREQS];
+    int16_t v2[GOERTZEL_BANK_MAX_FREQS];
+    int16_t v3[GOERTZEL_BANK_MAX_FREQS];
+    /*! The sum of the squares of the samples in the block so far. */
+    int32_t energy;
+#else
+    float fac[GOERTZEL_BANK_MAX_FREQS];
+    float v2[GOERTZEL_BANK_MAX_FREQS];
+    float v3[GOERTZEL_BANK_MAX_FREQS];
+    /*! The sum of the squares of the samples in the block so far. */
+    float energy;
+#endif
+};
+
 /*!
     Goertzel filter descriptor.
 */
@@ -67,6 +100,11 @@ typedef struct goertzel_descriptor_s goertzel_descriptor_t;
 */
 typedef struct goertzel_state_s goertzel_state_t;
 
+/*!
+    Goertzel filter bank state descriptor.
+*/
+typedef struct goertzel_bank_state_s goertzel_bank_state_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -78,7 +116,7 @@ SPAN_DECLARE(void) make_goertzel_descriptor(goertzel_descriptor_t *t,
                                             int samples);
 
 /*! \brief Initialise the state of a Goertzel transform.
-    \param s The Goertzel context. If NULL, a context is allocated with malloc.
+    \param s The Goertzel context. If NULL, a context is allocated with span_alloc().
     \param t The Goertzel descriptor.
     \return A pointer to the Goertzel state. */
 SPAN_DECLARE(goertzel_state_t *) goertzel_init(goertzel_state_t *s,
@@ -113,6 +151,47 @@ SPAN_DECLARE(int32_t) goertzel_result(goertzel_state_t *s);
 SPAN_DECLARE(float) goertzel_result(goertzel_state_t *s);
 #endif
 
+/*! \brief Initialise a bank of Goertzel transforms, which evaluate several frequencies
+           in one pass over a signal.
+    \param s The Goertzel bank context. If NULL, a context is allocated with span_alloc().
+    \param t An array of Goertzel descriptors, which must all have the same block length.
+    \param freqs The number of descriptors, up to GOERTZEL_BANK_MAX_FREQS.
+    \return A pointer to the Goertzel bank state, or NULL on error. */
+SPAN_DECLARE(goertzel_bank_state_t *) goertzel_bank_init(goertzel_bank_state_t *s,
+                                                         const goertzel_descriptor_t t[],
+                                                         int freqs);
+
+SPAN_DECLARE(int) goertzel_bank_release(goertzel_bank_state_t *s);
+
+SPAN_DECLARE(int) goertzel_bank_free(goertzel_bank_state_t *s);
+
+/*! \brief Reset the state of a bank of Goertzel transforms.
+    \param s The Goertzel bank context. */
+SPAN_DECLARE(void) goertzel_bank_reset(goertzel_bank_state_t *s);
+
+/*! \brief Update the state of a bank of Goertzel transforms. This stops at the end of
+           the current block, so goertzel_bank_result() can be called.
+    \param s The Goertzel bank context.
+    \param amp The samples to be transformed.
+    \param samples The number of samples.
+    \return The number of samples processed. */
+SPAN_DECLARE(int) goertzel_bank_update(goertzel_bank_state_t *s,
+                                       const int16_t amp[],
+                                       int samples);
+
+/*! \brief Evaluate the final results of a bank of Goertzel transforms, and reset the
+           bank for the next block.
+    \param s The Goertzel bank context.
+    \param result The results, one per frequency, in the order of the descriptors given
+           to goertzel_bank_init(). Each is on the same scale as goertzel_result().
+    \return The sum of the squares of the samples in the block. In a fixed point build the
+            samples are scaled down, as they are for the Goertzel filters. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+SPAN_DECLARE(int32_t) goertzel_bank_result(goertzel_bank_state_t *s, int32_t result[]);
+#else
+SPAN_DECLARE(float) goertzel_bank_result(goertzel_bank_state_t *s, float result[]);
+#endif
+
 /*! \brief Update the state of a Goertzel transform.
     \param s The Goertzel context.
     \param amp The sample to be transformed. */
@@ -255,6 +255,13 @@ SPAN_DECLARE(int) v17_rx_free(v17_rx_state_t *s);
     \return A pointer to the logging context */
 SPAN_DECLARE(logging_state_t *) v17_rx_get_logging_state(v17_rx_state_t *s);
 
+/*! Get a snapshot of the performance counters of a V.17 modem receive context.
+    \brief Get a snapshot of the performance counters of a V.17 modem receive context.
+    \param s The modem context.
+    \param stats A pointer to the buffer for the counters.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) v17_rx_get_stats(v17_rx_state_t *s, span_stats_t *stats);
+
 /*! Change the put_bit function associated with a V.17 modem receive context.
     \brief Change the put_bit function associated with a V.17 modem receive context.
     \param s The modem context.
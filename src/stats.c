@@ -0,0 +1,131 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * stats.c - Per object performance counters
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
+
+static const struct
+{
+    const char *name;
+    const char *help;
+    size_t offset;
+} counters[] =
+{
+    {"samples_in_total", "Audio samples received.", offsetof(span_stats_t, samples_in)},
+    {"samples_out_total", "Audio samples generated.", offsetof(span_stats_t, samples_out)},
+    {"cycles_total", "CPU cycles spent processing.", offsetof(span_stats_t, cycles)},
+    {"frames_in_total", "Good HDLC frames received.", offsetof(span_stats_t, frames_in)},
+    {"frames_out_total", "HDLC frames sent.", offsetof(span_stats_t, frames_out)},
+    {"crc_errors_total", "HDLC frames received with a bad CRC.", offsetof(span_stats_t, crc_errors)},
+    {"retrains_total", "Receiver trainings started.", offsetof(span_stats_t, retrains)},
+    {"underflows_total", "Times input did not arrive in time.", offsetof(span_stats_t, underflows)}
+};
+
+SPAN_DECLARE(void) span_stats_reset(span_stats_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) span_stats_accumulate(span_stats_t *total, const span_stats_t *s)
+{
+    total->samples_in += s->samples_in;
+    total->samples_out += s->samples_out;
+    total->cycles += s->cycles;
+    total->frames_in += s->frames_in;
+    total->frames_out += s->frames_out;
+    total->crc_errors += s->crc_errors;
+    total->retrains += s->retrains;
+    total->underflows += s->underflows;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) span_stats_format(char *buf,
+                                    int len,
+                                    const char *prefix,
+                                    const char *labels[],
+                                    const span_stats_t stats[],
+                                    int entries)
+{
+    const char *label;
+    uint64_t value;
+    int i;
+    int j;
+    int n;
+    int pos;
+
+    if (len <= 0)
+        return -1;
+    /*endif*/
+    buf[0] = '\0';
+    pos = 0;
+    /* Prometheus requires all the samples of a metric family to be grouped together,
+       so the snapshots are interleaved, a counter at a time. */
+    for (i = 0;  i < (int) (sizeof(counters)/sizeof(counters[0]));  i++)
+    {
+        n = snprintf(buf + pos,
+                     len - pos,
+                     "# HELP %s_%s %s\n# TYPE %s_%s counter\n",
+                     prefix,
+                     counters[i].name,
+                     counters[i].help,
+                     prefix,
+                     counters[i].name);
+        if (n < 0  ||  (pos += n) >= len)
+            return -1;
+        /*endif*/
+        for (j = 0;  j < entries;  j++)
+        {
+            value = *((const uint64_t *) ((const uint8_t *) &stats[j] + counters[i].offset));
+            label = (labels)  ?  labels[j]  :  NULL;
+            if (label  &&  label[0])
+                n = snprintf(buf + pos, len - pos, "%s_%s{%s} %" PRIu64 "\n", prefix, counters[i].name, label, value);
+            else
+                n = snprintf(buf + pos, len - pos, "%s_%s %" PRIu64 "\n", prefix, counters[i].name, value);
+            /*endif*/
+            if (n < 0  ||  (pos += n) >= len)
+                return -1;
+            /*endif*/
+        }
+        /*endfor*/
+    }
+    /*endfor*/
+    return pos;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -50,7 +50,10 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/queue.h"
 #include "spandsp/power_meter.h"
@@ -473,6 +476,45 @@ static int terminate_operation_in_progress(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int ecm_buffer_alloc(t30_state_t *s, int frame_octets)
+{
+    uint8_t *buf;
+    int stride;
+    int i;
+
+    /* The ECM partial page buffer is only allocated when ECM is actually used, and is
+       sized for the frame length in use. Each slot holds a complete HDLC frame for
+       sending (4 octets of header and the image data), or the image data from a
+       received frame. */
+    stride = frame_octets + 4;
+    if (s->ecm_buf  &&  s->ecm_frame_stride >= stride)
+        return 0;
+    if ((buf = (uint8_t *) span_alloc(256*stride)) == NULL)
+        return -1;
+    if (s->ecm_buf)
+    {
+        /* The far end has sent bigger frames than we expected. Keep the frames we
+           already have, so the block is not lost. */
+        for (i = 0;  i < 256;  i++)
+        {
+            if (s->ecm_len[i] > 0)
+                memcpy(&buf[i*stride], &s->ecm_buf[i*s->ecm_frame_stride], s->ecm_len[i]);
+        }
+        span_free(s->ecm_buf);
+    }
+    span_log(&s->logging, SPAN_LOG_FLOW, "ECM buffer allocated for %d octet frames\n", frame_octets);
+    s->ecm_buf = buf;
+    s->ecm_frame_stride = stride;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ uint8_t *ecm_frame(t30_state_t *s, int frame_no)
+{
+    return &s->ecm_buf[frame_no*s->ecm_frame_stride];
+}
+/*- End of function --------------------------------------------------------*/
+
 static int tx_start_page(t30_state_t *s)
 {
     if (t4_tx_start_page(&s->t4.tx))
@@ -622,91 +664,98 @@ static void release_resources(t30_state_t *s)
 {
     if (s->tx_info.nsf)
     {
-        free(s->tx_info.nsf);
+        span_free(s->tx_info.nsf);
         s->tx_info.nsf = NULL;
     }
     s->tx_info.nsf_len = 0;
     if (s->tx_info.nsc)
     {
-        free(s->tx_info.nsc);
+        span_free(s->tx_info.nsc);
         s->tx_info.nsc = NULL;
     }
     s->tx_info.nsc_len = 0;
     if (s->tx_info.nss)
     {
-        free(s->tx_info.nss);
+        span_free(s->tx_info.nss);
         s->tx_info.nss = NULL;
     }
     s->tx_info.nss_len = 0;
     if (s->tx_info.tsa)
     {
-        free(s->tx_info.tsa);
+        span_free(s->tx_info.tsa);
         s->tx_info.tsa = NULL;
     }
     if (s->tx_info.ira)
     {
-        free(s->tx_info.ira);
+        span_free(s->tx_info.ira);
         s->tx_info.ira = NULL;
     }
     if (s->tx_info.cia)
     {
-        free(s->tx_info.cia);
+        span_free(s->tx_info.cia);
         s->tx_info.cia = NULL;
     }
     if (s->tx_info.isp)
     {
-        free(s->tx_info.isp);
+        span_free(s->tx_info.isp);
         s->tx_info.isp = NULL;
     }
     if (s->tx_info.csa)
     {
-        free(s->tx_info.csa);
+        span_free(s->tx_info.csa);
         s->tx_info.csa = NULL;
     }
 
     if (s->rx_info.nsf)
     {
-        free(s->rx_info.nsf);
+        span_free(s->rx_info.nsf);
         s->rx_info.nsf = NULL;
     }
     s->rx_info.nsf_len = 0;
     if (s->rx_info.nsc)
     {
-        free(s->rx_info.nsc);
+        span_free(s->rx_info.nsc);
         s->rx_info.nsc = NULL;
     }
     s->rx_info.nsc_len = 0;
     if (s->rx_info.nss)
     {
-        free(s->rx_info.nss);
+        span_free(s->rx_info.nss);
         s->rx_info.nss = NULL;
     }
     s->rx_info.nss_len = 0;
     if (s->rx_info.tsa)
     {
-        free(s->rx_info.tsa);
+        span_free(s->rx_info.tsa);
         s->rx_info.tsa = NULL;
     }
     if (s->rx_info.ira)
     {
-        free(s->rx_info.ira);
+        span_free(s->rx_info.ira);
         s->rx_info.ira = NULL;
     }
     if (s->rx_info.cia)
     {
-        free(s->rx_info.cia);
+        span_free(s->rx_info.cia);
         s->rx_info.cia = NULL;
     }
     if (s->rx_info.isp)
     {
-        free(s->rx_info.isp);
+        span_free(s->rx_info.isp);
         s->rx_info.isp = NULL;
     }
     if (s->rx_info.csa)
     {
-        free(s->rx_info.csa);
+        span_free(s->rx_info.csa);
         s->rx_info.csa = NULL;
     }
+
+    if (s->ecm_buf)
+    {
+        span_free(s->ecm_buf);
+        s->ecm_buf = NULL;
+    }
+    s->ecm_frame_stride = 0;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -749,6 +798,12 @@ static int get_partial_ecm_page(t30_state_t *s)
     int i;
     int len;
 
+    if (ecm_buffer_alloc(s, s->octets_per_ecm_frame))
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "Failed to allocate the ECM buffer\n");
+        t30_set_status(s, T30_ERR_NOMEM);
+        return -1;
+    }
     s->ppr_count = 0;
     s->ecm_progress = 0;
     /* Fill our partial page buffer with a partial page. Use the negotiated preferred frame size
@@ -761,19 +816,19 @@ static int get_partial_ecm_page(t30_state_t *s)
     for (i = 0;  i < 256;  i++)
     {
         s->ecm_len[i] = -1;
-        s->ecm_data[i][0] = ADDRESS_FIELD;
-        s->ecm_data[i][1] = CONTROL_FIELD_NON_FINAL_FRAME;
-        s->ecm_data[i][2] = T4_FCD;
+        ecm_frame(s, i)[0] = ADDRESS_FIELD;
+        ecm_frame(s, i)[1] = CONTROL_FIELD_NON_FINAL_FRAME;
+        ecm_frame(s, i)[2] = T4_FCD;
         /* These frames contain a frame sequence number within the partial page (one octet) followed
            by some image data. */
-        s->ecm_data[i][3] = (uint8_t) i;
-        if ((len = t4_tx_get_chunk(&s->t4.tx, &s->ecm_data[i][4], s->octets_per_ecm_frame)) < s->octets_per_ecm_frame)
+        ecm_frame(s, i)[3] = (uint8_t) i;
+        if ((len = t4_tx_get_chunk(&s->t4.tx, &ecm_frame(s, i)[4], s->octets_per_ecm_frame)) < s->octets_per_ecm_frame)
         {
             /* The image is not big enough to fill the entire buffer */
             /* We need to pad to a full frame, as most receivers expect that. */
             if (len > 0)
             {
-                memset(&s->ecm_data[i][4 + len], 0, s->octets_per_ecm_frame - len);
+                memset(&ecm_frame(s, i)[4 + len], 0, s->octets_per_ecm_frame - len);
                 s->ecm_len[i++] = (int16_t) (s->octets_per_ecm_frame + 4);
             }
             s->ecm_frames = i;
@@ -804,7 +859,7 @@ static int send_next_ecm_frame(t30_state_t *s)
         {
             if (s->ecm_len[i] >= 0)
             {
-                send_frame(s, s->ecm_data[i], s->ecm_len[i]);
+                send_frame(s, ecm_frame(s, i), s->ecm_len[i]);
                 s->ecm_current_tx_frame = i + 1;
                 s->ecm_frames_this_tx_burst++;
                 return 0;
@@ -851,8 +906,12 @@ static int send_first_ecm_frame(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static void print_frame(t30_state_t *s, const char *io, const uint8_t *msg, int len)
+static void print_frame(t30_state_t *s, int event, const char *io, const uint8_t *msg, int len)
 {
+    /* If a binary event handler is collecting the frames, don't spend time formatting them */
+    if (span_log_event(&s->logging, SPAN_LOG_FLOW, event, 0, 0, msg, len))
+        return;
+    /*endif*/
     span_log(&s->logging,
              SPAN_LOG_FLOW,
              "%s %s with%s final frame tag\n",
@@ -872,7 +931,7 @@ static void shut_down_hdlc_tx(t30_state_t *s)
 
 static void send_frame(t30_state_t *s, const uint8_t *msg, int len)
 {
-    print_frame(s, "Tx: ", msg, len);
+    print_frame(s, SPAN_LOG_EVENT_FRAME_TX, "Tx: ", msg, len);
 
     if (s->real_time_frame_handler)
         s->real_time_frame_handler(s, s->real_time_frame_user_data, false, msg, len);
@@ -2014,6 +2073,7 @@ static int set_min_scan_time_code(t30_state_t *s)
 static int start_sending_document(t30_state_t *s)
 {
     int min_row_bits;
+    int res;
 
     if (s->tx_file[0] == '\0')
     {
@@ -2053,7 +2113,12 @@ static int start_sending_document(t30_state_t *s)
     s->image_width = t4_tx_get_image_width(&s->t4.tx);
     if (s->error_correcting_mode)
     {
-        if (get_partial_ecm_page(s) == 0)
+        if ((res = get_partial_ecm_page(s)) < 0)
+        {
+            terminate_operation_in_progress(s);
+            return -1;
+        }
+        if (res == 0)
             span_log(&s->logging, SPAN_LOG_WARNING, "No image data to send\n");
     }
     return 0;
@@ -2614,7 +2679,7 @@ static int process_rx_pps(t30_state_t *s, const uint8_t *msg, int len)
         span_log(&s->logging, SPAN_LOG_FLOW, "Partial page OK - committing block %d, %d frames\n", s->ecm_block, s->ecm_frames);
         for (i = 0;  i < s->ecm_frames;  i++)
         {
-            if (t4_rx_put_chunk(&s->t4.rx, s->ecm_data[i], s->ecm_len[i]))
+            if (t4_rx_put_chunk(&s->t4.rx, ecm_frame(s, i), s->ecm_len[i]))
             {
                 /* This is the end of the document */
                 break;
@@ -2788,10 +2853,18 @@ static void process_rx_fcd(t30_state_t *s, const uint8_t *msg, int len)
         else
         {
             frame_no = msg[3];
-            /* Just store the actual image data, and record its length */
-            span_log(&s->logging, SPAN_LOG_FLOW, "Storing ECM frame %d, length %d\n", frame_no, len - 4);
-            memcpy(&s->ecm_data[frame_no][0], &msg[4], len - 4);
-            s->ecm_len[frame_no] = (int16_t) (len - 4);
+            if (ecm_buffer_alloc(s, (len - 4 > s->octets_per_ecm_frame)  ?  len - 4  :  s->octets_per_ecm_frame))
+            {
+                /* Treat this like a lost frame, and let retries sort things out. */
+                span_log(&s->logging, SPAN_LOG_WARNING, "Failed to allocate the ECM buffer\n");
+            }
+            else
+            {
+                /* Just store the actual image data, and record its length */
+                span_log(&s->logging, SPAN_LOG_FLOW, "Storing ECM frame %d, length %d\n", frame_no, len - 4);
+                memcpy(ecm_frame(s, frame_no), &msg[4], len - 4);
+                s->ecm_len[frame_no] = (int16_t) (len - 4);
+            }
             /* In case we are just after a CTC/CTR exchange, which kicked us back to long training */
             s->short_train = true;
         }
@@ -4453,7 +4526,7 @@ static void process_state_call_finished(t30_state_t *s, const uint8_t *msg, int
 static void process_rx_control_msg(t30_state_t *s, const uint8_t *msg, int len)
 {
     /* We should only get good frames here. */
-    print_frame(s, "Rx: ", msg, len);
+    print_frame(s, SPAN_LOG_EVENT_FRAME_RX, "Rx: ", msg, len);
     if (s->real_time_frame_handler)
         s->real_time_frame_handler(s, s->real_time_frame_user_data, true, msg, len);
 
@@ -5305,7 +5378,7 @@ static int decode_nsf_nss_nsc(t30_state_t *s, uint8_t *msg[], const uint8_t *pkt
 {
     uint8_t *t;
 
-    if ((t = malloc(len - 1)) == NULL)
+    if ((t = span_alloc(len - 1)) == NULL)
         return 0;
     memcpy(t, &pkt[1], len - 1);
     *msg = t;
@@ -6335,7 +6408,7 @@ SPAN_DECLARE(t30_state_t *) t30_init(t30_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (t30_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t30_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -6370,6 +6443,7 @@ SPAN_DECLARE(int) t30_release(t30_state_t *s)
     /* Make sure any FAX in progress is tidied up. If the tidying up has
        already happened, repeating it here is harmless. */
     terminate_operation_in_progress(s);
+    release_resources(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -6377,11 +6451,22 @@ SPAN_DECLARE(int) t30_release(t30_state_t *s)
 SPAN_DECLARE(int) t30_free(t30_state_t *s)
 {
     t30_release(s);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(size_t) t30_get_memory_footprint(t30_state_t *s)
+{
+    size_t len;
+
+    len = sizeof(*s);
+    if (s->ecm_buf)
+        len += 256*s->ecm_frame_stride;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t30_call_active(t30_state_t *s)
 {
     return (s->phase != T30_PHASE_CALL_FINISHED);
@@ -46,6 +46,8 @@
 
 #include "spandsp/telephony.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/queue.h"
 #include "spandsp/power_meter.h"
@@ -626,7 +628,9 @@ SPAN_DECLARE(void) t30_decode_dis_dtc_dcs(t30_state_t *s, const uint8_t *pkt, in
         { 0x00, NULL }
     };
 
-    if (!span_log_test(&s->logging, SPAN_LOG_FLOW))
+    /* If a binary event handler is collecting frames, it has the raw frame, which it
+       can decode later, at leisure. */
+    if (!span_log_test(&s->logging, SPAN_LOG_FLOW)  ||  span_log_event_test(&s->logging, SPAN_LOG_FLOW))
         return;
     frame_type = pkt[2] & 0xFE;
     log = &s->logging;
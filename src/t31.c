@@ -51,7 +51,10 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/bitstream.h"
 #include "spandsp/dc_restore.h"
@@ -91,6 +94,7 @@
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/bitstream.h"
+#include "spandsp/private/queue.h"
 #include "spandsp/private/t38_core.h"
 #include "spandsp/private/silence_gen.h"
 #include "spandsp/private/fsk.h"
@@ -332,6 +336,7 @@ static int process_rx_missing(t38_core_state_t *t, void *user_data, int rx_seq_n
     
     s = (t31_state_t *) user_data;
     s->t38_fe.rx_data_missing = TRUE;
+    s->stats.underflows++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1033,6 +1038,7 @@ static int stream_cng(t31_state_t *s)
 SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
 {
     t31_t38_front_end_state_t *fe;
+    uint64_t start;
     int delay;
 
     fe = &s->t38_fe;
@@ -1040,6 +1046,7 @@ SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
         return TRUE;
 
     fe->samples += samples;
+    s->stats.samples_in += samples;
     if (fe->timeout_rx_samples  &&  fe->samples > fe->timeout_rx_samples)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Timeout mid-receive\n");
@@ -1053,6 +1060,7 @@ SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
     if (fe->ms_per_tx_chunk  &&  fe->samples < fe->next_tx_samples)
         return FALSE;
     /* Its time to send something */
+    start = span_stats_cycles();
     delay = 0;
     switch (fe->timed_step & 0xFFF0)
     {
@@ -1077,6 +1085,7 @@ SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
         front_end_status(s, T30_FRONT_END_SEND_STEP_COMPLETE);
         break;
     }
+    s->stats.cycles += span_stats_cycles() - start;
     fe->next_tx_samples += us_to_samples(delay);
     return FALSE;
 }
@@ -1483,6 +1492,8 @@ static void hdlc_accept_frame(void *user_data, const uint8_t *msg, int len, int
 {
     t31_state_t *s;
     uint8_t buf[256];
+    uint8_t *span[2];
+    int span_len[2];
     int i;
 
     if (len < 0)
@@ -1491,6 +1502,10 @@ static void hdlc_accept_frame(void *user_data, const uint8_t *msg, int len, int
         return;
     }
     s = (t31_state_t *) user_data;
+    if (ok)
+        s->stats.frames_in++;
+    else
+        s->stats.crc_errors++;
     if (!s->rx_frame_received)
     {
         if (s->at_state.dte_is_waiting)
@@ -1538,12 +1553,19 @@ static void hdlc_accept_frame(void *user_data, const uint8_t *msg, int len, int
         }
         else
         {
-            /* Queue it */
-            buf[0] = (ok)  ?  AT_RESPONSE_CODE_OK  :  AT_RESPONSE_CODE_ERROR;
-            /* It is safe to look at the two bytes beyond the length of the message,
-               and expect to find the FCS there. */
-            memcpy(buf + 1, msg, len + 2);
-            queue_write_msg(s->rx_queue, buf, len + 3);
+            /* Queue it, building the queue entry in place */
+            if (queue_write_msg_reserve(s->rx_queue, span, span_len, len + 3) == len + 3)
+            {
+                span[0][0] = (ok)  ?  AT_RESPONSE_CODE_OK  :  AT_RESPONSE_CODE_ERROR;
+                /* It is safe to look at the two bytes beyond the length of the message,
+                   and expect to find the FCS there. */
+                memcpy(span[0] + 1, msg, span_len[0] - 1);
+                if (span_len[1])
+                    memcpy(span[1], msg + span_len[0] - 1, span_len[1]);
+                /*endif*/
+                queue_write_msg_commit(s->rx_queue, len + 3);
+            }
+            /*endif*/
         }
     }
     t31_set_at_rx_mode(s, AT_MODE_OFFHOOK_COMMAND);
@@ -1692,8 +1714,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         }
         else
         {
-            v17_tx_restart(&t->fast_modems.v17_tx, s->bit_rate, FALSE, s->short_train);
-            set_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_modems.v17_tx);
+            fax_modems_select_fast_tx_modem(t, FAX_MODEM_V17_TX);
+            v17_tx_restart(&t->fast_tx.v17_tx, s->bit_rate, FALSE, s->short_train);
+            set_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_tx.v17_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
         s->tx.out_bytes = 0;
@@ -1704,7 +1727,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         if (!s->t38_mode)
         {
             set_rx_handler(s, (span_rx_handler_t *) &v17_v21_rx, (span_rx_fillin_handler_t *) &v17_v21_rx_fillin, s);
-            v17_rx_restart(&t->fast_modems.v17_rx, s->bit_rate, s->short_train);
+            fax_modems_select_fast_rx_modem(t, FAX_MODEM_V17_RX);
+            v17_rx_restart(&t->fast_rx.v17_rx, s->bit_rate, s->short_train);
+            s->stats.retrains++;
             /* Allow for +FCERROR/+FRH:3 */
             t31_v21_rx(s);
         }
@@ -1729,8 +1754,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         }
         else
         {
-            v27ter_tx_restart(&t->fast_modems.v27ter_tx, s->bit_rate, FALSE);
-            set_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_modems.v27ter_tx);
+            fax_modems_select_fast_tx_modem(t, FAX_MODEM_V27TER_TX);
+            v27ter_tx_restart(&t->fast_tx.v27ter_tx, s->bit_rate, FALSE);
+            set_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_tx.v27ter_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
         s->tx.out_bytes = 0;
@@ -1741,7 +1767,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         if (!s->t38_mode)
         {
             set_rx_handler(s, (span_rx_handler_t *) &v27ter_v21_rx, (span_rx_fillin_handler_t *) &v27ter_v21_rx_fillin, s);
-            v27ter_rx_restart(&t->fast_modems.v27ter_rx, s->bit_rate, FALSE);
+            fax_modems_select_fast_rx_modem(t, FAX_MODEM_V27TER_RX);
+            v27ter_rx_restart(&t->fast_rx.v27ter_rx, s->bit_rate, FALSE);
+            s->stats.retrains++;
             /* Allow for +FCERROR/+FRH:3 */
             t31_v21_rx(s);
         }
@@ -1766,8 +1794,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         }
         else
         {
-            v29_tx_restart(&t->fast_modems.v29_tx, s->bit_rate, FALSE);
-            set_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_modems.v29_tx);
+            fax_modems_select_fast_tx_modem(t, FAX_MODEM_V29_TX);
+            v29_tx_restart(&t->fast_tx.v29_tx, s->bit_rate, FALSE);
+            set_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_tx.v29_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
         s->tx.out_bytes = 0;
@@ -1778,7 +1807,9 @@ static int restart_modem(t31_state_t *s, int new_modem)
         if (!s->t38_mode)
         {
             set_rx_handler(s, (span_rx_handler_t *) &v29_v21_rx, (span_rx_fillin_handler_t *) &v29_v21_rx_fillin, s);
-            v29_rx_restart(&t->fast_modems.v29_rx, s->bit_rate, FALSE);
+            fax_modems_select_fast_rx_modem(t, FAX_MODEM_V29_RX);
+            v29_rx_restart(&t->fast_rx.v29_rx, s->bit_rate, FALSE);
+            s->stats.retrains++;
             /* Allow for +FCERROR/+FRH:3 */
             t31_v21_rx(s);
         }
@@ -1846,6 +1877,7 @@ static __inline__ void dle_unstuff_hdlc(t31_state_t *s, const char *stuffed, int
             if (stuffed[i] == ETX)
             {
                 s->hdlc_tx.final = (s->hdlc_tx.buf[1] & 0x10);
+                s->stats.frames_out++;
                 if (s->t38_mode)
                 {
                     send_hdlc(s, s->hdlc_tx.buf, s->hdlc_tx.len);
@@ -1926,8 +1958,11 @@ static int process_class1_cmd(at_state_t *t, void *user_data, int direction, int
     int i;
     int len;
     int immediate_response;
+    int j;
+    int code;
     t31_state_t *s;
-    uint8_t msg[256];
+    const uint8_t *span[2];
+    int span_len[2];
 
     s = (t31_state_t *) user_data;
     new_transmit = direction;
@@ -1996,25 +2031,30 @@ static int process_class1_cmd(at_state_t *t, void *user_data, int direction, int
             s->rx_frame_received = FALSE;
             do
             {
-                if (!queue_empty(s->rx_queue))
+                if ((len = queue_read_msg_peek(s->rx_queue, span, span_len)) > 0)
                 {
-                    len = queue_read_msg(s->rx_queue, msg, 256);
+                    /* DLE stuff the frame straight out of the queue */
+                    code = span[0][0];
                     if (len > 1)
                     {
-                        if (msg[0] == AT_RESPONSE_CODE_OK)
+                        if (code == AT_RESPONSE_CODE_OK)
                             at_put_response_code(&s->at_state, AT_RESPONSE_CODE_CONNECT);
-                        for (i = 1;  i < len;  i++)
+                        for (j = 0;  j < 2;  j++)
                         {
-                            if (msg[i] == DLE)
-                                s->at_state.rx_data[s->at_state.rx_data_bytes++] = DLE;
-                            s->at_state.rx_data[s->at_state.rx_data_bytes++] = msg[i];
+                            for (i = (j == 0)  ?  1  :  0;  i < span_len[j];  i++)
+                            {
+                                if (span[j][i] == DLE)
+                                    s->at_state.rx_data[s->at_state.rx_data_bytes++] = DLE;
+                                s->at_state.rx_data[s->at_state.rx_data_bytes++] = span[j][i];
+                            }
                         }
                         s->at_state.rx_data[s->at_state.rx_data_bytes++] = DLE;
                         s->at_state.rx_data[s->at_state.rx_data_bytes++] = ETX;
                         s->at_state.at_tx_handler(&s->at_state, s->at_state.at_tx_user_data, s->at_state.rx_data, s->at_state.rx_data_bytes);
                         s->at_state.rx_data_bytes = 0;
                     }
-                    at_put_response_code(&s->at_state, msg[0]);
+                    queue_read_msg_consume(s->rx_queue);
+                    at_put_response_code(&s->at_state, code);
                 }
                 else
                 {
@@ -2022,7 +2062,7 @@ static int process_class1_cmd(at_state_t *t, void *user_data, int direction, int
                     break;
                 }
             }
-            while (msg[0] == AT_RESPONSE_CODE_CONNECT);
+            while (code == AT_RESPONSE_CODE_CONNECT);
         }
         immediate_response = FALSE;
         break;
@@ -2260,13 +2300,13 @@ static int v17_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v17_rx(&s->fast_modems.v17_rx, amp, len);
+    v17_rx(&s->fast_rx.v17_rx, amp, len);
     if (t->at_state.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_modems.v17_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_modems.v17_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_rx.v17_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_rx.v17_rx);
     }
     else
     {
@@ -2290,7 +2330,7 @@ static int v17_v21_rx_fillin(void *user_data, int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v17_rx_fillin(&s->fast_modems.v17_rx, len);
+    v17_rx_fillin(&s->fast_rx.v17_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -2303,13 +2343,13 @@ static int v27ter_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v27ter_rx(&s->fast_modems.v27ter_rx, amp, len);
+    v27ter_rx(&s->fast_rx.v27ter_rx, amp, len);
     if (t->at_state.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_modems.v27ter_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_modems.v27ter_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_rx.v27ter_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &s->fast_rx.v27ter_rx);
     }
     else
     {
@@ -2333,7 +2373,7 @@ static int v27ter_v21_rx_fillin(void *user_data, int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v27ter_rx_fillin(&s->fast_modems.v27ter_rx, len);
+    v27ter_rx_fillin(&s->fast_rx.v27ter_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -2346,13 +2386,13 @@ static int v29_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v29_rx(&s->fast_modems.v29_rx, amp, len);
+    v29_rx(&s->fast_rx.v29_rx, amp, len);
     if (t->at_state.rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_modems.v29_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_modems.v29_rx);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_rx.v29_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_rx.v29_rx);
     }
     else
     {
@@ -2376,7 +2416,7 @@ static int v29_v21_rx_fillin(void *user_data, int len)
 
     t = (t31_state_t *) user_data;
     s = &t->audio.modems;
-    v29_rx_fillin(&s->fast_modems.v29_rx, len);
+    v29_rx_fillin(&s->fast_rx.v29_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -2386,7 +2426,9 @@ SPAN_DECLARE_NONSTD(int) t31_rx(t31_state_t *s, int16_t amp[], int len)
 {
     int i;
     int32_t power;
+    uint64_t start;
 
+    start = span_stats_cycles();
     /* Monitor for received silence.  Maximum needed detection is AT+FRS=255 (255*10ms). */
     /* We could probably only run this loop if (s->modem == FAX_MODEM_SILENCE_RX), however,
        the spec says "when silence has been present on the line for the amount of
@@ -2424,6 +2466,8 @@ SPAN_DECLARE_NONSTD(int) t31_rx(t31_state_t *s, int16_t amp[], int len)
 
     if (!s->at_state.transmit  ||  s->modem == FAX_MODEM_CNG_TONE)
         s->audio.modems.rx_handler(s->audio.modems.rx_user_data, amp, len);
+    s->stats.samples_in += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2437,6 +2481,7 @@ SPAN_DECLARE_NONSTD(int) t31_rx_fillin(t31_state_t *s, int len)
        diverge. */
     /* Time is determined by counting the samples in audio packets coming in. */
     s->call_samples += len;
+    s->stats.underflows++;
 
     /* In HDLC transmit mode, if 5 seconds elapse without data from the DTE
        we must treat this as an error. We return the result ERROR, and change
@@ -2455,15 +2500,15 @@ SPAN_DECLARE_NONSTD(int) t31_rx_fillin(t31_state_t *s, int len)
         break;
     case FAX_MODEM_V27TER_RX:
         /* TODO: what about FSK in the early stages */
-        len = v27ter_rx_fillin(&s->audio.modems.fast_modems.v27ter_rx, len);
+        len = v27ter_rx_fillin(&s->audio.modems.fast_rx.v27ter_rx, len);
         break;
     case FAX_MODEM_V29_RX:
         /* TODO: what about FSK in the early stages */
-        len = v29_rx_fillin(&s->audio.modems.fast_modems.v29_rx, len);
+        len = v29_rx_fillin(&s->audio.modems.fast_rx.v29_rx, len);
         break;
     case FAX_MODEM_V17_RX:
         /* TODO: what about FSK in the early stages */
-        len = v17_rx_fillin(&s->audio.modems.fast_modems.v17_rx, len);
+        len = v17_rx_fillin(&s->audio.modems.fast_rx.v17_rx, len);
         break;
     }
     return 0;
@@ -2488,8 +2533,10 @@ static int set_next_tx_type(t31_state_t *s)
 
 SPAN_DECLARE_NONSTD(int) t31_tx(t31_state_t *s, int16_t amp[], int max_len)
 {
+    uint64_t start;
     int len;
 
+    start = span_stats_cycles();
     len = 0;
     if (s->at_state.transmit)
     {
@@ -2507,6 +2554,8 @@ SPAN_DECLARE_NONSTD(int) t31_tx(t31_state_t *s, int16_t amp[], int max_len)
         memset(amp + len, 0, (max_len - len)*sizeof(int16_t));
         len = max_len;        
     }
+    s->stats.samples_out += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2563,6 +2612,25 @@ SPAN_DECLARE(logging_state_t *) t31_get_logging_state(t31_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t31_get_stats(t31_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) t31_get_memory_footprint(t31_state_t *s)
+{
+    size_t len;
+
+    len = sizeof(*s);
+    if (s->rx_queue)
+        len += sizeof(queue_state_t) + s->rx_queue->len;
+    /*endif*/
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(t38_core_state_t *) t31_get_t38_core_state(t31_state_t *s)
 {
     return &s->t38_fe.t38;
@@ -2621,7 +2689,7 @@ SPAN_DECLARE(t31_state_t *) t31_init(t31_state_t *s,
     alloced = FALSE;
     if (s == NULL)
     {
-        if ((s = (t31_state_t *) malloc(sizeof (*s))) == NULL)
+        if ((s = (t31_state_t *) span_alloc(sizeof (*s))) == NULL)
             return NULL;
         alloced = TRUE;
     }
@@ -2674,7 +2742,7 @@ SPAN_DECLARE(t31_state_t *) t31_init(t31_state_t *s,
     if ((s->rx_queue = queue_init(NULL, 4096, QUEUE_WRITE_ATOMIC | QUEUE_READ_ATOMIC)) == NULL)
     {
         if (alloced)
-            free(s);
+            span_free(s);
         return NULL;
     }
     at_init(&s->at_state, at_tx_handler, at_tx_user_data, t31_modem_control_handler, s);
@@ -2700,7 +2768,7 @@ SPAN_DECLARE(int) t31_release(t31_state_t *s)
 SPAN_DECLARE(int) t31_free(t31_state_t *s)
 {
     t31_release(s);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
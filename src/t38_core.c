@@ -47,6 +47,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/t38_core.h"
@@ -344,7 +345,9 @@ SPAN_DECLARE_NONSTD(int) t38_core_rx_ifp_stream(t38_core_state_t *s, const uint8
     uint8_t field_data_present;
     char tag[20];
 
-    if (span_log_test(&s->logging, SPAN_LOG_FLOW))
+    if (span_log_test(&s->logging, SPAN_LOG_FLOW)
+        &&
+        !span_log_event(&s->logging, SPAN_LOG_FLOW, SPAN_LOG_EVENT_T38_IFP_RX, log_seq_no, 0, buf, len))
     {
         sprintf(tag, "Rx %5d: IFP", log_seq_no);
         span_log_buf(&s->logging, SPAN_LOG_FLOW, tag, buf, len);
@@ -877,7 +880,9 @@ static int t38_encode_data(t38_core_state_t *s, uint8_t buf[], int data_type, co
         buf[3] = len & 0xFF;
     }
 
-    if (span_log_test(&s->logging, SPAN_LOG_FLOW))
+    if (span_log_test(&s->logging, SPAN_LOG_FLOW)
+        &&
+        !span_log_event(&s->logging, SPAN_LOG_FLOW, SPAN_LOG_EVENT_T38_IFP_TX, s->tx_seq_no, 0, buf, len))
     {
         sprintf(tag, "Tx %5d: IFP", s->tx_seq_no);
         span_log_buf(&s->logging, SPAN_LOG_FLOW, tag, buf, len);
@@ -1109,7 +1114,7 @@ SPAN_DECLARE(t38_core_state_t *) t38_core_init(t38_core_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (t38_core_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_core_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1157,7 +1162,7 @@ SPAN_DECLARE(int) t38_core_release(t38_core_state_t *s)
 SPAN_DECLARE(int) t38_core_free(t38_core_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
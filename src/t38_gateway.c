@@ -50,7 +50,10 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/queue.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/bit_operations.h"
@@ -232,7 +235,7 @@ static int v17_v21_rx_fillin(void *user_data, int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v17_rx_fillin(&s->fast_modems.v17_rx, len);
+    v17_rx_fillin(&s->fast_rx.v17_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -245,13 +248,13 @@ static int v17_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v17_rx(&s->fast_modems.v17_rx, amp, len);
+    v17_rx(&s->fast_rx.v17_rx, amp, len);
     if (s->rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_modems.v17_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_modems.v17_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.17 + V.21 to V.17 (%.2fdBm0)\n", v17_rx_signal_power(&s->fast_rx.v17_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &s->fast_rx.v17_rx);
     }
     else
     {
@@ -275,7 +278,7 @@ static int v27ter_v21_rx_fillin(void *user_data, int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v27ter_rx_fillin(&s->fast_modems.v27ter_rx, len);
+    v27ter_rx_fillin(&s->fast_rx.v27ter_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -288,13 +291,13 @@ static int v27ter_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v27ter_rx(&s->fast_modems.v27ter_rx, amp, len);
+    v27ter_rx(&s->fast_rx.v27ter_rx, amp, len);
     if (s->rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_modems.v27ter_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_v21_rx_fillin, &s->fast_modems.v27ter_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.27ter + V.21 to V.27ter (%.2fdBm0)\n", v27ter_rx_signal_power(&s->fast_rx.v27ter_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_v21_rx_fillin, &s->fast_rx.v27ter_rx);
     }
     else
     {
@@ -318,7 +321,7 @@ static int v29_v21_rx_fillin(void *user_data, int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v29_rx_fillin(&s->fast_modems.v29_rx, len);
+    v29_rx_fillin(&s->fast_rx.v29_rx, len);
     fsk_rx_fillin(&s->v21_rx, len);
     return 0;
 }
@@ -331,13 +334,13 @@ static int v29_v21_rx(void *user_data, const int16_t amp[], int len)
 
     t = (t38_gateway_state_t *) user_data;
     s = &t->audio.modems;
-    v29_rx(&s->fast_modems.v29_rx, amp, len);
+    v29_rx(&s->fast_rx.v29_rx, amp, len);
     if (s->rx_trained)
     {
         /* The fast modem has trained, so we no longer need to run the slow
            one in parallel. */
-        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_modems.v29_rx));
-        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_modems.v29_rx);
+        span_log(&t->logging, SPAN_LOG_FLOW, "Switching from V.29 + V.21 to V.29 (%.2fdBm0)\n", v29_rx_signal_power(&s->fast_rx.v29_rx));
+        set_rx_handler(t, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &s->fast_rx.v29_rx);
     }
     else
     {
@@ -516,10 +519,11 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         }
         /*endswitch*/
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
-        v27ter_tx_restart(&t->fast_modems.v27ter_tx, t->tx_bit_rate, t->use_tep);
-        v27ter_tx_set_get_bit(&t->fast_modems.v27ter_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V27TER_TX);
+        v27ter_tx_restart(&t->fast_tx.v27ter_tx, t->tx_bit_rate, t->use_tep);
+        v27ter_tx_set_get_bit(&t->fast_tx.v27ter_tx, get_bit_func, get_bit_user_data);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_modems.v27ter_tx);
+        set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->fast_tx.v27ter_tx);
         set_rx_active(s, TRUE);
         break;
     case T38_IND_V29_7200_TRAINING:
@@ -535,10 +539,11 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         }
         /*endswitch*/
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
-        v29_tx_restart(&t->fast_modems.v29_tx, t->tx_bit_rate, t->use_tep);
-        v29_tx_set_get_bit(&t->fast_modems.v29_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V29_TX);
+        v29_tx_restart(&t->fast_tx.v29_tx, t->tx_bit_rate, t->use_tep);
+        v29_tx_set_get_bit(&t->fast_tx.v29_tx, get_bit_func, get_bit_user_data);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_modems.v29_tx);
+        set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->fast_tx.v29_tx);
         set_rx_active(s, TRUE);
         break;
     case T38_IND_V17_7200_SHORT_TRAINING:
@@ -583,10 +588,11 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         }
         /*endswitch*/
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
-        v17_tx_restart(&t->fast_modems.v17_tx, t->tx_bit_rate, t->use_tep, short_train);
-        v17_tx_set_get_bit(&t->fast_modems.v17_tx, get_bit_func, get_bit_user_data);
+        fax_modems_select_fast_tx_modem(t, FAX_MODEM_V17_TX);
+        v17_tx_restart(&t->fast_tx.v17_tx, t->tx_bit_rate, t->use_tep, short_train);
+        v17_tx_set_get_bit(&t->fast_tx.v17_tx, get_bit_func, get_bit_user_data);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
-        set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_modems.v17_tx);
+        set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->fast_tx.v17_tx);
         set_rx_active(s, TRUE);
         break;
     case T38_IND_V8_ANSAM:
@@ -631,6 +637,7 @@ static void finalise_hdlc_frame(t38_gateway_state_t *s, int good_fcs)
     if (!good_fcs  ||  (hdlc_buf->flags & HDLC_FLAG_MISSING_DATA))
         hdlc_buf->flags |= HDLC_FLAG_CORRUPT_CRC;
     /*endif*/
+    s->stats.frames_out++;
     if (s->core.hdlc_to_modem.in == s->core.hdlc_to_modem.out)
     {
         /* This is the frame in progress at the output. */
@@ -1063,6 +1070,7 @@ static int process_rx_missing(t38_core_state_t *t, void *user_data, int rx_seq_n
     
     s = (t38_gateway_state_t *) user_data;
     s->core.hdlc_to_modem.buf[s->core.hdlc_to_modem.in].flags |= HDLC_FLAG_MISSING_DATA;
+    s->stats.underflows++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1984,6 +1992,7 @@ static void rx_flag_or_abort(hdlc_rx_state_t *t)
                     if (t->num_bits != 7)
                     {
                         t->rx_crc_errors++;
+                        s->stats.crc_errors++;
                         span_log(&s->logging, SPAN_LOG_FLOW, "HDLC frame type %s, misaligned terminating flag at %d\n", t30_frametype(t->buffer[2]), t->len);
                         /* It seems some boxes may not like us sending a _SIG_END here, and then another
                            when the carrier actually drops. Lets just send T38_FIELD_HDLC_FCS_OK here. */
@@ -1994,6 +2003,7 @@ static void rx_flag_or_abort(hdlc_rx_state_t *t)
                     else if ((u->crc & 0xFFFF) != 0xF0B8)
                     {
                         t->rx_crc_errors++;
+                        s->stats.crc_errors++;
                         span_log(&s->logging, SPAN_LOG_FLOW, "HDLC frame type %s, bad CRC at %d\n", t30_frametype(t->buffer[2]), t->len);
                         /* It seems some boxes may not like us sending a _SIG_END here, and then another
                            when the carrier actually drops. Lets just send T38_FIELD_HDLC_FCS_OK here. */
@@ -2005,6 +2015,7 @@ static void rx_flag_or_abort(hdlc_rx_state_t *t)
                     {
                         t->rx_frames++;
                         t->rx_bytes += t->len - 2;
+                        s->stats.frames_in++;
                         span_log(&s->logging, SPAN_LOG_FLOW, "HDLC frame type %s, CRC OK\n", t30_frametype(t->buffer[2]));
                         if (s->t38x.current_tx_data_type == T38_DATA_V21)
                         {
@@ -2212,20 +2223,26 @@ static int restart_rx_modem(t38_gateway_state_t *s)
     switch (s->core.fast_rx_modem)
     {
     case FAX_MODEM_V27TER_RX:
-        v27ter_rx_restart(&t->fast_modems.v27ter_rx, s->core.fast_bit_rate, FALSE);
-        v27ter_rx_set_put_bit(&t->fast_modems.v27ter_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V27TER_RX);
+        v27ter_rx_restart(&t->fast_rx.v27ter_rx, s->core.fast_bit_rate, FALSE);
+        s->stats.retrains++;
+        v27ter_rx_set_put_bit(&t->fast_rx.v27ter_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         s->core.fast_rx_active = FAX_MODEM_V27TER_RX;
         break;
     case FAX_MODEM_V29_RX:
-        v29_rx_restart(&t->fast_modems.v29_rx, s->core.fast_bit_rate, FALSE);
-        v29_rx_set_put_bit(&t->fast_modems.v29_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V29_RX);
+        v29_rx_restart(&t->fast_rx.v29_rx, s->core.fast_bit_rate, FALSE);
+        s->stats.retrains++;
+        v29_rx_set_put_bit(&t->fast_rx.v29_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         s->core.fast_rx_active = FAX_MODEM_V29_RX;
         break;
     case FAX_MODEM_V17_RX:
-        v17_rx_restart(&t->fast_modems.v17_rx, s->core.fast_bit_rate, s->core.short_train);
-        v17_rx_set_put_bit(&t->fast_modems.v17_rx, put_bit_func, put_bit_user_data);
+        fax_modems_select_fast_rx_modem(t, FAX_MODEM_V17_RX);
+        v17_rx_restart(&t->fast_rx.v17_rx, s->core.fast_bit_rate, s->core.short_train);
+        s->stats.retrains++;
+        v17_rx_set_put_bit(&t->fast_rx.v17_rx, put_bit_func, put_bit_user_data);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         s->core.fast_rx_active = FAX_MODEM_V17_RX;
         break;
@@ -2279,8 +2296,10 @@ static void update_rx_timing(t38_gateway_state_t *s, int len)
 
 SPAN_DECLARE_NONSTD(int) t38_gateway_rx(t38_gateway_state_t *s, int16_t amp[], int len)
 {
+    uint64_t start;
     int i;
 
+    start = span_stats_cycles();
 #if defined(LOG_FAX_AUDIO)
     if (s->audio.modems.audio_rx_log >= 0)
         write(s->audio.modems.audio_rx_log, amp, len*sizeof(int16_t));
@@ -2291,6 +2310,8 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx(t38_gateway_state_t *s, int16_t amp[], i
         amp[i] = dc_restore(&s->audio.modems.dc_restore, amp[i]);
     /*endfor*/
     s->audio.modems.rx_handler(s->audio.modems.rx_user_data, amp, len);
+    s->stats.samples_in += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2317,6 +2338,7 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx_fillin(t38_gateway_state_t *s, int len)
     }
 #endif
     update_rx_timing(s, len);
+    s->stats.underflows++;
     /* TODO: handle the modems properly */
     s->audio.modems.rx_fillin_handler(s->audio.modems.rx_user_data, len);
     return 0;
@@ -2325,12 +2347,14 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx_fillin(t38_gateway_state_t *s, int len)
 
 SPAN_DECLARE_NONSTD(int) t38_gateway_tx(t38_gateway_state_t *s, int16_t amp[], int max_len)
 {
+    uint64_t start;
     int len;
 #if defined(LOG_FAX_AUDIO)
     int required_len;
     
     required_len = max_len;
 #endif
+    start = span_stats_cycles();
     if ((len = s->audio.modems.tx_handler(s->audio.modems.tx_user_data, amp, max_len)) < max_len)
     {
         if (set_next_tx_type(s))
@@ -2364,6 +2388,8 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_tx(t38_gateway_state_t *s, int16_t amp[], i
     }
     /*endif*/
 #endif
+    s->stats.samples_out += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return len;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2389,6 +2415,19 @@ SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_gateway_get_stats(t38_gateway_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) t38_gateway_get_memory_footprint(t38_gateway_state_t *s)
+{
+    return sizeof(*s);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_gateway_set_ecm_capability(t38_gateway_state_t *s, int ecm_allowed)
 {
     s->core.ecm_allowed = ecm_allowed;
@@ -2463,7 +2502,7 @@ static int t38_gateway_audio_init(t38_gateway_state_t *s)
     /* TODO: Don't use the very low cutoff levels we would like to. We get some quirks if we do.
        We need to sort this out. */
     fsk_rx_signal_cutoff(&s->audio.modems.v21_rx, -30.0f);
-    v29_rx_signal_cutoff(&s->audio.modems.fast_modems.v29_rx, -28.5f);
+    s->audio.modems.v29_rx_cutoff = -28.5f;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2500,7 +2539,7 @@ SPAN_DECLARE(t38_gateway_state_t *) t38_gateway_init(t38_gateway_state_t *s,
     /*endif*/
     if (s == NULL)
     {
-        if ((s = (t38_gateway_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_gateway_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         /*endif*/
     }
@@ -2565,7 +2604,7 @@ SPAN_DECLARE(int) t38_gateway_release(t38_gateway_state_t *s)
 
 SPAN_DECLARE(int) t38_gateway_free(t38_gateway_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
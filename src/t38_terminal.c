@@ -46,7 +46,10 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/queue.h"
 #include "spandsp/power_meter.h"
@@ -147,6 +150,15 @@ static __inline__ int front_end_status(t38_terminal_state_t *s, int status)
 
 static __inline__ void hdlc_accept_frame(t38_terminal_state_t *s, const uint8_t *msg, int len, int ok)
 {
+    if (len >= 0)
+    {
+        if (ok)
+            s->stats.frames_in++;
+        else
+            s->stats.crc_errors++;
+        /*endif*/
+    }
+    /*endif*/
     t30_hdlc_accept(&s->t30, msg, len, ok);
 }
 /*- End of function --------------------------------------------------------*/
@@ -209,6 +221,7 @@ static int process_rx_missing(t38_core_state_t *t, void *user_data, int rx_seq_n
     
     s = (t38_terminal_state_t *) user_data;
     s->t38_fe.rx_data_missing = TRUE;
+    s->stats.underflows++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -629,6 +642,7 @@ static void send_hdlc(void *user_data, const uint8_t *msg, int len)
     bit_reverse(s->t38_fe.hdlc_tx.buf, msg, len);
     s->t38_fe.hdlc_tx.len = len;
     s->t38_fe.hdlc_tx.ptr = 0;
+    s->stats.frames_out++;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -1136,6 +1150,7 @@ static int stream_cng(t38_terminal_state_t *s)
 SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples)
 {
     t38_terminal_front_end_state_t *fe;
+    uint64_t start;
     int delay;
 
     fe = &s->t38_fe;
@@ -1144,6 +1159,7 @@ SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples
     /*endif*/
 
     fe->samples += samples;
+    s->stats.samples_in += samples;
     t30_timer_update(&s->t30, samples);
     if (fe->timeout_rx_samples  &&  fe->samples > fe->timeout_rx_samples)
     {
@@ -1161,6 +1177,7 @@ SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples
         return FALSE;
     /*endif*/
     /* Its time to send something */
+    start = span_stats_cycles();
     delay = 0;
     switch ((fe->timed_step & 0xFFF0))
     {
@@ -1186,6 +1203,7 @@ SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples
         break;
     }
     /*endswitch*/
+    s->stats.cycles += span_stats_cycles() - start;
     if (delay < 0)
     {
         t30_terminate(&s->t30);
@@ -1497,6 +1515,19 @@ SPAN_DECLARE(logging_state_t *) t38_terminal_get_logging_state(t38_terminal_stat
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_terminal_get_stats(t38_terminal_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(size_t) t38_terminal_get_memory_footprint(t38_terminal_state_t *s)
+{
+    return sizeof(*s) - sizeof(s->t30) + t30_get_memory_footprint(&s->t30);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t38_terminal_restart(t38_terminal_state_t *s,
                                        int calling_party)
 {
@@ -1517,7 +1548,7 @@ SPAN_DECLARE(t38_terminal_state_t *) t38_terminal_init(t38_terminal_state_t *s,
 
     if (s == NULL)
     {
-        if ((s = (t38_terminal_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t38_terminal_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         /*endif*/
     }
@@ -1556,7 +1587,7 @@ SPAN_DECLARE(int) t38_terminal_release(t38_terminal_state_t *s)
 SPAN_DECLARE(int) t38_terminal_free(t38_terminal_state_t *s)
 {
     t38_terminal_release(s);
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
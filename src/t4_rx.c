@@ -79,6 +79,7 @@
 #include <tiffio.h>
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
@@ -286,7 +287,7 @@ static int close_tiff_output_file(t4_rx_state_t *s)
            put in it. */
         if (s->current_page == 0)
             remove(t->file);
-        free((char *) t->file);
+        span_free((char *) t->file);
         t->file = NULL;
     }
     return 0;
@@ -398,23 +399,23 @@ static int free_buffers(t4_rx_state_t *s)
 {
     if (s->image_buffer)
     {
-        free(s->image_buffer);
+        span_free(s->image_buffer);
         s->image_buffer = NULL;
         s->image_buffer_size = 0;
     }
     if (s->cur_runs)
     {
-        free(s->cur_runs);
+        span_free(s->cur_runs);
         s->cur_runs = NULL;
     }
     if (s->ref_runs)
     {
-        free(s->ref_runs);
+        span_free(s->ref_runs);
         s->ref_runs = NULL;
     }
     if (s->row_buf)
     {
-        free(s->row_buf);
+        span_free(s->row_buf);
         s->row_buf = NULL;
     }
     return 0;
@@ -475,7 +476,7 @@ static int put_decoded_row(t4_rx_state_t *s)
     /* Make sure there is enough room for another row */
     if (s->image_size + s->bytes_per_row >= s->image_buffer_size)
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        if ((t = span_realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
             return -1;
         s->image_buffer_size += 100*s->bytes_per_row;
         s->image_buffer = t;
@@ -650,13 +651,59 @@ static __inline__ void force_drop_rx_bits(t4_rx_state_t *s, int bits)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void lost_step(t4_rx_state_t *s)
+{
+    /* Something is wrong with the code words, so fall back to scanning every bit
+       position for an EOL, until an EOL brings us back in step. */
+    s->t4_t6_rx.codes_in_step = FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int eol_within_code(uint32_t bitstream, int bits)
+{
+    uint32_t zeros;
+
+    /* Look for the 11 zeros which begin an EOL, starting at any bit position inside
+       the code word, other than its first. No valid sequence of code words contains
+       11 zeros in a row, so if we find them a bit error has put us out of step, and
+       the EOL would be lost by dropping the code word whole. Bits beyond the end of
+       the buffer are zero, so an EOL which might be arriving also counts. */
+    zeros = ~bitstream;
+    zeros &= (zeros >> 1);
+    zeros &= (zeros >> 2);
+    zeros &= (zeros >> 4);
+    zeros &= (zeros >> 3);
+    return (zeros & (((uint32_t) 1 << bits) - 2)) != 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void drop_code_bits(t4_rx_state_t *s, int bits)
+{
+    /* When we are confident we are in step with the code words, drop the whole
+       code word. Otherwise, drop it step by step, scanning for an EOL. */
+    if (s->t4_t6_rx.codes_in_step)
+    {
+        if (!eol_within_code(s->t4_t6_rx.rx_bitstream, bits))
+        {
+            force_drop_rx_bits(s, bits);
+            return;
+        }
+        lost_step(s);
+    }
+    drop_rx_bits(s, bits);
+}
+/*- End of function --------------------------------------------------------*/
+
 static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
 {
     int bits;
     int old_a0;
 
     /* We decompress bit by bit, as the data stream is received. We need to
-       scan continuously for EOLs, so we might as well work this way. */
+       scan continuously for EOLs, so we might as well work this way. In fast
+       decode mode we only do that after a bad code word. Otherwise we resolve
+       each code word in one table lookup, drop it whole, and only look for EOLs
+       between code words. */
     s->line_image_size += quantity;
     s->t4_t6_rx.rx_bitstream |= (bit_string << s->t4_t6_rx.rx_bits);
     /* The longest item we need to scan for is 13 bits long (a 2D EOL), so we
@@ -684,6 +731,7 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
             /* We have an EOL, so now the page begins and we can proceed to
                process the bit stream as image data. */
             s->t4_t6_rx.consecutive_eols = 0;
+            s->t4_t6_rx.codes_in_step = s->t4_t6_rx.fast_decode;
             if (s->line_encoding == T4_COMPRESSION_ITU_T4_1D)
             {
                 s->row_is_2d = FALSE;
@@ -763,6 +811,8 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
             s->t4_t6_rx.black_white = 0;
             s->t4_t6_rx.run_length = 0;
             s->row_len = 0;
+            /* An EOL puts us back in step with the code words */
+            s->t4_t6_rx.codes_in_step = s->t4_t6_rx.fast_decode;
             continue;
         }
         if (s->t4_t6_rx.rx_skip_bits)
@@ -782,6 +832,7 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
                         t4_2d_table[bits].width);
             if (s->row_len >= s->image_width)
             {
+                lost_step(s);
                 drop_rx_bits(s, t4_2d_table[bits].width);
                 continue;
             }
@@ -824,6 +875,7 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
                         /* Undo the update we just started, and carry on as if this code does not exist */
                         /* TODO: we really should record that something wasn't right at this point. */
                         s->t4_t6_rx.a0 = old_a0;
+                        lost_step(s);
                         break;
     		        }
 	            }
@@ -862,16 +914,19 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
                             ((s->t4_t6_rx.rx_bitstream >> t4_2d_table[bits].width) & 0x7),
                             s->t4_t6_rx.rx_bitstream);
                 /* TODO: The uncompressed option should be implemented. */
+                lost_step(s);
                 break;
             case S_Null:
                 STATE_TRACE("Null\n");
+                lost_step(s);
                 break;
             default:
                 STATE_TRACE("Unexpected T.4 state\n");
                 span_log(&s->logging, SPAN_LOG_WARNING, "Unexpected T.4 state %d\n", t4_2d_table[bits].state);
+                lost_step(s);
                 break;
             }
-            drop_rx_bits(s, t4_2d_table[bits].width);
+            drop_code_bits(s, t4_2d_table[bits].width);
         }
         else
         {
@@ -905,9 +960,10 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
                 default:
                     /* Bad black */
                     s->t4_t6_rx.black_white = 0;
+                    lost_step(s);
                     break;
                 }
-                drop_rx_bits(s, t4_1d_black_table[bits].width);
+                drop_code_bits(s, t4_1d_black_table[bits].width);
             }
             else
             {
@@ -939,9 +995,10 @@ static int rx_put_bits(t4_rx_state_t *s, uint32_t bit_string, int quantity)
                 default:
                     /* Bad white */
                     s->t4_t6_rx.black_white = 0;
+                    lost_step(s);
                     break;
                 }
-                drop_rx_bits(s, t4_1d_white_table[bits].width);
+                drop_code_bits(s, t4_1d_white_table[bits].width);
             }
         }
         if (s->t4_t6_rx.a0 >= s->image_width)
@@ -1024,10 +1081,10 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_rx_state_t *s)
     {
         /* Allocate the space required for decoding the new row length. */
         s->bytes_per_row = bytes_per_row;
-        if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->cur_runs, run_space)) == NULL)
             return -1;
         s->cur_runs = bufptr;
-        if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->ref_runs, run_space)) == NULL)
             return -1;
         s->ref_runs = bufptr;
     }
@@ -1045,6 +1102,8 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_rx_state_t *s)
     /* We start at -1 EOLs for 1D and 2D decoding, as an indication we are waiting for the
        first EOL. T.6 coding starts without any preamble. */
     s->t4_t6_rx.consecutive_eols = (s->line_encoding == T4_COMPRESSION_ITU_T6)  ?  0  :  -1;
+    /* A T.6 image has no EOL to get us in step, but starts right at the first code word. */
+    s->t4_t6_rx.codes_in_step = (s->line_encoding == T4_COMPRESSION_ITU_T6)  ?  s->t4_t6_rx.fast_decode  :  FALSE;
 
     s->t4_t6_rx.bad_rows = 0;
     s->t4_t6_rx.longest_bad_row_run = 0;
@@ -1076,6 +1135,14 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t4_rx_set_fast_decode(t4_rx_state_t *s, int fast)
+{
+    s->t4_t6_rx.fast_decode = fast;
+    if (!fast)
+        s->t4_t6_rx.codes_in_step = FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t4_rx_set_rx_encoding(t4_rx_state_t *s, int encoding)
 {
     s->line_encoding = encoding;
@@ -1178,7 +1245,7 @@ SPAN_DECLARE(t4_rx_state_t *) t4_rx_init(t4_rx_state_t *s, const char *file, int
 {
     if (s == NULL)
     {
-        if ((s = (t4_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t4_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1192,7 +1259,7 @@ SPAN_DECLARE(t4_rx_state_t *) t4_rx_init(t4_rx_state_t *s, const char *file, int
         return NULL;
 
     /* Save the file name for logging reports. */
-    s->tiff.file = strdup(file);
+    s->tiff.file = span_strdup(file);
     /* Only provide for one form of coding throughout the file, even though the
        coding on the wire could change between pages. */
     switch (output_encoding)
@@ -1248,7 +1315,7 @@ SPAN_DECLARE(int) t4_rx_free(t4_rx_state_t *s)
     int ret;
 
     ret = t4_rx_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
@@ -75,7 +75,10 @@
 #include "floating_fudge.h"
 #include <tiffio.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
@@ -107,6 +110,23 @@
 /*! The number of EOLs to be sent at the end of a T.6 page */
 #define EOLS_TO_END_T6_TX_PAGE      2
 
+/* The AVX2 version is built with per-function target attributes, so the rest of
+   the library can still be built for a baseline CPU. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define T4_TX_WITH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+typedef int (*row_to_run_lengths_kernel_t)(uint32_t list[], const uint8_t row[], int width);
+
+static int row_to_run_lengths_select(uint32_t list[], const uint8_t row[], int width);
+
+/* This starts out pointing at a routine which picks the real implementation on first use */
+static row_to_run_lengths_kernel_t row_to_run_lengths_kernel = row_to_run_lengths_select;
+static int t4_tx_implementation = T4_TX_IMPLEMENTATION_AUTO;
+
 #if defined(T4_STATE_DEBUGGING)
 static void STATE_TRACE(const char *format, ...)
 {
@@ -704,7 +724,7 @@ static int close_tiff_input_file(t4_tx_state_t *s)
     TIFFClose(s->tiff.tiff_file);
     s->tiff.tiff_file = NULL;
     if (s->tiff.file)
-        free((char *) s->tiff.file);
+        span_free((char *) s->tiff.file);
     s->tiff.file = NULL;
     return 0;
 }
@@ -724,31 +744,63 @@ static int free_buffers(t4_tx_state_t *s)
 {
     if (s->image_buffer)
     {
-        free(s->image_buffer);
+        span_free(s->image_buffer);
         s->image_buffer = NULL;
         s->image_buffer_size = 0;
     }
     if (s->cur_runs)
     {
-        free(s->cur_runs);
+        span_free(s->cur_runs);
         s->cur_runs = NULL;
     }
     if (s->ref_runs)
     {
-        free(s->ref_runs);
+        span_free(s->ref_runs);
         s->ref_runs = NULL;
     }
     if (s->row_buf)
     {
-        free(s->row_buf);
+        span_free(s->row_buf);
         s->row_buf = NULL;
     }
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
-static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
+static __inline__ uint64_t load_be64(const uint8_t row[])
+{
+    /* Compilers turn this into a single load and a bswap on little endian machines */
+    return ((uint64_t) row[0] << 56)
+         | ((uint64_t) row[1] << 48)
+         | ((uint64_t) row[2] << 40)
+         | ((uint64_t) row[3] << 32)
+         | ((uint64_t) row[4] << 24)
+         | ((uint64_t) row[5] << 16)
+         | ((uint64_t) row[6] << 8)
+         | ((uint64_t) row[7]);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int leading_zeros64(uint64_t x)
 {
+    /* This returns 64 for zero, to match the 31 - top_bit(0) == 32 behaviour the
+       32 bit word code relies on. */
+#if defined(__GNUC__)
+    return (x)  ?  __builtin_clzll(x)  :  64;
+#else
+    if ((x >> 32))
+        return 31 - top_bit((uint32_t) (x >> 32));
+    return 63 - top_bit((uint32_t) x);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+typedef int (*uniform_skip_t)(const uint8_t row[], int i, int limit, uint8_t flip);
+
+static __inline__ int row_to_run_lengths_core(uint32_t list[], const uint8_t row[], int width, int wide, uniform_skip_t skip)
+{
+    uint64_t flip64;
+    uint64_t x64;
     uint32_t flip;
     uint32_t x;
     int span;
@@ -759,13 +811,52 @@ static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
     int i;
     int pos;
 
-    /* Deal with whole words first. We know we are starting on a word boundary. */
     entry = 0;
     flip = 0;
-    limit = (width >> 3) & ~3;
     span = 0;
     pos = 0;
-    for (i = 0;  i < limit;  i += sizeof(uint32_t))
+    i = 0;
+    if (wide)
+    {
+        /* Deal with whole 64 bit words first. We know we are starting on a word boundary. */
+        flip64 = 0;
+        limit = (width >> 3) & ~7;
+        for (  ;  i < limit;  i += sizeof(uint64_t))
+        {
+            memcpy(&x64, &row[i], sizeof(x64));
+            if (x64 == flip64)
+            {
+                /* We are in a stretch of all white or all black. Skip as much of it as we can
+                   in big steps. */
+                if (skip)
+                    i = skip(row, i + sizeof(uint64_t), limit, (uint8_t) flip64) - sizeof(uint64_t);
+                continue;
+            }
+            x64 = load_be64(&row[i]);
+            /* We know we are going to find at least one transition. */
+            frag = leading_zeros64(x64 ^ flip64);
+            pos += ((i << 3) - span + frag);
+            list[entry++] = pos;
+            x64 <<= frag;
+            flip64 = ~flip64;
+            rem = 64 - frag;
+            /* Now see if there are any more */
+            while ((frag = leading_zeros64(x64 ^ flip64)) < rem)
+            {
+                pos += frag;
+                list[entry++] = pos;
+                x64 <<= frag;
+                flip64 = ~flip64;
+                rem -= frag;
+            }
+            /* Save the remainder of the word */
+            span = (i << 3) + 64 - rem;
+        }
+        flip = (uint32_t) flip64;
+    }
+    /* Deal with whole 32 bit words. */
+    limit = (width >> 3) & ~3;
+    for (  ;  i < limit;  i += sizeof(uint32_t))
     {
         x = *((uint32_t *) &row[i]);
         if (x != flip)
@@ -854,6 +945,101 @@ static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int row_to_run_lengths_word32(uint32_t list[], const uint8_t row[], int width)
+{
+    return row_to_run_lengths_core(list, row, width, FALSE, NULL);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int row_to_run_lengths_word64(uint32_t list[], const uint8_t row[], int width)
+{
+    return row_to_run_lengths_core(list, row, width, TRUE, NULL);
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(T4_TX_WITH_AVX2)
+__attribute__((target("avx2")))
+static int skip_uniform_bytes_avx2(const uint8_t row[], int i, int limit, uint8_t flip)
+{
+    __m256i ref;
+
+    /* Step over 32 bytes at a time, while they are all the same colour */
+    ref = _mm256_set1_epi8((char) flip);
+    for (  ;  i + 32 <= limit;  i += 32)
+    {
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) &row[i]), ref)) != -1)
+            break;
+    }
+    return i;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Every CPU with AVX2 also has LZCNT, which makes the leading zero counts branch free */
+__attribute__((target("avx2,lzcnt")))
+static int row_to_run_lengths_avx2(uint32_t list[], const uint8_t row[], int width)
+{
+    return row_to_run_lengths_core(list, row, width, TRUE, skip_uniform_bytes_avx2);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static int implementation_available(int implementation)
+{
+    switch (implementation)
+    {
+    case T4_TX_IMPLEMENTATION_WORD32:
+    case T4_TX_IMPLEMENTATION_WORD64:
+        return TRUE;
+#if defined(T4_TX_WITH_AVX2)
+    case T4_TX_IMPLEMENTATION_AVX2:
+        return has_AVX2();
+#endif
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_set_implementation(int implementation)
+{
+    if (implementation == T4_TX_IMPLEMENTATION_AUTO)
+        implementation = (implementation_available(T4_TX_IMPLEMENTATION_AVX2))  ?  T4_TX_IMPLEMENTATION_AVX2  :  T4_TX_IMPLEMENTATION_WORD64;
+    else if (!implementation_available(implementation))
+        return -1;
+    switch (implementation)
+    {
+#if defined(T4_TX_WITH_AVX2)
+    case T4_TX_IMPLEMENTATION_AVX2:
+        row_to_run_lengths_kernel = row_to_run_lengths_avx2;
+        break;
+#endif
+    case T4_TX_IMPLEMENTATION_WORD64:
+        row_to_run_lengths_kernel = row_to_run_lengths_word64;
+        break;
+    default:
+        implementation = T4_TX_IMPLEMENTATION_WORD32;
+        row_to_run_lengths_kernel = row_to_run_lengths_word32;
+        break;
+    }
+    t4_tx_implementation = implementation;
+    return implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_get_implementation(void)
+{
+    if (t4_tx_implementation == T4_TX_IMPLEMENTATION_AUTO)
+        t4_tx_set_implementation(T4_TX_IMPLEMENTATION_AUTO);
+    return t4_tx_implementation;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int row_to_run_lengths_select(uint32_t list[], const uint8_t row[], int width)
+{
+    t4_tx_set_implementation(T4_TX_IMPLEMENTATION_AUTO);
+    return row_to_run_lengths_kernel(list, row, width);
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int put_encoded_bits(t4_tx_state_t *s, uint32_t bits, int length)
 {
     uint8_t *t;
@@ -865,7 +1051,7 @@ static __inline__ int put_encoded_bits(t4_tx_state_t *s, uint32_t bits, int leng
     s->row_bits += length;
     if ((s->image_size + (s->tx_bits + 7)/8) >= s->image_buffer_size)
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        if ((t = span_realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
             return -1;
         s->image_buffer = t;
         s->image_buffer_size += 100*s->bytes_per_row;
@@ -1050,7 +1236,7 @@ static void encode_2d_row(t4_tx_state_t *s)
                           Vertical and horizontal modes
      */
     /* The following implements the 2-D encoding section of the flow chart in Figure7/T.4 */
-    cur_steps = row_to_run_lengths(s->cur_runs, s->row_buf, s->image_width);
+    cur_steps = row_to_run_lengths_kernel(s->cur_runs, s->row_buf, s->image_width);
     /* Stretch the row a little, so when we step by 2 we are guaranteed to
        hit an entry showing the row length */
     s->cur_runs[cur_steps] =
@@ -1155,7 +1341,7 @@ static void encode_1d_row(t4_tx_state_t *s)
 
     /* Do our work in the reference row buffer, and it is already in place if
        we need a reference row for a following 2D encoded row. */
-    s->t4_t6_tx.ref_steps = row_to_run_lengths(s->ref_runs, s->row_buf, s->image_width);
+    s->t4_t6_tx.ref_steps = row_to_run_lengths_kernel(s->ref_runs, s->row_buf, s->image_width);
     put_1d_span(s, s->ref_runs[0], t4_white_codes);
     for (i = 1;  i < s->t4_t6_tx.ref_steps;  i++)
         put_1d_span(s, s->ref_runs[i] - s->ref_runs[i - 1], (i & 1)  ?  t4_black_codes  :  t4_white_codes);
@@ -1254,13 +1440,13 @@ SPAN_DECLARE(int) t4_tx_start_page(t4_tx_state_t *s)
     {
         s->bytes_per_row = (s->image_width + 7)/8;
 
-        if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->cur_runs, run_space)) == NULL)
             return -1;
         s->cur_runs = bufptr;
-        if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
+        if ((bufptr = (uint32_t *) span_realloc(s->ref_runs, run_space)) == NULL)
             return -1;
         s->ref_runs = bufptr;
-        if ((bufptr8 = realloc(s->row_buf, s->bytes_per_row)) == NULL)
+        if ((bufptr8 = span_realloc(s->row_buf, s->bytes_per_row)) == NULL)
             return -1;
         s->row_buf = bufptr8;
     }
@@ -1498,7 +1684,7 @@ SPAN_DECLARE(t4_tx_state_t *) t4_tx_init(t4_tx_state_t *s, const char *file, int
     allocated = FALSE;
     if (s == NULL)
     {
-        if ((s = (t4_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (t4_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
         allocated = TRUE;
     }
@@ -1512,10 +1698,10 @@ SPAN_DECLARE(t4_tx_state_t *) t4_tx_init(t4_tx_state_t *s, const char *file, int
     if (open_tiff_input_file(s, file) < 0)
     {
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
-    s->tiff.file = strdup(file);
+    s->tiff.file = span_strdup(file);
     s->current_page =
     s->tiff.start_page = (start_page >= 0)  ?  start_page  :  0;
     s->tiff.stop_page = (stop_page >= 0)  ?  stop_page : INT_MAX;
@@ -1523,14 +1709,14 @@ SPAN_DECLARE(t4_tx_state_t *) t4_tx_init(t4_tx_state_t *s, const char *file, int
     if (!TIFFSetDirectory(s->tiff.tiff_file, (tdir_t) s->current_page))
     {
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
     if (get_tiff_directory_info(s))
     {
         close_tiff_input_file(s);
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
 
@@ -1539,26 +1725,26 @@ SPAN_DECLARE(t4_tx_state_t *) t4_tx_init(t4_tx_state_t *s, const char *file, int
     s->tiff.pages_in_file = -1;
 
     run_space = (s->image_width + 4)*sizeof(uint32_t);
-    if ((s->cur_runs = (uint32_t *) malloc(run_space)) == NULL)
+    if ((s->cur_runs = (uint32_t *) span_alloc(run_space)) == NULL)
     {
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
-    if ((s->ref_runs = (uint32_t *) malloc(run_space)) == NULL)
+    if ((s->ref_runs = (uint32_t *) span_alloc(run_space)) == NULL)
     {
         free_buffers(s);
         close_tiff_input_file(s);
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
-    if ((s->row_buf = malloc(s->bytes_per_row)) == NULL)
+    if ((s->row_buf = span_alloc(s->bytes_per_row)) == NULL)
     {
         free_buffers(s);
         close_tiff_input_file(s);
         if (allocated)
-            free(s);
+            span_free(s);
         return NULL;
     }
     s->ref_runs[0] =
@@ -1587,7 +1773,7 @@ SPAN_DECLARE(int) t4_tx_free(t4_tx_state_t *s)
     int ret;
 
     ret = t4_tx_release(s);
-    free(s);
+    span_free(s);
     return ret;
 }
 /*- End of function --------------------------------------------------------*/
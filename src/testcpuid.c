@@ -32,8 +32,12 @@
 
 #include <inttypes.h>
 
+#include "mmx_sse_decs.h"
+
 /* Make this file just disappear if we are not on an x86 machine */
-#if defined(__i386__) //  ||  defined(__x86_64__)
+#if defined(__i386__)  ||  defined(__x86_64__)
+
+#if defined(__i386__)
 
 enum
 {
@@ -188,11 +192,165 @@ int has_3DNow(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+#endif
+
+/* Execute CPUID for the specified leaf and sub-leaf. %ebx may be the PIC register
+   on i386, so it is preserved by hand. */
+static __inline__ void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(__i386__)
+    __asm__ __volatile__ (
+        " push  %%ebx;\n"
+        " cpuid;\n"
+        " mov   %%ebx,%%esi;\n"
+        " pop   %%ebx;\n"
+        : "=a" (regs[0]), "=S" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+        : "a" (leaf), "c" (subleaf));
+#else
+    __asm__ __volatile__ (
+        " cpuid;\n"
+        : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+        : "a" (leaf), "c" (subleaf));
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Find which register sets the OS saves on a context switch. The XGETBV opcode is
+   given as bytes, for the benefit of older assemblers. */
+static __inline__ uint32_t xgetbv0(void)
+{
+    uint32_t eax;
+    uint32_t edx;
+
+    __asm__ __volatile__ (
+        " .byte 0x0f, 0x01, 0xd0;\n"
+        : "=a" (eax), "=d" (edx)
+        : "c" (0));
+    return eax;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Check the features in CPUID leaf 7 %ebx, together with the OS support for the
+   register state they need. */
+static int has_leaf7_feature(uint32_t ebx_bits, uint32_t xcr0_bits)
+{
+    uint32_t regs[4];
+
+#if defined(__i386__)
+    if (!have_cpuid_p())
+        return 0;
+    /*endif*/
+#endif
+    cpuid(0, 0, regs);
+    if (regs[0] < 7)
+        return 0;
+    /*endif*/
+    cpuid(1, 0, regs);
+    /* We need OSXSAVE (bit 27) before XGETBV can be used, and AVX itself (bit 28). */
+    if ((regs[2] & 0x18000000) != 0x18000000)
+        return 0;
+    /*endif*/
+    if ((xgetbv0() & xcr0_bits) != xcr0_bits)
+        return 0;
+    /*endif*/
+    cpuid(7, 0, regs);
+    return ((regs[1] & ebx_bits) == ebx_bits);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_AVX(void)
+{
+    uint32_t regs[4];
+
+#if defined(__i386__)
+    if (!have_cpuid_p())
+        return 0;
+    /*endif*/
+#endif
+    cpuid(1, 0, regs);
+    /* We need OSXSAVE (bit 27) and AVX (bit 28), and the OS must save the SSE
+       and AVX register state. */
+    if ((regs[2] & 0x18000000) != 0x18000000)
+        return 0;
+    /*endif*/
+    return ((xgetbv0() & 0x00000006) == 0x00000006);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_PCLMUL(void)
+{
+    uint32_t regs[4];
+
+#if defined(__i386__)
+    if (!have_cpuid_p())
+        return 0;
+    /*endif*/
+#endif
+    cpuid(1, 0, regs);
+    /* PCLMULQDQ is %ecx bit 1. The routines which use it also need SSE2, which is
+       %edx bit 26. */
+    return ((regs[2] & 0x00000002)  &&  (regs[3] & 0x04000000));
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_SSE2(void)
+{
+    uint32_t regs[4];
+
+#if defined(__i386__)
+    if (!have_cpuid_p())
+        return 0;
+    /*endif*/
+#endif
+    cpuid(1, 0, regs);
+    /* SSE2 is %edx bit 26. */
+    return ((regs[3] & 0x04000000) != 0);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_SSE4_1(void)
+{
+    uint32_t regs[4];
+
+#if defined(__i386__)
+    if (!have_cpuid_p())
+        return 0;
+    /*endif*/
+#endif
+    cpuid(1, 0, regs);
+    /* SSE4.1 is %ecx bit 19. The routines which use it also use PSHUFB, which is
+       SSSE3, in %ecx bit 9. */
+    return ((regs[2] & 0x00080200) == 0x00080200);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_AVX2(void)
+{
+    /* AVX2 is leaf 7 %ebx bit 5. The OS must save the SSE and AVX register state. */
+    return has_leaf7_feature(0x00000020, 0x00000006);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_AVX512F(void)
+{
+    /* AVX-512F is leaf 7 %ebx bit 16. The OS must also save the opmask and ZMM state. */
+    return has_leaf7_feature(0x00010000, 0x000000E6);
+}
+/*- End of function --------------------------------------------------------*/
+
+int has_AVX512BW(void)
+{
+    /* AVX-512BW is leaf 7 %ebx bit 30, and is only useful alongside AVX-512F. */
+    return has_leaf7_feature(0x40010000, 0x000000E6);
+}
+/*- End of function --------------------------------------------------------*/
+
 #if defined(TESTBED)
 int main(int argc, char *argv[])
 {
     int result;
 
+#if defined(__i386__)
     result = has_MMX();
     printf("MMX is %x\n", result);
     result = has_SIMD();
@@ -201,6 +359,21 @@ int main(int argc, char *argv[])
     printf("SIMD2 is %x\n", result);
     result = has_3DNow();
     printf("3DNow is %x\n", result);
+#endif
+    result = has_AVX();
+    printf("AVX is %x\n", result);
+    result = has_PCLMUL();
+    printf("PCLMUL is %x\n", result);
+    result = has_SSE2();
+    printf("SSE2 is %x\n", result);
+    result = has_SSE4_1();
+    printf("SSE4.1 is %x\n", result);
+    result = has_AVX2();
+    printf("AVX2 is %x\n", result);
+    result = has_AVX512F();
+    printf("AVX-512F is %x\n", result);
+    result = has_AVX512BW();
+    printf("AVX-512BW is %x\n", result);
     return  0;
 }
 /*- End of function --------------------------------------------------------*/
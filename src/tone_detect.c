@@ -43,7 +43,10 @@
 #include <time.h>
 #include <fcntl.h>
 
+#include "mmx_sse_decs.h"
+
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/complex.h"
 #include "spandsp/complex_vector_float.h"
 #include "spandsp/tone_detect.h"
@@ -56,6 +59,34 @@
 #define M_PI 3.14159265358979323846264338327
 #endif
 
+/* The Goertzel bank uses SSE or SSE2 where the compiler's baseline target has them.
+   The AVX routine is built with a per-function target attribute, and is only used
+   when a run time check finds the CPU supports it. */
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#if defined(SPANDSP_USE_FIXED_POINT)
+#if defined(__SSE2__)
+#define GOERTZEL_BANK_WITH_SSE
+#include <emmintrin.h>
+#endif
+#else
+#if defined(__SSE__)
+#define GOERTZEL_BANK_WITH_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__clang__)  ||  __GNUC__ > 4  ||  (__GNUC__ == 4  &&  __GNUC_MINOR__ >= 9)
+#define GOERTZEL_BANK_WITH_AVX
+#include <immintrin.h>
+#endif
+#endif
+#endif
+
+typedef void (*goertzel_bank_kernel_t)(goertzel_bank_state_t *s, const int16_t amp[], int samples);
+
+static void goertzel_bank_update_select(goertzel_bank_state_t *s, const int16_t amp[], int samples);
+
+/* This starts out pointing at a routine which picks the real implementation on first use */
+static goertzel_bank_kernel_t goertzel_bank_kernel = goertzel_bank_update_select;
+
 SPAN_DECLARE(void) make_goertzel_descriptor(goertzel_descriptor_t *t, float freq, int samples)
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
@@ -72,7 +103,7 @@ SPAN_DECLARE(goertzel_state_t *) goertzel_init(goertzel_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (goertzel_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (goertzel_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
 #if defined(SPANDSP_USE_FIXED_POINT)
@@ -98,7 +129,7 @@ SPAN_DECLARE(int) goertzel_release(goertzel_state_t *s)
 SPAN_DECLARE(int) goertzel_free(goertzel_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -198,6 +229,299 @@ SPAN_DECLARE(float) goertzel_result(goertzel_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+/* All the Goertzel bank routines perform the same operations, in the same order, as
+   goertzel_update(), so the results match those of separate Goertzel states. The
+   multiply and add are kept as separate operations for this reason. The results are
+   bit exact, unless the compiler is allowed to reorder floating point operations
+   (e.g. with -ffast-math). Fixed point results are always bit exact. */
+static void goertzel_bank_update_generic(goertzel_bank_state_t *s, const int16_t amp[], int samples)
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t xamp;
+    int16_t x;
+    int16_t v1;
+#else
+    float xamp;
+    float v1;
+#endif
+    int i;
+    int k;
+
+    for (i = 0;  i < samples;  i++)
+    {
+        xamp = goertzel_preadjust_amp(amp[i]);
+        for (k = 0;  k < s->lanes;  k++)
+        {
+            v1 = s->v2[k];
+            s->v2[k] = s->v3[k];
+#if defined(SPANDSP_USE_FIXED_POINT)
+            x = (((int32_t) s->fac[k]*s->v2[k]) >> 14);
+            s->v3[k] = x - v1 + xamp;
+#else
+            s->v3[k] = s->fac[k]*s->v2[k] - v1 + xamp;
+#endif
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(GOERTZEL_BANK_WITH_SSE)
+#if defined(SPANDSP_USE_FIXED_POINT)
+static void goertzel_bank_update_sse(goertzel_bank_state_t *s, const int16_t amp[], int samples)
+{
+    __m128i fac;
+    __m128i v1;
+    __m128i v2;
+    __m128i v3;
+    __m128i hi;
+    __m128i lo;
+    __m128i xamp;
+    int i;
+    int k;
+
+    /* Work through the frequencies 8 at a time, keeping their state in registers for
+       the whole run of samples. The low 16 bits of (fac*v2) >> 14 are put together
+       from the high and low halves of the 32 bit products. */
+    for (k = 0;  k < s->lanes;  k += 8)
+    {
+        fac = _mm_loadu_si128((const __m128i *) &s->fac[k]);
+        v2 = _mm_loadu_si128((const __m128i *) &s->v2[k]);
+        v3 = _mm_loadu_si128((const __m128i *) &s->v3[k]);
+        for (i = 0;  i < samples;  i++)
+        {
+            xamp = _mm_set1_epi16(goertzel_preadjust_amp(amp[i]));
+            v1 = v2;
+            v2 = v3;
+            hi = _mm_mulhi_epi16(fac, v2);
+            lo = _mm_mullo_epi16(fac, v2);
+            v3 = _mm_or_si128(_mm_slli_epi16(hi, 2), _mm_srli_epi16(lo, 14));
+            v3 = _mm_add_epi16(_mm_sub_epi16(v3, v1), xamp);
+        }
+        _mm_storeu_si128((__m128i *) &s->v2[k], v2);
+        _mm_storeu_si128((__m128i *) &s->v3[k], v3);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#else
+static void goertzel_bank_update_sse(goertzel_bank_state_t *s, const int16_t amp[], int samples)
+{
+    __m128 fac[2];
+    __m128 v1;
+    __m128 v2[2];
+    __m128 v3[2];
+    __m128 xamp;
+    int i;
+    int j;
+    int k;
+
+    /* Work through the frequencies 8 at a time, keeping their state in registers for
+       the whole run of samples. */
+    for (k = 0;  k < s->lanes;  k += 8)
+    {
+        for (j = 0;  j < 2;  j++)
+        {
+            fac[j] = _mm_loadu_ps(&s->fac[k + 4*j]);
+            v2[j] = _mm_loadu_ps(&s->v2[k + 4*j]);
+            v3[j] = _mm_loadu_ps(&s->v3[k + 4*j]);
+        }
+        for (i = 0;  i < samples;  i++)
+        {
+            xamp = _mm_set1_ps(goertzel_preadjust_amp(amp[i]));
+            for (j = 0;  j < 2;  j++)
+            {
+                v1 = v2[j];
+                v2[j] = v3[j];
+                v3[j] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac[j], v2[j]), v1), xamp);
+            }
+        }
+        for (j = 0;  j < 2;  j++)
+        {
+            _mm_storeu_ps(&s->v2[k + 4*j], v2[j]);
+            _mm_storeu_ps(&s->v3[k + 4*j], v3[j]);
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+#endif
+
+#if defined(GOERTZEL_BANK_WITH_AVX)
+__attribute__((target("avx")))
+static void goertzel_bank_update_avx(goertzel_bank_state_t *s, const int16_t amp[], int samples)
+{
+    __m256 fac[2];
+    __m256 v1;
+    __m256 v2[2];
+    __m256 v3[2];
+    __m256 xamp;
+    int i;
+    int j;
+    int k;
+    int n;
+
+    /* Work through the frequencies 16 at a time, with a single vector for any final
+       group of 8. */
+    for (k = 0;  k < s->lanes;  k += 16)
+    {
+        n = (s->lanes - k > 8)  ?  2  :  1;
+        for (j = 0;  j < n;  j++)
+        {
+            fac[j] = _mm256_loadu_ps(&s->fac[k + 8*j]);
+            v2[j] = _mm256_loadu_ps(&s->v2[k + 8*j]);
+            v3[j] = _mm256_loadu_ps(&s->v3[k + 8*j]);
+        }
+        for (i = 0;  i < samples;  i++)
+        {
+            xamp = _mm256_set1_ps(goertzel_preadjust_amp(amp[i]));
+            for (j = 0;  j < n;  j++)
+            {
+                v1 = v2[j];
+                v2[j] = v3[j];
+                v3[j] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fac[j], v2[j]), v1), xamp);
+            }
+        }
+        for (j = 0;  j < n;  j++)
+        {
+            _mm256_storeu_ps(&s->v2[k + 8*j], v2[j]);
+            _mm256_storeu_ps(&s->v3[k + 8*j], v3[j]);
+        }
+    }
+    _mm256_zeroupper();
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void goertzel_bank_update_select(goertzel_bank_state_t *s, const int16_t amp[], int samples)
+{
+    goertzel_bank_kernel = goertzel_bank_update_generic;
+#if defined(GOERTZEL_BANK_WITH_SSE)
+    goertzel_bank_kernel = goertzel_bank_update_sse;
+#endif
+#if defined(GOERTZEL_BANK_WITH_AVX)
+    if (has_AVX())
+        goertzel_bank_kernel = goertzel_bank_update_avx;
+#endif
+    goertzel_bank_kernel(s, amp, samples);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(goertzel_bank_state_t *) goertzel_bank_init(goertzel_bank_state_t *s,
+                                                         const goertzel_descriptor_t t[],
+                                                         int freqs)
+{
+    int i;
+
+    if (freqs < 1  ||  freqs > GOERTZEL_BANK_MAX_FREQS)
+        return NULL;
+    for (i = 1;  i < freqs;  i++)
+    {
+        if (t[i].samples != t[0].samples)
+            return NULL;
+    }
+    if (s == NULL)
+    {
+        if ((s = (goertzel_bank_state_t *) span_alloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    /* The spare lanes have zero coefficients, and their results are never used */
+    memset(s, 0, sizeof(*s));
+    s->freqs = freqs;
+#if defined(GOERTZEL_BANK_WITH_SSE)  ||  defined(GOERTZEL_BANK_WITH_AVX)
+    s->lanes = (freqs + 7) & ~7;
+#else
+    s->lanes = freqs;
+#endif
+    s->samples = t[0].samples;
+    for (i = 0;  i < freqs;  i++)
+        s->fac[i] = t[i].fac;
+    goertzel_bank_reset(s);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) goertzel_bank_release(goertzel_bank_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) goertzel_bank_free(goertzel_bank_state_t *s)
+{
+    if (s)
+        span_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) goertzel_bank_reset(goertzel_bank_state_t *s)
+{
+    memset(s->v2, 0, sizeof(s->v2));
+    memset(s->v3, 0, sizeof(s->v3));
+#if defined(SPANDSP_USE_FIXED_POINT)
+    s->energy = 0;
+#else
+    s->energy = 0.0f;
+#endif
+    s->current_sample = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) goertzel_bank_update(goertzel_bank_state_t *s,
+                                       const int16_t amp[],
+                                       int samples)
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int16_t xamp;
+#else
+    float xamp;
+#endif
+    int i;
+
+    if (samples > s->samples - s->current_sample)
+        samples = s->samples - s->current_sample;
+    for (i = 0;  i < samples;  i++)
+    {
+        xamp = goertzel_preadjust_amp(amp[i]);
+#if defined(SPANDSP_USE_FIXED_POINT)
+        s->energy += ((int32_t) xamp*xamp);
+#else
+        s->energy += xamp*xamp;
+#endif
+    }
+    goertzel_bank_kernel(s, amp, samples);
+    s->current_sample += samples;
+    return samples;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(SPANDSP_USE_FIXED_POINT)
+SPAN_DECLARE(int32_t) goertzel_bank_result(goertzel_bank_state_t *s, int32_t result[])
+#else
+SPAN_DECLARE(float) goertzel_bank_result(goertzel_bank_state_t *s, float result[])
+#endif
+{
+    goertzel_state_t state;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t energy;
+#else
+    float energy;
+#endif
+    int i;
+
+    /* Finish each filter off with exactly the same code as a lone Goertzel */
+    for (i = 0;  i < s->freqs;  i++)
+    {
+        state.fac = s->fac[i];
+        state.v2 = s->v2[i];
+        state.v3 = s->v3[i];
+        result[i] = goertzel_result(&state);
+    }
+    energy = s->energy;
+    goertzel_bank_reset(s);
+    return energy;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(complexf_t) periodogram(const complexf_t coeffs[], const complexf_t amp[], int len)
 {
     complexf_t sum;
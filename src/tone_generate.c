@@ -44,6 +44,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/dc_restore.h"
 #include "spandsp/complex.h"
@@ -70,7 +71,7 @@ SPAN_DECLARE(tone_gen_descriptor_t *) tone_gen_descriptor_init(tone_gen_descript
 {
     if (s == NULL)
     {
-        if ((s = (tone_gen_descriptor_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (tone_gen_descriptor_t *) span_alloc(sizeof(*s))) == NULL)
         {
             return NULL;
         }
@@ -115,7 +116,7 @@ SPAN_DECLARE(tone_gen_descriptor_t *) tone_gen_descriptor_init(tone_gen_descript
 
 SPAN_DECLARE(void) tone_gen_descriptor_free(tone_gen_descriptor_t *s)
 {
-    free(s);
+    span_free(s);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -221,7 +222,7 @@ SPAN_DECLARE(tone_gen_state_t *) tone_gen_init(tone_gen_state_t *s, tone_gen_des
 
     if (s == NULL)
     {
-        if ((s = (tone_gen_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (tone_gen_state_t *) span_alloc(sizeof(*s))) == NULL)
         {
             return NULL;
         }
@@ -253,7 +254,7 @@ SPAN_DECLARE(int) tone_gen_release(tone_gen_state_t *s)
 SPAN_DECLARE(int) tone_gen_free(tone_gen_state_t *s)
 {
     if (s)
-        free(s);
+        span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -44,7 +44,10 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/math_fixed.h"
 #include "spandsp/saturated.h"
@@ -1232,7 +1235,9 @@ SPAN_DECLARE_NONSTD(int) v17_rx(v17_rx_state_t *s, const int16_t amp[], int len)
     float v;
 #endif
     int32_t power;
+    uint64_t start;
 
+    start = span_stats_cycles();
     for (i = 0;  i < len;  i++)
     {
 #if defined(RESCALER_TEST)
@@ -1325,6 +1330,8 @@ SPAN_DECLARE_NONSTD(int) v17_rx(v17_rx_state_t *s, const int16_t amp[], int len)
         dds_advancef(&s->carrier_phase, s->carrier_phase_rate);
 #endif
     }
+    s->stats.samples_in += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1336,6 +1343,7 @@ SPAN_DECLARE_NONSTD(int) v17_rx_fillin(v17_rx_state_t *s, int len)
     /* We want to sustain the current state (i.e carrier on<->carrier off), and
        try to sustain the carrier phase. We should probably push the filters, as well */
     span_log(&s->logging, SPAN_LOG_FLOW, "Fill-in %d samples\n", len);
+    s->stats.underflows++;
     if (s->signal_present <= 0)
         return 0;
     if (s->training_stage == TRAINING_STAGE_PARKED)
@@ -1377,6 +1385,13 @@ SPAN_DECLARE(logging_state_t *) v17_rx_get_logging_state(v17_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) v17_rx_get_stats(v17_rx_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) v17_rx_restart(v17_rx_state_t *s, int bit_rate, int short_train)
 {
     int i;
@@ -1510,6 +1525,7 @@ SPAN_DECLARE(int) v17_rx_restart(v17_rx_state_t *s, int bit_rate, int short_trai
 
     s->total_baud_timing_correction = 0;
 
+    s->stats.retrains++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1530,7 +1546,7 @@ SPAN_DECLARE(v17_rx_state_t *) v17_rx_init(v17_rx_state_t *s, int bit_rate, put_
     }
     if (s == NULL)
     {
-        if ((s = (v17_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v17_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1555,7 +1571,7 @@ SPAN_DECLARE(int) v17_rx_release(v17_rx_state_t *s)
 
 SPAN_DECLARE(int) v17_rx_free(v17_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
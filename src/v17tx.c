@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -444,7 +445,7 @@ SPAN_DECLARE(v17_tx_state_t *) v17_tx_init(v17_tx_state_t *s, int bit_rate, int
     }
     if (s == NULL)
     {
-        if ((s = (v17_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v17_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -468,7 +469,7 @@ SPAN_DECLARE(int) v17_tx_release(v17_tx_state_t *s)
 
 SPAN_DECLARE(int) v17_tx_free(v17_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -43,6 +43,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
 #include "spandsp/queue.h"
 #include "spandsp/async.h"
@@ -831,7 +832,7 @@ SPAN_DECLARE(v18_state_t *) v18_init(v18_state_t *s,
 {
     if (s == NULL)
     {
-        if ((s = (v18_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v18_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -907,7 +908,7 @@ SPAN_DECLARE(int) v18_release(v18_state_t *s)
 
 SPAN_DECLARE(int) v18_free(v18_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -45,8 +45,11 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/complex.h"
 #include "spandsp/vector_float.h"
 #include "spandsp/complex_vector_float.h"
@@ -650,7 +653,7 @@ SPAN_DECLARE(v22bis_state_t *) v22bis_init(v22bis_state_t *s,
     }
     if (s == NULL)
     {
-        if ((s = (v22bis_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v22bis_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -698,7 +701,7 @@ SPAN_DECLARE(int) v22bis_release(v22bis_state_t *s)
 
 SPAN_DECLARE(int) v22bis_free(v22bis_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -43,7 +43,10 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/logging.h"
+#include "spandsp/timing.h"
+#include "spandsp/stats.h"
 #include "spandsp/complex.h"
 #include "spandsp/vector_float.h"
 #include "spandsp/complex_vector_float.h"
@@ -849,7 +852,9 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx(v27ter_rx_state_t *s, const int16_t amp[], in
     float v;
 #endif
     int32_t power;
+    uint64_t start;
 
+    start = span_stats_cycles();
     if (s->bit_rate == 4800)
     {
         for (i = 0;  i < len;  i++)
@@ -974,6 +979,8 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx(v27ter_rx_state_t *s, const int16_t amp[], in
 #endif
         }
     }
+    s->stats.samples_in += len;
+    s->stats.cycles += span_stats_cycles() - start;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -985,6 +992,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx_fillin(v27ter_rx_state_t *s, int len)
     /* We want to sustain the current state (i.e carrier on<->carrier off), and
        try to sustain the carrier phase. We should probably push the filters, as well */
     span_log(&s->logging, SPAN_LOG_FLOW, "Fill-in %d samples\n", len);
+    s->stats.underflows++;
     if (s->signal_present <= 0)
         return 0;
     if (s->training_stage == TRAINING_STAGE_PARKED)
@@ -1033,6 +1041,13 @@ SPAN_DECLARE(logging_state_t *) v27ter_rx_get_logging_state(v27ter_rx_state_t *s
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) v27ter_rx_get_stats(v27ter_rx_state_t *s, span_stats_t *stats)
+{
+    *stats = s->stats;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) v27ter_rx_restart(v27ter_rx_state_t *s, int bit_rate, int old_train)
 {
     span_log(&s->logging, SPAN_LOG_FLOW, "Restarting V.27ter\n");
@@ -1097,6 +1112,7 @@ SPAN_DECLARE(int) v27ter_rx_restart(v27ter_rx_state_t *s, int bit_rate, int old_
     s->gardner_step = 512;
     s->baud_half = 0;
 
+    s->stats.retrains++;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1113,7 +1129,7 @@ SPAN_DECLARE(v27ter_rx_state_t *) v27ter_rx_init(v27ter_rx_state_t *s, int bit_r
     }
     if (s == NULL)
     {
-        if ((s = (v27ter_rx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v27ter_rx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -1136,7 +1152,7 @@ SPAN_DECLARE(int) v27ter_rx_release(v27ter_rx_state_t *s)
 
 SPAN_DECLARE(int) v27ter_rx_free(v27ter_rx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
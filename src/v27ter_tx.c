@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -422,7 +423,7 @@ SPAN_DECLARE(v27ter_tx_state_t *) v27ter_tx_init(v27ter_tx_state_t *s, int bit_r
     }
     if (s == NULL)
     {
-        if ((s = (v27ter_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v27ter_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -445,7 +446,7 @@ SPAN_DECLARE(int) v27ter_tx_release(v27ter_tx_state_t *s)
 
 SPAN_DECLARE(int) v27ter_tx_free(v27ter_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -42,6 +42,7 @@
 #include "floating_fudge.h"
 
 #include "spandsp/telephony.h"
+#include "spandsp/alloc.h"
 #include "spandsp/fast_convert.h"
 #include "spandsp/logging.h"
 #include "spandsp/complex.h"
@@ -379,7 +380,7 @@ SPAN_DECLARE(v29_tx_state_t *) v29_tx_init(v29_tx_state_t *s, int bit_rate, int
     }
     if (s == NULL)
     {
-        if ((s = (v29_tx_state_t *) malloc(sizeof(*s))) == NULL)
+        if ((s = (v29_tx_state_t *) span_alloc(sizeof(*s))) == NULL)
             return NULL;
     }
     memset(s, 0, sizeof(*s));
@@ -402,7 +403,7 @@ SPAN_DECLARE(int) v29_tx_release(v29_tx_state_t *s)
 
 SPAN_DECLARE(int) v29_tx_free(v29_tx_state_t *s)
 {
-    free(s);
+    span_free(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -0,0 +1,283 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * alloc_tests.c - Tests for the memory allocation routines.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page alloc_tests_page Memory allocation tests
+\section alloc_tests_page_sec_1 What does it do?
+These tests check that custom heap allocation routines installed with
+span_set_allocator() see every allocation and free made by the library, and
+that memory arenas behave correctly, including growing and moving allocations
+with span_realloc(), and failing cleanly when they are exhausted. A complete
+FAX call, with the FAX contexts and everything they allocate during the call
+drawn from one arena, is then run, and the heap is checked to be untouched.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define INPUT_FILE_NAME     "../test-data/itu/fax/itutests.tif"
+#define OUTPUT_FILE_NAME    "alloc_tests.tif"
+
+#define SAMPLES_PER_CHUNK   160
+
+static int heap_allocs = 0;
+static int heap_reallocs = 0;
+static int heap_frees = 0;
+
+static void *counting_alloc(size_t size)
+{
+    heap_allocs++;
+    return malloc(size);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *counting_realloc(void *ptr, size_t size)
+{
+    heap_reallocs++;
+    return realloc(ptr, size);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void counting_free(void *ptr)
+{
+    heap_frees++;
+    free(ptr);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void custom_allocator_tests(void)
+{
+    dtmf_rx_state_t *dtmf;
+    echo_can_state_t *ec;
+
+    printf("Testing custom heap allocation routines\n");
+    span_set_allocator(counting_alloc, counting_realloc, counting_free);
+    heap_allocs = 0;
+    heap_frees = 0;
+    if ((dtmf = dtmf_rx_init(NULL, NULL, NULL)) == NULL)
+    {
+        printf("Failed to create a DTMF receiver\n");
+        exit(2);
+    }
+    if ((ec = echo_can_init(256, 0)) == NULL)
+    {
+        printf("Failed to create an echo canceller\n");
+        exit(2);
+    }
+    dtmf_rx_free(dtmf);
+    echo_can_free(ec);
+    printf("%d allocations, %d frees\n", heap_allocs, heap_frees);
+    if (heap_allocs < 2  ||  heap_allocs != heap_frees)
+    {
+        printf("The custom allocator did not see every allocation and free\n");
+        exit(2);
+    }
+    span_set_allocator(NULL, NULL, NULL);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void arena_tests(void)
+{
+    span_arena_t *arena;
+    uint8_t buf[1000];
+    uint8_t *a;
+    uint8_t *b;
+    uint8_t *c;
+    size_t used;
+    int i;
+
+    printf("Testing memory arenas\n");
+    if ((arena = span_arena_init(NULL, buf, sizeof(buf))) == NULL)
+    {
+        printf("Failed to create an arena\n");
+        exit(2);
+    }
+    span_arena_select(arena);
+    a = (uint8_t *) span_alloc(100);
+    b = (uint8_t *) span_alloc(100);
+    if (a == NULL  ||  b == NULL  ||  a < buf  ||  b + 100 > buf + sizeof(buf)  ||  b < a + 100)
+    {
+        printf("Bad arena allocation\n");
+        exit(2);
+    }
+    for (i = 0;  i < 100;  i++)
+    {
+        a[i] = i;
+        b[i] = 100 + i;
+    }
+    /* The most recent allocation should grow in place */
+    used = span_arena_get_used(arena);
+    if ((c = (uint8_t *) span_realloc(b, 200)) != b  ||  span_arena_get_used(arena) <= used)
+    {
+        printf("The last allocation did not grow in place\n");
+        exit(2);
+    }
+    /* An earlier one should move, and keep its contents */
+    if ((c = (uint8_t *) span_realloc(a, 150)) == NULL  ||  c == a)
+    {
+        printf("An earlier allocation did not move\n");
+        exit(2);
+    }
+    for (i = 0;  i < 100;  i++)
+    {
+        if (c[i] != i  ||  b[i] != 100 + i)
+        {
+            printf("Arena contents damaged\n");
+            exit(2);
+        }
+    }
+    /* Freeing arena memory does nothing */
+    used = span_arena_get_used(arena);
+    span_free(c);
+    if (span_arena_get_used(arena) != used)
+    {
+        printf("Freeing changed the arena\n");
+        exit(2);
+    }
+    /* The arena must not be overrun */
+    if (span_alloc(sizeof(buf)) != NULL)
+    {
+        printf("Arena overrun not detected\n");
+        exit(2);
+    }
+    if (span_arena_select(NULL) != arena)
+    {
+        printf("Wrong arena selected\n");
+        exit(2);
+    }
+    /* With no arena selected, memory comes from the heap again */
+    a = (uint8_t *) span_alloc(100);
+    if (a >= buf  &&  a < buf + sizeof(buf))
+    {
+        printf("Heap allocation came from the arena\n");
+        exit(2);
+    }
+    span_free(a);
+    span_arena_reset(arena);
+    if (span_arena_get_used(arena) != 0)
+    {
+        printf("Arena not reset\n");
+        exit(2);
+    }
+    span_arena_free(arena);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void arena_call_tests(void)
+{
+    span_arena_t *arena;
+    fax_state_t *fax[2];
+    t30_state_t *t30;
+    int16_t amp[2][SAMPLES_PER_CHUNK];
+    int calls;
+    int i;
+    int j;
+    int len;
+
+    printf("Testing a FAX call drawn from one arena\n");
+    span_set_allocator(counting_alloc, counting_realloc, counting_free);
+    if ((arena = span_arena_init(NULL, NULL, 2000000)) == NULL)
+    {
+        printf("Failed to create an arena\n");
+        exit(2);
+    }
+    for (calls = 0;  calls < 2;  calls++)
+    {
+        heap_allocs = 0;
+        heap_reallocs = 0;
+        heap_frees = 0;
+        span_arena_select(arena);
+        for (i = 0;  i < 2;  i++)
+        {
+            if ((fax[i] = fax_init(NULL, (i == 0))) == NULL)
+            {
+                printf("Failed to create a FAX context\n");
+                exit(2);
+            }
+            t30 = fax_get_t30_state(fax[i]);
+            t30_set_ecm_capability(t30, TRUE);
+            t30_set_supported_compressions(t30, T30_SUPPORT_T4_1D_COMPRESSION | T30_SUPPORT_T4_2D_COMPRESSION | T30_SUPPORT_T6_COMPRESSION);
+            if (i == 0)
+                t30_set_tx_file(t30, INPUT_FILE_NAME, 0, 0);
+            else
+                t30_set_rx_file(t30, OUTPUT_FILE_NAME, -1);
+        }
+        for (j = 0;  j < 50*60;  j++)
+        {
+            for (i = 0;  i < 2;  i++)
+            {
+                len = fax_tx(fax[i], amp[i], SAMPLES_PER_CHUNK);
+                if (len < SAMPLES_PER_CHUNK)
+                    memset(amp[i] + len, 0, sizeof(int16_t)*(SAMPLES_PER_CHUNK - len));
+            }
+            fax_rx(fax[0], amp[1], SAMPLES_PER_CHUNK);
+            fax_rx(fax[1], amp[0], SAMPLES_PER_CHUNK);
+            if (!t30_call_active(fax_get_t30_state(fax[0]))  &&  !t30_call_active(fax_get_t30_state(fax[1])))
+                break;
+        }
+        printf("Call %d: %d blocks, %lu bytes of the arena used\n", calls, j, (unsigned long int) span_arena_get_used(arena));
+        for (i = 0;  i < 2;  i++)
+            fax_free(fax[i]);
+        span_arena_select(NULL);
+        /* Libtiff allocates for itself, but spandsp should not have touched the heap */
+        if (heap_allocs  ||  heap_reallocs  ||  heap_frees)
+        {
+            printf("The heap was used during the call - %d allocs, %d reallocs, %d frees\n", heap_allocs, heap_reallocs, heap_frees);
+            exit(2);
+        }
+        if (j >= 50*60)
+        {
+            printf("The call did not complete\n");
+            exit(2);
+        }
+        span_arena_reset(arena);
+    }
+    span_arena_free(arena);
+    span_set_allocator(NULL, NULL, NULL);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    custom_allocator_tests();
+    arena_tests();
+    arena_call_tests();
+    printf("Tests passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -28,7 +28,10 @@
 /*! \page crc_tests_page CRC tests
 \section crc_tests_page_sec_1 What does it do?
 The CRC tests exercise the ITU-16 and ITU-32 CRC module, and verifies
-correct operation.
+correct operation. Every CRC implementation the CPU supports is checked against
+a simple bit by bit calculation, for frames of every length up to a few hundred
+bytes, starting at every alignment. The speed of each implementation is then
+reported.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -38,11 +41,23 @@ correct operation.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "spandsp.h"
 
+#define SPEED_TEST_LEN      (1024*1024)
+
+static const char *implementation_names[] =
+{
+    "auto",
+    "byte-wise",
+    "slice by 8",
+    "PCLMUL"
+};
+
 int ref_len;
 uint8_t buf[1000];
+uint8_t speed_buf[SPEED_TEST_LEN];
 
 /* Use a local random generator, so the results are consistent across platforms. We have hard coded
    correct results for a message sequence generated by this particular PRNG. */
@@ -68,6 +83,139 @@ static int cook_up_msg(uint8_t *buf)
 }
 /*- End of function --------------------------------------------------------*/
 
+static uint32_t ref_crc_itu32(const uint8_t *buf, int len, uint32_t crc)
+{
+    int i;
+    int j;
+
+    for (i = 0;  i < len;  i++)
+    {
+        crc ^= buf[i];
+        for (j = 0;  j < 8;  j++)
+            crc = (crc & 1)  ?  ((crc >> 1) ^ 0xEDB88320)  :  (crc >> 1);
+    }
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint16_t ref_crc_itu16_bits(uint8_t buf, int len, uint16_t crc)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+    {
+        if (((buf ^ crc) & 1))
+            crc = (crc >> 1) ^ 0x8408;
+        else
+            crc = crc >> 1;
+        buf >>= 1;
+    }
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint16_t ref_crc_itu16(const uint8_t *buf, int len, uint16_t crc)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        crc = ref_crc_itu16_bits(buf[i], 8, crc);
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec*1000000 + tv.tv_usec;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int implementation_tests(int impl)
+{
+    uint32_t crc32;
+    uint16_t crc16;
+    int len;
+    int offset;
+    int i;
+
+    for (i = 0;  i < 1000;  i++)
+        buf[i] = my_rand();
+    /* Cover short frames, the lengths around the points where the faster
+       routines change gear, and all the alignments. */
+    for (len = 0;  len <= 300;  len++)
+    {
+        for (offset = 0;  offset < 16;  offset++)
+        {
+            crc32 = my_rand();
+            if (crc_itu32_calc(buf + offset, len, crc32) != ref_crc_itu32(buf + offset, len, crc32))
+            {
+                printf("CRC-32 failure with %s, length %d, offset %d\n", implementation_names[impl], len, offset);
+                return -1;
+            }
+            crc16 = my_rand();
+            if (crc_itu16_calc(buf + offset, len, crc16) != ref_crc_itu16(buf + offset, len, crc16))
+            {
+                printf("CRC-16 failure with %s, length %d, offset %d\n", implementation_names[impl], len, offset);
+                return -1;
+            }
+        }
+    }
+    for (len = 301;  len <= 1000 - 16;  len += 7)
+    {
+        if (crc_itu32_calc(buf, len, 0xFFFFFFFF) != ref_crc_itu32(buf, len, 0xFFFFFFFF)
+            ||
+            crc_itu16_calc(buf, len, 0xFFFF) != ref_crc_itu16(buf, len, 0xFFFF))
+        {
+            printf("CRC failure with %s, length %d\n", implementation_names[impl], len);
+            return -1;
+        }
+    }
+    printf("%s implementation OK\n", implementation_names[impl]);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void speed_tests(int impl)
+{
+    static const int frame_lens[] =
+    {
+        64, 256, 2048, SPEED_TEST_LEN, -1
+    };
+    uint64_t start;
+    uint64_t end;
+    uint32_t crc32;
+    uint16_t crc16;
+    int frames;
+    int len;
+    int i;
+    int j;
+
+    crc32 = 0;
+    crc16 = 0;
+    for (j = 0;  frame_lens[j] > 0;  j++)
+    {
+        len = frame_lens[j];
+        frames = SPEED_TEST_LEN/len;
+        start = now_us();
+        for (i = 0;  i < 64*frames;  i++)
+            crc32 ^= crc_itu32_calc(&speed_buf[(i%frames)*len], len, 0xFFFFFFFF);
+        end = now_us();
+        printf("%-10s CRC-32 %7d byte frames %7.2f GB/s\n", implementation_names[impl], len, (64.0*SPEED_TEST_LEN)/(1000.0*(end - start + 1)));
+        start = now_us();
+        for (i = 0;  i < 64*frames;  i++)
+            crc16 ^= crc_itu16_calc(&speed_buf[(i%frames)*len], len, 0xFFFF);
+        end = now_us();
+        printf("%-10s CRC-16 %7d byte frames %7.2f GB/s\n", implementation_names[impl], len, (64.0*SPEED_TEST_LEN)/(1000.0*(end - start + 1)));
+    }
+    /* Make sure the compiler cannot skip the work */
+    if (crc32 == 0x12345678  &&  crc16 == 0x1234)
+        printf("\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -112,6 +260,21 @@ int main(int argc, char *argv[])
     }
     printf("Test passed.\n\n");
     
+    printf("Testing the CRC-16 bit by bit routine for partial and overlong bytes\n");
+    for (i = 0;  i < 256;  i++)
+    {
+        for (j = 0;  j <= 16;  j++)
+        {
+            crc16a = my_rand();
+            if (crc_itu16_bits(i, j, crc16a) != ref_crc_itu16_bits(i, j, crc16a))
+            {
+                printf("CRC-16 failure\n");
+                exit(2);
+            }
+        }
+    }
+    printf("Test passed.\n\n");
+
     printf("Testing the CRC-32 routines\n");
     for (i = 0;  i < 100;  i++)
     {
@@ -123,7 +286,32 @@ int main(int argc, char *argv[])
             exit(2);
         }
     }
-    printf("Test passed.\n");
+    printf("Test passed.\n\n");
+
+    printf("Testing each CRC implementation against a bit by bit calculation\n");
+    printf("The preferred CRC implementation on this machine is %s\n", implementation_names[crc_get_implementation()]);
+    for (i = CRC_IMPLEMENTATION_BYTEWISE;  i <= CRC_IMPLEMENTATION_PCLMUL;  i++)
+    {
+        if (crc_set_implementation(i) != i)
+        {
+            printf("%s implementation not available\n", implementation_names[i]);
+            continue;
+        }
+        if (implementation_tests(i))
+            exit(2);
+    }
+    printf("Test passed.\n\n");
+
+    for (i = 0;  i < SPEED_TEST_LEN;  i++)
+        speed_buf[i] = my_rand();
+    for (i = CRC_IMPLEMENTATION_BYTEWISE;  i <= CRC_IMPLEMENTATION_PCLMUL;  i++)
+    {
+        if (crc_set_implementation(i) != i)
+            continue;
+        speed_tests(i);
+    }
+    crc_set_implementation(CRC_IMPLEMENTATION_AUTO);
+    printf("Tests passed.\n");
     return  0;
 }
 /*- End of function --------------------------------------------------------*/
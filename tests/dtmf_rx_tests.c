@@ -824,6 +824,214 @@ static void callback_function_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+#define BANK_TEST_SAMPLES           40000
+#define BANK_TEST_MAX_EVENTS        200
+
+typedef struct
+{
+    int events;
+    int signal[BANK_TEST_MAX_EVENTS];
+    int level[BANK_TEST_MAX_EVENTS];
+    int delay[BANK_TEST_MAX_EVENTS];
+    char digits[128 + 1];
+    int digit_count;
+} bank_channel_log_t;
+
+static int16_t bank_amp[DTMF_RX_BANK_MAX_CHANNELS][BANK_TEST_SAMPLES];
+static int16_t bank_interleaved[DTMF_RX_BANK_MAX_CHANNELS*BANK_TEST_SAMPLES];
+static bank_channel_log_t bank_ref_log[DTMF_RX_BANK_MAX_CHANNELS];
+static bank_channel_log_t bank_log[DTMF_RX_BANK_MAX_CHANNELS];
+
+static void bank_digit_delivery(void *data, const char *digits, int len)
+{
+    bank_channel_log_t *log;
+
+    log = (bank_channel_log_t *) data;
+    if (log->digit_count + len > 128)
+        len = 128 - log->digit_count;
+    memcpy(log->digits + log->digit_count, digits, len);
+    log->digit_count += len;
+    log->digits[log->digit_count] = '\0';
+}
+/*- End of function --------------------------------------------------------*/
+
+static void bank_digit_status(void *data, int signal, int level, int delay)
+{
+    bank_channel_log_t *log;
+
+    log = (bank_channel_log_t *) data;
+    if (log->events < BANK_TEST_MAX_EVENTS)
+    {
+        log->signal[log->events] = signal;
+        log->level[log->events] = level;
+        log->delay[log->events] = delay;
+    }
+    log->events++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int bank_test_signals(int channels)
+{
+    awgn_state_t noise_source;
+    tone_gen_descriptor_t dial_tone_desc;
+    tone_gen_state_t dial_tone;
+    char digits[20 + 1];
+    int ch;
+    int i;
+    int len;
+    int samples;
+
+    samples = BANK_TEST_SAMPLES;
+    for (ch = 0;  ch < channels;  ch++)
+    {
+        /* Give each channel its own digits, level and noise, and put dial tone on
+           some of them, so the channels' decisions differ from block to block. */
+        for (i = 0;  i < 20;  i++)
+            digits[i] = ALL_POSSIBLE_DIGITS[rand() & 0xF];
+        digits[20] = '\0';
+        my_dtmf_gen_init(0.0f, -5 - 2*(ch%10), 0.0f, -6 - 2*(ch%10), 40 + ch, 50 + 2*ch);
+        len = my_dtmf_generate(bank_amp[ch], digits);
+        memset(&bank_amp[ch][len], 0, sizeof(int16_t)*(samples - len));
+        awgn_init_dbm0(&noise_source, 1234567 + ch, -30.0f - ch);
+        for (i = 0;  i < samples;  i++)
+            bank_amp[ch][i] = saturate(bank_amp[ch][i] + awgn(&noise_source));
+        if (ch%3 == 2)
+        {
+            tone_gen_descriptor_init(&dial_tone_desc, 350, -20, 440, -20, 1, 0, 0, 0, TRUE);
+            tone_gen_init(&dial_tone, &dial_tone_desc);
+            tone_gen(&dial_tone, amp2, samples);
+            for (i = 0;  i < samples;  i++)
+                bank_amp[ch][i] = saturate(bank_amp[ch][i] + amp2[i]);
+        }
+        for (i = 0;  i < samples;  i++)
+            bank_interleaved[i*channels + ch] = bank_amp[ch][i];
+    }
+    return samples;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void bank_setup_channel(dtmf_rx_state_t *s, int ch, bank_channel_log_t *log)
+{
+    /* Half the channels report through the realtime callback, and half deliver digits */
+    if (ch & 1)
+        dtmf_rx_set_realtime_callback(s, bank_digit_status, log);
+    if (ch%3 == 2)
+        dtmf_rx_parms(s, TRUE, -1, -1, -99);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void bank_tests(void)
+{
+    static const int channel_counts[] =
+    {
+        1, 4, 5, 8, 13, 16, -1
+    };
+    dtmf_rx_state_t *ref[DTMF_RX_BANK_MAX_CHANNELS];
+    dtmf_rx_bank_t *bank;
+    void *user_data[DTMF_RX_BANK_MAX_CHANNELS];
+    const int16_t *chan_amp[DTMF_RX_BANK_MAX_CHANNELS];
+    uint64_t start;
+    uint64_t ref_cycles;
+    uint64_t bank_cycles;
+    int interleaved;
+    int channels;
+    int samples;
+    int chunk;
+    int sample;
+    int ch;
+    int j;
+
+    printf("Test: Multi-channel receiver bank.\n");
+    for (j = 0;  channel_counts[j] > 0;  j++)
+    {
+        channels = channel_counts[j];
+        samples = bank_test_signals(channels);
+        for (interleaved = 0;  interleaved < 2;  interleaved++)
+        {
+            memset(bank_ref_log, 0, sizeof(bank_ref_log));
+            memset(bank_log, 0, sizeof(bank_log));
+            for (ch = 0;  ch < channels;  ch++)
+            {
+                ref[ch] = dtmf_rx_init(NULL, bank_digit_delivery, &bank_ref_log[ch]);
+                bank_setup_channel(ref[ch], ch, &bank_ref_log[ch]);
+                user_data[ch] = &bank_log[ch];
+            }
+            bank = dtmf_rx_bank_init(NULL, channels, bank_digit_delivery, user_data);
+            for (ch = 0;  ch < channels;  ch++)
+                bank_setup_channel(dtmf_rx_bank_get_channel(bank, ch), ch, &bank_log[ch]);
+
+            /* Use a chunk size which does not fit the receiver's block length */
+            chunk = (interleaved)  ?  SAMPLES_PER_CHUNK  :  37;
+            ref_cycles = 0;
+            bank_cycles = 0;
+            for (sample = 0;  sample < samples;  sample += chunk)
+            {
+                if (chunk > samples - sample)
+                    chunk = samples - sample;
+                start = rdtscll();
+                for (ch = 0;  ch < channels;  ch++)
+                    dtmf_rx(ref[ch], &bank_amp[ch][sample], chunk);
+                ref_cycles += rdtscll() - start;
+                start = rdtscll();
+                if (interleaved)
+                {
+                    dtmf_rx_bank_interleaved(bank, &bank_interleaved[sample*channels], chunk);
+                }
+                else
+                {
+                    for (ch = 0;  ch < channels;  ch++)
+                        chan_amp[ch] = &bank_amp[ch][sample];
+                    dtmf_rx_bank(bank, chan_amp, chunk);
+                }
+                bank_cycles += rdtscll() - start;
+            }
+            for (ch = 0;  ch < channels;  ch++)
+            {
+                if ((bank_log[ch].digit_count == 0  &&  bank_log[ch].events == 0)
+                    ||
+                    strcmp(bank_log[ch].digits, bank_ref_log[ch].digits)
+                    ||
+                    bank_log[ch].events != bank_ref_log[ch].events
+                    ||
+                    memcmp(bank_log[ch].signal, bank_ref_log[ch].signal, sizeof(bank_log[ch].signal))
+                    ||
+                    memcmp(bank_log[ch].level, bank_ref_log[ch].level, sizeof(bank_log[ch].level))
+                    ||
+                    memcmp(bank_log[ch].delay, bank_ref_log[ch].delay, sizeof(bank_log[ch].delay))
+                    ||
+                    dtmf_rx_status(dtmf_rx_bank_get_channel(bank, ch)) != dtmf_rx_status(ref[ch]))
+                {
+                    printf("    Channel %d of %d differs - '%s' (%d events) vs '%s' (%d events)\n",
+                           ch,
+                           channels,
+                           bank_log[ch].digits,
+                           bank_log[ch].events,
+                           bank_ref_log[ch].digits,
+                           bank_ref_log[ch].events);
+                    printf("    Failed\n");
+                    exit(2);
+                }
+            }
+            printf("    %2d channels, %s: %6.1f cycles/channel/sample vs %6.1f separately\n",
+                   channels,
+                   (interleaved)  ?  "interleaved"  :  "separate buffers",
+                   (double) bank_cycles/(channels*samples),
+                   (double) ref_cycles/(channels*samples));
+            for (ch = 0;  ch < channels;  ch++)
+                dtmf_rx_free(ref[ch]);
+            dtmf_rx_bank_free(bank);
+        }
+    }
+    if (dtmf_rx_bank_init(NULL, DTMF_RX_BANK_MAX_CHANNELS + 1, NULL, NULL))
+    {
+        printf("    Bank with too many channels accepted\n");
+        printf("    Failed\n");
+        exit(2);
+    }
+    printf("    Passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 static void decode_test(const char *test_file)
 {
     int16_t amp[SAMPLES_PER_CHUNK];
@@ -915,6 +1123,7 @@ int main(int argc, char *argv[])
         dial_tone_tolerance_tests();
         callback_function_tests();
         printf("    Passed\n");
+        bank_tests();
         duration = time(NULL) - now;
         printf("Tests passed in %ds\n", duration);
     }
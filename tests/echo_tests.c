@@ -32,6 +32,16 @@
 The echo cancellation tests test the echo cancellor against the G.168 spec. Not
 all the tests in G.168 are fully implemented at this time.
 
+The "block" test checks that the block processing function, using the SIMD FIR
+and LMS routines, produces exactly the same output as the sample by sample
+function using plain C, for each of the G.168 line models.
+
+The "long" test compares the time domain canceller with the frequency domain
+canceller, selected by ECHO_CAN_USE_FREQ_DOMAIN, for tails of 128ms, 256ms and
+512ms. It reports the cost per sample and the echo return loss enhancement each
+achieves after convergence, and fails if the frequency domain canceller does
+not achieve at least 20dB.
+
 \section echo_can_tests_page_sec_2 How does it work?
 
 \section echo_can_tests_page_sec_2 How do I use it?
@@ -74,6 +84,14 @@ all the tests in G.168 are fully implemented at this time.
 
 #define TEST_EC_TAPS            256
 
+/* The block processing test uses a 128ms tail */
+#define BLOCK_TEST_EC_TAPS      1024
+#define BLOCK_TEST_SAMPLES      (10*SAMPLE_RATE)
+
+/* The long tail test compares the time and frequency domain cancellers */
+#define LONG_TAIL_TEST_SAMPLES  (20*SAMPLE_RATE)
+#define LONG_TAIL_MIN_ERLE      20.0f
+
 #define RESIDUE_FILE_NAME       "residue_sound.wav"
 
 /*
@@ -1417,6 +1435,200 @@ static int perform_test_15(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int perform_test_block(void)
+{
+    static int16_t tx[BLOCK_TEST_SAMPLES];
+    static int16_t rx[BLOCK_TEST_SAMPLES];
+    static int16_t clean1[BLOCK_TEST_SAMPLES];
+    static int16_t clean2[BLOCK_TEST_SAMPLES];
+    echo_can_state_t *ctx1;
+    echo_can_state_t *ctx2;
+    tone_gen_descriptor_t tone_desc;
+    tone_gen_state_t tone_state;
+    uint64_t start;
+    uint64_t sample_cycles;
+    uint64_t block_cycles;
+    int model;
+    int best;
+    int len;
+    int i;
+    int j;
+
+    /* Check the block processing path against the sample by sample path, using
+       each of the G.168 line models. The sample by sample path is forced to use
+       plain C, and the block path uses the best SIMD routines this machine has, so
+       the results can only match if the SIMD FIR and LMS routines are bit exact. */
+    print_test_title("Performing block processing test - block and sample by sample results must match\n");
+    best = fir_get_implementation();
+    for (model = 1;  model <= 8;  model++)
+    {
+        if (channel_model_create(&chan_model, model, erl, munger))
+        {
+            fprintf(stderr, "    Failed to create line model\n");
+            exit(2);
+        }
+        /* Converge on speech, with bursts of far end speech to exercise the double
+           talk handling, then send tones to exercise the narrowband detection. */
+        signal_restart(&local_css, 0.0f);
+        signal_restart(&far_css, -6.0f);
+        tone_gen_descriptor_init(&tone_desc, 697, -11, 1209, -9, 1, 0, 0, 0, 1);
+        tone_gen_init(&tone_state, &tone_desc);
+        for (i = 0;  i < BLOCK_TEST_SAMPLES;  i++)
+        {
+            if (i < 8*SAMPLE_RATE)
+            {
+                tx[i] = local_css_signal();
+                rx[i] = channel_model(&chan_model, tx[i], ((i/SAMPLE_RATE)%4 == 3)  ?  far_css_signal()  :  0);
+            }
+            else
+            {
+                tone_gen(&tone_state, &tx[i], 1);
+                rx[i] = channel_model(&chan_model, tx[i], 0);
+            }
+        }
+
+        ctx1 = echo_can_init(BLOCK_TEST_EC_TAPS, ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_NLP);
+        ctx2 = echo_can_init(BLOCK_TEST_EC_TAPS, ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_NLP);
+
+        fir_set_implementation(FIR_IMPLEMENTATION_GENERIC);
+        start = rdtscll();
+        for (i = 0;  i < BLOCK_TEST_SAMPLES;  i++)
+            clean1[i] = echo_can_update(ctx1, tx[i], rx[i]);
+        sample_cycles = rdtscll() - start;
+
+        fir_set_implementation(best);
+        start = rdtscll();
+        /* Use a mixture of block lengths */
+        for (i = 0, j = 0;  i < BLOCK_TEST_SAMPLES;  i += len, j++)
+        {
+            len = (j & 1)  ?  160  :  37;
+            if (len > BLOCK_TEST_SAMPLES - i)
+                len = BLOCK_TEST_SAMPLES - i;
+            echo_can_update_block(ctx2, &tx[i], &rx[i], &clean2[i], len);
+        }
+        block_cycles = rdtscll() - start;
+
+        for (i = 0;  i < BLOCK_TEST_SAMPLES;  i++)
+        {
+            if (clean1[i] != clean2[i])
+            {
+                printf("Line model %d: sample %d is %d, but should be %d\n", model, i, clean2[i], clean1[i]);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+        for (i = 0;  i < BLOCK_TEST_EC_TAPS;  i++)
+        {
+            if (ctx1->fir_taps32[i] != ctx2->fir_taps32[i])
+            {
+                printf("Line model %d: tap %d is %d, but should be %d\n", model, i, ctx2->fir_taps32[i], ctx1->fir_taps32[i]);
+                printf("Test failed\n");
+                exit(2);
+            }
+        }
+        printf("Line model %d: %.1f cycles/sample by sample, %.1f cycles/sample by block\n",
+               model,
+               (double) sample_cycles/BLOCK_TEST_SAMPLES,
+               (double) block_cycles/BLOCK_TEST_SAMPLES);
+        echo_can_free(ctx1);
+        echo_can_free(ctx2);
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int perform_test_long_tail(void)
+{
+    static const int tails[] =
+    {
+        128, 256, 512, -1
+    };
+    static const int modes[] =
+    {
+        ECHO_CAN_USE_ADAPTION,
+        ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_FREQ_DOMAIN
+    };
+    static int16_t tx[LONG_TAIL_TEST_SAMPLES];
+    static int16_t rx[LONG_TAIL_TEST_SAMPLES];
+    echo_can_state_t *ctx;
+    uint64_t start;
+    uint64_t cycles;
+    double rx_power;
+    double clean_power;
+    float erle;
+    int16_t clean;
+    int latency;
+    int delay;
+    int model;
+    int tail;
+    int mode;
+    int i;
+    int j;
+
+    /* Compare the time domain and frequency domain cancellers, for tail lengths
+       which need the frequency domain canceller. The G.168 echo models are short,
+       so they are preceded by a bulk delay which puts most of the echo near the
+       far end of the tail. */
+    print_test_title("Performing long tail test - time domain and frequency domain cancellers\n");
+    printf("Tail   Model  Mode  Cycles/sample  ERLE (dB)\n");
+    for (j = 0;  tails[j] > 0;  j++)
+    {
+        tail = tails[j]*SAMPLE_RATE/1000;
+        delay = tail - 256;
+        for (model = 1;  model <= 8;  model++)
+        {
+            if (channel_model_create(&chan_model, model, erl, munger))
+            {
+                fprintf(stderr, "    Failed to create line model\n");
+                exit(2);
+            }
+            signal_restart(&local_css, 0.0f);
+            for (i = 0;  i < LONG_TAIL_TEST_SAMPLES;  i++)
+            {
+                tx[i] = local_css_signal();
+                rx[i] = channel_model(&chan_model, (i >= delay)  ?  tx[i - delay]  :  0, 0);
+            }
+            for (mode = 0;  mode < 2;  mode++)
+            {
+                ctx = echo_can_init(tail, modes[mode]);
+                latency = (modes[mode] & ECHO_CAN_USE_FREQ_DOMAIN)  ?  ECHO_CAN_FDAF_BLOCK_LEN  :  0;
+                rx_power = 0.0;
+                clean_power = 0.0;
+                cycles = 0;
+                for (i = 0;  i < LONG_TAIL_TEST_SAMPLES;  i++)
+                {
+                    start = rdtscll();
+                    clean = echo_can_update(ctx, tx[i], rx[i]);
+                    cycles += rdtscll() - start;
+                    /* Measure the echo return loss enhancement over the last 2s */
+                    if (i >= LONG_TAIL_TEST_SAMPLES - 2*SAMPLE_RATE)
+                    {
+                        rx_power += (double) rx[i - latency]*rx[i - latency];
+                        clean_power += (double) clean*clean;
+                    }
+                }
+                erle = 10.0f*log10f((rx_power + 1.0)/(clean_power + 1.0));
+                printf("%4dms  %5d  %s  %13.1f  %9.2f\n",
+                       tails[j],
+                       model,
+                       (modes[mode] & ECHO_CAN_USE_FREQ_DOMAIN)  ?  "FDAF"  :  "NLMS",
+                       (double) cycles/LONG_TAIL_TEST_SAMPLES,
+                       erle);
+                if ((modes[mode] & ECHO_CAN_USE_FREQ_DOMAIN)  &&  erle < LONG_TAIL_MIN_ERLE)
+                {
+                    printf("Test failed\n");
+                    exit(2);
+                }
+                echo_can_free(ctx);
+            }
+        }
+    }
+    printf("Test passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int match_test_name(const char *name)
 {
     const struct
@@ -1447,6 +1659,8 @@ static int match_test_name(const char *name)
         {"13", perform_test_13},
         {"14", perform_test_14},
         {"15", perform_test_15},
+        {"block", perform_test_block},
+        {"long", perform_test_long_tail},
         {NULL, NULL}
     };
     int i;
@@ -0,0 +1,255 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * fir_tests.c - Tests for the FIR filter routines.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page fir_tests_page FIR filter tests
+\section fir_tests_page_sec_1 What does it do?
+These tests check the 16 bit, 32 bit and floating point FIR filters against a
+simple direct convolution, for a range of filter lengths which do and do not
+fill whole SIMD registers. Each test is repeated for every dot product
+implementation this CPU supports, using both the per-sample and the block
+functions. The speed of each implementation is then measured for a 1024 tap
+filter, the size used by the line echo canceller.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define MAX_TAPS            1024
+#define TEST_SAMPLES        4000
+#define SPEED_TEST_SAMPLES  8000
+
+static const char *implementation_names[] =
+{
+    "auto",
+    "generic",
+    "AVX2",
+    "AVX-512"
+};
+
+static int16_t coeffs16[MAX_TAPS];
+static int32_t coeffs32[MAX_TAPS];
+static float coeffs_float[MAX_TAPS];
+static int16_t in[TEST_SAMPLES];
+static int16_t out[TEST_SAMPLES];
+static int16_t expected[TEST_SAMPLES];
+
+static void make_coeffs(int taps)
+{
+    int i;
+
+    /* Keep the gain modest, so the outputs stay in range */
+    for (i = 0;  i < taps;  i++)
+    {
+        coeffs16[i] = (int16_t) ((rand() & 0x7FFF) - 0x4000)/((taps + 3)/4);
+        coeffs32[i] = coeffs16[i];
+        coeffs_float[i] = coeffs16[i]/32768.0f;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void reference_fir(int taps, int float_mode)
+{
+    int i;
+    int j;
+    int32_t y;
+    float yf;
+
+    for (i = 0;  i < TEST_SAMPLES;  i++)
+    {
+        y = 0;
+        yf = 0.0f;
+        for (j = 0;  j < taps  &&  j <= i;  j++)
+        {
+            y += coeffs16[j]*in[i - j];
+            yf += coeffs_float[j]*in[i - j];
+        }
+        expected[i] = (float_mode)  ?  (int16_t) yf  :  (int16_t) (y >> 15);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int check(const char *tag, int taps, int tolerance)
+{
+    int i;
+
+    for (i = 0;  i < TEST_SAMPLES;  i++)
+    {
+        if (abs(out[i] - expected[i]) > tolerance)
+        {
+            printf("%s, %d taps: sample %d is %d, but should be %d\n", tag, taps, i, out[i], expected[i]);
+            printf("Tests failed\n");
+            exit(2);
+        }
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void test_implementation(int impl)
+{
+    static const int tap_counts[] =
+    {
+        1, 3, 8, 15, 16, 17, 31, 32, 33, 63, 64, 100, 128, 255, 256, 1024, -1
+    };
+    fir16_state_t fir16_state;
+    fir32_state_t fir32_state;
+    fir_float_state_t fir_float_state;
+    int taps;
+    int i;
+    int j;
+
+    for (j = 0;  tap_counts[j] > 0;  j++)
+    {
+        taps = tap_counts[j];
+        make_coeffs(taps);
+
+        reference_fir(taps, FALSE);
+        fir16_create(&fir16_state, coeffs16, taps);
+        for (i = 0;  i < TEST_SAMPLES;  i++)
+            out[i] = fir16(&fir16_state, in[i]);
+        check("fir16", taps, 0);
+        fir16_flush(&fir16_state);
+        /* Use odd block lengths, so the blocks start at varying points in the history */
+        for (i = 0;  i < TEST_SAMPLES;  i += 37)
+            fir16_block(&fir16_state, &out[i], &in[i], (TEST_SAMPLES - i < 37)  ?  (TEST_SAMPLES - i)  :  37);
+        check("fir16_block", taps, 0);
+        fir16_free(&fir16_state);
+
+        fir32_create(&fir32_state, coeffs32, taps);
+        for (i = 0;  i < TEST_SAMPLES;  i++)
+            out[i] = fir32(&fir32_state, in[i]);
+        check("fir32", taps, 0);
+        fir32_flush(&fir32_state);
+        memcpy(out, in, sizeof(out));
+        /* Filter in place */
+        fir32_block(&fir32_state, out, out, TEST_SAMPLES);
+        check("fir32_block", taps, 0);
+        fir32_free(&fir32_state);
+
+        /* The order of the floating point additions differs between implementations,
+           so allow the truncated result to be out by one. */
+        reference_fir(taps, TRUE);
+        fir_float_create(&fir_float_state, coeffs_float, taps);
+        for (i = 0;  i < TEST_SAMPLES;  i++)
+            out[i] = fir_float(&fir_float_state, in[i]);
+        check("fir_float", taps, 1);
+        fir_float_free(&fir_float_state);
+        fir_float_create(&fir_float_state, coeffs_float, taps);
+        fir_float_block(&fir_float_state, out, in, TEST_SAMPLES);
+        check("fir_float_block", taps, 1);
+        fir_float_free(&fir_float_state);
+    }
+    printf("%s implementation OK\n", implementation_names[impl]);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void speed_test(int impl)
+{
+    fir16_state_t fir16_state;
+    fir32_state_t fir32_state;
+    fir_float_state_t fir_float_state;
+    int16_t buf[SPEED_TEST_SAMPLES];
+    uint64_t start;
+    uint64_t end;
+    int i;
+
+    for (i = 0;  i < SPEED_TEST_SAMPLES;  i++)
+        buf[i] = in[i%TEST_SAMPLES];
+    make_coeffs(MAX_TAPS);
+
+    fir16_create(&fir16_state, coeffs16, MAX_TAPS);
+    start = rdtscll();
+    for (i = 0;  i < SPEED_TEST_SAMPLES;  i++)
+        buf[i] = fir16(&fir16_state, buf[i]);
+    end = rdtscll();
+    printf("%-8s fir16            %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/SPEED_TEST_SAMPLES);
+    start = rdtscll();
+    fir16_block(&fir16_state, buf, buf, SPEED_TEST_SAMPLES);
+    end = rdtscll();
+    printf("%-8s fir16_block      %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/SPEED_TEST_SAMPLES);
+    fir16_free(&fir16_state);
+
+    fir32_create(&fir32_state, coeffs32, MAX_TAPS);
+    start = rdtscll();
+    fir32_block(&fir32_state, buf, buf, SPEED_TEST_SAMPLES);
+    end = rdtscll();
+    printf("%-8s fir32_block      %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/SPEED_TEST_SAMPLES);
+    fir32_free(&fir32_state);
+
+    fir_float_create(&fir_float_state, coeffs_float, MAX_TAPS);
+    start = rdtscll();
+    fir_float_block(&fir_float_state, buf, buf, SPEED_TEST_SAMPLES);
+    end = rdtscll();
+    printf("%-8s fir_float_block  %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/SPEED_TEST_SAMPLES);
+    fir_float_free(&fir_float_state);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int best;
+    int impl;
+    int i;
+
+    best = fir_get_implementation();
+    printf("The preferred FIR implementation on this machine is %s\n", implementation_names[best]);
+    srand(1234567);
+    for (i = 0;  i < TEST_SAMPLES;  i++)
+        in[i] = (rand() & 0xFFFF) - 0x8000;
+
+    for (impl = FIR_IMPLEMENTATION_GENERIC;  impl <= FIR_IMPLEMENTATION_AVX512;  impl++)
+    {
+        if (fir_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        test_implementation(impl);
+    }
+    for (impl = FIR_IMPLEMENTATION_GENERIC;  impl <= FIR_IMPLEMENTATION_AVX512;  impl++)
+    {
+        if (fir_set_implementation(impl) != impl)
+            continue;
+        speed_test(impl);
+    }
+    fir_set_implementation(FIR_IMPLEMENTATION_AUTO);
+    printf("Tests passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
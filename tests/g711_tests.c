@@ -60,6 +60,227 @@ uint8_t alaw_data[65536];
 const uint8_t alaw_1khz_sine[] = {0x34, 0x21, 0x21, 0x34, 0xB4, 0xA1, 0xA1, 0xB4};
 const uint8_t ulaw_1khz_sine[] = {0x1E, 0x0B, 0x0B, 0x1E, 0x9E, 0x8B, 0x8B, 0x9E};
 
+#define MULTI_CHANNELS      8
+#define SPEED_TEST_SAMPLES  (8*65536)
+
+static const char *implementation_names[] =
+{
+    "auto",
+    "generic",
+    "table",
+    "SSE4.1",
+    "AVX2"
+};
+
+static void implementation_check(int impl)
+{
+    g711_state_t *states[MULTI_CHANNELS];
+    int16_t *amps[MULTI_CHANNELS];
+    uint8_t *codes[MULTI_CHANNELS];
+    int16_t lin[256 + 64];
+    uint8_t codes_in[256 + 64];
+    int i;
+    int j;
+    int ch;
+    int law;
+    int offset;
+    int len;
+
+    /* Encode every possible linear value, and decode every possible code. Use a
+       range of start offsets and lengths, so the unaligned cases, and the tails
+       after the vector loops, are all covered. */
+    for (law = G711_ALAW;  law <= G711_ULAW;  law++)
+    {
+        states[0] = g711_init(NULL, law);
+        for (offset = 0;  offset < 33;  offset++)
+        {
+            len = 65536 - offset - (offset & 7);
+            for (i = 0;  i < 65536;  i++)
+                amp[i] = (int16_t) (i - 32768);
+            memset(alaw_data, 0, sizeof(alaw_data));
+            if (g711_encode(states[0], alaw_data, &amp[offset], len) != len)
+            {
+                printf("%s encode gave the wrong length\n", implementation_names[impl]);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+            for (i = 0;  i < len;  i++)
+            {
+                j = (law == G711_ALAW)  ?  linear_to_alaw(amp[offset + i])  :  linear_to_ulaw(amp[offset + i]);
+                if (alaw_data[i] != j)
+                {
+                    printf("%s %s encode mismatch at %d -> 0x%02X\n",
+                           implementation_names[impl],
+                           (law == G711_ALAW)  ?  "A-law"  :  "u-law",
+                           amp[offset + i],
+                           alaw_data[i]);
+                    printf("Tests failed.\n");
+                    exit(2);
+                }
+            }
+            if (len < 65536  &&  alaw_data[len] != 0)
+            {
+                printf("%s encode overran its buffer\n", implementation_names[impl]);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+
+            for (i = 0;  i < 256 + 64;  i++)
+                codes_in[i] = (uint8_t) (i*7 + offset);
+            len = 256 + offset;
+            memset(lin, 0, sizeof(lin));
+            if (g711_decode(states[0], lin, &codes_in[offset], len) != len)
+            {
+                printf("%s decode gave the wrong length\n", implementation_names[impl]);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+            for (i = 0;  i < len;  i++)
+            {
+                j = (law == G711_ALAW)  ?  alaw_to_linear(codes_in[offset + i])  :  ulaw_to_linear(codes_in[offset + i]);
+                if (lin[i] != j)
+                {
+                    printf("%s %s decode mismatch at 0x%02X -> %d\n",
+                           implementation_names[impl],
+                           (law == G711_ALAW)  ?  "A-law"  :  "u-law",
+                           codes_in[offset + i],
+                           lin[i]);
+                    printf("Tests failed.\n");
+                    exit(2);
+                }
+            }
+        }
+        g711_free(states[0]);
+    }
+
+    /* Run a batch of mixed A-law and u-law channels, and check each matches the
+       single sample routines. */
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+    {
+        states[ch] = g711_init(NULL, (ch & 1)  ?  G711_ULAW  :  G711_ALAW);
+        amps[ch] = &amp[ch*BLOCK_LEN];
+        codes[ch] = &ulaw_data[ch*BLOCK_LEN];
+        for (i = 0;  i < BLOCK_LEN;  i++)
+            amps[ch][i] = (int16_t) ((rand() & 0xFFFF) >> (ch & 7));
+    }
+    if (g711_encode_multi(states, codes, (const int16_t **) amps, MULTI_CHANNELS, BLOCK_LEN) != BLOCK_LEN)
+    {
+        printf("%s multi-channel encode gave the wrong length\n", implementation_names[impl]);
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+    {
+        for (i = 0;  i < BLOCK_LEN;  i++)
+        {
+            j = (ch & 1)  ?  linear_to_ulaw(amps[ch][i])  :  linear_to_alaw(amps[ch][i]);
+            if (codes[ch][i] != j)
+            {
+                printf("%s multi-channel encode mismatch on channel %d\n", implementation_names[impl], ch);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+        }
+    }
+    if (g711_decode_multi(states, amps, (const uint8_t **) codes, MULTI_CHANNELS, BLOCK_LEN) != BLOCK_LEN)
+    {
+        printf("%s multi-channel decode gave the wrong length\n", implementation_names[impl]);
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+    {
+        for (i = 0;  i < BLOCK_LEN;  i++)
+        {
+            j = (ch & 1)  ?  ulaw_to_linear(codes[ch][i])  :  alaw_to_linear(codes[ch][i]);
+            if (amps[ch][i] != j)
+            {
+                printf("%s multi-channel decode mismatch on channel %d\n", implementation_names[impl], ch);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+        }
+    }
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+        amps[ch] = (int16_t *) &alaw_data[ch*BLOCK_LEN];
+    g711_transcode_multi(states, (uint8_t **) amps, (const uint8_t **) codes, MULTI_CHANNELS, BLOCK_LEN);
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+    {
+        for (i = 0;  i < BLOCK_LEN;  i++)
+        {
+            j = (ch & 1)  ?  ulaw_to_alaw(codes[ch][i])  :  alaw_to_ulaw(codes[ch][i]);
+            if (alaw_data[ch*BLOCK_LEN + i] != j)
+            {
+                printf("%s multi-channel transcode mismatch on channel %d\n", implementation_names[impl], ch);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+        }
+    }
+    for (ch = 0;  ch < MULTI_CHANNELS;  ch++)
+        g711_free(states[ch]);
+    printf("%s implementation OK\n", implementation_names[impl]);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void speed_test(int impl)
+{
+    static int16_t buf[SPEED_TEST_SAMPLES];
+    static uint8_t codes[SPEED_TEST_SAMPLES];
+    g711_state_t *state;
+    uint64_t start;
+    uint64_t end;
+    int law;
+    int i;
+
+    for (i = 0;  i < SPEED_TEST_SAMPLES;  i++)
+        buf[i] = (int16_t) ((rand() & 0xFFFF) >> (i & 7));
+    for (law = G711_ALAW;  law <= G711_ULAW;  law++)
+    {
+        state = g711_init(NULL, law);
+        start = rdtscll();
+        g711_encode(state, codes, buf, SPEED_TEST_SAMPLES);
+        end = rdtscll();
+        printf("%-8s %s encode %8.2f cycles/sample\n",
+               implementation_names[impl],
+               (law == G711_ALAW)  ?  "A-law"  :  "u-law",
+               (double) (end - start)/SPEED_TEST_SAMPLES);
+        start = rdtscll();
+        g711_decode(state, buf, codes, SPEED_TEST_SAMPLES);
+        end = rdtscll();
+        printf("%-8s %s decode %8.2f cycles/sample\n",
+               implementation_names[impl],
+               (law == G711_ALAW)  ?  "A-law"  :  "u-law",
+               (double) (end - start)/SPEED_TEST_SAMPLES);
+        g711_free(state);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void implementation_tests(void)
+{
+    int impl;
+
+    printf("The preferred G.711 implementation on this machine is %s\n", implementation_names[g711_get_implementation()]);
+    for (impl = G711_IMPLEMENTATION_GENERIC;  impl <= G711_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (g711_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        implementation_check(impl);
+    }
+    for (impl = G711_IMPLEMENTATION_GENERIC;  impl <= G711_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (g711_set_implementation(impl) != impl)
+            continue;
+        speed_test(impl);
+    }
+    g711_set_implementation(G711_IMPLEMENTATION_AUTO);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void compliance_tests(int log_audio)
 {
     SNDFILE *outhandle;
@@ -396,6 +617,7 @@ int main(int argc, char *argv[])
 
     if (basic_tests)
     {
+        implementation_tests();
         compliance_tests(TRUE);
     }
     else
@@ -151,6 +151,22 @@ uint16_t itu_ref_upper[MAX_TEST_VECTOR_LEN];
 uint8_t compressed[MAX_TEST_VECTOR_LEN];
 int16_t decompressed[MAX_TEST_VECTOR_LEN];
 
+#define IMPL_TEST_SAMPLES   (10*G722_SAMPLE_RATE)
+
+static const char *implementation_names[] =
+{
+    "auto",
+    "generic",
+    "SSE2",
+    "AVX2"
+};
+
+int16_t impl_in[IMPL_TEST_SAMPLES];
+uint8_t impl_ref_codes[IMPL_TEST_SAMPLES];
+int16_t impl_ref_out[IMPL_TEST_SAMPLES];
+uint8_t impl_codes[IMPL_TEST_SAMPLES];
+int16_t impl_out[IMPL_TEST_SAMPLES];
+
 static int hex_get(char *s)
 {
     int i;
@@ -358,6 +374,122 @@ static void itu_compliance_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int impl_code_round_trip(int bit_rate, int options, uint8_t codes[], int *codes_len, int16_t out[])
+{
+    g722_encode_state_t *enc;
+    g722_decode_state_t *dec;
+    int pos;
+    int len;
+    int out_len;
+    unsigned int step;
+
+    enc = g722_encode_init(NULL, bit_rate, options);
+    dec = g722_decode_init(NULL, bit_rate, options);
+    /* Use a variety of block lengths, so the blocks the QMF works on are split in
+       many ways */
+    *codes_len = 0;
+    step = 1;
+    for (pos = 0;  pos < IMPL_TEST_SAMPLES;  pos += len)
+    {
+        len = (step%321)*2 + 2;
+        step = step*7 + 3;
+        if (len > IMPL_TEST_SAMPLES - pos)
+            len = IMPL_TEST_SAMPLES - pos;
+        *codes_len += g722_encode(enc, &codes[*codes_len], &impl_in[pos], len);
+    }
+    out_len = 0;
+    step = 5;
+    for (pos = 0;  pos < *codes_len;  pos += len)
+    {
+        len = step%333 + 1;
+        step = step*5 + 1;
+        if (len > *codes_len - pos)
+            len = *codes_len - pos;
+        out_len += g722_decode(dec, &out[out_len], &codes[pos], len);
+    }
+    g722_encode_free(enc);
+    g722_decode_free(dec);
+    return out_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void implementation_tests(void)
+{
+    static const int bit_rates[3] = {48000, 56000, 64000};
+    g722_encode_state_t *enc;
+    g722_decode_state_t *dec;
+    awgn_state_t *noise;
+    uint64_t start;
+    uint64_t end;
+    int impl;
+    int rate;
+    int options;
+    int len;
+    int ref_len;
+    int codes_len;
+    int ref_codes_len;
+    int i;
+
+    printf("The preferred G.722 implementation on this machine is %s\n", implementation_names[g722_get_implementation()]);
+    /* Noise, at a range of levels, up to and including clipping */
+    noise = awgn_init_dbm0(NULL, 1234567, 3.0f);
+    for (i = 0;  i < IMPL_TEST_SAMPLES;  i++)
+        impl_in[i] = awgn(noise) >> ((i/4000)%12);
+    awgn_free(noise);
+
+    for (rate = 0;  rate < 3;  rate++)
+    {
+        for (options = 0;  options <= G722_PACKED;  options += G722_PACKED)
+        {
+            g722_set_implementation(G722_IMPLEMENTATION_GENERIC);
+            ref_len = impl_code_round_trip(bit_rates[rate], options, impl_ref_codes, &ref_codes_len, impl_ref_out);
+            for (impl = G722_IMPLEMENTATION_SSE2;  impl <= G722_IMPLEMENTATION_AVX2;  impl++)
+            {
+                if (g722_set_implementation(impl) != impl)
+                    continue;
+                len = impl_code_round_trip(bit_rates[rate], options, impl_codes, &codes_len, impl_out);
+                if (len != ref_len
+                    ||
+                    codes_len != ref_codes_len
+                    ||
+                    memcmp(impl_codes, impl_ref_codes, codes_len)
+                    ||
+                    memcmp(impl_out, impl_ref_out, len*sizeof(impl_out[0])))
+                {
+                    printf("%s implementation differs from the generic one at %dbps\n", implementation_names[impl], bit_rates[rate]);
+                    printf("Tests failed.\n");
+                    exit(2);
+                }
+            }
+        }
+    }
+    for (impl = G722_IMPLEMENTATION_GENERIC;  impl <= G722_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (g722_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        enc = g722_encode_init(NULL, 64000, 0);
+        dec = g722_decode_init(NULL, 64000, 0);
+        start = rdtscll();
+        for (i = 0;  i < IMPL_TEST_SAMPLES;  i += BLOCK_LEN)
+            g722_encode(enc, &impl_codes[i/2], &impl_in[i], BLOCK_LEN);
+        end = rdtscll();
+        printf("%-8s encode %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/IMPL_TEST_SAMPLES);
+        start = rdtscll();
+        for (i = 0;  i < IMPL_TEST_SAMPLES/2;  i += BLOCK_LEN/2)
+            g722_decode(dec, &impl_out[2*i], &impl_codes[i], BLOCK_LEN/2);
+        end = rdtscll();
+        printf("%-8s decode %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/IMPL_TEST_SAMPLES);
+        g722_encode_free(enc);
+        g722_decode_free(dec);
+    }
+    g722_set_implementation(G722_IMPLEMENTATION_AUTO);
+    printf("All implementations match\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 static void signal_to_distortion_tests(void)
 {
     g722_encode_state_t enc_state;
@@ -508,6 +640,7 @@ int main(int argc, char *argv[])
 
     if (itutests)
     {
+        implementation_tests();
         itu_compliance_tests();
         signal_to_distortion_tests();
     }
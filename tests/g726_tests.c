@@ -27,7 +27,10 @@
 
 /*! \page g726_tests_page G.726 tests
 \section g726_tests_page_sec_1 What does it do?
-Two sets of tests are performed:
+Three sets of tests are performed:
+    - A check that the multi-channel encode and decode functions, in each of their
+      implementations, give exactly the same results as encoding and decoding each channel
+      separately.
     - The tests defined in the G.726 specification, using the test data files supplied with
       the specification.
     - A generally audio quality test, consisting of compressing and decompressing a speeech
@@ -83,6 +86,9 @@ decompressed, and the resulting audio stored in post_g726.wav.
 #define BLOCK_LEN           320
 #define MAX_TEST_VECTOR_LEN 40000
 
+#define MULTI_CHANNELS      11
+#define MULTI_SAMPLES       8000
+
 #define TESTDATA_DIR    "../test-data/itu/g726/"
 
 #define IN_FILE_NAME    "../test-data/local/short_nb_voice.wav"
@@ -96,6 +102,19 @@ uint8_t itu_ref[MAX_TEST_VECTOR_LEN];
 uint8_t unpacked[MAX_TEST_VECTOR_LEN];
 uint8_t xlaw[MAX_TEST_VECTOR_LEN];
 
+int16_t multi_in[MULTI_CHANNELS][MULTI_SAMPLES];
+uint8_t multi_ref_codes[MULTI_CHANNELS][MULTI_SAMPLES];
+int16_t multi_ref_out[MULTI_CHANNELS][MULTI_SAMPLES];
+uint8_t multi_codes[MULTI_CHANNELS][MULTI_SAMPLES];
+int16_t multi_out[MULTI_CHANNELS][MULTI_SAMPLES];
+
+static const char *implementation_names[] =
+{
+    "auto",
+    "generic",
+    "AVX2"
+};
+
 /*
 Table 4 - V Reset and homing sequences for u-law
             Normal                              I-input     Overload
@@ -1075,6 +1094,208 @@ static int get_test_vector(const char *file, uint8_t buf[], int max_len)
 }
 /*- End of function --------------------------------------------------------*/
 
+/* Encode and decode each channel in turn, or all the channels together, in blocks of
+   varying size. Returns the number of samples decoded for each channel. */
+static int multi_round_trip(int bit_rate, int packing, int together, uint8_t codes[][MULTI_SAMPLES], int16_t out[][MULTI_SAMPLES])
+{
+    g726_state_t *enc[MULTI_CHANNELS];
+    g726_state_t *dec[MULTI_CHANNELS];
+    const int16_t *in_ptr[MULTI_CHANNELS];
+    uint8_t *codes_ptr[MULTI_CHANNELS];
+    const uint8_t *const_codes_ptr[MULTI_CHANNELS];
+    int16_t *out_ptr[MULTI_CHANNELS];
+    int codes_len;
+    int out_len;
+    int pos;
+    int len;
+    int n;
+    int k;
+
+    for (k = 0;  k < MULTI_CHANNELS;  k++)
+    {
+        /* Mix the external codings, which the channels of a group need not share */
+        enc[k] = g726_init(NULL, bit_rate, k%3, packing);
+        dec[k] = g726_init(NULL, bit_rate, k%3, packing);
+    }
+    codes_len = 0;
+    for (pos = 0;  pos < MULTI_SAMPLES;  pos += len)
+    {
+        len = (pos*7)%293 + 1;
+        if (len > MULTI_SAMPLES - pos)
+            len = MULTI_SAMPLES - pos;
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+        {
+            in_ptr[k] = (k%3 == G726_ENCODING_LINEAR)  ?  &multi_in[k][pos]  :  (const int16_t *) ((const uint8_t *) multi_in[k] + pos);
+            codes_ptr[k] = &codes[k][codes_len];
+        }
+        n = 0;
+        if (together)
+        {
+            n = g726_encode_multi(enc, codes_ptr, in_ptr, MULTI_CHANNELS, len);
+        }
+        else
+        {
+            for (k = 0;  k < MULTI_CHANNELS;  k++)
+                n = g726_encode(enc[k], codes_ptr[k], in_ptr[k], len);
+        }
+        codes_len += n;
+    }
+    out_len = 0;
+    for (pos = 0;  pos < codes_len;  pos += len)
+    {
+        len = (pos*5)%97 + 1;
+        if (len > codes_len - pos)
+            len = codes_len - pos;
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+        {
+            const_codes_ptr[k] = &codes[k][pos];
+            out_ptr[k] = (k%3 == G726_ENCODING_LINEAR)  ?  &out[k][out_len]  :  (int16_t *) ((uint8_t *) out[k] + out_len);
+        }
+        n = 0;
+        if (together)
+        {
+            n = g726_decode_multi(dec, out_ptr, const_codes_ptr, MULTI_CHANNELS, len);
+        }
+        else
+        {
+            for (k = 0;  k < MULTI_CHANNELS;  k++)
+                n = g726_decode(dec[k], out_ptr[k], const_codes_ptr[k], len);
+        }
+        out_len += n;
+    }
+    for (k = 0;  k < MULTI_CHANNELS;  k++)
+    {
+        g726_free(enc[k]);
+        g726_free(dec[k]);
+    }
+    return out_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void multi_channel_tests(void)
+{
+    g726_state_t *s[MULTI_CHANNELS];
+    const int16_t *in_ptr[MULTI_CHANNELS];
+    uint8_t *codes_ptr[MULTI_CHANNELS];
+    const uint8_t *const_codes_ptr[MULTI_CHANNELS];
+    int16_t *out_ptr[MULTI_CHANNELS];
+    awgn_state_t *noise;
+    uint64_t start;
+    uint64_t end;
+    int bit_rate;
+    int packing;
+    int impl;
+    int ref_len;
+    int len;
+    int i;
+    int k;
+
+    printf("The preferred G.726 implementation on this machine is %s\n", implementation_names[g726_get_implementation()]);
+    /* Noise, at a range of levels, up to and including clipping, with some stretches
+       of a steady level to push the predictors to their limits */
+    noise = awgn_init_dbm0(NULL, 1234567, 3.0f);
+    for (k = 0;  k < MULTI_CHANNELS;  k++)
+    {
+        for (i = 0;  i < MULTI_SAMPLES;  i++)
+        {
+            multi_in[k][i] = awgn(noise) >> ((i/500 + k)%12);
+            if ((i/1000 + k)%7 == 3)
+                multi_in[k][i] = 10000 - 2000*k;
+        }
+        for (i = 0;  i < MULTI_SAMPLES;  i++)
+        {
+            if (k%3 == G726_ENCODING_ALAW)
+                ((uint8_t *) multi_in[k])[i] = linear_to_alaw(multi_in[k][i]);
+            else if (k%3 == G726_ENCODING_ULAW)
+                ((uint8_t *) multi_in[k])[i] = linear_to_ulaw(multi_in[k][i]);
+        }
+    }
+    awgn_free(noise);
+
+    for (bit_rate = 16000;  bit_rate <= 40000;  bit_rate += 8000)
+    {
+        for (packing = G726_PACKING_NONE;  packing <= G726_PACKING_RIGHT;  packing++)
+        {
+            ref_len = multi_round_trip(bit_rate, packing, FALSE, multi_ref_codes, multi_ref_out);
+            for (impl = G726_IMPLEMENTATION_GENERIC;  impl <= G726_IMPLEMENTATION_AVX2;  impl++)
+            {
+                if (g726_set_implementation(impl) != impl)
+                    continue;
+                len = multi_round_trip(bit_rate, packing, TRUE, multi_codes, multi_out);
+                if (len != ref_len
+                    ||
+                    memcmp(multi_codes, multi_ref_codes, sizeof(multi_codes))
+                    ||
+                    memcmp(multi_out, multi_ref_out, sizeof(multi_out)))
+                {
+                    printf("%s multi-channel implementation differs from single channel operation at %dbps, packing %d\n",
+                           implementation_names[impl],
+                           bit_rate,
+                           packing);
+                    printf("Tests failed.\n");
+                    exit(2);
+                }
+            }
+        }
+    }
+
+    /* Channels which are out of step should be refused */
+    for (k = 0;  k < 2;  k++)
+        s[k] = g726_init(NULL, (k == 0)  ?  32000  :  24000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+    in_ptr[0] = in_ptr[1] = multi_in[0];
+    codes_ptr[0] = codes_ptr[1] = multi_codes[0];
+    if (g726_encode_multi(s, codes_ptr, in_ptr, 2, 160) != -1)
+    {
+        printf("Mismatched channels accepted\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    for (k = 0;  k < 2;  k++)
+        g726_free(s[k]);
+
+    for (impl = G726_IMPLEMENTATION_GENERIC;  impl <= G726_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (g726_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+            s[k] = g726_init(NULL, 32000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+        start = rdtscll();
+        for (i = 0;  i < MULTI_SAMPLES;  i += 160)
+        {
+            for (k = 0;  k < MULTI_CHANNELS;  k++)
+            {
+                in_ptr[k] = &multi_ref_out[k][i];
+                codes_ptr[k] = &multi_codes[k][i];
+            }
+            g726_encode_multi(s, codes_ptr, in_ptr, MULTI_CHANNELS, 160);
+        }
+        end = rdtscll();
+        printf("%-8s encode %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/(MULTI_CHANNELS*MULTI_SAMPLES));
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+            g726_init(s[k], 32000, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+        start = rdtscll();
+        for (i = 0;  i < MULTI_SAMPLES;  i += 160)
+        {
+            for (k = 0;  k < MULTI_CHANNELS;  k++)
+            {
+                const_codes_ptr[k] = &multi_codes[k][i];
+                out_ptr[k] = &multi_out[k][i];
+            }
+            g726_decode_multi(s, out_ptr, const_codes_ptr, MULTI_CHANNELS, 160);
+        }
+        end = rdtscll();
+        printf("%-8s decode %8.1f cycles/sample\n", implementation_names[impl], (double) (end - start)/(MULTI_CHANNELS*MULTI_SAMPLES));
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+            g726_free(s[k]);
+    }
+    g726_set_implementation(G726_IMPLEMENTATION_AUTO);
+    printf("All implementations match\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 static void itu_compliance_tests(void)
 {
     g726_state_t enc_state;
@@ -1242,6 +1463,7 @@ int main(int argc, char *argv[])
 
     if (itutests)
     {
+        multi_channel_tests();
         itu_compliance_tests();
     }
     else
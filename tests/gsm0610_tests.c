@@ -27,9 +27,11 @@
 
 /*! \page gsm0610_tests_page GSM 06.10 full rate codec tests
 \section gsm0610_tests_page_sec_1 What does it do?
-Two sets of tests are performed:
+Three sets of tests are performed:
     - The tests defined in the GSM 06.10 specification, using the test data files supplied with
-      the specification.
+      the specification. These are run with each of the implementations the CPU supports.
+    - A comparison of the SSE2 and AVX2 implementations with the generic one, over a long
+      synthetic signal, followed by a measurement of the encoding speed of each.
     - A generally audio quality test, consisting of compressing and decompressing a speeech
       file for audible comparison.
 
@@ -121,6 +123,7 @@ will be compressed to GSM 06.10 data, decompressed, and the resulting audio stor
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/time.h>
 #include <sndfile.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
@@ -139,6 +142,8 @@ will be compressed to GSM 06.10 data, decompressed, and the resulting audio stor
 
 #define HIST_LEN        1000
 
+#define IMPLEMENTATION_TEST_SAMPLES     (60*SAMPLE_RATE)
+
 uint8_t law_in_vector[1000000];
 int16_t in_vector[1000000];
 uint16_t code_vector_buf[1000000];
@@ -514,23 +519,152 @@ static int perform_pack_unpack_test(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void make_implementation_test_signal(int16_t amp[], int len)
+{
+    awgn_state_t *noise;
+    double phase;
+    int i;
+
+    noise = awgn_init_dbm0(NULL, 1234567, -10.0f);
+    phase = 0.0;
+    for (i = 0;  i < len;  i++)
+    {
+        /* A mixture of speech like tones, noise, heavy clipping, and silence, at a range
+           of levels, to exercise all the scaling paths */
+        switch ((i/8000)%5)
+        {
+        case 0:
+            phase += 0.3;
+            amp[i] = (int16_t) (20000.0*sin(phase)) + (awgn(noise) >> 3);
+            break;
+        case 1:
+            amp[i] = awgn(noise) >> ((i/800)%10);
+            break;
+        case 2:
+            amp[i] = (i & (8 << ((i/1600)%5)))  ?  32767  :  -32768;
+            break;
+        case 3:
+            amp[i] = ((i/800) & 1)  ?  saturate(awgn(noise)*4)  :  0;
+            break;
+        default:
+            amp[i] = (i%BLOCK_LEN < 3)  ?  -32768  :  (awgn(noise) >> 6);
+            break;
+        }
+    }
+    awgn_free(noise);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void implementation_tests(void)
+{
+    static const char *implementation_names[] =
+    {
+        "auto",
+        "generic",
+        "SSE2",
+        "AVX2"
+    };
+    gsm0610_state_t *enc;
+    gsm0610_state_t *dec;
+    struct timeval start;
+    struct timeval end;
+    uint64_t start_cycles;
+    uint64_t end_cycles;
+    double duration;
+    int ref_bytes;
+    int bytes;
+    int samples;
+    int packing;
+    int impl;
+
+    printf("Performing implementation tests (not part of the ETSI conformance tests).\n");
+    make_implementation_test_signal(in_vector, IMPLEMENTATION_TEST_SAMPLES);
+    for (packing = GSM0610_PACKING_NONE;  packing <= GSM0610_PACKING_VOIP;  packing++)
+    {
+        gsm0610_set_implementation(GSM0610_IMPLEMENTATION_GENERIC);
+        enc = gsm0610_init(NULL, packing);
+        dec = gsm0610_init(NULL, packing);
+        ref_bytes = gsm0610_encode(enc, ref_code_vector, in_vector, IMPLEMENTATION_TEST_SAMPLES);
+        gsm0610_decode(dec, ref_out_vector, ref_code_vector, ref_bytes);
+        gsm0610_free(enc);
+        gsm0610_free(dec);
+        for (impl = GSM0610_IMPLEMENTATION_SSE2;  impl <= GSM0610_IMPLEMENTATION_AVX2;  impl++)
+        {
+            if (gsm0610_set_implementation(impl) != impl)
+                continue;
+            enc = gsm0610_init(NULL, packing);
+            dec = gsm0610_init(NULL, packing);
+            bytes = gsm0610_encode(enc, code_vector, in_vector, IMPLEMENTATION_TEST_SAMPLES);
+            samples = gsm0610_decode(dec, out_vector, code_vector, bytes);
+            gsm0610_free(enc);
+            gsm0610_free(dec);
+            if (bytes != ref_bytes
+                ||
+                samples != IMPLEMENTATION_TEST_SAMPLES
+                ||
+                memcmp(code_vector, ref_code_vector, bytes)
+                ||
+                memcmp(out_vector, ref_out_vector, sizeof(int16_t)*samples))
+            {
+                printf("%s implementation differs from the generic one, packing %d\n", implementation_names[impl], packing);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+        }
+    }
+
+    /* Measure the encoder throughput */
+    for (impl = GSM0610_IMPLEMENTATION_GENERIC;  impl <= GSM0610_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (gsm0610_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        enc = gsm0610_init(NULL, GSM0610_PACKING_VOIP);
+        gettimeofday(&start, NULL);
+        start_cycles = rdtscll();
+        gsm0610_encode(enc, code_vector, in_vector, IMPLEMENTATION_TEST_SAMPLES);
+        end_cycles = rdtscll();
+        gettimeofday(&end, NULL);
+        gsm0610_free(enc);
+        duration = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+        printf("%-8s encode %8.0f cycles/frame, %8.0f frames/second\n",
+               implementation_names[impl],
+               (double) (end_cycles - start_cycles)/(IMPLEMENTATION_TEST_SAMPLES/BLOCK_LEN),
+               (duration > 0.0)  ?  (IMPLEMENTATION_TEST_SAMPLES/BLOCK_LEN)/duration  :  0.0);
+    }
+    gsm0610_set_implementation(GSM0610_IMPLEMENTATION_AUTO);
+    printf("Test passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 static void etsi_compliance_tests(void)
 {
-    perform_linear_test(TRUE, 1, "Seq01");
-    perform_linear_test(TRUE, 1, "Seq02");
-    perform_linear_test(TRUE, 1, "Seq03");
-    perform_linear_test(TRUE, 1, "Seq04");
-    perform_linear_test(FALSE, 1, "Seq05");
-    perform_law_test(TRUE, 'a', "Seq01");
-    perform_law_test(TRUE, 'a', "Seq02");
-    perform_law_test(TRUE, 'a', "Seq03");
-    perform_law_test(TRUE, 'a', "Seq04");
-    perform_law_test(FALSE, 'a', "Seq05");
-    perform_law_test(TRUE, 'u', "Seq01");
-    perform_law_test(TRUE, 'u', "Seq02");
-    perform_law_test(TRUE, 'u', "Seq03");
-    perform_law_test(TRUE, 'u', "Seq04");
-    perform_law_test(FALSE, 'u', "Seq05");
+    int impl;
+
+    for (impl = GSM0610_IMPLEMENTATION_GENERIC;  impl <= GSM0610_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (gsm0610_set_implementation(impl) != impl)
+            continue;
+        printf("Testing implementation %d\n", impl);
+        perform_linear_test(TRUE, 1, "Seq01");
+        perform_linear_test(TRUE, 1, "Seq02");
+        perform_linear_test(TRUE, 1, "Seq03");
+        perform_linear_test(TRUE, 1, "Seq04");
+        perform_linear_test(FALSE, 1, "Seq05");
+        perform_law_test(TRUE, 'a', "Seq01");
+        perform_law_test(TRUE, 'a', "Seq02");
+        perform_law_test(TRUE, 'a', "Seq03");
+        perform_law_test(TRUE, 'a', "Seq04");
+        perform_law_test(FALSE, 'a', "Seq05");
+        perform_law_test(TRUE, 'u', "Seq01");
+        perform_law_test(TRUE, 'u', "Seq02");
+        perform_law_test(TRUE, 'u', "Seq03");
+        perform_law_test(TRUE, 'u', "Seq04");
+        perform_law_test(FALSE, 'u', "Seq05");
+    }
+    gsm0610_set_implementation(GSM0610_IMPLEMENTATION_AUTO);
     /* This is not actually an ETSI test */
     perform_pack_unpack_test();
 
@@ -573,6 +707,8 @@ int main(int argc, char *argv[])
 
     if (etsitests)
     {
+        /* This does not need the ETSI test data, so it is run first */
+        implementation_tests();
         etsi_compliance_tests();
     }
     else
@@ -28,7 +28,10 @@
 /*! \page hdlc_tests_page HDLC tests
 \section hdlc_tests_page_sec_1 What does it do?
 The HDLC tests exercise the HDLC module, and verifies correct operation
-using both 16 and 32 bit CRCs.
+using both 16 and 32 bit CRCs. The table driven octet processing is checked
+against bit by bit processing, for both transmission and reception, using a
+damaged octet stream which produces bad frames, aborts and octet counting
+reports.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -751,6 +754,223 @@ static int test_hdlc_octet_count_handling(void)
 /*- End of function --------------------------------------------------------*/
 #endif
 
+#define EVENT_LOG_LEN       20000
+#define TABLE_TEST_OCTETS   400000
+
+typedef struct
+{
+    int entries;
+    uint32_t log[EVENT_LOG_LEN][3];
+} event_log_t;
+
+static uint8_t table_test_stream[TABLE_TEST_OCTETS];
+
+static void logging_frame_handler(void *user_data, const uint8_t *pkt, int len, int ok)
+{
+    event_log_t *log;
+
+    log = (event_log_t *) user_data;
+    if (log->entries >= EVENT_LOG_LEN)
+        return;
+    log->log[log->entries][0] = len;
+    log->log[log->entries][1] = ok;
+    log->log[log->entries][2] = (len > 0)  ?  crc_itu32_calc(pkt, len, 0xFFFFFFFF)  :  0;
+    log->entries++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int compare_event_logs(const char *tag, event_log_t *ref, event_log_t *log)
+{
+    int i;
+
+    for (i = 0;  i < ref->entries  &&  i < log->entries;  i++)
+    {
+        if (memcmp(ref->log[i], log->log[i], sizeof(ref->log[i])))
+        {
+            printf("%s: event %d is %d/%d, but should be %d/%d\n",
+                   tag,
+                   i,
+                   (int) log->log[i][0],
+                   (int) log->log[i][1],
+                   (int) ref->log[i][0],
+                   (int) ref->log[i][1]);
+            return -1;
+        }
+    }
+    if (ref->entries != log->entries)
+    {
+        printf("%s: %d events, but there should be %d\n", tag, log->entries, ref->entries);
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_hdlc_octet_tables(void)
+{
+    static event_log_t bit_log;
+    static event_log_t byte_log;
+    static event_log_t table_log;
+    static event_log_t chunk_log;
+    hdlc_tx_state_t tx_bits;
+    hdlc_tx_state_t tx_tables;
+    hdlc_rx_state_t rx_bit;
+    hdlc_rx_state_t rx_byte;
+    hdlc_rx_state_t rx_table;
+    hdlc_rx_state_t rx_chunk;
+    hdlc_rx_stats_t stats[2];
+    uint8_t msg[200];
+    int msg_len;
+    int crc32;
+    int x;
+    int y;
+    int i;
+    int j;
+
+    for (crc32 = FALSE;  crc32 <= TRUE;  crc32++)
+    {
+        printf("Testing the octet tables against bit by bit processing, with CRC-%d\n", (crc32)  ?  32  :  16);
+        /* Generate an octet stream of frames, timed flags and aborts both ways, and
+           check the results are identical. */
+        hdlc_tx_init(&tx_bits, crc32, 2, FALSE, NULL, NULL);
+        hdlc_tx_set_octet_tables(&tx_bits, FALSE);
+        hdlc_tx_init(&tx_tables, crc32, 2, FALSE, NULL, NULL);
+        hdlc_tx_flags(&tx_bits, 10);
+        hdlc_tx_flags(&tx_tables, 10);
+        for (i = 0;  i < TABLE_TEST_OCTETS;  i++)
+        {
+            if ((my_rand() & 0x3F) == 0)
+            {
+                msg_len = (my_rand() & 0x7F) + 1;
+                for (j = 0;  j < msg_len;  j++)
+                {
+                    /* Bias the data towards ones, so there is plenty of bit stuffing */
+                    msg[j] = my_rand() | my_rand();
+                }
+                x = hdlc_tx_frame(&tx_bits, msg, msg_len);
+                y = hdlc_tx_frame(&tx_tables, msg, msg_len);
+                if (x != y)
+                {
+                    printf("Frame acceptance differs\n");
+                    return -1;
+                }
+            }
+            else if ((my_rand() & 0x3FF) == 0)
+            {
+                hdlc_tx_abort(&tx_bits);
+                hdlc_tx_abort(&tx_tables);
+            }
+            x = hdlc_tx_get_byte(&tx_bits);
+            y = hdlc_tx_get_byte(&tx_tables);
+            if (x != y)
+            {
+                printf("Tx octet %d is 0x%X, but should be 0x%X\n", i, y, x);
+                return -1;
+            }
+            table_test_stream[i] = (uint8_t) x;
+        }
+        printf("Tx octet streams match\n");
+
+        /* Damage the stream, to produce bad CRCs, misaligned flags, overlength frames
+           and aborts, as well as good frames. */
+        for (i = 0;  i < TABLE_TEST_OCTETS;  i++)
+        {
+            switch (my_rand() & 0x1FFF)
+            {
+            case 0:
+                table_test_stream[i] ^= (1 << (my_rand() & 7));
+                break;
+            case 1:
+                table_test_stream[i] = 0xFF;
+                break;
+            case 2:
+                table_test_stream[i] = (uint8_t) my_rand();
+                break;
+            }
+        }
+
+        hdlc_rx_init(&rx_bit, crc32, TRUE, 3, logging_frame_handler, &bit_log);
+        hdlc_rx_init(&rx_byte, crc32, TRUE, 3, logging_frame_handler, &byte_log);
+        hdlc_rx_set_octet_tables(&rx_byte, FALSE);
+        hdlc_rx_init(&rx_table, crc32, TRUE, 3, logging_frame_handler, &table_log);
+        hdlc_rx_init(&rx_chunk, crc32, TRUE, 3, logging_frame_handler, &chunk_log);
+        hdlc_rx_set_max_frame_len(&rx_bit, 100);
+        hdlc_rx_set_max_frame_len(&rx_byte, 100);
+        hdlc_rx_set_max_frame_len(&rx_table, 100);
+        hdlc_rx_set_max_frame_len(&rx_chunk, 100);
+        hdlc_rx_set_octet_counting_report_interval(&rx_bit, 8);
+        hdlc_rx_set_octet_counting_report_interval(&rx_byte, 8);
+        hdlc_rx_set_octet_counting_report_interval(&rx_table, 8);
+        hdlc_rx_set_octet_counting_report_interval(&rx_chunk, 8);
+        bit_log.entries = 0;
+        byte_log.entries = 0;
+        table_log.entries = 0;
+        chunk_log.entries = 0;
+        for (i = 0;  i < TABLE_TEST_OCTETS;  i++)
+        {
+            for (j = 7;  j >= 0;  j--)
+                hdlc_rx_put_bit(&rx_bit, (table_test_stream[i] >> j) & 1);
+        }
+        start = rdtscll();
+        hdlc_rx_put(&rx_byte, table_test_stream, TABLE_TEST_OCTETS);
+        end = rdtscll();
+        printf("Bit by bit rx %.2f ticks/octet\n", (double) (end - start)/TABLE_TEST_OCTETS);
+        start = rdtscll();
+        hdlc_rx_put(&rx_table, table_test_stream, TABLE_TEST_OCTETS);
+        end = rdtscll();
+        printf("Octet table rx %.2f ticks/octet\n", (double) (end - start)/TABLE_TEST_OCTETS);
+        /* Feed the chunks at odd lengths, switching between single octets and bits */
+        for (i = 0;  i < TABLE_TEST_OCTETS;  i += j)
+        {
+            j = (my_rand() & 0x1F) + 1;
+            if (i + j > TABLE_TEST_OCTETS)
+                j = TABLE_TEST_OCTETS - i;
+            if ((j & 3) == 0)
+            {
+                for (x = 0;  x < 8;  x++)
+                    hdlc_rx_put_bit(&rx_chunk, (table_test_stream[i] >> (7 - x)) & 1);
+                hdlc_rx_put(&rx_chunk, &table_test_stream[i + 1], j - 1);
+            }
+            else
+            {
+                hdlc_rx_put(&rx_chunk, &table_test_stream[i], j);
+            }
+        }
+        printf("%d events seen\n", bit_log.entries);
+        if (compare_event_logs("Bit by bit octets", &bit_log, &byte_log)
+            ||
+            compare_event_logs("Octet tables", &bit_log, &table_log)
+            ||
+            compare_event_logs("Mixed octet tables and bits", &bit_log, &chunk_log))
+        {
+            return -1;
+        }
+        hdlc_rx_get_stats(&rx_bit, &stats[0]);
+        hdlc_rx_get_stats(&rx_table, &stats[1]);
+        printf("%lu good frames, %lu CRC errors, %lu length errors, %lu aborts\n",
+               stats[0].good_frames,
+               stats[0].crc_errors,
+               stats[0].length_errors,
+               stats[0].aborts);
+        if (memcmp(&stats[0], &stats[1], sizeof(stats[0]))
+            ||
+            stats[0].good_frames == 0
+            ||
+            stats[0].crc_errors == 0
+            ||
+            stats[0].length_errors == 0
+            ||
+            stats[0].aborts == 0)
+        {
+            printf("Rx statistics differ, or some conditions were not exercised\n");
+            return -1;
+        }
+        printf("Test passed.\n\n");
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static void hdlc_tests(void)
 {
     printf("HDLC module tests\n");
@@ -775,6 +995,11 @@ static void hdlc_tests(void)
         printf("Tests failed\n");
         exit(2);
     }
+    if (test_hdlc_octet_tables())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
 #if 0
     if (test_hdlc_octet_count_handling())
     {
@@ -25,6 +25,12 @@
 
 /*! \page logging_tests_page Logging tests
 \section logging_tests_page_sec_1 What does it do?
+These tests check the labelling and delivery of log messages, first in the normal
+synchronous mode, and then in the asynchronous mode, where the same messages must
+come out of the drain. The asynchronous mode is then checked with several threads
+logging through small rings at once, where every message must either be delivered
+or counted as dropped. The cost of a log call to the calling thread is measured in
+both modes. Finally, the delivery of binary log events is checked.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -38,7 +44,12 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <memory.h>
+#include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <wchar.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
@@ -46,6 +57,10 @@
 
 #include "spandsp.h"
 
+#define ASYNC_THREADS   4
+#define ASYNC_MESSAGES  100000
+#define TIMING_MESSAGES 100000
+
 static int tests_failed = FALSE;
 
 static int msg_step = 0;
@@ -103,6 +118,14 @@ static void message_handler2(int level, const char *text)
 }
 /*- End of function --------------------------------------------------------*/
 
+static char *captured = NULL;
+
+static void capture_message_handler(int level, const char *text)
+{
+    strcpy(captured, text);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void error_handler(const char *text)
 {
     const char *ref[] =
@@ -122,13 +145,28 @@ static void error_handler(const char *text)
 }
 /*- End of function --------------------------------------------------------*/
 
-int main(int argc, char *argv[])
+static void drain(int async_mode)
+{
+    if (async_mode)
+        span_log_async_drain();
+}
+/*- End of function --------------------------------------------------------*/
+
+static int run_sequence(int async_mode)
 {
     logging_state_t log;
     int i;
     uint8_t buf[1000];
     struct timespec delay;
 
+    tests_failed = FALSE;
+    msg_step = 0;
+    msg2_step = 0;
+    error_step = 0;
+    msg_done = FALSE;
+    msg2_done = FALSE;
+    error_done = FALSE;
+
     /* Set up a logger */
     if (span_log_init(&log, 123, "TAG") == NULL)
     {
@@ -141,6 +179,7 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Logged.\n");
     else
         fprintf(stderr, "Not logged.\n");
+    drain(async_mode);
 
     /* Now set a custom log handler */
     span_log_set_message_handler(&log, &message_handler);
@@ -207,6 +246,9 @@ int main(int argc, char *argv[])
         span_log(&log, SPAN_LOG_FLOW, "Time tagged log %d %d %d\n", 1, 2, 3);
         span_log_bump_samples(&log, 441*2);
     }
+    /* In asynchronous mode, the records are only delivered here, long after the
+       context's sample count has moved on */
+    drain(async_mode);
 
     /* Check timestamping by current date and time */
     span_log_set_message_handler(&log, &message_handler2);
@@ -218,13 +260,247 @@ int main(int argc, char *argv[])
         delay.tv_nsec = 20000000;
         nanosleep(&delay, NULL);
     }
+    drain(async_mode);
     if (tests_failed  ||  !msg_done  ||  !error_done)
     {
         printf("Tests failed - %d %d %d.\n", tests_failed, msg_done, error_done);
-        return 2;
+        return -1;
     }
 
     span_log_set_message_handler(&log, &message_handler);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int counted_messages = 0;
+static volatile int writers_done = 0;
+
+static void counting_message_handler(int level, const char *text)
+{
+    counted_messages++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void async_format_tests(void)
+{
+    logging_state_t log;
+    char *s;
+    char *t;
+    static char result[1025];
+
+    /* Check conversions the record capture must handle, including transient strings */
+    span_log_init(&log, SPAN_LOG_FLOW | SPAN_LOG_SUPPRESS_LABELLING, NULL);
+    span_log_set_message_handler(&log, &capture_message_handler);
+    captured = result;
+    s = malloc(10);
+    strcpy(s, "transient");
+    span_log(&log, SPAN_LOG_FLOW, "%5d|%-5s|%*d|%.*f|%lld|%zu|%lx|%c|%%|%s|%Lg|%08.3e\n",
+             42, "ab", 4, 7, 2, 3.14159, (long long int) -1234567890123LL, (size_t) 99, 0xABCDEFL, 'z', s, (long double) 1.5, 12345.678);
+    free(s);
+    span_log_async_drain();
+    if (strcmp(result, "   42|ab   |   7|3.14|-1234567890123|99|abcdef|z|%|transient|1.5|1.235e+04\n"))
+    {
+        printf("Bad asynchronous formatting: %s", result);
+        exit(2);
+    }
+    /* A precision lets a string be unterminated, so the capture must not read past it */
+    s = malloc(4);
+    memcpy(s, "abcd", 4);
+    t = malloc(3);
+    memcpy(t, "xyz", 3);
+    span_log(&log, SPAN_LOG_FLOW, "%.*s|%.3s|%.*s|%-6.2s|\n", 4, s, t, -1, "neg", t);
+    free(s);
+    free(t);
+    span_log_async_drain();
+    if (strcmp(result, "abcd|xyz|neg|xy    |\n"))
+    {
+        printf("Bad asynchronous formatting of strings with a precision: %s", result);
+        exit(2);
+    }
+    /* Wide strings cannot be captured, so this one has to be formatted immediately */
+    span_log(&log, SPAN_LOG_FLOW, "%ls\n", L"wide");
+    span_log_async_drain();
+    if (strcmp(result, "wide\n"))
+    {
+        printf("Bad preformatted asynchronous message: %s", result);
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *async_writer(void *arg)
+{
+    logging_state_t log;
+    int i;
+
+    span_log_init(&log, SPAN_LOG_FLOW, "Thread");
+    span_log_set_message_handler(&log, &counting_message_handler);
+    for (i = 0;  i < ASYNC_MESSAGES;  i++)
+        span_log(&log, SPAN_LOG_FLOW, "Message %d from thread %d\n", i, (int) (intptr_t) arg);
+    span_log_async_thread_done();
+    __sync_fetch_and_add(&writers_done, 1);
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void async_thread_tests(void)
+{
+    pthread_t thread[ASYNC_THREADS];
+    int i;
+
+    /* Several threads log flat out, through rings small enough to overflow, while
+       this thread drains them. Every message must either arrive, or be counted as
+       dropped. */
+    counted_messages = 0;
+    writers_done = 0;
+    for (i = 0;  i < ASYNC_THREADS;  i++)
+    {
+        if (pthread_create(&thread[i], NULL, async_writer, (void *) (intptr_t) i))
+        {
+            printf("Failed to create thread\n");
+            exit(2);
+        }
+    }
+    while (writers_done < ASYNC_THREADS)
+    {
+        if (span_log_async_drain() == 0)
+            sched_yield();
+    }
+    for (i = 0;  i < ASYNC_THREADS;  i++)
+        pthread_join(thread[i], NULL);
+    span_log_async_drain();
+    printf("%d messages delivered, %d dropped\n", counted_messages, span_log_async_get_dropped());
+    if (counted_messages + span_log_async_get_dropped() != ASYNC_THREADS*ASYNC_MESSAGES)
+    {
+        printf("Messages lost without being counted\n");
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void async_timing_tests(void)
+{
+    logging_state_t log;
+    struct timeval start;
+    struct timeval end;
+    double sync_time;
+    double async_time;
+    int i;
+
+    span_log_init(&log, SPAN_LOG_FLOW | SPAN_LOG_SHOW_DATE | SPAN_LOG_SHOW_SEVERITY | SPAN_LOG_SHOW_PROTOCOL, "Tag");
+    span_log_set_protocol(&log, "Timing");
+    span_log_set_message_handler(&log, &counting_message_handler);
+    gettimeofday(&start, NULL);
+    for (i = 0;  i < TIMING_MESSAGES;  i++)
+        span_log(&log, SPAN_LOG_FLOW, "Frame %d, level %.2fdBm0, state %s\n", i, -13.5, "OK");
+    gettimeofday(&end, NULL);
+    sync_time = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+
+    span_log_async_init(TIMING_MESSAGES*128);
+    gettimeofday(&start, NULL);
+    for (i = 0;  i < TIMING_MESSAGES;  i++)
+        span_log(&log, SPAN_LOG_FLOW, "Frame %d, level %.2fdBm0, state %s\n", i, -13.5, "OK");
+    gettimeofday(&end, NULL);
+    async_time = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+    span_log_async_release();
+    printf("Cost per log call on the logging thread - synchronous %.0fns, asynchronous %.0fns\n",
+           1.0e9*sync_time/TIMING_MESSAGES,
+           1.0e9*async_time/TIMING_MESSAGES);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int events_seen = 0;
+
+static void event_handler(void *user_data, const span_log_event_t *ev)
+{
+    if (user_data != (void *) &events_seen
+        ||
+        ev->level != SPAN_LOG_FLOW
+        ||
+        ev->event != SPAN_LOG_EVENT_FRAME_RX
+        ||
+        ev->field[0] != 1234
+        ||
+        ev->field[1] != -5
+        ||
+        ev->len != 3
+        ||
+        memcmp(ev->data, "\xFF\x13\x80", 3)
+        ||
+        strcmp(ev->protocol, "Events")
+        ||
+        ev->elapsed_samples != 8000)
+    {
+        printf("Bad binary log event\n");
+        exit(2);
+    }
+    events_seen++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void event_tests(void)
+{
+    logging_state_t log;
+
+    span_log_init(&log, SPAN_LOG_FLOW, NULL);
+    span_log_set_protocol(&log, "Events");
+    span_log_bump_samples(&log, 8000);
+    /* With no handler, events are not taken, and the caller should log text instead */
+    if (span_log_event_test(&log, SPAN_LOG_FLOW)
+        ||
+        span_log_event(&log, SPAN_LOG_FLOW, SPAN_LOG_EVENT_FRAME_RX, 1234, -5, (const uint8_t *) "\xFF\x13\x80", 3))
+    {
+        printf("Binary log event taken with no handler\n");
+        exit(2);
+    }
+    span_log_set_event_handler(&log, event_handler, &events_seen);
+    if (!span_log_event_test(&log, SPAN_LOG_FLOW)
+        ||
+        span_log_event_test(&log, SPAN_LOG_FLOW_2)
+        ||
+        !span_log_event(&log, SPAN_LOG_FLOW, SPAN_LOG_EVENT_FRAME_RX, 1234, -5, (const uint8_t *) "\xFF\x13\x80", 3)
+        ||
+        span_log_event(&log, SPAN_LOG_DEBUG, SPAN_LOG_EVENT_FRAME_RX, 1234, -5, (const uint8_t *) "\xFF\x13\x80", 3)
+        ||
+        !(span_log_event)(&log, SPAN_LOG_FLOW, SPAN_LOG_EVENT_FRAME_RX, 1234, -5, (const uint8_t *) "\xFF\x13\x80", 3))
+    {
+        printf("Binary log events not taken as expected\n");
+        exit(2);
+    }
+    if (events_seen != 2)
+    {
+        printf("%d binary log events seen, rather than 2\n", events_seen);
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    printf("Synchronous logging tests\n");
+    if (run_sequence(FALSE))
+        return 2;
+
+    printf("Asynchronous logging tests\n");
+    if (span_log_async_init(0))
+    {
+        printf("Failed to start asynchronous logging.\n");
+        return 2;
+    }
+    if (run_sequence(TRUE))
+        return 2;
+    async_format_tests();
+    span_log_async_release();
+
+    printf("Asynchronous threaded logging tests\n");
+    span_log_async_init(16384);
+    async_thread_tests();
+    span_log_async_release();
+
+    async_timing_tests();
+
+    printf("Binary log event tests\n");
+    event_tests();
 
     printf("Tests passed.\n");
     return 0;
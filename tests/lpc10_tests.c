@@ -31,6 +31,10 @@
 \section lpc10_tests_page_sec_2 How is it used?
 To perform a general audio quality test, lpc10 should be run. The file ../test-data/local/dam9.wav
 will be compressed to LPC10 data, decompressed, and the resulting audio stored in post_lpc10.wav.
+
+Before this, a group of channels of synthetic audio is encoded with lpc10_encode_multi(), using
+each encoder implementation the machine supports, and the results are checked against the
+single channel encoder. The encode throughput of each implementation is reported.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -63,6 +67,150 @@ will be compressed to LPC10 data, decompressed, and the resulting audio stored i
 #define DECOMPRESS_FILE_NAME    "lpc10_in.lpc10"
 #define OUT_FILE_NAME           "post_lpc10.wav"
 
+/* An odd number of channels, so a partly filled group of SIMD lanes is exercised */
+#define MULTI_CHANNELS          11
+#define MULTI_FRAMES            300
+
+static const char *implementation_names[] =
+{
+    "Auto",
+    "Generic",
+    "SSE2",
+    "AVX2"
+};
+
+static int16_t multi_in[MULTI_CHANNELS][MULTI_FRAMES*BLOCK_LEN];
+static uint8_t multi_ref_codes[MULTI_CHANNELS][MULTI_FRAMES*7];
+static uint8_t multi_codes[MULTI_CHANNELS][MULTI_FRAMES*7];
+
+static void multi_channel_tests(void)
+{
+    lpc10_encode_state_t *s[MULTI_CHANNELS];
+    const int16_t *in_ptr[MULTI_CHANNELS];
+    uint8_t *codes_ptr[MULTI_CHANNELS];
+    awgn_state_t *noise;
+    uint64_t start;
+    uint64_t end;
+    double phase;
+    int impl;
+    int len;
+    int i;
+    int j;
+    int k;
+
+    printf("The preferred LPC10 implementation on this machine is %s\n", implementation_names[lpc10_get_implementation()]);
+    /* A pulse train with a wandering pitch, a tone and some noise, at a range of levels, with
+       a different mix in each channel, and stretches of silence and of noise alone, so the
+       voicing and pitch tracking are kept busy. */
+    noise = awgn_init_dbm0(NULL, 1234567, -15.0f);
+    for (k = 0;  k < MULTI_CHANNELS;  k++)
+    {
+        phase = 0.0;
+        j = 0;
+        for (i = 0;  i < MULTI_FRAMES*BLOCK_LEN;  i++)
+        {
+            phase += 2.0*3.14159265*(200.0 + 50.0*k)/SAMPLE_RATE;
+            multi_in[k][i] = awgn(noise) >> (k%4);
+            if ((i/2000 + k)%5 != 4)
+            {
+                if (++j >= 30 + 5*k + (i/900)%40)
+                {
+                    multi_in[k][i] += 20000 >> ((i/4000 + k)%6);
+                    j = 0;
+                }
+                multi_in[k][i] += (int16_t) (3000.0*sin(phase));
+            }
+            if ((i/3000 + k)%9 == 8)
+                multi_in[k][i] = 0;
+        }
+    }
+    awgn_free(noise);
+
+    /* The reference is the plain C encoder, running one channel at a time */
+    lpc10_set_implementation(LPC10_IMPLEMENTATION_GENERIC);
+    for (k = 0;  k < MULTI_CHANNELS;  k++)
+    {
+        s[k] = lpc10_encode_init(NULL, TRUE);
+        if (lpc10_encode(s[k], multi_ref_codes[k], multi_in[k], MULTI_FRAMES*BLOCK_LEN) != MULTI_FRAMES*7)
+        {
+            printf("Bad encode length\n");
+            printf("Tests failed.\n");
+            exit(2);
+        }
+        lpc10_encode_free(s[k]);
+    }
+
+    for (impl = LPC10_IMPLEMENTATION_GENERIC;  impl <= LPC10_IMPLEMENTATION_AVX2;  impl++)
+    {
+        if (lpc10_set_implementation(impl) != impl)
+        {
+            printf("%s implementation not available\n", implementation_names[impl]);
+            continue;
+        }
+        /* Single channel operation */
+        memset(multi_codes, 0, sizeof(multi_codes));
+        s[0] = lpc10_encode_init(NULL, TRUE);
+        start = rdtscll();
+        lpc10_encode(s[0], multi_codes[0], multi_in[0], MULTI_FRAMES*BLOCK_LEN);
+        end = rdtscll();
+        lpc10_encode_free(s[0]);
+        if (memcmp(multi_codes[0], multi_ref_codes[0], MULTI_FRAMES*7))
+        {
+            printf("%s implementation differs from the generic one\n", implementation_names[impl]);
+            printf("Tests failed.\n");
+            exit(2);
+        }
+        printf("%-8s single channel encode %8.0f cycles/frame\n", implementation_names[impl], (double) (end - start)/MULTI_FRAMES);
+
+        /* Multi-channel operation, fed a few frames at a time */
+        memset(multi_codes, 0, sizeof(multi_codes));
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+            s[k] = lpc10_encode_init(NULL, TRUE);
+        start = rdtscll();
+        for (i = 0;  i < MULTI_FRAMES;  i += 3)
+        {
+            for (k = 0;  k < MULTI_CHANNELS;  k++)
+            {
+                in_ptr[k] = &multi_in[k][i*BLOCK_LEN];
+                codes_ptr[k] = &multi_codes[k][i*7];
+            }
+            len = lpc10_encode_multi(s, codes_ptr, in_ptr, MULTI_CHANNELS, 3*BLOCK_LEN);
+            if (len != 3*7)
+            {
+                printf("Bad multi-channel encode length %d\n", len);
+                printf("Tests failed.\n");
+                exit(2);
+            }
+        }
+        end = rdtscll();
+        for (k = 0;  k < MULTI_CHANNELS;  k++)
+            lpc10_encode_free(s[k]);
+        if (memcmp(multi_codes, multi_ref_codes, sizeof(multi_codes)))
+        {
+            printf("%s multi-channel implementation differs from single channel operation\n", implementation_names[impl]);
+            printf("Tests failed.\n");
+            exit(2);
+        }
+        printf("%-8s multi-channel encode  %8.0f cycles/frame\n", implementation_names[impl], (double) (end - start)/(MULTI_CHANNELS*MULTI_FRAMES));
+    }
+    lpc10_set_implementation(LPC10_IMPLEMENTATION_AUTO);
+
+    if (lpc10_encode_multi(s, codes_ptr, in_ptr, 0, BLOCK_LEN) != -1)
+    {
+        printf("An empty set of channels was accepted\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    if (lpc10_encode_multi(s, codes_ptr, in_ptr, MULTI_CHANNELS, BLOCK_LEN + 1) != -1)
+    {
+        printf("A partial frame was accepted\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    printf("All implementations match\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     SNDFILE *inhandle;
@@ -120,6 +268,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (!compress  &&  !decompress)
+        multi_channel_tests();
+
     compress_file = -1;
     decompress_file = -1;
     inhandle = NULL;
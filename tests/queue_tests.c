@@ -40,6 +40,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <sched.h>
+#include <sys/time.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
@@ -50,6 +51,8 @@
 #define BUF_LEN     10000
 #define MSG_LEN     17
 
+#define STRESS_BLOCKS   5000000
+
 pthread_t thread[2];
 queue_state_t *queue;
 volatile int put_oks;
@@ -60,6 +63,15 @@ volatile int got_misses;
 int total_in;
 int total_out;
 
+typedef struct
+{
+    queue_state_t *queue;
+    int messages;
+    int block_len;
+    int blocks;
+    int misses;
+} stress_state_t;
+
 static void tests_failed(void)
 {
     printf("Tests failed\n");
@@ -154,7 +166,7 @@ static void threaded_stream_tests(void)
 {
     pthread_attr_t attr;
 
-    if ((queue = queue_init(NULL, BUF_LEN, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC)) == NULL)
+    if ((queue = queue_init(NULL, BUF_LEN, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC | QUEUE_ATOMIC)) == NULL)
     {
         printf("Failed to create the queue\n");
         tests_failed();
@@ -261,7 +273,7 @@ static void threaded_message_tests(void)
 {
     pthread_attr_t attr;
 
-    if ((queue = queue_init(NULL, BUF_LEN, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC)) == NULL)
+    if ((queue = queue_init(NULL, BUF_LEN, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC | QUEUE_ATOMIC)) == NULL)
     {
         printf("Failed to create the queue\n");
         tests_failed();
@@ -287,6 +299,143 @@ static void threaded_message_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void *run_stress_write(void *arg)
+{
+    stress_state_t *st;
+    uint8_t buf[1024];
+    int i;
+    int len;
+    int next;
+    int block;
+
+    st = (stress_state_t *) arg;
+    next = 0;
+    for (block = 0;  block < st->blocks;  )
+    {
+        /* Vary the block length, so the pointers wrap at every possible offset */
+        len = (st->messages)  ?  1 + block%st->block_len  :  st->block_len;
+        for (i = 0;  i < len;  i++)
+            buf[i] = (next + i) & 0xFF;
+        if (st->messages)
+            len = queue_write_msg(st->queue, buf, len);
+        else
+            len = queue_write(st->queue, buf, len);
+        if (len > 0)
+        {
+            next = (next + len) & 0xFF;
+            block++;
+        }
+        else
+        {
+            st->misses++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *run_stress_read(void *arg)
+{
+    stress_state_t *st;
+    uint8_t buf[1024];
+    int i;
+    int len;
+    int next;
+    int block;
+
+    st = (stress_state_t *) arg;
+    next = 0;
+    for (block = 0;  block < st->blocks;  )
+    {
+        if (st->messages)
+            len = queue_read_msg(st->queue, buf, 1024);
+        else
+            len = queue_read(st->queue, buf, st->block_len);
+        if (len > 0)
+        {
+            if (len != ((st->messages)  ?  1 + block%st->block_len  :  st->block_len))
+            {
+                printf("Block %d has length %d\n", block, len);
+                tests_failed();
+            }
+            for (i = 0;  i < len;  i++)
+            {
+                if (buf[i] != ((next + i) & 0xFF))
+                {
+                    printf("Block %d byte %d is 0x%X, not 0x%X\n", block, i, buf[i], (next + i) & 0xFF);
+                    tests_failed();
+                }
+            }
+            next = (next + len) & 0xFF;
+            block++;
+        }
+        else
+        {
+            st->misses++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void threaded_stress_tests(int messages, int queue_len, int block_len, int blocks)
+{
+    pthread_t writer;
+    pthread_t reader;
+    stress_state_t write_state;
+    stress_state_t read_state;
+    struct timeval start;
+    struct timeval end;
+    double elapsed;
+    double bytes;
+
+    /* Run a writer and a reader thread flat out for a fixed amount of data, checking
+       every byte arrives intact and in order. */
+    if ((queue = queue_init(NULL, queue_len, QUEUE_READ_ATOMIC | QUEUE_WRITE_ATOMIC | QUEUE_ATOMIC)) == NULL)
+    {
+        printf("Failed to create the queue\n");
+        tests_failed();
+    }
+    write_state.queue = queue;
+    write_state.messages = messages;
+    write_state.block_len = block_len;
+    write_state.blocks = blocks;
+    write_state.misses = 0;
+    read_state = write_state;
+    gettimeofday(&start, NULL);
+    if (pthread_create(&writer, NULL, run_stress_write, &write_state)
+        ||
+        pthread_create(&reader, NULL, run_stress_read, &read_state))
+    {
+        printf("Failed to create thread\n");
+        tests_failed();
+    }
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+    gettimeofday(&end, NULL);
+    if (!queue_empty(queue))
+    {
+        printf("Queue not empty at the end of the test\n");
+        tests_failed();
+    }
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+    bytes = (messages)  ?  (double) blocks*(block_len + 1)/2.0  :  (double) blocks*block_len;
+    printf("%s mode, %d byte queue, %d byte blocks - %d blocks in %.3fs, %.1fM blocks/s, %.1fMB/s, %d/%d misses\n",
+           (messages)  ?  "Message"  :  "Stream",
+           queue_len,
+           block_len,
+           blocks,
+           elapsed,
+           blocks/elapsed/1.0e6,
+           bytes/elapsed/1.0e6,
+           write_state.misses,
+           read_state.misses);
+    queue_free(queue);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void check_contents(int total_in, int total_out)
 {
     if (queue_contents(queue) != (total_in - total_out))
@@ -693,6 +842,208 @@ static void functional_message_tests(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void fill_spans(uint8_t *buf[2], int buf_len[2], int *next)
+{
+    int i;
+    int j;
+
+    for (j = 0;  j < 2;  j++)
+    {
+        for (i = 0;  i < buf_len[j];  i++)
+        {
+            buf[j][i] = *next;
+            *next = (*next + 1) & 0xFF;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void check_spans(const uint8_t *buf[2], int buf_len[2], int len, int *next)
+{
+    int i;
+    int j;
+
+    if (buf_len[0] + buf_len[1] != len  ||  (buf_len[1]  &&  buf[1] == NULL))
+    {
+        printf("Bad spans %d + %d for %d bytes\n", buf_len[0], buf_len[1], len);
+        tests_failed();
+    }
+    for (j = 0;  j < 2;  j++)
+    {
+        for (i = 0;  i < buf_len[j];  i++)
+        {
+            if (buf[j][i] != *next)
+            {
+                printf("Read 0x%X, expected 0x%X\n", buf[j][i], *next);
+                tests_failed();
+            }
+            *next = (*next + 1) & 0xFF;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void functional_in_place_tests(void)
+{
+    uint8_t *wbuf[2];
+    const uint8_t *rbuf[2];
+    int wlen[2];
+    int rlen[2];
+    uint8_t buf[100];
+    int write_next;
+    int read_next;
+    int wrapped;
+    int len;
+    int i;
+    int j;
+
+    /* Use a small queue, so the spans wrap at every possible point */
+    if ((queue = queue_init(NULL, 97, QUEUE_ATOMIC)) == NULL)
+    {
+        printf("Failed to create the queue\n");
+        tests_failed();
+    }
+    write_next = 0;
+    read_next = 0;
+    wrapped = 0;
+    for (i = 0;  i < 10000;  i++)
+    {
+        /* Build some data in place, but only commit part of it */
+        len = queue_write_reserve(queue, wbuf, wlen, 1 + i%50);
+        if (len != 1 + i%50  &&  len != queue_free_space(queue))
+        {
+            printf("Reserved %d bytes, with %d free\n", len, queue_free_space(queue));
+            tests_failed();
+        }
+        if (wlen[1])
+            wrapped++;
+        if (len > 0)
+        {
+            if (queue_contents(queue) + len > 97)
+            {
+                printf("Reserve changed the queue\n");
+                tests_failed();
+            }
+            wlen[1] = 0;
+            if (wlen[0] > (len + 1)/2)
+                wlen[0] = (len + 1)/2;
+            fill_spans(wbuf, wlen, &write_next);
+            if (queue_write_commit(queue, wlen[0]) != wlen[0])
+            {
+                printf("Commit failed\n");
+                tests_failed();
+            }
+        }
+        /* Alternately parse in place, and read with a copy, to check the two agree */
+        if ((i & 1))
+        {
+            len = queue_read_peek(queue, rbuf, rlen, 1 + i%37);
+            check_spans(rbuf, rlen, len, &read_next);
+            if (queue_read_consume(queue, len) != len)
+            {
+                printf("Consume failed\n");
+                tests_failed();
+            }
+        }
+        else
+        {
+            len = queue_read(queue, buf, 1 + i%37);
+            for (j = 0;  j < len;  j++)
+            {
+                if (buf[j] != read_next)
+                {
+                    printf("Read 0x%X, expected 0x%X\n", buf[j], read_next);
+                    tests_failed();
+                }
+                read_next = (read_next + 1) & 0xFF;
+            }
+        }
+    }
+    if (queue_write_commit(queue, 98) >= 0  ||  queue_read_consume(queue, queue_contents(queue) + 1) >= 0)
+    {
+        printf("Over length commit or consume accepted\n");
+        tests_failed();
+    }
+    if (wrapped == 0)
+    {
+        printf("The spans never wrapped\n");
+        tests_failed();
+    }
+    queue_flush(queue);
+
+    /* Now the same with messages, mixing in place and copied access */
+    write_next = 0;
+    read_next = 0;
+    for (i = 0;  i < 10000;  i++)
+    {
+        len = 1 + i%40;
+        if ((i & 1))
+        {
+            if (queue_write_msg_reserve(queue, wbuf, wlen, len + 5) == len + 5)
+            {
+                wlen[1] = len - wlen[0];
+                if (wlen[1] < 0)
+                {
+                    wlen[0] = len;
+                    wlen[1] = 0;
+                }
+                fill_spans(wbuf, wlen, &write_next);
+                if (queue_write_msg_commit(queue, len) != len)
+                {
+                    printf("Message commit failed\n");
+                    tests_failed();
+                }
+            }
+        }
+        else
+        {
+            for (j = 0;  j < len;  j++)
+                buf[j] = (write_next + j) & 0xFF;
+            if (queue_write_msg(queue, buf, len) == len)
+                write_next = (write_next + len) & 0xFF;
+        }
+        if ((i%3) == 0)
+        {
+            if ((len = queue_read_msg_peek(queue, rbuf, rlen)) >= 0)
+            {
+                check_spans(rbuf, rlen, len, &read_next);
+                if (queue_read_msg_consume(queue) != len)
+                {
+                    printf("Message consume failed\n");
+                    tests_failed();
+                }
+            }
+        }
+        else
+        {
+            if ((len = queue_read_msg(queue, buf, 100)) >= 0)
+            {
+                for (j = 0;  j < len;  j++)
+                {
+                    if (buf[j] != read_next)
+                    {
+                        printf("Read 0x%X, expected 0x%X\n", buf[j], read_next);
+                        tests_failed();
+                    }
+                    read_next = (read_next + 1) & 0xFF;
+                }
+            }
+        }
+    }
+    while ((len = queue_read_msg_peek(queue, rbuf, rlen)) >= 0)
+    {
+        check_spans(rbuf, rlen, len, &read_next);
+        queue_read_msg_consume(queue);
+    }
+    if (read_next != write_next  ||  !queue_empty(queue))
+    {
+        printf("Messages lost\n");
+        tests_failed();
+    }
+    queue_free(queue);
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int threaded_messages;
@@ -719,6 +1070,19 @@ int main(int argc, char *argv[])
     functional_stream_tests();
     printf("Message mode functional tests\n");
     functional_message_tests();
+    printf("In place access functional tests\n");
+    functional_in_place_tests();
+
+    /* Run separate write and read threads through a fixed amount of data, to verify
+       the lock free mode is sound, and to measure its throughput. Small queues keep
+       the threads tripping over each other's pointers; larger blocks measure the
+       bulk transfer rate. */
+    printf("Threaded lock free stress tests\n");
+    threaded_stress_tests(FALSE, 61, 7, STRESS_BLOCKS);
+    threaded_stress_tests(TRUE, 101, 37, STRESS_BLOCKS);
+    threaded_stress_tests(FALSE, BUF_LEN, 16, STRESS_BLOCKS);
+    threaded_stress_tests(FALSE, BUF_LEN, 256, STRESS_BLOCKS);
+    threaded_stress_tests(TRUE, BUF_LEN, 160, STRESS_BLOCKS);
 
     /* Run separate write and read threads for a while, to verify there are no locking
        issues. */
@@ -732,6 +1096,7 @@ int main(int argc, char *argv[])
         printf("Message mode threaded tests\n");
         threaded_message_tests();
     }
+    printf("Tests passed.\n");
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
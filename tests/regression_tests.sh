@@ -244,6 +244,15 @@ then
 fi
 echo fax_tests completed OK
 
+./fir_tests >$STDOUT_DEST 2>$STDERR_DEST
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo fir_tests failed!
+    exit $RETVAL
+fi
+echo fir_tests completed OK
+
 ./fsk_tests >$STDOUT_DEST 2>$STDERR_DEST
 RETVAL=$?
 if [ $RETVAL != 0 ]
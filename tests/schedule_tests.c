@@ -25,10 +25,17 @@
 
 /*! \page schedule_tests_page Event scheduler tests
 \section schedule_tests_page_sec_1 What does it do?
-???.
+These tests check that scheduled events are called back at the right times and in the
+right order, that event IDs remain valid for deletion however the pending events are
+reordered, and measure the cost of running the scheduler with a large number of timers
+pending.
 
 \section schedule_tests_page_sec_2 How does it work?
-???.
+A pair of self rescheduling events is run for a long period, checking each callback
+occurs exactly when it should. A large set of events with random delays is then
+scheduled, some are deleted, and the time line is stepped along, checking only the
+surviving events fire, each once, in time order. Finally, 100000 self rescheduling
+timers are run for a while, and the time per event is reported.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -38,13 +45,30 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
 #include "spandsp.h"
 
+#define RANDOM_TIMERS       20000
+#define BENCHMARK_TIMERS    100000
+#define BENCHMARK_EVENTS    2000000
+
+typedef struct
+{
+    int id;
+    uint64_t when;
+    int deleted;
+    int fired;
+} test_timer_t;
+
 uint64_t when1;
 uint64_t when2;
 
+test_timer_t timers[BENCHMARK_TIMERS];
+uint64_t last_fired;
+int fired;
+
 static void callback1(span_sched_state_t *s, void *user_data)
 {
     int id;
@@ -81,20 +105,20 @@ static void callback2(span_sched_state_t *s, void *user_data)
     printf("2: Event %d, earliest is %" PRId64 "\n", id, when);
 }
 
-int main(int argc, char *argv[])
+static void basic_tests(void)
 {
     int i;
     span_sched_state_t sched;
     uint64_t when;
 
+    printf("Basic timing tests\n");
     span_schedule_init(&sched);
 
     span_schedule_event(&sched, 500000, callback1, NULL);
     span_schedule_event(&sched, 550000, callback2, NULL);
     when1 = span_schedule_time(&sched) + 500000;
     when2 = span_schedule_time(&sched) + 550000;
-    //span_schedule_del(&sched, id);
-    
+
     for (i = 0;  i < 100000000;  i += 20000)
         span_schedule_update(&sched, 20000);
     when = span_schedule_time(&sched);
@@ -104,6 +128,165 @@ int main(int argc, char *argv[])
         exit(2);
     }
     span_schedule_release(&sched);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void random_callback(span_sched_state_t *s, void *user_data)
+{
+    test_timer_t *t;
+    uint64_t when;
+
+    t = (test_timer_t *) user_data;
+    when = span_schedule_time(s);
+    if (t->deleted)
+    {
+        printf("Deleted event %d fired.\n", t->id);
+        exit(2);
+    }
+    if (t->fired)
+    {
+        printf("Event %d fired twice.\n", t->id);
+        exit(2);
+    }
+    if (t->when > when  ||  t->when < last_fired)
+    {
+        printf("Event %d due at %" PRIu64 " fired at %" PRIu64 ", after an event due at %" PRIu64 ".\n", t->id, t->when, when, last_fired);
+        exit(2);
+    }
+    t->fired = TRUE;
+    last_fired = t->when;
+    fired++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void random_tests(void)
+{
+    int i;
+    int j;
+    int delay;
+    int expected;
+    span_sched_state_t *sched;
+
+    printf("Random event ordering and deletion tests\n");
+    if ((sched = span_schedule_init(NULL)) == NULL)
+    {
+        printf("Failed to create the scheduler.\n");
+        exit(2);
+    }
+    srand(1234);
+    for (i = 0;  i < RANDOM_TIMERS;  i++)
+    {
+        /* Use a coarse grid of delays, so plenty of events share a due time */
+        delay = (rand() % 1000)*1000;
+        timers[i].when = span_schedule_time(sched) + delay;
+        timers[i].deleted = FALSE;
+        timers[i].fired = FALSE;
+        timers[i].id = span_schedule_event(sched, delay, random_callback, &timers[i]);
+        if (timers[i].id != i)
+        {
+            printf("Event %d was given ID %d.\n", i, timers[i].id);
+            exit(2);
+        }
+    }
+    /* Delete a third of the events, in a random order, after the heap has been well stirred */
+    expected = RANDOM_TIMERS;
+    for (i = 0;  i < RANDOM_TIMERS/3;  i++)
+    {
+        j = rand() % RANDOM_TIMERS;
+        if (timers[j].deleted)
+            continue;
+        span_schedule_del(sched, timers[j].id);
+        timers[j].deleted = TRUE;
+        expected--;
+    }
+    last_fired = 0;
+    fired = 0;
+    while (span_schedule_next(sched) != ~((uint64_t) 0))
+        span_schedule_update(sched, 20000);
+    if (fired != expected)
+    {
+        printf("%d events fired. %d were expected.\n", fired, expected);
+        exit(2);
+    }
+    for (i = 0;  i < RANDOM_TIMERS;  i++)
+    {
+        if (!timers[i].deleted  &&  !timers[i].fired)
+        {
+            printf("Event %d never fired.\n", i);
+            exit(2);
+        }
+    }
+    /* Free slots should be reused, rather than growing the tables */
+    for (i = 0;  i < RANDOM_TIMERS;  i++)
+    {
+        if (span_schedule_event(sched, 1000, random_callback, &timers[i]) >= RANDOM_TIMERS)
+        {
+            printf("Event IDs are not being reused.\n");
+            exit(2);
+        }
+    }
+    span_schedule_free(sched);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void benchmark_callback(span_sched_state_t *s, void *user_data)
+{
+    test_timer_t *t;
+
+    t = (test_timer_t *) user_data;
+    fired++;
+    /* Each timer restarts itself, like a protocol timer being refreshed */
+    t->id = span_schedule_event(s, 1000 + rand()%2000000, benchmark_callback, t);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void benchmark_tests(void)
+{
+    int i;
+    int deleted;
+    span_sched_state_t *sched;
+    struct timeval start;
+    struct timeval end;
+    double elapsed;
+
+    printf("Benchmark with %d timers\n", BENCHMARK_TIMERS);
+    sched = span_schedule_init(NULL);
+    srand(4321);
+    gettimeofday(&start, NULL);
+    for (i = 0;  i < BENCHMARK_TIMERS;  i++)
+        timers[i].id = span_schedule_event(sched, 1000 + rand()%2000000, benchmark_callback, &timers[i]);
+    fired = 0;
+    deleted = 0;
+    while (fired < BENCHMARK_EVENTS)
+    {
+        span_schedule_update(sched, 1000);
+        /* Cancel and restart a few timers on each tick, as a busy application would */
+        for (i = 0;  i < 10;  i++)
+        {
+            test_timer_t *t;
+
+            t = &timers[rand()%BENCHMARK_TIMERS];
+            span_schedule_del(sched, t->id);
+            t->id = span_schedule_event(sched, 1000 + rand()%2000000, benchmark_callback, t);
+            deleted++;
+        }
+    }
+    gettimeofday(&end, NULL);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+    printf("%d events fired, %d deleted, in %.3fs (%.1fns per event)\n",
+           fired,
+           deleted,
+           elapsed,
+           1.0e9*elapsed/(fired + deleted));
+    span_schedule_free(sched);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    basic_tests();
+    random_tests();
+    benchmark_tests();
 
     printf("Tests passed.\n");
     return  0;
@@ -0,0 +1,259 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * stats_tests.c
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \page stats_tests_page Performance counter tests
+\section stats_tests_page_sec_1 What does it do?
+These tests check the handling and formatting of performance counters, and that the
+objects which keep counters update them sensibly.
+
+\section stats_tests_page_sec_2 How does it work?
+Some known counter sets are formatted, and the text checked against the expected
+Prometheus output. A V.17 receiver and an echo canceller are then fed known amounts
+of audio, and their counters checked. Finally, two FAX machines are connected back
+to back for a while, and the HDLC frame counts of each side are checked against the
+other.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spandsp.h"
+
+#define SAMPLES_PER_CHUNK       160
+
+static void format_tests(void)
+{
+    span_stats_t stats[2];
+    span_stats_t total;
+    const char *labels[2];
+    char buf[4096];
+    int len;
+    static const char expected[] =
+        "# HELP test_frames_in_total Good HDLC frames received.\n"
+        "# TYPE test_frames_in_total counter\n"
+        "test_frames_in_total{chan=\"0\"} 7\n"
+        "test_frames_in_total 9\n";
+
+    printf("Format tests\n");
+    span_stats_reset(&stats[0]);
+    span_stats_reset(&stats[1]);
+    stats[0].samples_in = 8000;
+    stats[0].frames_in = 7;
+    stats[1].samples_in = 1234567890123LL;
+    stats[1].frames_in = 9;
+    stats[1].underflows = 3;
+    labels[0] = "chan=\"0\"";
+    labels[1] = NULL;
+    if ((len = span_stats_format(buf, sizeof(buf), "test", labels, stats, 2)) < 0)
+    {
+        printf("Formatting failed\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    printf("%s", buf);
+    if (len != (int) strlen(buf))
+    {
+        printf("Bad length %d - expected %d\n", len, (int) strlen(buf));
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    if (strstr(buf, expected) == NULL
+        ||
+        strstr(buf, "test_samples_in_total 1234567890123\n") == NULL
+        ||
+        strstr(buf, "test_underflows_total{chan=\"0\"} 0\n") == NULL)
+    {
+        printf("Unexpected formatted text\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    /* A buffer which is too short should be reported, without overrunning it */
+    memset(buf, 0x55, sizeof(buf));
+    if (span_stats_format(buf, len, "test", labels, stats, 2) != -1  ||  buf[len] != 0x55)
+    {
+        printf("Overflow not handled\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+
+    span_stats_reset(&total);
+    span_stats_accumulate(&total, &stats[0]);
+    span_stats_accumulate(&total, &stats[1]);
+    if (total.samples_in != 1234567898123LL  ||  total.frames_in != 16  ||  total.underflows != 3)
+    {
+        printf("Accumulation failed\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void modem_tests(void)
+{
+    v17_rx_state_t *rx;
+    echo_can_state_t *ec;
+    awgn_state_t *noise;
+    span_stats_t stats;
+    int16_t amp[SAMPLES_PER_CHUNK];
+    int16_t echo[SAMPLES_PER_CHUNK];
+    int16_t clean[SAMPLES_PER_CHUNK];
+    int i;
+    int j;
+
+    printf("Modem and echo canceller tests\n");
+    noise = awgn_init_dbm0(NULL, 1234567, -20.0f);
+    rx = v17_rx_init(NULL, 14400, NULL, NULL);
+    ec = echo_can_init(256, ECHO_CAN_USE_ADAPTION);
+    for (i = 0;  i < 100;  i++)
+    {
+        for (j = 0;  j < SAMPLES_PER_CHUNK;  j++)
+        {
+            amp[j] = awgn(noise);
+            echo[j] = amp[j] >> 2;
+        }
+        v17_rx(rx, amp, SAMPLES_PER_CHUNK);
+        echo_can_update_block(ec, amp, echo, clean, SAMPLES_PER_CHUNK);
+    }
+    v17_rx_fillin(rx, SAMPLES_PER_CHUNK);
+    v17_rx_restart(rx, 9600, FALSE);
+
+    v17_rx_get_stats(rx, &stats);
+    printf("V.17 rx - %" PRIu64 " samples, %" PRIu64 " cycles, %" PRIu64 " retrains, %" PRIu64 " underflows\n",
+           stats.samples_in,
+           stats.cycles,
+           stats.retrains,
+           stats.underflows);
+    /* The initial training counts, as well as the restart */
+    if (stats.samples_in != 100*SAMPLES_PER_CHUNK  ||  stats.retrains != 2  ||  stats.underflows != 1)
+    {
+        printf("Bad V.17 counters\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+#if defined(__GNUC__)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+    if (stats.cycles == 0)
+    {
+        printf("No cycles counted\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+#endif
+
+    echo_can_get_stats(ec, &stats);
+    printf("Echo canceller - %" PRIu64 " samples, %" PRIu64 " cycles\n", stats.samples_in, stats.cycles);
+    if (stats.samples_in != 100*SAMPLES_PER_CHUNK)
+    {
+        printf("Bad echo canceller counters\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    echo_can_update(ec, 0, 0);
+    echo_can_get_stats(ec, &stats);
+    if (stats.samples_in != 100*SAMPLES_PER_CHUNK + 1)
+    {
+        printf("Bad echo canceller counters\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    v17_rx_free(rx);
+    echo_can_free(ec);
+    awgn_free(noise);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fax_tests(void)
+{
+    fax_state_t *fax[2];
+    span_stats_t stats[2];
+    const char *labels[2];
+    int16_t amp[2][SAMPLES_PER_CHUNK];
+    char buf[4096];
+    int i;
+    int j;
+
+    printf("FAX tests\n");
+    fax[0] = fax_init(NULL, TRUE);
+    fax[1] = fax_init(NULL, FALSE);
+    for (j = 0;  j < 2;  j++)
+        fax_set_transmit_on_idle(fax[j], TRUE);
+    /* Run for long enough for the answering side's DIS to be answered */
+    for (i = 0;  i < 15*SAMPLE_RATE/SAMPLES_PER_CHUNK;  i++)
+    {
+        for (j = 0;  j < 2;  j++)
+            fax_tx(fax[j], amp[j], SAMPLES_PER_CHUNK);
+        for (j = 0;  j < 2;  j++)
+            fax_rx(fax[j], amp[j ^ 1], SAMPLES_PER_CHUNK);
+    }
+    for (j = 0;  j < 2;  j++)
+        fax_get_stats(fax[j], &stats[j]);
+    labels[0] = "side=\"caller\"";
+    labels[1] = "side=\"answerer\"";
+    if (span_stats_format(buf, sizeof(buf), "spandsp_fax", labels, stats, 2) < 0)
+    {
+        printf("Formatting failed\n");
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    printf("%s", buf);
+    for (j = 0;  j < 2;  j++)
+    {
+        if (stats[j].samples_in != 15*SAMPLE_RATE
+            ||
+            stats[j].samples_out != 15*SAMPLE_RATE
+            ||
+            stats[j].frames_out == 0
+            ||
+            stats[j].frames_in == 0
+            ||
+            stats[j].frames_in > stats[j ^ 1].frames_out
+            ||
+            stats[j].crc_errors != 0)
+        {
+            printf("Bad FAX counters\n");
+            printf("Tests failed.\n");
+            exit(2);
+        }
+    }
+    for (j = 0;  j < 2;  j++)
+        fax_free(fax[j]);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    format_tests();
+    modem_tests();
+    fax_tests();
+
+    printf("Tests passed.\n");
+    return  0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
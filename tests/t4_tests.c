@@ -28,7 +28,11 @@
 /*! \page t4_tests_page T.4 tests
 \section t4_tests_page_sec_1 What does it do
 These tests exercise the image compression and decompression methods defined
-in ITU specifications T.4 and T.6.
+in ITU specifications T.4 and T.6. The fast decode mode is checked against the
+normal bit by bit EOL scan, both for identical images and for recovery from bit
+errors, and the throughput of the two is compared. The row to run length
+implementations used by the encoders are checked to give identical encoded data,
+and their speeds are compared on the ITU test charts.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -275,6 +279,351 @@ static int detect_page_end(int bit, int page_ended)
 }
 /*- End of function --------------------------------------------------------*/
 
+typedef struct
+{
+    int rows;
+    uint32_t crc;
+} image_digest_t;
+
+static int digest_row_write_handler(void *user_data, const uint8_t buf[], size_t len)
+{
+    image_digest_t *digest;
+
+    digest = (image_digest_t *) user_data;
+    if (len == 0)
+        return 0;
+    digest->rows++;
+    digest->crc = crc_itu32_calc(buf, len, digest->crc);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_page(const uint8_t *page, int len, int compression, int width, int fast, image_digest_t *digest, uint64_t *ticks)
+{
+    t4_rx_state_t rx;
+    t4_stats_t stats;
+    uint64_t start;
+    int page_ended;
+
+    if (t4_rx_init(&rx, OUT_FILE_NAME, T4_COMPRESSION_ITU_T4_2D) == NULL)
+    {
+        printf("Failed to init T.4 rx\n");
+        exit(2);
+    }
+    digest->rows = 0;
+    digest->crc = 0xFFFFFFFF;
+    t4_rx_set_row_write_handler(&rx, digest_row_write_handler, digest);
+    t4_rx_set_image_width(&rx, width);
+    t4_rx_set_rx_encoding(&rx, compression);
+    t4_rx_set_fast_decode(&rx, fast);
+    t4_rx_start_page(&rx);
+    start = rdtscll();
+    page_ended = t4_rx_put_chunk(&rx, page, len);
+    *ticks += rdtscll() - start;
+    t4_rx_get_transfer_statistics(&rx, &stats);
+    t4_rx_end_page(&rx);
+    t4_rx_release(&rx);
+    if (!page_ended)
+    {
+        printf("Receiver missed the end of page mark\n");
+        exit(2);
+    }
+    return stats.bad_rows;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fast_decode_tests(const char *in_file_name, int min_row_bits)
+{
+    static const int compressions[] =
+    {
+        T4_COMPRESSION_ITU_T4_1D,
+        T4_COMPRESSION_ITU_T4_2D,
+        T4_COMPRESSION_ITU_T6,
+        -1
+    };
+    image_digest_t digest[2];
+    uint64_t ticks[2];
+    uint8_t *page;
+    uint8_t *damaged;
+    int page_len;
+    int page_size;
+    int width;
+    int bad_rows[2];
+    int len;
+    int i;
+    int j;
+    int fast;
+
+    printf("Testing fast decoding against the bit by bit EOL scan\n");
+    page_size = 1000000;
+    if ((page = (uint8_t *) malloc(page_size)) == NULL  ||  (damaged = (uint8_t *) malloc(page_size)) == NULL)
+    {
+        printf("Failed to allocate memory\n");
+        exit(2);
+    }
+    for (i = 0;  compressions[i] >= 0;  i++)
+    {
+        /* Compress the first page of the test file once */
+        if (t4_tx_init(&send_state, in_file_name, -1, -1) == NULL)
+        {
+            printf("Failed to init T.4 send\n");
+            exit(2);
+        }
+        t4_tx_set_min_bits_per_row(&send_state, min_row_bits);
+        t4_tx_set_tx_encoding(&send_state, compressions[i]);
+        if (t4_tx_start_page(&send_state))
+        {
+            printf("Failed to start T.4 send page\n");
+            exit(2);
+        }
+        width = t4_tx_get_image_width(&send_state);
+        page_len = 0;
+        while ((len = t4_tx_get_chunk(&send_state, &page[page_len], page_size - page_len)) > 0)
+        {
+            page_len += len;
+            if (page_len >= page_size)
+            {
+                printf("Compressed page too long\n");
+                exit(2);
+            }
+        }
+        t4_tx_end_page(&send_state);
+        t4_tx_release(&send_state);
+
+        /* Decode it repeatedly, scanning bit by bit and fast, and check the images match */
+        for (fast = 0;  fast < 2;  fast++)
+        {
+            ticks[fast] = 0;
+            for (j = 0;  j < 20;  j++)
+            {
+                if (decode_page(page, page_len, compressions[i], width, fast, &digest[fast], &ticks[fast]))
+                {
+                    printf("Bad rows in an error free image\n");
+                    exit(2);
+                }
+            }
+        }
+        printf("%s: %d bytes, %d rows, bit by bit %.2f ticks/byte, fast %.2f ticks/byte, %.1fx\n",
+               t4_encoding_to_str(compressions[i]),
+               page_len,
+               digest[0].rows,
+               (double) ticks[0]/(20.0*page_len),
+               (double) ticks[1]/(20.0*page_len),
+               (double) ticks[0]/ticks[1]);
+        if (digest[0].rows != digest[1].rows  ||  digest[0].crc != digest[1].crc)
+        {
+            printf("Fast decoding produced a different image\n");
+            exit(2);
+        }
+
+        if (compressions[i] != T4_COMPRESSION_ITU_T6)
+        {
+            /* Add some bit errors, and check the fast decoder recovers from them at exactly
+               the same EOLs as the bit by bit scan */
+            memcpy(damaged, page, page_len);
+            srand(1234567);
+            for (j = 0;  j < 20;  j++)
+                damaged[page_len/4 + rand()%(page_len/2)] ^= (1 << (rand() & 7));
+            bad_rows[0] = decode_page(damaged, page_len, compressions[i], width, FALSE, &digest[0], &ticks[0]);
+            printf("With bit errors, bit by bit - %d rows, %d bad\n", digest[0].rows, bad_rows[0]);
+            bad_rows[1] = decode_page(damaged, page_len, compressions[i], width, TRUE, &digest[1], &ticks[1]);
+            printf("With bit errors, fast - %d rows, %d bad\n", digest[1].rows, bad_rows[1]);
+            if (bad_rows[1] == 0  ||  bad_rows[1] != bad_rows[0]  ||  digest[1].rows != digest[0].rows)
+            {
+                printf("Fast decoding did not recover from bit errors\n");
+                exit(2);
+            }
+        }
+    }
+    free(damaged);
+    free(page);
+}
+/*- End of function --------------------------------------------------------*/
+
+typedef struct
+{
+    uint8_t *image;
+    int bytes_per_row;
+    int rows;
+    int row;
+} page_image_t;
+
+static int image_row_write_handler(void *user_data, const uint8_t buf[], size_t len)
+{
+    page_image_t *page;
+
+    page = (page_image_t *) user_data;
+    if (len == 0)
+        return 0;
+    memcpy(&page->image[page->rows*len], buf, len);
+    page->bytes_per_row = len;
+    page->rows++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int image_row_read_handler(void *user_data, uint8_t buf[], size_t len)
+{
+    page_image_t *page;
+
+    page = (page_image_t *) user_data;
+    if (page->row >= page->rows)
+        return 0;
+    memcpy(buf, &page->image[page->row*len], len);
+    page->row++;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_image(const char *in_file_name, int page_no, page_image_t *page, int compression, uint8_t *buf, int buf_size, int *width, uint64_t *ticks)
+{
+    uint64_t start;
+    int total;
+    int len;
+
+    if (t4_tx_init(&send_state, in_file_name, page_no, page_no) == NULL)
+    {
+        printf("Failed to init T.4 send\n");
+        exit(2);
+    }
+    t4_tx_set_tx_encoding(&send_state, compression);
+    if (page)
+    {
+        page->row = 0;
+        t4_tx_set_row_read_handler(&send_state, image_row_read_handler, page);
+    }
+    /* The whole page is encoded as it is started, so that is what we time */
+    start = rdtscll();
+    if (t4_tx_start_page(&send_state))
+    {
+        printf("Failed to start T.4 send page\n");
+        exit(2);
+    }
+    *ticks += rdtscll() - start;
+    *width = t4_tx_get_image_width(&send_state);
+    total = 0;
+    while ((len = t4_tx_get_chunk(&send_state, &buf[total], buf_size - total)) > 0)
+    {
+        total += len;
+        if (total >= buf_size)
+        {
+            printf("Compressed page too long\n");
+            exit(2);
+        }
+    }
+    t4_tx_end_page(&send_state);
+    t4_tx_release(&send_state);
+    return total;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void run_length_tests(const char *in_file_name)
+{
+    static const int compressions[] =
+    {
+        T4_COMPRESSION_ITU_T4_1D,
+        T4_COMPRESSION_ITU_T4_2D,
+        T4_COMPRESSION_ITU_T6,
+        -1
+    };
+    static const char *implementation_names[] =
+    {
+        "auto",
+        "32 bit words",
+        "64 bit words",
+        "AVX2"
+    };
+    t4_rx_state_t rx;
+    page_image_t page;
+    uint64_t ticks;
+    uint8_t *ref;
+    uint8_t *buf;
+    int ref_len;
+    int len;
+    int buf_size;
+    int width;
+    int pages;
+    int page_no;
+    int i;
+    int j;
+    int implementation;
+
+    printf("Testing the row to run length implementations\n");
+    buf_size = 1000000;
+    if ((ref = (uint8_t *) malloc(buf_size)) == NULL
+        ||
+        (buf = (uint8_t *) malloc(buf_size)) == NULL
+        ||
+        (page.image = (uint8_t *) malloc(4000*1024)) == NULL)
+    {
+        printf("Failed to allocate memory\n");
+        exit(2);
+    }
+    if (t4_tx_init(&send_state, in_file_name, -1, -1) == NULL)
+    {
+        printf("Failed to init T.4 send\n");
+        exit(2);
+    }
+    pages = t4_tx_get_pages_in_file(&send_state);
+    t4_tx_release(&send_state);
+    for (page_no = 0;  page_no < pages;  page_no++)
+    {
+        /* Unpack the page into memory, so the timings below only cover the encoding */
+        ticks = 0;
+        len = encode_image(in_file_name, page_no, NULL, T4_COMPRESSION_ITU_T6, buf, buf_size, &width, &ticks);
+        if (t4_rx_init(&rx, OUT_FILE_NAME, T4_COMPRESSION_ITU_T4_2D) == NULL)
+        {
+            printf("Failed to init T.4 rx\n");
+            exit(2);
+        }
+        page.rows = 0;
+        t4_rx_set_row_write_handler(&rx, image_row_write_handler, &page);
+        t4_rx_set_image_width(&rx, width);
+        t4_rx_set_rx_encoding(&rx, T4_COMPRESSION_ITU_T6);
+        t4_rx_start_page(&rx);
+        t4_rx_put_chunk(&rx, buf, len);
+        t4_rx_end_page(&rx);
+        t4_rx_release(&rx);
+        printf("Page %d: %d rows of %d bytes\n", page_no, page.rows, page.bytes_per_row);
+
+        for (i = 0;  compressions[i] >= 0;  i++)
+        {
+            ref_len = -1;
+            for (implementation = T4_TX_IMPLEMENTATION_WORD32;  implementation <= T4_TX_IMPLEMENTATION_AVX2;  implementation++)
+            {
+                if (t4_tx_set_implementation(implementation) < 0)
+                {
+                    printf("%s: %s not available on this machine\n", t4_encoding_to_str(compressions[i]), implementation_names[implementation]);
+                    continue;
+                }
+                ticks = 0;
+                for (j = 0;  j < 10;  j++)
+                    len = encode_image(in_file_name, page_no, &page, compressions[i], buf, buf_size, &width, &ticks);
+                printf("%s: %s - %d bytes, %.1f ticks/row\n",
+                       t4_encoding_to_str(compressions[i]),
+                       implementation_names[implementation],
+                       len,
+                       (double) ticks/(10.0*page.rows));
+                if (ref_len < 0)
+                {
+                    memcpy(ref, buf, len);
+                    ref_len = len;
+                }
+                else if (len != ref_len  ||  memcmp(ref, buf, len))
+                {
+                    printf("The %s implementation produced different encoded data\n", implementation_names[implementation]);
+                    exit(2);
+                }
+            }
+        }
+    }
+    t4_tx_set_implementation(T4_TX_IMPLEMENTATION_AUTO);
+    free(page.image);
+    free(buf);
+    free(ref);
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     static const int compression_sequence[] =
@@ -662,6 +1011,8 @@ int main(int argc, char *argv[])
         t4_tx_release(&send_state);
         t4_rx_release(&receive_state);
 #endif
+        fast_decode_tests(in_file_name, min_row_bits);
+        run_length_tests(in_file_name);
 #if 1
         printf("Testing TIFF->compress->decompress->TIFF cycle\n");
         /* Send end gets TIFF from a file */
@@ -25,6 +25,9 @@
 
 /*! \page tone_detect_tests_page Tone detection tests
 \section tone_detect_tests_page_sec_1 What does it do?
+These tests check that a Goertzel bank gives exactly the same results as a set
+of separate Goertzel filters, for a range of bank sizes and update lengths, and
+measure how much faster the bank is. They then check the periodogram routines.
 */
 
 #if defined(HAVE_CONFIG_H)
@@ -50,6 +53,118 @@
 #define PG_WINDOW           56
 #define FREQ1               440.0f
 #define FREQ2               480.0f
+#define GOERTZEL_SAMPLES    205
+
+static int goertzel_bank_tests(void)
+{
+    static const int freq_counts[] =
+    {
+        1, 2, 6, 8, 9, 16, 17, 31, GOERTZEL_BANK_MAX_FREQS, -1
+    };
+    goertzel_descriptor_t desc[GOERTZEL_BANK_MAX_FREQS];
+    goertzel_state_t state[GOERTZEL_BANK_MAX_FREQS];
+    goertzel_bank_state_t bank;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t result[GOERTZEL_BANK_MAX_FREQS];
+    int32_t energy;
+    int32_t expected_energy;
+#else
+    float result[GOERTZEL_BANK_MAX_FREQS];
+    float energy;
+    float expected_energy;
+    float x;
+#endif
+    int16_t amp[GOERTZEL_SAMPLES];
+    awgn_state_t noise_source;
+    uint64_t start;
+    uint64_t separate_cycles;
+    uint64_t bank_cycles;
+    int freqs;
+    int block;
+    int len;
+    int i;
+    int j;
+    int k;
+
+    printf("Goertzel bank tests\n");
+    awgn_init_dbm0(&noise_source, 1234567, -10.0f);
+    for (k = 0;  freq_counts[k] > 0;  k++)
+    {
+        freqs = freq_counts[k];
+        for (i = 0;  i < freqs;  i++)
+        {
+            make_goertzel_descriptor(&desc[i], 300.0f + 3300.0f*i/GOERTZEL_BANK_MAX_FREQS, GOERTZEL_SAMPLES);
+            goertzel_init(&state[i], &desc[i]);
+        }
+        if (goertzel_bank_init(&bank, desc, freqs) == NULL)
+        {
+            printf("Failed to create a bank of %d Goertzels\n", freqs);
+            return -1;
+        }
+        separate_cycles = 0;
+        bank_cycles = 0;
+        for (block = 0;  block < 100;  block++)
+        {
+            for (i = 0;  i < GOERTZEL_SAMPLES;  i++)
+                amp[i] = awgn(&noise_source);
+            /* Use an update length which does not fit the block length */
+            for (i = 0;  i < GOERTZEL_SAMPLES;  i += len)
+            {
+                len = (GOERTZEL_SAMPLES - i > 37)  ?  37  :  (GOERTZEL_SAMPLES - i);
+                start = rdtscll();
+                for (j = 0;  j < freqs;  j++)
+                    goertzel_update(&state[j], &amp[i], len);
+                separate_cycles += rdtscll() - start;
+                start = rdtscll();
+                if (goertzel_bank_update(&bank, &amp[i], len) != len)
+                {
+                    printf("Goertzel bank stopped short\n");
+                    return -1;
+                }
+                bank_cycles += rdtscll() - start;
+            }
+            energy = goertzel_bank_result(&bank, result);
+            for (j = 0;  j < freqs;  j++)
+            {
+#if defined(SPANDSP_USE_FIXED_POINT)
+                if (result[j] != goertzel_result(&state[j]))
+#else
+                /* The bank and the separate filters do the same arithmetic, but with
+                   -ffast-math the compiler may order the additions differently. */
+                x = goertzel_result(&state[j]);
+                if (fabsf(result[j] - x) > 1.0e-4f*(fabsf(x) + 1.0f))
+#endif
+                {
+                    printf("Goertzel bank of %d differs at frequency %d\n", freqs, j);
+                    return -1;
+                }
+            }
+            expected_energy = 0;
+            for (i = 0;  i < GOERTZEL_SAMPLES;  i++)
+                expected_energy += goertzel_preadjust_amp(amp[i])*goertzel_preadjust_amp(amp[i]);
+#if defined(SPANDSP_USE_FIXED_POINT)
+            if (energy != expected_energy)
+#else
+            if (fabsf(energy - expected_energy) > 1.0e-4f*expected_energy)
+#endif
+            {
+                printf("Goertzel bank energy is wrong\n");
+                return -1;
+            }
+        }
+        printf("%2d frequencies: %7.1f cycles/sample in a bank, vs %7.1f separately\n",
+               freqs,
+               (double) bank_cycles/(100*GOERTZEL_SAMPLES),
+               (double) separate_cycles/(100*GOERTZEL_SAMPLES));
+    }
+    if (goertzel_bank_init(&bank, desc, GOERTZEL_BANK_MAX_FREQS + 1))
+    {
+        printf("Oversized Goertzel bank accepted\n");
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
 
 static int periodogram_tests(void)
 {
@@ -133,6 +248,8 @@ static int periodogram_tests(void)
 
 int main(int argc, char *argv[])
 {
+    if (goertzel_bank_tests())
+        exit(2);
     if (periodogram_tests())
         exit(2);
     printf("Tests passed\n");